@@ -1,20 +1,24 @@
 #include "stdafx.h"
 #include "LBApplication.h"
 #include "LBRenderer.h"
+#include "LBD3D12Backend.h"
 #include "LBScene.h"
+#include "LBShaderCache.h"
 
 namespace LB
 {
-	Application::Application() : _width(1280), _height(720), _title(L"leapBoxing 15"), _renderer(nullptr)
+	Application::Application() : _width(1280), _height(720), _title(L"leapBoxing 15"), _backend(nullptr), _renderer(nullptr), _scene(nullptr), _running(false)
 	{
 		WCHAR assetsPath[512];
 		GetAssetsPath(assetsPath, _countof(assetsPath));
 		_assetsPath = assetsPath;
+
+		_shaderCache = new ShaderCache(_assetsPath + L"ShaderCache");
 	}
 
 	Application::~Application()
 	{
-
+		delete _shaderCache;
 	}
 
 	bool Application::OnEvent(MSG)
@@ -53,9 +57,22 @@ namespace LB
 
 		ShowWindow(_hwnd, nCmdShow);
 
-		_renderer = new Renderer(_hwnd, false);
+		_backend = new D3D12Backend(_hwnd, false);
+		_renderer = new Renderer(_backend);
+
+		std::chrono::high_resolution_clock::time_point sceneStart = std::chrono::high_resolution_clock::now();
+		SetScene(new LB::Scene(_renderer));
+		const double sceneMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - sceneStart).count();
+
+		// Startup cost of the shaders, compare a run with an empty shader cache to
+		// one after -precompileshaders.
+		const ShaderCacheStatistics shaderStatistics = _shaderCache->GetStatistics();
+		wchar_t message[256];
+		swprintf_s(message, L"Scene loaded in %.1f ms, shaders: %u compiled in %.1f ms, %u loaded in %.1f ms, %u shared\n", sceneMilliseconds, shaderStatistics.misses, shaderStatistics.compileMilliseconds, shaderStatistics.diskHits, shaderStatistics.loadMilliseconds, shaderStatistics.memoryHits);
+		OutputDebugString(message);
 
-		SetScene(new LB::Scene());
+		_running = true;
+		_simulationThread = std::thread(&Application::SimulationLoop, this);
 
 		// Main sample loop.
 		MSG msg = { 0 };
@@ -73,20 +90,66 @@ namespace LB
 				// Pass events into our sample.
 				OnEvent(msg);
 			}
+			else
+			{
+				// Wait for the frame first, so the snapshot picked up is the newest one
+				// available once the GPU can take another frame. The frame stays started
+				// until it is rendered, so without a snapshot the wait returns right away
+				// and the loop blocks on the simulation instead, with a timeout to keep
+				// the window responsive if it stalls.
+				_renderer->WaitForNextFrame();
+
+				const RenderSnapshot *snapshot = _snapshots.Acquire(SnapshotTimeout);
+				if(snapshot)
+				{
+					_renderer->Render(*snapshot);
+					_snapshots.Release();
+				}
+			}
 		}
 
+		_running = false;
+		_snapshots.Shutdown();
+		_simulationThread.join();
+
+		// The scene frees its meshes and buffers through the renderer.
+		delete _scene;
+		_scene = nullptr;
+
 		delete _renderer;
 		_renderer = nullptr;
 
+		delete _backend;
+		_backend = nullptr;
+
 		// Return this part of the WM_QUIT message to Windows.
 		return static_cast<char>(msg.wParam);
 	}
 
+	int Application::PrecompileShaders()
+	{
+		// Shaders that aren't deployed next to the executable are skipped, they
+		// get compiled when first used instead.
+		const LPCWSTR shaderFiles[] = { L"shaders.hlsl" };
+		for(LPCWSTR shaderFile : shaderFiles)
+		{
+			if(GetFileAttributesW(GetPathForAsset(shaderFile).c_str()) != INVALID_FILE_ATTRIBUTES)
+				D3D12Backend::PrecompileShaders(shaderFile);
+		}
+
+		return 0;
+	}
+
 	Renderer *Application::GetRenderer()
 	{
 		return _renderer;
 	}
 
+	ShaderCache *Application::GetShaderCache()
+	{
+		return _shaderCache;
+	}
+
 	std::wstring Application::GetPathForAsset(LPCWSTR filename)
 	{
 		return _assetsPath + filename;
@@ -97,6 +160,22 @@ namespace LB
 		_scene = scene;
 	}
 
+	void Application::SimulationLoop()
+	{
+		std::chrono::high_resolution_clock::time_point lastUpdate = std::chrono::high_resolution_clock::now();
+
+		while(_running)
+		{
+			std::chrono::high_resolution_clock::time_point now = std::chrono::high_resolution_clock::now();
+			float delta = std::chrono::duration<float>(now - lastUpdate).count();
+			lastUpdate = now;
+
+			_scene->Update(delta);
+			_scene->Extract(_snapshots.BeginWrite());
+			_snapshots.Publish();
+		}
+	}
+
 	// Main message handler for the sample.
 	LRESULT CALLBACK Application::WindowProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam)
 	{
@@ -113,10 +192,9 @@ namespace LB
 		return 0;
 
 		case WM_PAINT:
-			if(application && application->GetRenderer() && application->_scene)
-			{
-				application->GetRenderer()->Render(application->_scene->_entities);
-			}
+			// Frames are rendered from the main loop as soon as a new snapshot is
+			// published, so there is nothing left to do but validating the window.
+			ValidateRect(hWnd, nullptr);
 			return 0;
 
 		case WM_SIZE:
@@ -1,9 +1,17 @@
 #pragma once
 
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include "LBRenderSnapshot.h"
+
 namespace LB
 {
 	class Renderer;
+	class D3D12Backend;
 	class Scene;
+	class ShaderCache;
 
 	class Application
 	{
@@ -16,7 +24,12 @@ namespace LB
 
 		int Run(HINSTANCE hInstance, int nCmdShow);
 
+		// Compiles all shaders into the shader cache without opening a window,
+		// used as a build step.
+		int PrecompileShaders();
+
 		Renderer *GetRenderer();
+		ShaderCache *GetShaderCache();
 		std::wstring GetPathForAsset(LPCWSTR filename);
 
 		void SetScene(Scene *scene);
@@ -29,8 +42,12 @@ namespace LB
 		void operator=(Application const&) = delete;
 
 		bool OnEvent(MSG);
+		void SimulationLoop();
 		static LRESULT CALLBACK WindowProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam);
 
+		// Longest the main loop waits for a snapshot before handling messages again.
+		static const uint32_t SnapshotTimeout = 10;
+
 		UINT _width;
 		UINT _height;
 		float _aspectRatio;
@@ -38,7 +55,15 @@ namespace LB
 		std::wstring _title;
 		std::wstring _assetsPath;
 
+		D3D12Backend *_backend;
 		Renderer *_renderer;
 		Scene *_scene;
+		ShaderCache *_shaderCache;
+
+		// The simulation thread updates the scene and extracts frame N+1 into
+		// _snapshots while the main thread renders frame N.
+		std::thread _simulationThread;
+		std::atomic<bool> _running;
+		RenderSnapshotBuffer _snapshots;
 	};
 }
\ No newline at end of file
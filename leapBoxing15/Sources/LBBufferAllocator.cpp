@@ -0,0 +1,450 @@
+#if defined(_WIN32)
+#include "stdafx.h"
+#endif
+
+#include "LBBufferAllocator.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace LB
+{
+	namespace
+	{
+		// Index of the highest set bit, v must not be 0.
+		uint32_t HighestBit(uint64_t v)
+		{
+#if defined(_MSC_VER) && defined(_WIN64)
+			unsigned long index;
+			_BitScanReverse64(&index, v);
+			return index;
+#elif defined(_MSC_VER)
+			unsigned long index;
+			if(_BitScanReverse(&index, static_cast<uint32_t>(v >> 32)))
+				return index + 32;
+			_BitScanReverse(&index, static_cast<uint32_t>(v));
+			return index;
+#else
+			return 63 - __builtin_clzll(v);
+#endif
+		}
+
+		// Index of the lowest set bit, v must not be 0.
+		uint32_t LowestBit(uint64_t v)
+		{
+#if defined(_MSC_VER) && defined(_WIN64)
+			unsigned long index;
+			_BitScanForward64(&index, v);
+			return index;
+#elif defined(_MSC_VER)
+			unsigned long index;
+			if(_BitScanForward(&index, static_cast<uint32_t>(v)))
+				return index;
+			_BitScanForward(&index, static_cast<uint32_t>(v >> 32));
+			return index + 32;
+#else
+			return __builtin_ctzll(v);
+#endif
+		}
+	}
+
+	const uint32_t TlsfAllocator::InvalidBlock;
+
+	TlsfAllocator::TlsfAllocator(uint64_t size, uint64_t granularity) : _size(size - size % granularity), _granularity(granularity), _usedSize(0), _allocationCount(0), _freeBlockCount(0), _firstLevelBitmap(0)
+	{
+		assert(granularity > 0 && (granularity & (granularity - 1)) == 0);
+
+		memset(_secondLevelBitmaps, 0, sizeof(_secondLevelBitmaps));
+		std::fill(&_freeLists[0][0], &_freeLists[0][0] + FirstLevelCount * SecondLevelCount, InvalidBlock);
+
+		_firstBlock = CreateBlock(0, _size);
+		InsertFreeBlock(_firstBlock);
+	}
+
+	void TlsfAllocator::Mapping(uint64_t size, uint32_t &firstLevel, uint32_t &secondLevel)
+	{
+		if(size < SecondLevelCount)
+		{
+			firstLevel = 0;
+			secondLevel = static_cast<uint32_t>(size);
+			return;
+		}
+
+		const uint32_t highestBit = HighestBit(size);
+		firstLevel = highestBit - SecondLevelLog2 + 1;
+		secondLevel = static_cast<uint32_t>(size >> (highestBit - SecondLevelLog2)) - SecondLevelCount;
+	}
+
+	uint32_t TlsfAllocator::CreateBlock(uint64_t offset, uint64_t size)
+	{
+		uint32_t index;
+		if(!_unusedBlocks.empty())
+		{
+			index = _unusedBlocks.back();
+			_unusedBlocks.pop_back();
+		}
+		else
+		{
+			index = static_cast<uint32_t>(_blocks.size());
+			_blocks.emplace_back();
+		}
+
+		Block &block = _blocks[index];
+		block.offset = offset;
+		block.size = size;
+		block.previousPhysical = InvalidBlock;
+		block.nextPhysical = InvalidBlock;
+		block.previousFree = InvalidBlock;
+		block.nextFree = InvalidBlock;
+		block.userData = nullptr;
+		block.free = false;
+
+		return index;
+	}
+
+	void TlsfAllocator::ReleaseBlock(uint32_t block)
+	{
+		_unusedBlocks.push_back(block);
+	}
+
+	uint32_t TlsfAllocator::FindFreeBlock(uint64_t size) const
+	{
+		// Round up to the next size class, so every block in the class found fits.
+		uint64_t classSize = size;
+		if(classSize >= SecondLevelCount)
+			classSize += (1ull << (HighestBit(classSize) - SecondLevelLog2)) - 1;
+
+		uint32_t firstLevel, secondLevel;
+		Mapping(classSize, firstLevel, secondLevel);
+
+		uint32_t secondLevelMap = (firstLevel < FirstLevelCount) ? _secondLevelBitmaps[firstLevel] & (~0u << secondLevel) : 0;
+		const uint64_t firstLevelMap = (firstLevel + 1 < FirstLevelCount) ? _firstLevelBitmap & (~0ull << (firstLevel + 1)) : 0;
+		if(secondLevelMap)
+			return _freeLists[firstLevel][LowestBit(secondLevelMap)];
+
+		if(firstLevelMap)
+		{
+			firstLevel = LowestBit(firstLevelMap);
+			return _freeLists[firstLevel][LowestBit(_secondLevelBitmaps[firstLevel])];
+		}
+
+		// Only blocks in the class of the size itself are left, some of them may
+		// still be large enough. Mostly hit by pages sized for one allocation.
+		Mapping(size, firstLevel, secondLevel);
+		if(firstLevel >= FirstLevelCount)
+			return InvalidBlock;
+
+		for(uint32_t index = _freeLists[firstLevel][secondLevel]; index != InvalidBlock; index = _blocks[index].nextFree)
+		{
+			if(_blocks[index].size >= size)
+				return index;
+		}
+
+		return InvalidBlock;
+	}
+
+	void TlsfAllocator::InsertFreeBlock(uint32_t index)
+	{
+		Block &block = _blocks[index];
+
+		uint32_t firstLevel, secondLevel;
+		Mapping(block.size, firstLevel, secondLevel);
+
+		const uint32_t head = _freeLists[firstLevel][secondLevel];
+		block.free = true;
+		block.previousFree = InvalidBlock;
+		block.nextFree = head;
+		if(head != InvalidBlock)
+			_blocks[head].previousFree = index;
+
+		_freeLists[firstLevel][secondLevel] = index;
+		_firstLevelBitmap |= 1ull << firstLevel;
+		_secondLevelBitmaps[firstLevel] |= 1u << secondLevel;
+		_freeBlockCount++;
+	}
+
+	void TlsfAllocator::RemoveFreeBlock(uint32_t index)
+	{
+		Block &block = _blocks[index];
+
+		uint32_t firstLevel, secondLevel;
+		Mapping(block.size, firstLevel, secondLevel);
+
+		if(block.previousFree != InvalidBlock)
+			_blocks[block.previousFree].nextFree = block.nextFree;
+		if(block.nextFree != InvalidBlock)
+			_blocks[block.nextFree].previousFree = block.previousFree;
+
+		if(_freeLists[firstLevel][secondLevel] == index)
+		{
+			_freeLists[firstLevel][secondLevel] = block.nextFree;
+			if(block.nextFree == InvalidBlock)
+			{
+				_secondLevelBitmaps[firstLevel] &= ~(1u << secondLevel);
+				if(!_secondLevelBitmaps[firstLevel])
+					_firstLevelBitmap &= ~(1ull << firstLevel);
+			}
+		}
+
+		block.free = false;
+		block.previousFree = InvalidBlock;
+		block.nextFree = InvalidBlock;
+		_freeBlockCount--;
+	}
+
+	uint32_t TlsfAllocator::Allocate(uint64_t size, void *userData)
+	{
+		size = std::max((size + _granularity - 1) & ~(_granularity - 1), _granularity);
+
+		const uint32_t index = FindFreeBlock(size);
+		if(index == InvalidBlock)
+			return InvalidBlock;
+
+		RemoveFreeBlock(index);
+
+		// Return the rest of the block to the free lists.
+		if(_blocks[index].size > size)
+		{
+			const uint32_t rest = CreateBlock(_blocks[index].offset + size, _blocks[index].size - size);
+
+			Block &block = _blocks[index];
+			Block &restBlock = _blocks[rest];
+			restBlock.previousPhysical = index;
+			restBlock.nextPhysical = block.nextPhysical;
+			if(block.nextPhysical != InvalidBlock)
+				_blocks[block.nextPhysical].previousPhysical = rest;
+
+			block.nextPhysical = rest;
+			block.size = size;
+
+			InsertFreeBlock(rest);
+		}
+
+		Block &block = _blocks[index];
+		block.userData = userData;
+
+		_usedSize += block.size;
+		_allocationCount++;
+
+		return index;
+	}
+
+	void TlsfAllocator::Free(uint32_t index)
+	{
+		assert(index < _blocks.size() && !_blocks[index].free);
+
+		_usedSize -= _blocks[index].size;
+		_allocationCount--;
+		_blocks[index].userData = nullptr;
+
+		// Merge with the following block.
+		const uint32_t next = _blocks[index].nextPhysical;
+		if(next != InvalidBlock && _blocks[next].free)
+		{
+			RemoveFreeBlock(next);
+
+			Block &block = _blocks[index];
+			block.size += _blocks[next].size;
+			block.nextPhysical = _blocks[next].nextPhysical;
+			if(block.nextPhysical != InvalidBlock)
+				_blocks[block.nextPhysical].previousPhysical = index;
+
+			ReleaseBlock(next);
+		}
+
+		// And with the preceding one, which then takes the place of this block.
+		const uint32_t previous = _blocks[index].previousPhysical;
+		if(previous != InvalidBlock && _blocks[previous].free)
+		{
+			RemoveFreeBlock(previous);
+
+			Block &block = _blocks[previous];
+			block.size += _blocks[index].size;
+			block.nextPhysical = _blocks[index].nextPhysical;
+			if(block.nextPhysical != InvalidBlock)
+				_blocks[block.nextPhysical].previousPhysical = previous;
+
+			ReleaseBlock(index);
+			index = previous;
+		}
+
+		InsertFreeBlock(index);
+	}
+
+	uint64_t TlsfAllocator::GetLargestFreeBlock() const
+	{
+		if(!_firstLevelBitmap)
+			return 0;
+
+		// Only the highest non empty class has to be searched.
+		const uint32_t firstLevel = HighestBit(_firstLevelBitmap);
+		const uint32_t secondLevel = HighestBit(_secondLevelBitmaps[firstLevel]);
+
+		uint64_t largest = 0;
+		for(uint32_t index = _freeLists[firstLevel][secondLevel]; index != InvalidBlock; index = _blocks[index].nextFree)
+			largest = std::max(largest, _blocks[index].size);
+
+		return largest;
+	}
+
+	uint32_t TlsfAllocator::Defragment(uint32_t maxMoves, std::vector<Move> &moves)
+	{
+		uint32_t moveCount = 0;
+		uint32_t index = _firstBlock;
+
+		while(index != InvalidBlock && moveCount < maxMoves)
+		{
+			const uint32_t next = _blocks[index].nextPhysical;
+			if(!_blocks[index].free || next == InvalidBlock || _blocks[next].free)
+			{
+				index = next;
+				continue;
+			}
+
+			// Swap the free block with the used one following it.
+			RemoveFreeBlock(index);
+
+			Block &freeBlock = _blocks[index];
+			Block &usedBlock = _blocks[next];
+
+			Move move;
+			move.block = next;
+			move.oldOffset = usedBlock.offset;
+			move.newOffset = freeBlock.offset;
+			move.size = usedBlock.size;
+			move.userData = usedBlock.userData;
+			moves.push_back(move);
+			moveCount++;
+
+			usedBlock.offset = freeBlock.offset;
+			freeBlock.offset = usedBlock.offset + usedBlock.size;
+
+			usedBlock.previousPhysical = freeBlock.previousPhysical;
+			if(usedBlock.previousPhysical != InvalidBlock)
+				_blocks[usedBlock.previousPhysical].nextPhysical = next;
+			else
+				_firstBlock = next;
+
+			freeBlock.nextPhysical = usedBlock.nextPhysical;
+			if(freeBlock.nextPhysical != InvalidBlock)
+				_blocks[freeBlock.nextPhysical].previousPhysical = index;
+
+			usedBlock.nextPhysical = index;
+			freeBlock.previousPhysical = next;
+
+			// The free space moved up and may now touch the next free block.
+			const uint32_t following = freeBlock.nextPhysical;
+			if(following != InvalidBlock && _blocks[following].free)
+			{
+				RemoveFreeBlock(following);
+
+				freeBlock.size += _blocks[following].size;
+				freeBlock.nextPhysical = _blocks[following].nextPhysical;
+				if(freeBlock.nextPhysical != InvalidBlock)
+					_blocks[freeBlock.nextPhysical].previousPhysical = index;
+
+				ReleaseBlock(following);
+			}
+
+			InsertFreeBlock(index);
+		}
+
+		return moveCount;
+	}
+
+
+	BufferAllocator::BufferAllocator(uint64_t pageSize, uint64_t granularity) : _pageSize(pageSize), _granularity(granularity)
+	{}
+
+	BufferAllocation BufferAllocator::Allocate(uint64_t size, void *userData)
+	{
+		BufferAllocation allocation;
+		allocation.size = size;
+
+		for(uint32_t page = 0; page < _pages.size(); page++)
+		{
+			const uint32_t block = _pages[page]->Allocate(size, userData);
+			if(block != TlsfAllocator::InvalidBlock)
+			{
+				allocation.page = page;
+				allocation.block = block;
+				allocation.offset = _pages[page]->GetOffset(block);
+				return allocation;
+			}
+		}
+
+		const uint64_t pageSize = std::max(_pageSize, (size + _granularity - 1) & ~(_granularity - 1));
+		_pages.emplace_back(new TlsfAllocator(pageSize, _granularity));
+
+		allocation.page = static_cast<uint32_t>(_pages.size() - 1);
+		allocation.block = _pages.back()->Allocate(size, userData);
+		allocation.offset = _pages.back()->GetOffset(allocation.block);
+		return allocation;
+	}
+
+	void BufferAllocator::Free(const BufferAllocation &allocation)
+	{
+		_pages[allocation.page]->Free(allocation.block);
+	}
+
+	uint32_t BufferAllocator::Defragment(uint32_t maxMoves, std::vector<BufferMove> &moves)
+	{
+		std::vector<TlsfAllocator::Move> pageMoves;
+
+		uint32_t moveCount = 0;
+		for(uint32_t page = 0; page < _pages.size() && moveCount < maxMoves; page++)
+		{
+			pageMoves.clear();
+			moveCount += _pages[page]->Defragment(maxMoves - moveCount, pageMoves);
+
+			for(const TlsfAllocator::Move &pageMove : pageMoves)
+			{
+				BufferMove move;
+				move.from.page = page;
+				move.from.block = pageMove.block;
+				move.from.offset = pageMove.oldOffset;
+				move.from.size = pageMove.size;
+				move.to.page = page;
+				move.to.block = pageMove.block;
+				move.to.offset = pageMove.newOffset;
+				move.to.size = pageMove.size;
+				move.userData = pageMove.userData;
+				moves.push_back(move);
+			}
+		}
+
+		return moveCount;
+	}
+
+	BufferAllocatorStatistics BufferAllocator::GetStatistics() const
+	{
+		BufferAllocatorStatistics statistics;
+		memset(&statistics, 0, sizeof(statistics));
+
+		statistics.pages = static_cast<uint32_t>(_pages.size());
+
+		uint64_t contiguousFreeBytes = 0;
+		for(const std::unique_ptr<TlsfAllocator> &page : _pages)
+		{
+			const uint64_t largestFreeBlock = page->GetLargestFreeBlock();
+
+			statistics.allocations += page->GetAllocationCount();
+			statistics.freeBlocks += page->GetFreeBlockCount();
+			statistics.reservedBytes += page->GetSize();
+			statistics.usedBytes += page->GetUsedSize();
+			statistics.largestFreeBlock = std::max(statistics.largestFreeBlock, largestFreeBlock);
+			contiguousFreeBytes += largestFreeBlock;
+		}
+
+		const uint64_t freeBytes = statistics.reservedBytes - statistics.usedBytes;
+		if(freeBytes > 0)
+			statistics.fragmentation = 1.0f - static_cast<float>(contiguousFreeBytes) / static_cast<float>(freeBytes);
+
+		return statistics;
+	}
+}
@@ -0,0 +1,140 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace LB
+{
+	// Two level segregated fit allocator for one contiguous range. Allocation and
+	// free are constant time: free blocks are binned by size class with one bitmap
+	// per level, neighbouring free blocks are merged immediately. Offsets and sizes
+	// are multiples of the granularity.
+	class TlsfAllocator
+	{
+	public:
+		static const uint32_t InvalidBlock = 0xffffffff;
+
+		TlsfAllocator(uint64_t size, uint64_t granularity);
+
+		// Returns the block handle, or InvalidBlock if no free block is large enough.
+		uint32_t Allocate(uint64_t size, void *userData);
+		void Free(uint32_t block);
+
+		uint64_t GetOffset(uint32_t block) const { return _blocks[block].offset; }
+		uint64_t GetSize() const { return _size; }
+		uint64_t GetUsedSize() const { return _usedSize; }
+		uint32_t GetAllocationCount() const { return _allocationCount; }
+		uint32_t GetFreeBlockCount() const { return _freeBlockCount; }
+		uint64_t GetLargestFreeBlock() const;
+
+		struct Move
+		{
+			uint32_t block;
+			uint64_t oldOffset;
+			uint64_t newOffset;
+			uint64_t size;
+			void *userData;
+		};
+
+		// Slides up to maxMoves allocations down over the free space in front of
+		// them, lowest offsets first, so free space collects at the end. Block
+		// handles stay valid, only their offsets change. Old and new range of a move
+		// can overlap, the caller has to read all old ranges before writing any new.
+		uint32_t Defragment(uint32_t maxMoves, std::vector<Move> &moves);
+
+	private:
+		static const uint32_t SecondLevelLog2 = 4;
+		static const uint32_t SecondLevelCount = 1 << SecondLevelLog2;
+		static const uint32_t FirstLevelCount = 64;
+
+		struct Block
+		{
+			uint64_t offset;
+			uint64_t size;
+			uint32_t previousPhysical;
+			uint32_t nextPhysical;
+			uint32_t previousFree;
+			uint32_t nextFree;
+			void *userData;
+			bool free;
+		};
+
+		static void Mapping(uint64_t size, uint32_t &firstLevel, uint32_t &secondLevel);
+
+		uint32_t CreateBlock(uint64_t offset, uint64_t size);
+		void ReleaseBlock(uint32_t block);
+		uint32_t FindFreeBlock(uint64_t size) const;
+		void InsertFreeBlock(uint32_t block);
+		void RemoveFreeBlock(uint32_t block);
+
+		uint64_t _size;
+		uint64_t _granularity;
+		uint64_t _usedSize;
+		uint32_t _allocationCount;
+		uint32_t _freeBlockCount;
+		uint32_t _firstBlock;
+
+		std::vector<Block> _blocks;
+		std::vector<uint32_t> _unusedBlocks;
+
+		uint64_t _firstLevelBitmap;
+		uint32_t _secondLevelBitmaps[FirstLevelCount];
+		uint32_t _freeLists[FirstLevelCount][SecondLevelCount];
+	};
+
+	struct BufferAllocation
+	{
+		uint32_t page;
+		uint32_t block;
+		uint64_t offset;
+		uint64_t size;
+	};
+
+	struct BufferMove
+	{
+		BufferAllocation from;
+		BufferAllocation to;
+		void *userData;
+	};
+
+	struct BufferAllocatorStatistics
+	{
+		uint32_t pages;
+		uint32_t allocations;
+		uint32_t freeBlocks;
+		uint64_t reservedBytes;
+		uint64_t usedBytes;
+		uint64_t largestFreeBlock;
+		float fragmentation;		// 1 - sum of the largest free block per page / free bytes, 0 means every page has one contiguous free range
+	};
+
+	// Sub-allocates buffer ranges from pages, each backed by one large GPU buffer.
+	// New pages are added whenever no existing one has room; allocations larger
+	// than a page get a page of their own. The caller creates the GPU side of
+	// every page index it has not seen before.
+	class BufferAllocator
+	{
+	public:
+		BufferAllocator(uint64_t pageSize, uint64_t granularity);
+
+		BufferAllocation Allocate(uint64_t size, void *userData);
+		void Free(const BufferAllocation &allocation);
+
+		// Compacts the pages by moving up to maxMoves allocations within their page,
+		// see TlsfAllocator::Defragment. Allocations keep their page and block, the
+		// caller has to copy the contents and update the offsets of their owners
+		// before anything new is allocated, and the GPU must not be using them.
+		uint32_t Defragment(uint32_t maxMoves, std::vector<BufferMove> &moves);
+
+		uint32_t GetPageCount() const { return static_cast<uint32_t>(_pages.size()); }
+		uint64_t GetPageSize(uint32_t page) const { return _pages[page]->GetSize(); }
+
+		BufferAllocatorStatistics GetStatistics() const;
+
+	private:
+		uint64_t _pageSize;
+		uint64_t _granularity;
+		std::vector<std::unique_ptr<TlsfAllocator>> _pages;
+	};
+}
@@ -0,0 +1,235 @@
+#if defined(_WIN32)
+#include "stdafx.h"
+#endif
+
+#include "LBCommandEncoder.h"
+
+#include <cassert>
+#include <cstring>
+
+namespace LB
+{
+	StateFilter::StateFilter(CommandEncoder *target) : _target(target)
+	{
+		Reset();
+	}
+
+	void StateFilter::Reset()
+	{
+		Invalidate();
+		memset(&_statistics, 0, sizeof(_statistics));
+	}
+
+	void StateFilter::Invalidate()
+	{
+		_hasPipelineState = false;
+		_pipelineState = nullptr;
+		_hasTopology = false;
+		_topology = 0;
+		_hasIndexBuffer = false;
+		memset(&_indexBuffer, 0, sizeof(_indexBuffer));
+
+		for(uint32_t i = 0; i < MaxVertexBuffers; i++)
+		{
+			_hasVertexBuffer[i] = false;
+			memset(&_vertexBuffers[i], 0, sizeof(_vertexBuffers[i]));
+		}
+
+		for(uint32_t i = 0; i < MaxConstantBuffers; i++)
+		{
+			_hasConstantBuffer[i] = false;
+			_constantBuffers[i] = 0;
+		}
+	}
+
+	void StateFilter::SetPipelineState(const void *pipelineState)
+	{
+		if(_hasPipelineState && _pipelineState == pipelineState)
+		{
+			_statistics.stateChangesSkipped++;
+			return;
+		}
+
+		_hasPipelineState = true;
+		_pipelineState = pipelineState;
+		_statistics.stateChangesIssued++;
+		_target->SetPipelineState(pipelineState);
+	}
+
+	void StateFilter::SetPrimitiveTopology(uint32_t topology)
+	{
+		if(_hasTopology && _topology == topology)
+		{
+			_statistics.stateChangesSkipped++;
+			return;
+		}
+
+		_hasTopology = true;
+		_topology = topology;
+		_statistics.stateChangesIssued++;
+		_target->SetPrimitiveTopology(topology);
+	}
+
+	void StateFilter::SetVertexBuffer(uint32_t slot, const VertexBufferBinding &binding)
+	{
+		assert(slot < MaxVertexBuffers);
+
+		VertexBufferBinding &bound = _vertexBuffers[slot];
+		if(_hasVertexBuffer[slot] && bound.location == binding.location && bound.size == binding.size && bound.stride == binding.stride)
+		{
+			_statistics.stateChangesSkipped++;
+			return;
+		}
+
+		_hasVertexBuffer[slot] = true;
+		bound = binding;
+		_statistics.stateChangesIssued++;
+		_target->SetVertexBuffer(slot, binding);
+	}
+
+	void StateFilter::SetIndexBuffer(const IndexBufferBinding &binding)
+	{
+		if(_hasIndexBuffer && _indexBuffer.location == binding.location && _indexBuffer.size == binding.size && _indexBuffer.format == binding.format)
+		{
+			_statistics.stateChangesSkipped++;
+			return;
+		}
+
+		_hasIndexBuffer = true;
+		_indexBuffer = binding;
+		_statistics.stateChangesIssued++;
+		_target->SetIndexBuffer(binding);
+	}
+
+	void StateFilter::SetConstantBuffer(uint32_t rootParameter, uint64_t location)
+	{
+		assert(rootParameter < MaxConstantBuffers);
+
+		if(_hasConstantBuffer[rootParameter] && _constantBuffers[rootParameter] == location)
+		{
+			_statistics.stateChangesSkipped++;
+			return;
+		}
+
+		_hasConstantBuffer[rootParameter] = true;
+		_constantBuffers[rootParameter] = location;
+		_statistics.stateChangesIssued++;
+		_target->SetConstantBuffer(rootParameter, location);
+	}
+
+	void StateFilter::DrawInstanced(uint32_t vertexCount, uint32_t instanceCount, uint32_t firstVertex, uint32_t firstInstance)
+	{
+		_statistics.draws++;
+		_target->DrawInstanced(vertexCount, instanceCount, firstVertex, firstInstance);
+	}
+
+	void StateFilter::DrawIndexedInstanced(uint32_t indexCount, uint32_t instanceCount, uint32_t firstIndex, int32_t baseVertex, uint32_t firstInstance)
+	{
+		_statistics.draws++;
+		_target->DrawIndexedInstanced(indexCount, instanceCount, firstIndex, baseVertex, firstInstance);
+	}
+
+
+	EncodedCommand &RecordingCommandEncoder::Append(EncodedCommandType type)
+	{
+		EncodedCommand command;
+		memset(&command, 0, sizeof(command));
+		command.type = type;
+
+		_commands.push_back(command);
+		return _commands.back();
+	}
+
+	void RecordingCommandEncoder::SetPipelineState(const void *pipelineState)
+	{
+		Append(EncodedCommandType::SetPipelineState).pipelineState = pipelineState;
+	}
+
+	void RecordingCommandEncoder::SetPrimitiveTopology(uint32_t topology)
+	{
+		Append(EncodedCommandType::SetPrimitiveTopology).arguments[0] = topology;
+	}
+
+	void RecordingCommandEncoder::SetVertexBuffer(uint32_t slot, const VertexBufferBinding &binding)
+	{
+		EncodedCommand &command = Append(EncodedCommandType::SetVertexBuffer);
+		command.arguments[0] = slot;
+		command.vertexBuffer = binding;
+	}
+
+	void RecordingCommandEncoder::SetIndexBuffer(const IndexBufferBinding &binding)
+	{
+		Append(EncodedCommandType::SetIndexBuffer).indexBuffer = binding;
+	}
+
+	void RecordingCommandEncoder::SetConstantBuffer(uint32_t rootParameter, uint64_t location)
+	{
+		EncodedCommand &command = Append(EncodedCommandType::SetConstantBuffer);
+		command.arguments[0] = rootParameter;
+		command.location = location;
+	}
+
+	void RecordingCommandEncoder::DrawInstanced(uint32_t vertexCount, uint32_t instanceCount, uint32_t firstVertex, uint32_t firstInstance)
+	{
+		EncodedCommand &command = Append(EncodedCommandType::DrawInstanced);
+		command.arguments[0] = vertexCount;
+		command.arguments[1] = instanceCount;
+		command.arguments[2] = firstVertex;
+		command.arguments[3] = firstInstance;
+	}
+
+	void RecordingCommandEncoder::DrawIndexedInstanced(uint32_t indexCount, uint32_t instanceCount, uint32_t firstIndex, int32_t baseVertex, uint32_t firstInstance)
+	{
+		EncodedCommand &command = Append(EncodedCommandType::DrawIndexedInstanced);
+		command.arguments[0] = indexCount;
+		command.arguments[1] = instanceCount;
+		command.arguments[2] = firstIndex;
+		command.arguments[3] = static_cast<uint32_t>(baseVertex);
+		command.arguments[4] = firstInstance;
+	}
+
+	void RecordingCommandEncoder::SetRenderTarget(const void *target, const void *depthBuffer, uint32_t width, uint32_t height)
+	{
+		EncodedCommand &command = Append(EncodedCommandType::SetRenderTarget);
+		command.resources[0] = target;
+		command.resources[1] = depthBuffer;
+		command.arguments[0] = width;
+		command.arguments[1] = height;
+	}
+
+	void RecordingCommandEncoder::ClearRenderTarget(const void *target, const float color[4])
+	{
+		EncodedCommand &command = Append(EncodedCommandType::ClearRenderTarget);
+		command.resources[0] = target;
+		memcpy(command.color, color, sizeof(command.color));
+	}
+
+	void RecordingCommandEncoder::ClearDepthBuffer(const void *depthBuffer, float depth)
+	{
+		EncodedCommand &command = Append(EncodedCommandType::ClearDepthBuffer);
+		command.resources[0] = depthBuffer;
+		command.color[0] = depth;
+	}
+
+	// The bundle's commands stay where they are, the backend replays them.
+	void RecordingCommandEncoder::ExecuteBundle(RenderCommandList *bundle)
+	{
+		Append(EncodedCommandType::ExecuteBundle).resources[0] = bundle;
+	}
+
+	void RecordingCommandEncoder::ResourceBarrier(const ResourceStateBarrier *barriers, size_t count)
+	{
+		for(size_t i = 0; i < count; i++)
+			Append(EncodedCommandType::ResourceBarrier).barrier = barriers[i];
+	}
+
+	void RecordingCommandEncoder::CopyBufferRegion(const void *destination, uint64_t destinationOffset, const void *source, uint64_t sourceOffset, uint64_t size)
+	{
+		EncodedCommand &command = Append(EncodedCommandType::CopyBufferRegion);
+		command.resources[0] = destination;
+		command.resources[1] = source;
+		command.location = destinationOffset;
+		command.sourceOffset = sourceOffset;
+		command.size = size;
+	}
+}
@@ -0,0 +1,189 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "LBResourceStateTracker.h"
+
+namespace LB
+{
+	// API independent mirrors of the D3D12 view structs, so encoders can be used
+	// and tested without any Windows headers. Pipeline states and resources are
+	// opaque handles.
+	struct VertexBufferBinding
+	{
+		uint64_t location;
+		uint32_t size;
+		uint32_t stride;
+	};
+
+	struct IndexBufferBinding
+	{
+		uint64_t location;
+		uint32_t size;
+		uint32_t format;
+	};
+
+	// Minimal set of command list calls the renderer issues per draw.
+	class CommandEncoder
+	{
+	public:
+		virtual ~CommandEncoder() {}
+
+		virtual void SetPipelineState(const void *pipelineState) = 0;
+		virtual void SetPrimitiveTopology(uint32_t topology) = 0;
+		virtual void SetVertexBuffer(uint32_t slot, const VertexBufferBinding &binding) = 0;
+		virtual void SetIndexBuffer(const IndexBufferBinding &binding) = 0;
+		virtual void SetConstantBuffer(uint32_t rootParameter, uint64_t location) = 0;
+
+		virtual void DrawInstanced(uint32_t vertexCount, uint32_t instanceCount, uint32_t firstVertex, uint32_t firstInstance) = 0;
+		virtual void DrawIndexedInstanced(uint32_t indexCount, uint32_t instanceCount, uint32_t firstIndex, int32_t baseVertex, uint32_t firstInstance) = 0;
+	};
+
+	// Command list of a backend, the per draw calls plus the few the renderer
+	// issues once per frame or upload batch.
+	class RenderCommandList : public CommandEncoder
+	{
+	public:
+		// Starts recording anew without any state bound, the commands recorded
+		// before have to be done executing, which the backends take care of.
+		virtual void Begin() = 0;
+		virtual void Close() = 0;
+
+		// Also sets the viewport and scissor rect to cover the whole target. The
+		// depth buffer is optional.
+		// A null target binds only the depth buffer, for depth only pipelines.
+		virtual void SetRenderTarget(const void *target, const void *depthBuffer, uint32_t width, uint32_t height) = 0;
+		virtual void ClearRenderTarget(const void *target, const float color[4]) = 0;
+		virtual void ClearDepthBuffer(const void *depthBuffer, float depth) = 0;
+
+		virtual void ResourceBarrier(const ResourceStateBarrier *barriers, size_t count) = 0;
+		virtual void CopyBufferRegion(const void *destination, uint64_t destinationOffset, const void *source, uint64_t sourceOffset, uint64_t size) = 0;
+
+		// Replays a closed bundle of the same backend, see RenderBackend::CreateBundle.
+		virtual void ExecuteBundle(RenderCommandList *bundle) = 0;
+
+		// The commands recorded so far stay in use until the graphics queue reached
+		// fenceValue, Begin doesn't reuse their memory before. Executed lists are
+		// retired by the backend, bundles by whoever records them again.
+		virtual void Retire(uint64_t /*fenceValue*/) {}
+	};
+
+	struct CommandEncoderStatistics
+	{
+		uint32_t stateChangesIssued;
+		uint32_t stateChangesSkipped;
+		uint32_t draws;
+	};
+
+	// Remembers the currently bound state and only forwards calls that change it.
+	// A reset command list starts out with undefined state, so Reset has to be
+	// called whenever the target starts recording anew.
+	class StateFilter : public CommandEncoder
+	{
+	public:
+		static const uint32_t MaxVertexBuffers = 4;
+		static const uint32_t MaxConstantBuffers = 4;
+
+		StateFilter(CommandEncoder *target = nullptr);
+
+		void SetTarget(CommandEncoder *target) { _target = target; }
+
+		// Forgets all bound state and clears the statistics.
+		void Reset();
+
+		// Forgets all bound state, for when the target was modified behind our back.
+		void Invalidate();
+
+		void SetPipelineState(const void *pipelineState) override;
+		void SetPrimitiveTopology(uint32_t topology) override;
+		void SetVertexBuffer(uint32_t slot, const VertexBufferBinding &binding) override;
+		void SetIndexBuffer(const IndexBufferBinding &binding) override;
+		void SetConstantBuffer(uint32_t rootParameter, uint64_t location) override;
+
+		void DrawInstanced(uint32_t vertexCount, uint32_t instanceCount, uint32_t firstVertex, uint32_t firstInstance) override;
+		void DrawIndexedInstanced(uint32_t indexCount, uint32_t instanceCount, uint32_t firstIndex, int32_t baseVertex, uint32_t firstInstance) override;
+
+		const CommandEncoderStatistics &GetStatistics() const { return _statistics; }
+
+	private:
+		CommandEncoder *_target;
+		CommandEncoderStatistics _statistics;
+
+		bool _hasPipelineState;
+		const void *_pipelineState;
+		bool _hasTopology;
+		uint32_t _topology;
+		bool _hasVertexBuffer[MaxVertexBuffers];
+		VertexBufferBinding _vertexBuffers[MaxVertexBuffers];
+		bool _hasIndexBuffer;
+		IndexBufferBinding _indexBuffer;
+		bool _hasConstantBuffer[MaxConstantBuffers];
+		uint64_t _constantBuffers[MaxConstantBuffers];
+	};
+
+	enum class EncodedCommandType : uint32_t
+	{
+		SetPipelineState,
+		SetPrimitiveTopology,
+		SetVertexBuffer,
+		SetIndexBuffer,
+		SetConstantBuffer,
+		DrawInstanced,
+		DrawIndexedInstanced,
+		SetRenderTarget,
+		ClearRenderTarget,
+		ClearDepthBuffer,
+		ResourceBarrier,
+		CopyBufferRegion,
+		ExecuteBundle
+	};
+
+	struct EncodedCommand
+	{
+		EncodedCommandType type;
+		const void *pipelineState;
+		uint32_t arguments[5];				// Topology, slot, root parameter, draw arguments or target size in call order
+		uint64_t location;					// Constant buffer address or copy destination offset
+		VertexBufferBinding vertexBuffer;
+		IndexBufferBinding indexBuffer;
+		const void *resources[2];			// Render target and depth buffer, copy destination and source or bundle
+		uint64_t sourceOffset;
+		uint64_t size;
+		float color[4];						// Clear color, or the clear depth first
+		ResourceStateBarrier barrier;		// One command per barrier of a batch
+	};
+
+	// Stores every call instead of executing it, for tests and headless runs.
+	class RecordingCommandEncoder : public RenderCommandList
+	{
+	public:
+		void Clear() { _commands.clear(); }
+		const std::vector<EncodedCommand> &GetCommands() const { return _commands; }
+
+		void Begin() override { _commands.clear(); }
+		void Close() override {}
+
+		void SetRenderTarget(const void *target, const void *depthBuffer, uint32_t width, uint32_t height) override;
+		void ClearRenderTarget(const void *target, const float color[4]) override;
+		void ClearDepthBuffer(const void *depthBuffer, float depth) override;
+		void ResourceBarrier(const ResourceStateBarrier *barriers, size_t count) override;
+		void CopyBufferRegion(const void *destination, uint64_t destinationOffset, const void *source, uint64_t sourceOffset, uint64_t size) override;
+		void ExecuteBundle(RenderCommandList *bundle) override;
+
+		void SetPipelineState(const void *pipelineState) override;
+		void SetPrimitiveTopology(uint32_t topology) override;
+		void SetVertexBuffer(uint32_t slot, const VertexBufferBinding &binding) override;
+		void SetIndexBuffer(const IndexBufferBinding &binding) override;
+		void SetConstantBuffer(uint32_t rootParameter, uint64_t location) override;
+
+		void DrawInstanced(uint32_t vertexCount, uint32_t instanceCount, uint32_t firstVertex, uint32_t firstInstance) override;
+		void DrawIndexedInstanced(uint32_t indexCount, uint32_t instanceCount, uint32_t firstIndex, int32_t baseVertex, uint32_t firstInstance) override;
+
+	private:
+		EncodedCommand &Append(EncodedCommandType type);
+
+		std::vector<EncodedCommand> _commands;
+	};
+}
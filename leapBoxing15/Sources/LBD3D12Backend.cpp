@@ -0,0 +1,856 @@
+#include "stdafx.h"
+#include "LBD3D12Backend.h"
+#include "LBApplication.h"
+#include "LBShaderCache.h"
+
+namespace LB
+{
+	D3D12CommandList::D3D12CommandList(D3D12Backend *backend, BackendQueue queue, bool bundle) : _backend(backend), _queue(queue)
+	{
+		if(bundle)
+			_type = D3D12_COMMAND_LIST_TYPE_BUNDLE;
+		else
+			_type = (queue == BackendQueue::Copy) ? D3D12_COMMAND_LIST_TYPE_COPY : D3D12_COMMAND_LIST_TYPE_DIRECT;
+
+		ThrowIfFailed(backend->_device->CreateCommandAllocator(_type, IID_PPV_ARGS(&_allocator)));
+		ThrowIfFailed(backend->_device->CreateCommandList(0, _type, _allocator.Get(), nullptr, IID_PPV_ARGS(&_list)));
+		ThrowIfFailed(_list->Close());
+
+		// Never executed, so it can be reused right away.
+		_allocatorPool.push_back(std::make_pair(0, _allocator));
+		_allocator.Reset();
+
+		_commandList = _list.Get();
+	}
+
+	void D3D12CommandList::Begin()
+	{
+		// Reuse the oldest allocator if the GPU is done with it.
+		if(!_allocatorPool.empty() && _allocatorPool.front().first <= _backend->GetCompletedValue(_queue))
+		{
+			_allocator = _allocatorPool.front().second;
+			_allocatorPool.pop_front();
+			ThrowIfFailed(_allocator->Reset());
+		}
+		else
+		{
+			ThrowIfFailed(_backend->_device->CreateCommandAllocator(_type, IID_PPV_ARGS(&_allocator)));
+		}
+
+		ThrowIfFailed(_list->Reset(_allocator.Get(), NULL));
+
+		// Bundles setting root parameters need the root signature of the lists
+		// executing them.
+		if(_type == D3D12_COMMAND_LIST_TYPE_BUNDLE || _queue == BackendQueue::Graphics)
+		{
+			ID3D12DescriptorHeap *heaps[] = { _backend->_descriptorHeap.Get() };
+			_list->SetDescriptorHeaps(_countof(heaps), heaps);
+			_list->SetGraphicsRootSignature(_backend->_rootSignature.Get());
+		}
+	}
+
+	void D3D12CommandList::Close()
+	{
+		ThrowIfFailed(_list->Close());
+	}
+
+	void D3D12CommandList::SetConstantBuffer(uint32_t rootParameter, uint64_t location)
+	{
+		if(rootParameter == ConstantSlotFrame)
+			_list->SetGraphicsRootDescriptorTable(rootParameter, _backend->CreateFrameConstantView(location));
+		else
+			D3D12CommandEncoder::SetConstantBuffer(rootParameter, location);
+	}
+
+	void D3D12CommandList::SetRenderTarget(const void *target, const void *depthBuffer, uint32_t width, uint32_t height)
+	{
+		const D3D12_VIEWPORT viewport = { 0.0f, 0.0f, static_cast<float>(width), static_cast<float>(height), 0.0f, 1.0f };
+		const D3D12_RECT scissorRect = { 0, 0, static_cast<LONG>(width), static_cast<LONG>(height) };
+
+		_list->RSSetViewports(1, &viewport);
+		_list->RSSetScissorRects(1, &scissorRect);
+
+		// Depth only passes bind no render target at all, the back buffer may
+		// still be in the present state.
+		const UINT targetCount = target ? 1 : 0;
+		D3D12_CPU_DESCRIPTOR_HANDLE rtvHandle = {};
+		if(target)
+			rtvHandle = _backend->GetRenderTargetView(target);
+
+		if(depthBuffer)
+		{
+			const D3D12_CPU_DESCRIPTOR_HANDLE dsvHandle = _backend->GetDepthStencilView(depthBuffer);
+			_list->OMSetRenderTargets(targetCount, target ? &rtvHandle : nullptr, FALSE, &dsvHandle);
+		}
+		else
+		{
+			_list->OMSetRenderTargets(targetCount, target ? &rtvHandle : nullptr, FALSE, nullptr);
+		}
+	}
+
+	void D3D12CommandList::ClearRenderTarget(const void *target, const float color[4])
+	{
+		_list->ClearRenderTargetView(_backend->GetRenderTargetView(target), color, 0, nullptr);
+	}
+
+	void D3D12CommandList::ClearDepthBuffer(const void *depthBuffer, float depth)
+	{
+		_list->ClearDepthStencilView(_backend->GetDepthStencilView(depthBuffer), D3D12_CLEAR_FLAG_DEPTH, depth, 0, 0, nullptr);
+	}
+
+	void D3D12CommandList::ExecuteBundle(RenderCommandList *bundle)
+	{
+		_list->ExecuteBundle(static_cast<D3D12CommandList *>(bundle)->GetCommandList());
+	}
+
+	void D3D12CommandList::Retire(uint64_t fenceValue)
+	{
+		if(!_allocator)
+			return;
+
+		_allocatorPool.push_back(std::make_pair(fenceValue, _allocator));
+		_allocator.Reset();
+	}
+
+	D3D12Backend::D3D12Backend(HWND hwnd, bool useWARPDevice, const RendererSettings &settings) : _width(0), _height(0), _rootSignatureHash(0), _rtvDescriptorSize(0), _descriptorSize(0), _descriptorAllocator(0, FrameDescriptorCount), _fenceEvent(nullptr), _frameLatencyWaitable(nullptr), _syncInterval(std::min(settings.syncInterval, 4u)), _tearingSupported(settings.allowTearing), _fullscreen(false), _timestampData(nullptr), _timestampFrequency(0), _timedSlot(NoTimestampSlot), _timedSlotPresented(false), _lastTimedFenceValue(0), _gpuMilliseconds(0.0)
+	{
+		_frameCount = std::min(std::max(settings.frameCount, FramePacer::MinFrameCount), FramePacer::MaxFrameCount);
+		ZeroMemory(_signaledValues, sizeof(_signaledValues));
+		ZeroMemory(_timestampLists, sizeof(_timestampLists));
+		ZeroMemory(_timestampFenceValues, sizeof(_timestampFenceValues));
+		ZeroMemory(_timestampsPending, sizeof(_timestampsPending));
+
+		CreatePipeline(hwnd, useWARPDevice);
+		SetMaximumFrameLatency(settings.maxFrameLatency);
+		LoadAssets();
+	}
+
+	D3D12Backend::~D3D12Backend()
+	{
+		// The renderer waited for the GPU before going away.
+		_pipelineCache.Save();
+
+		// Fullscreen state should always be false before exiting the app.
+		ThrowIfFailed(_swapChain->SetFullscreenState(FALSE, nullptr));
+
+		CloseHandle(_frameLatencyWaitable);
+		CloseHandle(_fenceEvent);
+	}
+
+	uint32_t D3D12Backend::GetBackBufferIndex()
+	{
+		return _swapChain->GetCurrentBackBufferIndex();
+	}
+
+	const void *D3D12Backend::GetBackBuffer(uint32_t index)
+	{
+		return _renderTargets[index].Get();
+	}
+
+	D3D12_CPU_DESCRIPTOR_HANDLE D3D12Backend::GetRenderTargetView(const void *target)
+	{
+		for(UINT n = 0; n < _frameCount; n++)
+		{
+			if(_renderTargets[n].Get() == target)
+				return CD3DX12_CPU_DESCRIPTOR_HANDLE(_rtvHeap->GetCPUDescriptorHandleForHeapStart(), n, _rtvDescriptorSize);
+		}
+
+		throw std::invalid_argument("Resource is not a render target");
+	}
+
+	const void *D3D12Backend::GetDepthBuffer()
+	{
+		return _depthBuffer.Get();
+	}
+
+	D3D12_CPU_DESCRIPTOR_HANDLE D3D12Backend::GetDepthStencilView(const void *depthBuffer)
+	{
+		if(depthBuffer != _depthBuffer.Get())
+			throw std::invalid_argument("Resource is not the depth buffer");
+
+		return _dsvHeap->GetCPUDescriptorHandleForHeapStart();
+	}
+
+	void D3D12Backend::Resize(uint32_t width, uint32_t height)
+	{
+		_width = width;
+		_height = height;
+
+		// Release the resources holding references to the swap chain (requirement of
+		// IDXGISwapChain::ResizeBuffers), the GPU is idle so every frame's fence
+		// value has been reached.
+		for(UINT n = 0; n < _frameCount; n++)
+			_renderTargets[n].Reset();
+
+		_depthBuffer.Reset();
+
+		// Resize the swap chain to the desired dimensions.
+		DXGI_SWAP_CHAIN_DESC desc = {};
+		_swapChain->GetDesc(&desc);
+		ThrowIfFailed(_swapChain->ResizeBuffers(_frameCount, width, height, desc.BufferDesc.Format, desc.Flags));
+
+		CreateFramebuffers();
+	}
+
+	void D3D12Backend::ToggleFullscreen()
+	{
+		BOOL fullscreenState;
+		ThrowIfFailed(_swapChain->GetFullscreenState(&fullscreenState, nullptr));
+		if(SUCCEEDED(_swapChain->SetFullscreenState(!fullscreenState, nullptr)))
+		{
+			_fullscreen = !fullscreenState;
+		}
+		else
+		{
+			// Transitions to fullscreen mode can fail when running apps over
+			// terminal services or for some other unexpected reason.  Consider
+			// notifying the user in some way when this happens.
+			OutputDebugString(L"Fullscreen transition failed");
+			assert(false);
+		}
+	}
+
+	void D3D12Backend::WaitForPresent(uint32_t timeoutMilliseconds)
+	{
+		WaitForSingleObjectEx(_frameLatencyWaitable, timeoutMilliseconds, TRUE);
+	}
+
+	void D3D12Backend::Present()
+	{
+		{
+			std::lock_guard<std::mutex> lock(_lock);
+
+			if(_timedSlot != NoTimestampSlot && !_timedSlotPresented)
+			{
+				D3D12CommandList *commandList = _timestampLists[_timedSlot][1];
+				commandList->Begin();
+				commandList->GetCommandList()->EndQuery(_timestampHeap.Get(), D3D12_QUERY_TYPE_TIMESTAMP, _timedSlot * 2 + 1);
+				commandList->GetCommandList()->ResolveQueryData(_timestampHeap.Get(), D3D12_QUERY_TYPE_TIMESTAMP, _timedSlot * 2, 2, _timestampBuffer.Get(), _timedSlot * 2 * sizeof(UINT64));
+				commandList->Close();
+
+				ID3D12CommandList *ppCommandLists[] = { commandList->GetCommandList() };
+				GetQueue(BackendQueue::Graphics)->ExecuteCommandLists(1, ppCommandLists);
+				_executedLists[static_cast<UINT>(BackendQueue::Graphics)].push_back(commandList);
+
+				_timedSlotPresented = true;
+			}
+		}
+
+		// Tearing is not allowed in exclusive fullscreen.
+		const UINT presentFlags = (_syncInterval == 0 && _tearingSupported && !_fullscreen) ? DXGI_PRESENT_ALLOW_TEARING : 0;
+		ThrowIfFailed(_swapChain->Present(_syncInterval, presentFlags));
+	}
+
+	void D3D12Backend::SetSourceSize(uint32_t width, uint32_t height)
+	{
+		// The compositor or the display stretches it to the window.
+		ThrowIfFailed(_swapChain->SetSourceSize(width, height));
+	}
+
+	double D3D12Backend::GetGpuMilliseconds()
+	{
+		std::lock_guard<std::mutex> lock(_lock);
+
+		ReadTimestamps();
+		return _gpuMilliseconds;
+	}
+
+	// Takes the most recent completed frame, which frees all completed slots.
+	void D3D12Backend::ReadTimestamps()
+	{
+		const UINT64 completedValue = _fences[static_cast<UINT>(BackendQueue::Graphics)]->GetCompletedValue();
+
+		for(UINT n = 0; n < _frameCount; n++)
+		{
+			if(!_timestampsPending[n] || _timestampFenceValues[n] > completedValue)
+				continue;
+
+			_timestampsPending[n] = false;
+
+			const UINT64 begin = _timestampData[n * 2];
+			const UINT64 end = _timestampData[n * 2 + 1];
+
+			if(_timestampFenceValues[n] > _lastTimedFenceValue && end > begin)
+			{
+				_lastTimedFenceValue = _timestampFenceValues[n];
+				_gpuMilliseconds = static_cast<double>(end - begin) * 1000.0 / _timestampFrequency;
+			}
+		}
+	}
+
+	const void *D3D12Backend::CreateBuffer(uint64_t size, BufferHeap heap, uint32_t initialState)
+	{
+		ID3D12Resource *resource = nullptr;
+
+		if(heap == BufferHeap::Upload)
+		{
+			ThrowIfFailed(_device->CreateCommittedResource(
+				&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
+				D3D12_HEAP_FLAG_NONE,
+				&CD3DX12_RESOURCE_DESC::Buffer(size),
+				D3D12_RESOURCE_STATE_GENERIC_READ,
+				nullptr,
+				IID_PPV_ARGS(&resource)));
+
+			return resource;
+		}
+
+		D3D12_HEAP_DESC heapDesc = {};
+		heapDesc.SizeInBytes = size;
+		heapDesc.Properties = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT);
+		heapDesc.Alignment = D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT;
+		heapDesc.Flags = D3D12_HEAP_FLAG_ALLOW_ONLY_BUFFERS;
+
+		Microsoft::WRL::ComPtr<ID3D12Heap> bufferHeap;
+		ThrowIfFailed(_device->CreateHeap(&heapDesc, IID_PPV_ARGS(&bufferHeap)));
+
+		ThrowIfFailed(_device->CreatePlacedResource(
+			bufferHeap.Get(),
+			0,
+			&CD3DX12_RESOURCE_DESC::Buffer(size),
+			static_cast<D3D12_RESOURCE_STATES>(initialState),
+			nullptr,
+			IID_PPV_ARGS(&resource)));
+
+		std::lock_guard<std::mutex> lock(_lock);
+		_bufferHeaps[resource] = bufferHeap;
+
+		return resource;
+	}
+
+	void D3D12Backend::ReleaseResource(const void *resource)
+	{
+		ID3D12Resource *buffer = static_cast<ID3D12Resource *>(const_cast<void *>(resource));
+		buffer->Release();
+
+		std::lock_guard<std::mutex> lock(_lock);
+		_bufferHeaps.erase(buffer);
+	}
+
+	uint8_t *D3D12Backend::MapBuffer(const void *buffer)
+	{
+		// We never read from it on the CPU.
+		UINT8 *data;
+		ThrowIfFailed(static_cast<ID3D12Resource *>(const_cast<void *>(buffer))->Map(0, &CD3DX12_RANGE(0, 0), reinterpret_cast<void**>(&data)));
+		return data;
+	}
+
+	uint64_t D3D12Backend::GetBufferAddress(const void *buffer)
+	{
+		return static_cast<ID3D12Resource *>(const_cast<void *>(buffer))->GetGPUVirtualAddress();
+	}
+
+	const void *D3D12Backend::GetPipelineState(const PipelineDescription &description, uint32_t *pipelineID)
+	{
+		// Create the pipeline state, which includes compiling and loading shaders.
+		using namespace Microsoft::WRL;
+		ComPtr<ID3DBlob> vertexShader;
+		ComPtr<ID3DBlob> pixelShader;
+		LoadShaders(description.shaderFile.c_str(), vertexShader, pixelShader);
+
+		// Define the vertex input layout. The shader reads the first three columns
+		// of the world matrix rows, WORLD3 being the translation, so every
+		// instance format only needs its own offsets and formats.
+		D3D12_INPUT_ELEMENT_DESC inputElementDescs[] =
+		{
+			{ "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+			{ "COLOR", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 0, 12, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+			{ "WORLD", 0, DXGI_FORMAT_R32G32B32_FLOAT, 1, 0, D3D12_INPUT_CLASSIFICATION_PER_INSTANCE_DATA, 1 },
+			{ "WORLD", 1, DXGI_FORMAT_R32G32B32_FLOAT, 1, 16, D3D12_INPUT_CLASSIFICATION_PER_INSTANCE_DATA, 1 },
+			{ "WORLD", 2, DXGI_FORMAT_R32G32B32_FLOAT, 1, 32, D3D12_INPUT_CLASSIFICATION_PER_INSTANCE_DATA, 1 },
+			{ "WORLD", 3, DXGI_FORMAT_R32G32B32_FLOAT, 1, 48, D3D12_INPUT_CLASSIFICATION_PER_INSTANCE_DATA, 1 }
+		};
+
+		switch(description.instanceFormat)
+		{
+			case InstanceFormat::Matrix:
+				break;
+			case InstanceFormat::Affine:
+				for(UINT i = 0; i < 4; i++)
+					inputElementDescs[2 + i].AlignedByteOffset = i * 12;
+				break;
+			case InstanceFormat::AffineHalf:
+				// Translation first, then the rows as half4.
+				inputElementDescs[5].AlignedByteOffset = 0;
+				for(UINT i = 0; i < 3; i++)
+				{
+					inputElementDescs[2 + i].Format = DXGI_FORMAT_R16G16B16A16_FLOAT;
+					inputElementDescs[2 + i].AlignedByteOffset = 12 + i * 8;
+				}
+				break;
+		}
+
+		// Describe and create the graphics pipeline state object (PSO).
+		D3D12_GRAPHICS_PIPELINE_STATE_DESC psoDesc = {};
+		psoDesc.InputLayout = { inputElementDescs, _countof(inputElementDescs) };
+		psoDesc.pRootSignature = _rootSignature.Get();
+		psoDesc.VS = { reinterpret_cast<UINT8*>(vertexShader->GetBufferPointer()), vertexShader->GetBufferSize() };
+		psoDesc.PS = { reinterpret_cast<UINT8*>(pixelShader->GetBufferPointer()), pixelShader->GetBufferSize() };
+		psoDesc.RasterizerState = CD3DX12_RASTERIZER_DESC(D3D12_DEFAULT);
+		psoDesc.BlendState = CD3DX12_BLEND_DESC(D3D12_DEFAULT);
+		psoDesc.DepthStencilState = CD3DX12_DEPTH_STENCIL_DESC(D3D12_DEFAULT);
+		psoDesc.DepthStencilState.StencilEnable = FALSE;
+		psoDesc.SampleMask = UINT_MAX;
+		psoDesc.PrimitiveTopologyType = D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE;
+		psoDesc.NumRenderTargets = 1;
+		psoDesc.RTVFormats[0] = DXGI_FORMAT_R8G8B8A8_UNORM;
+		psoDesc.DSVFormat = DepthBufferFormat;
+
+		switch(description.depthMode)
+		{
+			case DepthMode::Disabled:
+				psoDesc.DepthStencilState.DepthEnable = FALSE;
+				break;
+			case DepthMode::ReadWrite:
+				break;
+			case DepthMode::DepthOnly:
+				psoDesc.BlendState.RenderTarget[0].RenderTargetWriteMask = 0;
+				psoDesc.NumRenderTargets = 0;
+				psoDesc.RTVFormats[0] = DXGI_FORMAT_UNKNOWN;
+				break;
+			case DepthMode::ReadOnly:
+				psoDesc.DepthStencilState.DepthWriteMask = D3D12_DEPTH_WRITE_MASK_ZERO;
+				psoDesc.DepthStencilState.DepthFunc = D3D12_COMPARISON_FUNC_LESS_EQUAL;
+				break;
+		}
+		psoDesc.SampleDesc.Count = 1;
+
+		// The cache keeps a reference for as long as the backend lives.
+		return _pipelineCache.GetPipelineState(psoDesc, _rootSignatureHash, pipelineID).Get();
+	}
+
+	void D3D12Backend::PrecompileShaders(LPCWSTR shaderfile)
+	{
+		Microsoft::WRL::ComPtr<ID3DBlob> vertexShader;
+		Microsoft::WRL::ComPtr<ID3DBlob> pixelShader;
+		LoadShaders(shaderfile, vertexShader, pixelShader);
+	}
+
+	// Shaders come from the shader cache, which only compiles them if it has no
+	// bytecode for this exact source and flags yet.
+	void D3D12Backend::LoadShaders(LPCWSTR shaderfile, Microsoft::WRL::ComPtr<ID3DBlob> &vertexShader, Microsoft::WRL::ComPtr<ID3DBlob> &pixelShader)
+	{
+#ifdef _DEBUG
+		// Enable better shader debugging with the graphics debugging tools.
+		UINT compileFlags = D3DCOMPILE_DEBUG | D3DCOMPILE_SKIP_OPTIMIZATION;
+#else
+		UINT compileFlags = 0;
+#endif
+
+		ShaderCache *shaderCache = Application::GetInstance().GetShaderCache();
+		const std::wstring path = Application::GetInstance().GetPathForAsset(shaderfile);
+
+		vertexShader = shaderCache->GetShader(path, "VSMain", "vs_5_0", compileFlags);
+		pixelShader = shaderCache->GetShader(path, "PSMain", "ps_5_0", compileFlags);
+	}
+
+	RenderCommandList *D3D12Backend::CreateCommandList(BackendQueue queue)
+	{
+		std::lock_guard<std::mutex> lock(_lock);
+
+		_commandLists.emplace_back(new D3D12CommandList(this, queue));
+		return _commandLists.back().get();
+	}
+
+	RenderCommandList *D3D12Backend::CreateBundle()
+	{
+		std::lock_guard<std::mutex> lock(_lock);
+
+		_commandLists.emplace_back(new D3D12CommandList(this, BackendQueue::Graphics, true));
+		return _commandLists.back().get();
+	}
+
+	void D3D12Backend::ExecuteCommandLists(BackendQueue queue, RenderCommandList *const *commandLists, uint32_t count)
+	{
+		std::lock_guard<std::mutex> lock(_lock);
+
+		ID3D12CommandList *ppCommandLists[33];
+		assert(count < _countof(ppCommandLists));
+
+		UINT listCount = 0;
+
+		// The first graphics submission of a frame starts the frame's time. The
+		// slot is free again, the renderer waited for the frame that used it last.
+		if(queue == BackendQueue::Graphics && _timedSlot == NoTimestampSlot)
+		{
+			ReadTimestamps();
+
+			_timedSlot = _swapChain->GetCurrentBackBufferIndex();
+			_timedSlotPresented = false;
+
+			D3D12CommandList *commandList = _timestampLists[_timedSlot][0];
+			commandList->Begin();
+			commandList->GetCommandList()->EndQuery(_timestampHeap.Get(), D3D12_QUERY_TYPE_TIMESTAMP, _timedSlot * 2);
+			commandList->Close();
+
+			ppCommandLists[listCount++] = commandList->GetCommandList();
+			_executedLists[static_cast<UINT>(queue)].push_back(commandList);
+		}
+
+		for(uint32_t i = 0; i < count; i++)
+		{
+			D3D12CommandList *commandList = static_cast<D3D12CommandList *>(commandLists[i]);
+			ppCommandLists[listCount++] = commandList->GetCommandList();
+			_executedLists[static_cast<UINT>(queue)].push_back(commandList);
+		}
+
+		GetQueue(queue)->ExecuteCommandLists(listCount, ppCommandLists);
+	}
+
+	ID3D12CommandQueue *D3D12Backend::GetQueue(BackendQueue queue)
+	{
+		return _queues[static_cast<UINT>(queue)].Get();
+	}
+
+	// Views in the ring are taken in recording order and only given back by
+	// Signal, so a full ring waits for the oldest frame still using it.
+	D3D12_GPU_DESCRIPTOR_HANDLE D3D12Backend::CreateFrameConstantView(uint64_t location)
+	{
+		std::lock_guard<std::mutex> lock(_lock);
+
+		ID3D12Fence *fence = _fences[static_cast<UINT>(BackendQueue::Graphics)].Get();
+		UINT index = _descriptorAllocator.AllocateTransient(1);
+		while(index == DescriptorAllocator::InvalidIndex)
+		{
+			const uint64_t fenceValue = _descriptorAllocator.GetOldestPendingFence();
+			if(fenceValue == 0)
+				throw std::runtime_error("Frame descriptor ring is full");
+
+			ThrowIfFailed(fence->SetEventOnCompletion(fenceValue, nullptr));
+			_descriptorAllocator.Reclaim(fence->GetCompletedValue());
+			index = _descriptorAllocator.AllocateTransient(1);
+		}
+
+		D3D12_CONSTANT_BUFFER_VIEW_DESC viewDesc = {};
+		viewDesc.BufferLocation = location;
+		viewDesc.SizeInBytes = (sizeof(FrameConstants) + D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT - 1) & ~(D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT - 1);
+		_device->CreateConstantBufferView(&viewDesc, CD3DX12_CPU_DESCRIPTOR_HANDLE(_descriptorHeap->GetCPUDescriptorHandleForHeapStart(), index, _descriptorSize));
+
+		return CD3DX12_GPU_DESCRIPTOR_HANDLE(_descriptorHeap->GetGPUDescriptorHandleForHeapStart(), index, _descriptorSize);
+	}
+
+	DescriptorStatistics D3D12Backend::TakeDescriptorStatistics()
+	{
+		std::lock_guard<std::mutex> lock(_lock);
+
+		const DescriptorStatistics statistics = _descriptorAllocator.GetStatistics();
+		_descriptorAllocator.ResetStatistics();
+		return statistics;
+	}
+
+	void D3D12Backend::Signal(BackendQueue queue, uint64_t value)
+	{
+		std::lock_guard<std::mutex> lock(_lock);
+
+		const UINT index = static_cast<UINT>(queue);
+		ThrowIfFailed(GetQueue(queue)->Signal(_fences[index].Get(), value));
+		_signaledValues[index] = value;
+
+		// Allocators of everything executed so far can be reused once the value is
+		// reached.
+		for(D3D12CommandList *commandList : _executedLists[index])
+			commandList->Retire(value);
+
+		_executedLists[index].clear();
+
+		if(queue == BackendQueue::Graphics)
+		{
+			_descriptorAllocator.FinishFrame(value);
+			_descriptorAllocator.Reclaim(_fences[index]->GetCompletedValue());
+
+			// Signaled after the present of a timed frame.
+			if(_timedSlot != NoTimestampSlot && _timedSlotPresented)
+			{
+				_timestampFenceValues[_timedSlot] = value;
+				_timestampsPending[_timedSlot] = true;
+				_timedSlot = NoTimestampSlot;
+			}
+		}
+	}
+
+	void D3D12Backend::Wait(BackendQueue queue, BackendQueue signalQueue, uint64_t value)
+	{
+		ThrowIfFailed(GetQueue(queue)->Wait(_fences[static_cast<UINT>(signalQueue)].Get(), value));
+	}
+
+	uint64_t D3D12Backend::GetCompletedValue(BackendQueue queue)
+	{
+		return _fences[static_cast<UINT>(queue)]->GetCompletedValue();
+	}
+
+	void D3D12Backend::WaitForValue(BackendQueue queue, uint64_t value)
+	{
+		ID3D12Fence *fence = _fences[static_cast<UINT>(queue)].Get();
+		if(fence->GetCompletedValue() < value)
+		{
+			// Uploads may be waited for from loader threads, without an event handle
+			// this blocks until the fence reached the value.
+			if(queue == BackendQueue::Copy)
+			{
+				ThrowIfFailed(fence->SetEventOnCompletion(value, nullptr));
+			}
+			else
+			{
+				ThrowIfFailed(fence->SetEventOnCompletion(value, _fenceEvent));
+				WaitForSingleObjectEx(_fenceEvent, INFINITE, FALSE);
+			}
+		}
+	}
+
+	void D3D12Backend::CreateFramebuffers()
+	{
+		CD3DX12_CPU_DESCRIPTOR_HANDLE rtvHandle(_rtvHeap->GetCPUDescriptorHandleForHeapStart());
+
+		// Create a RTV for each frame.
+		for(UINT n = 0; n < _frameCount; n++)
+		{
+			ThrowIfFailed(_swapChain->GetBuffer(n, IID_PPV_ARGS(&_renderTargets[n])));
+			_device->CreateRenderTargetView(_renderTargets[n].Get(), nullptr, rtvHandle);
+			rtvHandle.Offset(1, _rtvDescriptorSize);
+		}
+
+		// One depth buffer for all frames, they never overlap on the graphics queue.
+		ThrowIfFailed(_device->CreateCommittedResource(
+			&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
+			D3D12_HEAP_FLAG_NONE,
+			&CD3DX12_RESOURCE_DESC::Tex2D(DepthBufferFormat, _width, _height, 1, 1, 1, 0, D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL | D3D12_RESOURCE_FLAG_DENY_SHADER_RESOURCE),
+			D3D12_RESOURCE_STATE_DEPTH_WRITE,
+			&CD3DX12_CLEAR_VALUE(DepthBufferFormat, 1.0f, 0),
+			IID_PPV_ARGS(&_depthBuffer)));
+
+		D3D12_DEPTH_STENCIL_VIEW_DESC dsvDesc = {};
+		dsvDesc.Format = DepthBufferFormat;
+		dsvDesc.ViewDimension = D3D12_DSV_DIMENSION_TEXTURE2D;
+		_device->CreateDepthStencilView(_depthBuffer.Get(), &dsvDesc, _dsvHeap->GetCPUDescriptorHandleForHeapStart());
+	}
+
+	void D3D12Backend::CreatePipeline(HWND hwnd, bool useWARPDevice)
+	{
+		using namespace Microsoft::WRL;
+
+#ifdef _DEBUG
+		// Enable the D3D12 debug layer.
+		{
+			ComPtr<ID3D12Debug> debugController;
+			if(SUCCEEDED(D3D12GetDebugInterface(IID_PPV_ARGS(&debugController))))
+			{
+				debugController->EnableDebugLayer();
+			}
+		}
+#endif
+
+		ComPtr<IDXGIFactory4> factory;
+		ThrowIfFailed(CreateDXGIFactory1(IID_PPV_ARGS(&factory)));
+
+		if(useWARPDevice)
+		{
+			ComPtr<IDXGIAdapter> warpAdapter;
+			ThrowIfFailed(factory->EnumWarpAdapter(IID_PPV_ARGS(&warpAdapter)));
+
+			ThrowIfFailed(D3D12CreateDevice(
+				warpAdapter.Get(),
+				D3D_FEATURE_LEVEL_11_0,
+				IID_PPV_ARGS(&_device)
+				));
+		}
+		else
+		{
+			ComPtr<IDXGIAdapter1> hardwareAdapter;
+			GetHardwareAdapter(factory.Get(), &hardwareAdapter);
+
+			ThrowIfFailed(D3D12CreateDevice(
+				hardwareAdapter.Get(),
+				D3D_FEATURE_LEVEL_11_0,
+				IID_PPV_ARGS(&_device)
+				));
+		}
+
+		// Describe and create the command queues, uploads go through their own copy
+		// queue.
+		D3D12_COMMAND_QUEUE_DESC queueDesc = {};
+		queueDesc.Flags = D3D12_COMMAND_QUEUE_FLAG_NONE;
+		queueDesc.Type = D3D12_COMMAND_LIST_TYPE_DIRECT;
+
+		ThrowIfFailed(_device->CreateCommandQueue(&queueDesc, IID_PPV_ARGS(&_queues[static_cast<UINT>(BackendQueue::Graphics)])));
+
+		D3D12_COMMAND_QUEUE_DESC copyQueueDesc = {};
+		copyQueueDesc.Flags = D3D12_COMMAND_QUEUE_FLAG_NONE;
+		copyQueueDesc.Type = D3D12_COMMAND_LIST_TYPE_COPY;
+		ThrowIfFailed(_device->CreateCommandQueue(&copyQueueDesc, IID_PPV_ARGS(&_queues[static_cast<UINT>(BackendQueue::Copy)])));
+
+		RECT windowRect;
+		GetClientRect(hwnd, &windowRect);
+		_width = windowRect.right - windowRect.left;
+		_height = windowRect.bottom - windowRect.top;
+
+		// Tearing needs support by the runtime and the display.
+		if(_tearingSupported)
+		{
+			ComPtr<IDXGIFactory5> factory5;
+			BOOL allowTearing = FALSE;
+			if(FAILED(factory.As(&factory5)) || FAILED(factory5->CheckFeatureSupport(DXGI_FEATURE_PRESENT_ALLOW_TEARING, &allowTearing, sizeof(allowTearing))))
+				allowTearing = FALSE;
+
+			_tearingSupported = (allowTearing == TRUE);
+		}
+
+		// Describe and create the swap chain.
+		DXGI_SWAP_CHAIN_DESC swapChainDesc = {};
+		swapChainDesc.BufferCount = _frameCount;
+		swapChainDesc.BufferDesc.Width = _width;
+		swapChainDesc.BufferDesc.Height = _height;
+		swapChainDesc.BufferDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+		swapChainDesc.BufferUsage = DXGI_USAGE_RENDER_TARGET_OUTPUT;
+		swapChainDesc.SwapEffect = DXGI_SWAP_EFFECT_FLIP_DISCARD;
+		swapChainDesc.OutputWindow = hwnd;
+		swapChainDesc.SampleDesc.Count = 1;
+		swapChainDesc.Windowed = TRUE;
+		swapChainDesc.Flags = DXGI_SWAP_CHAIN_FLAG_FRAME_LATENCY_WAITABLE_OBJECT | (_tearingSupported ? DXGI_SWAP_CHAIN_FLAG_ALLOW_TEARING : 0);
+
+		ComPtr<IDXGISwapChain> swapChain;
+		ThrowIfFailed(factory->CreateSwapChain(
+			GetQueue(BackendQueue::Graphics),		// Swap chain needs the queue so that it can force a flush on it.
+			&swapChainDesc,
+			&swapChain
+			));
+
+		ThrowIfFailed(swapChain.As(&_swapChain));
+
+		// Create descriptor heaps.
+		{
+			// Describe and create a render target view (RTV) descriptor heap.
+			D3D12_DESCRIPTOR_HEAP_DESC rtvHeapDesc = {};
+			rtvHeapDesc.NumDescriptors = _frameCount;
+			rtvHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_RTV;
+			rtvHeapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_NONE;
+			ThrowIfFailed(_device->CreateDescriptorHeap(&rtvHeapDesc, IID_PPV_ARGS(&_rtvHeap)));
+
+			_rtvDescriptorSize = _device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_RTV);
+
+			// Describe and create a depth stencil view (DSV) descriptor heap.
+			D3D12_DESCRIPTOR_HEAP_DESC dsvHeapDesc = {};
+			dsvHeapDesc.NumDescriptors = 1;
+			dsvHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_DSV;
+			dsvHeapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_NONE;
+			ThrowIfFailed(_device->CreateDescriptorHeap(&dsvHeapDesc, IID_PPV_ARGS(&_dsvHeap)));
+
+			// Describe and create the shader visible heap for the descriptor ring.
+			D3D12_DESCRIPTOR_HEAP_DESC heapDesc = {};
+			heapDesc.NumDescriptors = _descriptorAllocator.GetCount();
+			heapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
+			heapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
+			ThrowIfFailed(_device->CreateDescriptorHeap(&heapDesc, IID_PPV_ARGS(&_descriptorHeap)));
+
+			_descriptorSize = _device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+		}
+	}
+
+	// Load the sample assets.
+	void D3D12Backend::LoadAssets()
+	{
+		// Create the root signature. The frame constants are a descriptor table
+		// into the descriptor ring, the draw constants are bound directly as a
+		// root constant buffer view into the per frame constant buffer.
+		{
+			using namespace Microsoft::WRL;
+
+			CD3DX12_DESCRIPTOR_RANGE frameRange;
+			frameRange.Init(D3D12_DESCRIPTOR_RANGE_TYPE_CBV, 1, 0);
+
+			CD3DX12_ROOT_PARAMETER rootParameters[2];
+			rootParameters[ConstantSlotFrame].InitAsDescriptorTable(1, &frameRange, D3D12_SHADER_VISIBILITY_VERTEX);
+			rootParameters[ConstantSlotDraw].InitAsConstantBufferView(1, 0, D3D12_SHADER_VISIBILITY_VERTEX);
+
+			CD3DX12_ROOT_SIGNATURE_DESC rootSignatureDesc;
+			rootSignatureDesc.Init(_countof(rootParameters), rootParameters, 0, nullptr, D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT);
+
+			ComPtr<ID3DBlob> signature;
+			ComPtr<ID3DBlob> error;
+			ThrowIfFailed(D3D12SerializeRootSignature(&rootSignatureDesc, D3D_ROOT_SIGNATURE_VERSION_1, &signature, &error));
+			ThrowIfFailed(_device->CreateRootSignature(0, signature->GetBufferPointer(), signature->GetBufferSize(), IID_PPV_ARGS(&_rootSignature)));
+
+			PipelineKey rootSignatureKey;
+			rootSignatureKey.AddBytes(signature->GetBufferPointer(), signature->GetBufferSize());
+			_rootSignatureHash = rootSignatureKey.GetHash();
+		}
+
+		_pipelineCache.Initialize(_device.Get(), Application::GetInstance().GetPathForAsset(L"pipelines.bin"));
+
+		CreateFramebuffers();
+
+		// Create synchronization objects.
+		for(UINT i = 0; i < QueueCount; i++)
+			ThrowIfFailed(_device->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&_fences[i])));
+
+		// Create an event handle to use for frame synchronization.
+		_fenceEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+		if(_fenceEvent == nullptr)
+		{
+			ThrowIfFailed(HRESULT_FROM_WIN32(GetLastError()));
+		}
+
+		// Two timestamps per frame, the readback buffer stays mapped and is only
+		// read after the fence of the frame that resolved into it.
+		{
+			D3D12_QUERY_HEAP_DESC queryHeapDesc = {};
+			queryHeapDesc.Type = D3D12_QUERY_HEAP_TYPE_TIMESTAMP;
+			queryHeapDesc.Count = MaxFrameCount * 2;
+			ThrowIfFailed(_device->CreateQueryHeap(&queryHeapDesc, IID_PPV_ARGS(&_timestampHeap)));
+
+			ThrowIfFailed(_device->CreateCommittedResource(
+				&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_READBACK),
+				D3D12_HEAP_FLAG_NONE,
+				&CD3DX12_RESOURCE_DESC::Buffer(MaxFrameCount * 2 * sizeof(UINT64)),
+				D3D12_RESOURCE_STATE_COPY_DEST,
+				nullptr,
+				IID_PPV_ARGS(&_timestampBuffer)));
+
+			ThrowIfFailed(_timestampBuffer->Map(0, nullptr, reinterpret_cast<void**>(&_timestampData)));
+			ThrowIfFailed(GetQueue(BackendQueue::Graphics)->GetTimestampFrequency(&_timestampFrequency));
+
+			for(UINT n = 0; n < _frameCount; n++)
+			{
+				for(UINT i = 0; i < 2; i++)
+					_timestampLists[n][i] = static_cast<D3D12CommandList *>(CreateCommandList(BackendQueue::Graphics));
+			}
+		}
+	}
+
+	// Presents queue up to the latency limit, waiting on the object before a
+	// frame keeps the CPU from running further ahead.
+	void D3D12Backend::SetMaximumFrameLatency(uint32_t maxFrameLatency)
+	{
+		ThrowIfFailed(_swapChain->SetMaximumFrameLatency(std::min(std::max(maxFrameLatency, 1u), _frameCount)));
+		_frameLatencyWaitable = _swapChain->GetFrameLatencyWaitableObject();
+	}
+
+	// Helper function for acquiring the first available hardware adapter that supports Direct3D 12.
+	// If no such adapter can be found, *ppAdapter will be set to nullptr.
+	void D3D12Backend::GetHardwareAdapter(_In_ IDXGIFactory4* pFactory, _Outptr_result_maybenull_ IDXGIAdapter1** ppAdapter)
+	{
+		IDXGIAdapter1* pAdapter = nullptr;
+		*ppAdapter = nullptr;
+
+		for(UINT adapterIndex = 0; DXGI_ERROR_NOT_FOUND != pFactory->EnumAdapters1(adapterIndex, &pAdapter); ++adapterIndex)
+		{
+			DXGI_ADAPTER_DESC1 desc;
+			pAdapter->GetDesc1(&desc);
+
+			if(desc.Flags & DXGI_ADAPTER_FLAG_SOFTWARE)
+			{
+				// Don't select the Basic Render Driver adapter.
+				// If you want a software adapter, pass in "/warp" on the command line.
+				continue;
+			}
+
+			// Check to see if the adapter supports Direct3D 12, but don't create the
+			// actual device yet.
+			if(SUCCEEDED(D3D12CreateDevice(pAdapter, D3D_FEATURE_LEVEL_12_1, _uuidof(ID3D12Device), nullptr)))
+			{
+				break;
+			}
+		}
+
+		*ppAdapter = pAdapter;
+	}
+}
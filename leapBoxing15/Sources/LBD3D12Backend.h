@@ -0,0 +1,185 @@
+#pragma once
+
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "LBRenderBackend.h"
+#include "LBD3D12CommandEncoder.h"
+#include "LBD3D12PipelineCache.h"
+#include "LBFramePacer.h"
+
+namespace LB
+{
+	class D3D12Backend;
+
+	// Command list with its own allocators, each is reused once the fence value
+	// signaled after the list was executed has been reached. Bundles are never
+	// executed on their own and get a new allocator every time they are recorded.
+	class D3D12CommandList : public D3D12CommandEncoder
+	{
+	public:
+		D3D12CommandList(D3D12Backend *backend, BackendQueue queue, bool bundle = false);
+
+		void Begin() override;
+		void Close() override;
+
+		void SetRenderTarget(const void *target, const void *depthBuffer, uint32_t width, uint32_t height) override;
+		void ClearRenderTarget(const void *target, const float color[4]) override;
+		void ClearDepthBuffer(const void *depthBuffer, float depth) override;
+		void ExecuteBundle(RenderCommandList *bundle) override;
+
+		// The frame constants are bound through a view in the descriptor ring.
+		void SetConstantBuffer(uint32_t rootParameter, uint64_t location) override;
+
+		ID3D12GraphicsCommandList *GetCommandList() const { return _list.Get(); }
+
+		// The allocator recorded into is in use until the queue reached fenceValue.
+		void Retire(uint64_t fenceValue) override;
+
+	private:
+		D3D12Backend *_backend;
+		BackendQueue _queue;
+		D3D12_COMMAND_LIST_TYPE _type;
+
+		Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList> _list;
+		Microsoft::WRL::ComPtr<ID3D12CommandAllocator> _allocator;
+		std::deque<std::pair<uint64_t, Microsoft::WRL::ComPtr<ID3D12CommandAllocator>>> _allocatorPool;
+	};
+
+	// Window, swap chain, queues and everything else D3D12 specific the renderer
+	// runs on.
+	class D3D12Backend : public RenderBackend
+	{
+	public:
+		friend D3D12CommandList;
+
+		D3D12Backend(HWND hwnd, bool useWARPDevice, const RendererSettings &settings = RendererSettings());
+		~D3D12Backend();
+
+		// Compiles the shaders into the shader cache without creating a device.
+		static void PrecompileShaders(LPCWSTR shaderfile);
+
+		uint32_t GetFrameCount() const override { return _frameCount; }
+		uint32_t GetWidth() const override { return _width; }
+		uint32_t GetHeight() const override { return _height; }
+
+		uint32_t GetBackBufferIndex() override;
+		const void *GetBackBuffer(uint32_t index) override;
+		const void *GetDepthBuffer() override;
+
+		void Resize(uint32_t width, uint32_t height) override;
+		void ToggleFullscreen() override;
+
+		void WaitForPresent(uint32_t timeoutMilliseconds) override;
+		void Present() override;
+
+		void SetSourceSize(uint32_t width, uint32_t height) override;
+		double GetGpuMilliseconds() override;
+		DescriptorStatistics TakeDescriptorStatistics() override;
+
+		const void *CreateBuffer(uint64_t size, BufferHeap heap, uint32_t initialState) override;
+		void ReleaseResource(const void *resource) override;
+
+		uint8_t *MapBuffer(const void *buffer) override;
+		uint64_t GetBufferAddress(const void *buffer) override;
+
+		const void *GetPipelineState(const PipelineDescription &description, uint32_t *pipelineID) override;
+		D3D12PipelineCacheStatistics GetPipelineStatistics() { return _pipelineCache.GetStatistics(); }
+
+		RenderCommandList *CreateCommandList(BackendQueue queue) override;
+		RenderCommandList *CreateBundle() override;
+		void ExecuteCommandLists(BackendQueue queue, RenderCommandList *const *commandLists, uint32_t count) override;
+
+		void Signal(BackendQueue queue, uint64_t value) override;
+		void Wait(BackendQueue queue, BackendQueue signalQueue, uint64_t value) override;
+		uint64_t GetCompletedValue(BackendQueue queue) override;
+		void WaitForValue(BackendQueue queue, uint64_t value) override;
+
+	private:
+		void CreatePipeline(HWND hwnd, bool useWARPDevice);
+		void LoadAssets();
+		void CreateFramebuffers();
+		void SetMaximumFrameLatency(uint32_t maxFrameLatency);
+		void GetHardwareAdapter(_In_ IDXGIFactory4* pFactory, _Outptr_result_maybenull_ IDXGIAdapter1** ppAdapter);
+		D3D12_CPU_DESCRIPTOR_HANDLE GetRenderTargetView(const void *target);
+		D3D12_CPU_DESCRIPTOR_HANDLE GetDepthStencilView(const void *depthBuffer);
+		ID3D12CommandQueue *GetQueue(BackendQueue queue);
+		D3D12_GPU_DESCRIPTOR_HANDLE CreateFrameConstantView(uint64_t location);
+		void ReadTimestamps();
+
+		static void LoadShaders(LPCWSTR shaderfile, Microsoft::WRL::ComPtr<ID3DBlob> &vertexShader, Microsoft::WRL::ComPtr<ID3DBlob> &pixelShader);
+
+		static const UINT MaxFrameCount = FramePacer::MaxFrameCount;
+		static const UINT QueueCount = 2;
+
+		static const DXGI_FORMAT DepthBufferFormat = DXGI_FORMAT_D32_FLOAT;
+
+		static const UINT NoTimestampSlot = ~0u;
+		static const UINT FrameDescriptorCount = 16384;
+
+		UINT _width;
+		UINT _height;
+		UINT _frameCount;
+
+		// Pipeline objects.
+		Microsoft::WRL::ComPtr<IDXGISwapChain3> _swapChain;
+		Microsoft::WRL::ComPtr<ID3D12Device> _device;
+		Microsoft::WRL::ComPtr<ID3D12Resource> _renderTargets[MaxFrameCount];
+		Microsoft::WRL::ComPtr<ID3D12CommandQueue> _queues[QueueCount];
+		Microsoft::WRL::ComPtr<ID3D12Resource> _depthBuffer;
+		Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> _rtvHeap;
+		Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> _dsvHeap;
+		Microsoft::WRL::ComPtr<ID3D12RootSignature> _rootSignature;
+		UINT64 _rootSignatureHash;
+		UINT _rtvDescriptorSize;
+
+		// Shader visible heap, its ring holds the views created while recording.
+		// They are reused once the graphics fence passed the frame.
+		Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> _descriptorHeap;
+		UINT _descriptorSize;
+		DescriptorAllocator _descriptorAllocator;
+
+		// Synchronization objects, one fence per queue.
+		HANDLE _fenceEvent;
+		HANDLE _frameLatencyWaitable;
+		Microsoft::WRL::ComPtr<ID3D12Fence> _fences[QueueCount];
+		UINT64 _signaledValues[QueueCount];
+
+		UINT _syncInterval;
+		bool _tearingSupported;
+		bool _fullscreen;
+
+		// Pipeline states by description, persisted in a pipeline library next to
+		// the assets.
+		D3D12PipelineCache _pipelineCache;
+
+		// Lists executed on a queue since its last signal, their allocators get
+		// tagged with the next value signaled.
+		std::vector<std::unique_ptr<D3D12CommandList>> _commandLists;
+		std::vector<D3D12CommandList *> _executedLists[QueueCount];
+
+		// The first graphics submission of a frame starts with a timestamp and
+		// Present adds one after the frame's work, both are resolved into the
+		// readback buffer at the frame's back buffer index. They are read once the
+		// fence value signaled after the frame has been reached.
+		Microsoft::WRL::ComPtr<ID3D12QueryHeap> _timestampHeap;
+		Microsoft::WRL::ComPtr<ID3D12Resource> _timestampBuffer;
+		UINT64 *_timestampData;
+		UINT64 _timestampFrequency;
+		D3D12CommandList *_timestampLists[MaxFrameCount][2];
+		UINT64 _timestampFenceValues[MaxFrameCount];
+		bool _timestampsPending[MaxFrameCount];
+		UINT _timedSlot;					// Frame being submitted, if timed
+		bool _timedSlotPresented;			// Waiting for its fence value
+		UINT64 _lastTimedFenceValue;
+		double _gpuMilliseconds;
+
+		// Default heap buffers are placed resources, each in its own heap.
+		std::unordered_map<ID3D12Resource *, Microsoft::WRL::ComPtr<ID3D12Heap>> _bufferHeaps;
+
+		std::mutex _lock;
+	};
+}
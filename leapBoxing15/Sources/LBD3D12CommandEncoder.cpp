@@ -0,0 +1,102 @@
+#include "stdafx.h"
+#include "LBD3D12CommandEncoder.h"
+
+namespace LB
+{
+	void D3D12CommandEncoder::SetPipelineState(const void *pipelineState)
+	{
+		_commandList->SetPipelineState(static_cast<ID3D12PipelineState *>(const_cast<void *>(pipelineState)));
+	}
+
+	void D3D12CommandEncoder::SetPrimitiveTopology(uint32_t topology)
+	{
+		_commandList->IASetPrimitiveTopology(static_cast<D3D12_PRIMITIVE_TOPOLOGY>(topology));
+	}
+
+	void D3D12CommandEncoder::SetVertexBuffer(uint32_t slot, const VertexBufferBinding &binding)
+	{
+		D3D12_VERTEX_BUFFER_VIEW view;
+		view.BufferLocation = binding.location;
+		view.SizeInBytes = binding.size;
+		view.StrideInBytes = binding.stride;
+
+		_commandList->IASetVertexBuffers(slot, 1, &view);
+	}
+
+	void D3D12CommandEncoder::SetIndexBuffer(const IndexBufferBinding &binding)
+	{
+		D3D12_INDEX_BUFFER_VIEW view;
+		view.BufferLocation = binding.location;
+		view.SizeInBytes = binding.size;
+		view.Format = static_cast<DXGI_FORMAT>(binding.format);
+
+		_commandList->IASetIndexBuffer(&view);
+	}
+
+	void D3D12CommandEncoder::SetConstantBuffer(uint32_t rootParameter, uint64_t location)
+	{
+		_commandList->SetGraphicsRootConstantBufferView(rootParameter, location);
+	}
+
+	void D3D12CommandEncoder::DrawInstanced(uint32_t vertexCount, uint32_t instanceCount, uint32_t firstVertex, uint32_t firstInstance)
+	{
+		_commandList->DrawInstanced(vertexCount, instanceCount, firstVertex, firstInstance);
+	}
+
+	void D3D12CommandEncoder::DrawIndexedInstanced(uint32_t indexCount, uint32_t instanceCount, uint32_t firstIndex, int32_t baseVertex, uint32_t firstInstance)
+	{
+		_commandList->DrawIndexedInstanced(indexCount, instanceCount, firstIndex, baseVertex, firstInstance);
+	}
+
+	// Render graph states are passed through as they are.
+	static_assert(ResourceState::RenderTarget == D3D12_RESOURCE_STATE_RENDER_TARGET && ResourceState::DepthWrite == D3D12_RESOURCE_STATE_DEPTH_WRITE && ResourceState::PixelShaderResource == D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE && ResourceState::CopySource == D3D12_RESOURCE_STATE_COPY_SOURCE && ResourceState::GenericRead == D3D12_RESOURCE_STATE_GENERIC_READ, "ResourceState values differ from D3D12_RESOURCE_STATES");
+
+	void D3D12CommandEncoder::ResourceBarrier(const ResourceStateBarrier *barriers, size_t count)
+	{
+		_barriers.clear();
+
+		for(size_t i = 0; i < count; i++)
+		{
+			const ResourceStateBarrier &barrier = barriers[i];
+			ID3D12Resource *resource = GetResource(barrier.resource);
+
+			switch(barrier.type)
+			{
+				case RenderBarrierType::Transition:
+					_barriers.push_back(CD3DX12_RESOURCE_BARRIER::Transition(resource, static_cast<D3D12_RESOURCE_STATES>(barrier.stateBefore), static_cast<D3D12_RESOURCE_STATES>(barrier.stateAfter)));
+					break;
+				case RenderBarrierType::Aliasing:
+					_barriers.push_back(CD3DX12_RESOURCE_BARRIER::Aliasing(GetResource(barrier.aliasBefore), resource));
+					break;
+				case RenderBarrierType::UnorderedAccess:
+					_barriers.push_back(CD3DX12_RESOURCE_BARRIER::UAV(resource));
+					break;
+			}
+		}
+
+		_commandList->ResourceBarrier(static_cast<UINT>(_barriers.size()), _barriers.data());
+	}
+
+	void D3D12CommandEncoder::CopyBufferRegion(const void *destination, uint64_t destinationOffset, const void *source, uint64_t sourceOffset, uint64_t size)
+	{
+		_commandList->CopyBufferRegion(GetResource(destination), destinationOffset, GetResource(source), sourceOffset, size);
+	}
+
+	VertexBufferBinding D3D12CommandEncoder::MakeBinding(const D3D12_VERTEX_BUFFER_VIEW &view)
+	{
+		VertexBufferBinding binding;
+		binding.location = view.BufferLocation;
+		binding.size = view.SizeInBytes;
+		binding.stride = view.StrideInBytes;
+		return binding;
+	}
+
+	IndexBufferBinding D3D12CommandEncoder::MakeBinding(const D3D12_INDEX_BUFFER_VIEW &view)
+	{
+		IndexBufferBinding binding;
+		binding.location = view.BufferLocation;
+		binding.size = view.SizeInBytes;
+		binding.format = static_cast<uint32_t>(view.Format);
+		return binding;
+	}
+}
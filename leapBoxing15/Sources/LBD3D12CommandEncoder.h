@@ -0,0 +1,42 @@
+#pragma once
+
+#include <vector>
+
+#include "LBCommandEncoder.h"
+
+namespace LB
+{
+	// Forwards encoder calls to a D3D12 graphics command list. Recording and
+	// render targets are left to the backend's command lists, which know about
+	// allocators and descriptors.
+	class D3D12CommandEncoder : public RenderCommandList
+	{
+	public:
+		D3D12CommandEncoder() : _commandList(nullptr) {}
+
+		void SetCommandList(ID3D12GraphicsCommandList *commandList) { _commandList = commandList; }
+
+		void SetPipelineState(const void *pipelineState) override;
+		void SetPrimitiveTopology(uint32_t topology) override;
+		void SetVertexBuffer(uint32_t slot, const VertexBufferBinding &binding) override;
+		void SetIndexBuffer(const IndexBufferBinding &binding) override;
+		void SetConstantBuffer(uint32_t rootParameter, uint64_t location) override;
+
+		void DrawInstanced(uint32_t vertexCount, uint32_t instanceCount, uint32_t firstVertex, uint32_t firstInstance) override;
+		void DrawIndexedInstanced(uint32_t indexCount, uint32_t instanceCount, uint32_t firstIndex, int32_t baseVertex, uint32_t firstInstance) override;
+
+		void ResourceBarrier(const ResourceStateBarrier *barriers, size_t count) override;
+		void CopyBufferRegion(const void *destination, uint64_t destinationOffset, const void *source, uint64_t sourceOffset, uint64_t size) override;
+
+		static VertexBufferBinding MakeBinding(const D3D12_VERTEX_BUFFER_VIEW &view);
+		static IndexBufferBinding MakeBinding(const D3D12_INDEX_BUFFER_VIEW &view);
+
+	protected:
+		static ID3D12Resource *GetResource(const void *resource) { return static_cast<ID3D12Resource *>(const_cast<void *>(resource)); }
+
+		ID3D12GraphicsCommandList *_commandList;
+
+	private:
+		std::vector<D3D12_RESOURCE_BARRIER> _barriers;
+	};
+}
@@ -0,0 +1,235 @@
+#include "stdafx.h"
+#include "LBD3D12PipelineCache.h"
+
+namespace LB
+{
+	D3D12PipelineCache::D3D12PipelineCache() : _libraryChanged(false), _statistics()
+	{}
+
+	void D3D12PipelineCache::Initialize(ID3D12Device *device, const std::wstring &path)
+	{
+		_device = device;
+		_path = path;
+
+		// Pipeline libraries need the Windows 10 Anniversary Update runtime.
+		Microsoft::WRL::ComPtr<ID3D12Device1> device1;
+		if(FAILED(device->QueryInterface(IID_PPV_ARGS(&device1))))
+			return;
+
+		FILE *file = nullptr;
+		_wfopen_s(&file, path.c_str(), L"rb");
+		if(file)
+		{
+			fseek(file, 0, SEEK_END);
+			const long size = ftell(file);
+			fseek(file, 0, SEEK_SET);
+
+			if(size > 0)
+			{
+				_libraryData.resize(size);
+				if(fread(_libraryData.data(), 1, size, file) != static_cast<size_t>(size))
+					_libraryData.clear();
+			}
+
+			fclose(file);
+		}
+
+		// A library written by another driver or adapter is rejected, start over
+		// with an empty one in that case.
+		if(!_libraryData.empty() && SUCCEEDED(device1->CreatePipelineLibrary(_libraryData.data(), _libraryData.size(), IID_PPV_ARGS(&_library))))
+			return;
+
+		_libraryData.clear();
+		_libraryChanged = true;
+
+		if(FAILED(device1->CreatePipelineLibrary(nullptr, 0, IID_PPV_ARGS(&_library))))
+			_library.Reset();
+	}
+
+	void D3D12PipelineCache::Save()
+	{
+		std::lock_guard<std::mutex> lock(_lock);
+
+		if(!_library || !_libraryChanged)
+			return;
+
+		std::vector<UINT8> data(_library->GetSerializedSize());
+		if(data.empty() || FAILED(_library->Serialize(data.data(), data.size())))
+			return;
+
+		FILE *file = nullptr;
+		_wfopen_s(&file, _path.c_str(), L"wb");
+		if(!file)
+			return;
+
+		const size_t written = fwrite(data.data(), 1, data.size(), file);
+		fclose(file);
+
+		// A partially written library would only be rejected on the next launch.
+		if(written != data.size())
+			_wremove(_path.c_str());
+		else
+			_libraryChanged = false;
+	}
+
+	Microsoft::WRL::ComPtr<ID3D12PipelineState> D3D12PipelineCache::GetPipelineState(const D3D12_GRAPHICS_PIPELINE_STATE_DESC &desc, uint64_t rootSignatureHash, uint32_t *pipelineID)
+	{
+		PipelineKey key;
+		BuildKey(desc, rootSignatureHash, key);
+
+		return _cache.GetOrCreate(key, [&]() {
+			return CreatePipelineState(desc, key);
+		}, pipelineID);
+	}
+
+	Microsoft::WRL::ComPtr<ID3D12PipelineState> D3D12PipelineCache::CreatePipelineState(const D3D12_GRAPHICS_PIPELINE_STATE_DESC &desc, const PipelineKey &key)
+	{
+		const std::wstring name = key.GetName();
+		Microsoft::WRL::ComPtr<ID3D12PipelineState> pipelineState;
+
+		if(_library)
+		{
+			std::lock_guard<std::mutex> lock(_lock);
+
+			// Fails if the name is unknown or the stored pipeline doesn't match desc.
+			if(SUCCEEDED(_library->LoadGraphicsPipeline(name.c_str(), &desc, IID_PPV_ARGS(&pipelineState))))
+			{
+				_statistics.loaded++;
+				return pipelineState;
+			}
+		}
+
+		ThrowIfFailed(_device->CreateGraphicsPipelineState(&desc, IID_PPV_ARGS(&pipelineState)));
+
+		std::lock_guard<std::mutex> lock(_lock);
+		_statistics.compiled++;
+
+		if(_library && SUCCEEDED(_library->StorePipeline(name.c_str(), pipelineState.Get())))
+			_libraryChanged = true;
+
+		return pipelineState;
+	}
+
+	D3D12PipelineCacheStatistics D3D12PipelineCache::GetStatistics()
+	{
+		const PipelineCacheStatistics cacheStatistics = _cache.GetStatistics();
+
+		std::lock_guard<std::mutex> lock(_lock);
+		D3D12PipelineCacheStatistics statistics = _statistics;
+		statistics.deduplicated = cacheStatistics.hits + cacheStatistics.waits;
+		return statistics;
+	}
+
+	static void AddShader(PipelineKey &key, const D3D12_SHADER_BYTECODE &shader)
+	{
+		key.AddUInt64(shader.pShaderBytecode ? shader.BytecodeLength : 0);
+		if(shader.pShaderBytecode)
+			key.AddBytes(shader.pShaderBytecode, shader.BytecodeLength);
+	}
+
+	static void AddStencilOperation(PipelineKey &key, const D3D12_DEPTH_STENCILOP_DESC &operation)
+	{
+		key.AddUInt32(operation.StencilFailOp);
+		key.AddUInt32(operation.StencilDepthFailOp);
+		key.AddUInt32(operation.StencilPassOp);
+		key.AddUInt32(operation.StencilFunc);
+	}
+
+	// Every field is added on its own, padding and pointer values never end up in
+	// the key. The cached blob is left out as it doesn't change the pipeline.
+	void D3D12PipelineCache::BuildKey(const D3D12_GRAPHICS_PIPELINE_STATE_DESC &desc, uint64_t rootSignatureHash, PipelineKey &key)
+	{
+		key.Clear();
+		key.AddUInt64(rootSignatureHash);
+
+		AddShader(key, desc.VS);
+		AddShader(key, desc.PS);
+		AddShader(key, desc.DS);
+		AddShader(key, desc.HS);
+		AddShader(key, desc.GS);
+
+		const D3D12_STREAM_OUTPUT_DESC &streamOutput = desc.StreamOutput;
+		key.AddUInt32(streamOutput.NumEntries);
+		for(UINT i = 0; i < streamOutput.NumEntries; i++)
+		{
+			const D3D12_SO_DECLARATION_ENTRY &entry = streamOutput.pSODeclaration[i];
+			key.AddUInt32(entry.Stream);
+			key.AddString(entry.SemanticName);
+			key.AddUInt32(entry.SemanticIndex);
+			key.AddUInt32(entry.StartComponent);
+			key.AddUInt32(entry.ComponentCount);
+			key.AddUInt32(entry.OutputSlot);
+		}
+		key.AddUInt32(streamOutput.NumStrides);
+		for(UINT i = 0; i < streamOutput.NumStrides; i++)
+			key.AddUInt32(streamOutput.pBufferStrides[i]);
+		key.AddUInt32(streamOutput.RasterizedStream);
+
+		const D3D12_BLEND_DESC &blend = desc.BlendState;
+		key.AddUInt32(blend.AlphaToCoverageEnable);
+		key.AddUInt32(blend.IndependentBlendEnable);
+		for(UINT i = 0; i < D3D12_SIMULTANEOUS_RENDER_TARGET_COUNT; i++)
+		{
+			const D3D12_RENDER_TARGET_BLEND_DESC &target = blend.RenderTarget[i];
+			key.AddUInt32(target.BlendEnable);
+			key.AddUInt32(target.LogicOpEnable);
+			key.AddUInt32(target.SrcBlend);
+			key.AddUInt32(target.DestBlend);
+			key.AddUInt32(target.BlendOp);
+			key.AddUInt32(target.SrcBlendAlpha);
+			key.AddUInt32(target.DestBlendAlpha);
+			key.AddUInt32(target.BlendOpAlpha);
+			key.AddUInt32(target.LogicOp);
+			key.AddUInt32(target.RenderTargetWriteMask);
+		}
+
+		key.AddUInt32(desc.SampleMask);
+
+		const D3D12_RASTERIZER_DESC &rasterizer = desc.RasterizerState;
+		key.AddUInt32(rasterizer.FillMode);
+		key.AddUInt32(rasterizer.CullMode);
+		key.AddUInt32(rasterizer.FrontCounterClockwise);
+		key.AddUInt32(static_cast<uint32_t>(rasterizer.DepthBias));
+		key.AddFloat(rasterizer.DepthBiasClamp);
+		key.AddFloat(rasterizer.SlopeScaledDepthBias);
+		key.AddUInt32(rasterizer.DepthClipEnable);
+		key.AddUInt32(rasterizer.MultisampleEnable);
+		key.AddUInt32(rasterizer.AntialiasedLineEnable);
+		key.AddUInt32(rasterizer.ForcedSampleCount);
+		key.AddUInt32(rasterizer.ConservativeRaster);
+
+		const D3D12_DEPTH_STENCIL_DESC &depthStencil = desc.DepthStencilState;
+		key.AddUInt32(depthStencil.DepthEnable);
+		key.AddUInt32(depthStencil.DepthWriteMask);
+		key.AddUInt32(depthStencil.DepthFunc);
+		key.AddUInt32(depthStencil.StencilEnable);
+		key.AddUInt32(depthStencil.StencilReadMask);
+		key.AddUInt32(depthStencil.StencilWriteMask);
+		AddStencilOperation(key, depthStencil.FrontFace);
+		AddStencilOperation(key, depthStencil.BackFace);
+
+		key.AddUInt32(desc.InputLayout.NumElements);
+		for(UINT i = 0; i < desc.InputLayout.NumElements; i++)
+		{
+			const D3D12_INPUT_ELEMENT_DESC &element = desc.InputLayout.pInputElementDescs[i];
+			key.AddString(element.SemanticName);
+			key.AddUInt32(element.SemanticIndex);
+			key.AddUInt32(element.Format);
+			key.AddUInt32(element.InputSlot);
+			key.AddUInt32(element.AlignedByteOffset);
+			key.AddUInt32(element.InputSlotClass);
+			key.AddUInt32(element.InstanceDataStepRate);
+		}
+
+		key.AddUInt32(desc.IBStripCutValue);
+		key.AddUInt32(desc.PrimitiveTopologyType);
+		key.AddUInt32(desc.NumRenderTargets);
+		for(UINT i = 0; i < D3D12_SIMULTANEOUS_RENDER_TARGET_COUNT; i++)
+			key.AddUInt32(desc.RTVFormats[i]);
+		key.AddUInt32(desc.DSVFormat);
+		key.AddUInt32(desc.SampleDesc.Count);
+		key.AddUInt32(desc.SampleDesc.Quality);
+		key.AddUInt32(desc.NodeMask);
+		key.AddUInt32(desc.Flags);
+	}
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "LBPipelineCache.h"
+
+namespace LB
+{
+	struct D3D12PipelineCacheStatistics
+	{
+		uint32_t compiled;			// Created by the driver
+		uint32_t loaded;			// Found in the pipeline library
+		uint32_t deduplicated;		// Served from memory for an identical description
+	};
+
+	// Hands out one pipeline state per distinct description. Pipelines missing
+	// in memory are looked up in an ID3D12PipelineLibrary loaded from disk before
+	// the driver compiles them, and newly compiled ones are stored into it so the
+	// next launch finds them. Without ID3D12Device1 it only caches in memory.
+	class D3D12PipelineCache
+	{
+	public:
+		D3D12PipelineCache();
+
+		// Loads the library at path if there is one the driver accepts.
+		void Initialize(ID3D12Device *device, const std::wstring &path);
+
+		// Writes the library back if pipelines were added to it.
+		void Save();
+
+		// The root signature is hashed through rootSignatureHash, which should
+		// be derived from its serialized blob. pipelineID receives a small id
+		// shared by all identical descriptions.
+		Microsoft::WRL::ComPtr<ID3D12PipelineState> GetPipelineState(const D3D12_GRAPHICS_PIPELINE_STATE_DESC &desc, uint64_t rootSignatureHash, uint32_t *pipelineID = nullptr);
+
+		D3D12PipelineCacheStatistics GetStatistics();
+
+		static void BuildKey(const D3D12_GRAPHICS_PIPELINE_STATE_DESC &desc, uint64_t rootSignatureHash, PipelineKey &key);
+
+	private:
+		Microsoft::WRL::ComPtr<ID3D12PipelineState> CreatePipelineState(const D3D12_GRAPHICS_PIPELINE_STATE_DESC &desc, const PipelineKey &key);
+
+		Microsoft::WRL::ComPtr<ID3D12Device> _device;
+		Microsoft::WRL::ComPtr<ID3D12PipelineLibrary> _library;
+
+		// The library references this memory for its whole lifetime.
+		std::vector<UINT8> _libraryData;
+		std::wstring _path;
+		bool _libraryChanged;
+
+		PipelineCache<Microsoft::WRL::ComPtr<ID3D12PipelineState>> _cache;
+
+		std::mutex _lock;
+		D3D12PipelineCacheStatistics _statistics;
+	};
+}
@@ -0,0 +1,168 @@
+#if defined(_WIN32)
+#include "stdafx.h"
+#endif
+
+#include "LBDescriptorAllocator.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+namespace LB
+{
+	DescriptorFreeList::DescriptorFreeList(uint32_t base, uint32_t count) : _freeCount(count)
+	{
+		if(count > 0)
+			_ranges.push_back({ base, count });
+	}
+
+	uint32_t DescriptorFreeList::Allocate(uint32_t count)
+	{
+		if(count == 0)
+			return InvalidIndex;
+
+		for(size_t i = 0; i < _ranges.size(); i++)
+		{
+			Range &range = _ranges[i];
+			if(range.count < count)
+				continue;
+
+			const uint32_t index = range.index;
+			range.index += count;
+			range.count -= count;
+
+			if(range.count == 0)
+				_ranges.erase(_ranges.begin() + i);
+
+			_freeCount -= count;
+			return index;
+		}
+
+		return InvalidIndex;
+	}
+
+	void DescriptorFreeList::Free(uint32_t index, uint32_t count)
+	{
+		if(count == 0)
+			return;
+
+		std::vector<Range>::iterator next = std::lower_bound(_ranges.begin(), _ranges.end(), index, [](const Range &range, uint32_t value) {
+			return range.index < value;
+		});
+
+		assert(next == _ranges.end() || index + count <= next->index);
+		assert(next == _ranges.begin() || (next - 1)->index + (next - 1)->count <= index);
+
+		_freeCount += count;
+
+		const bool mergePrevious = (next != _ranges.begin() && (next - 1)->index + (next - 1)->count == index);
+		const bool mergeNext = (next != _ranges.end() && index + count == next->index);
+
+		if(mergePrevious && mergeNext)
+		{
+			(next - 1)->count += count + next->count;
+			_ranges.erase(next);
+		}
+		else if(mergePrevious)
+		{
+			(next - 1)->count += count;
+		}
+		else if(mergeNext)
+		{
+			next->index = index;
+			next->count += count;
+		}
+		else
+		{
+			_ranges.insert(next, { index, count });
+		}
+	}
+
+	uint32_t DescriptorFreeList::GetLargestFreeRange() const
+	{
+		uint32_t largest = 0;
+		for(const Range &range : _ranges)
+			largest = std::max(largest, range.count);
+
+		return largest;
+	}
+
+
+	DescriptorAllocator::DescriptorAllocator(uint32_t persistentCount, uint32_t transientCount) : _persistentCount(persistentCount), _transientCount(transientCount), _persistent(0, persistentCount), _transient(transientCount)
+	{
+		memset(&_statistics, 0, sizeof(_statistics));
+	}
+
+	uint32_t DescriptorAllocator::AllocatePersistent(uint32_t count)
+	{
+		const uint32_t index = _persistent.Allocate(count);
+		if(index == InvalidIndex)
+		{
+			_statistics.failedAllocations++;
+			return InvalidIndex;
+		}
+
+		_statistics.persistentAllocations += count;
+		return index;
+	}
+
+	void DescriptorAllocator::FreePersistent(uint32_t index, uint32_t count, uint64_t fenceValue)
+	{
+		assert(index + count <= _persistentCount);
+		assert(_pendingFrees.empty() || _pendingFrees.back().fenceValue <= fenceValue);
+
+		_pendingFrees.push_back({ fenceValue, index, count });
+		_statistics.persistentFrees += count;
+	}
+
+	uint32_t DescriptorAllocator::AllocateTransient(uint32_t count)
+	{
+		const uint64_t offset = _transient.Allocate(count, 1);
+		if(offset == UploadRing::InvalidOffset)
+		{
+			_statistics.failedAllocations++;
+			return InvalidIndex;
+		}
+
+		_statistics.transientDescriptors += count;
+		return _persistentCount + static_cast<uint32_t>(offset);
+	}
+
+	void DescriptorAllocator::FinishFrame(uint64_t fenceValue)
+	{
+		_transient.FinishBatch(fenceValue);
+	}
+
+	void DescriptorAllocator::Reclaim(uint64_t completedFenceValue)
+	{
+		_transient.Reclaim(completedFenceValue);
+
+		while(!_pendingFrees.empty() && _pendingFrees.front().fenceValue <= completedFenceValue)
+		{
+			_persistent.Free(_pendingFrees.front().index, _pendingFrees.front().count);
+			_pendingFrees.pop_front();
+		}
+	}
+
+	uint64_t DescriptorAllocator::GetOldestPendingFence() const
+	{
+		uint64_t fenceValue = _transient.GetOldestPendingFence();
+		if(!_pendingFrees.empty() && (fenceValue == 0 || _pendingFrees.front().fenceValue < fenceValue))
+			fenceValue = _pendingFrees.front().fenceValue;
+
+		return fenceValue;
+	}
+
+	DescriptorStatistics DescriptorAllocator::GetStatistics() const
+	{
+		DescriptorStatistics statistics = _statistics;
+		statistics.persistentInUse = _persistentCount - _persistent.GetFreeCount();
+		statistics.transientInUse = static_cast<uint32_t>(_transient.GetUsedSize());
+		return statistics;
+	}
+
+	void DescriptorAllocator::ResetStatistics()
+	{
+		memset(&_statistics, 0, sizeof(_statistics));
+	}
+}
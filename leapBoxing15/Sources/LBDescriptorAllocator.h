@@ -0,0 +1,104 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+#include "LBUploadRing.h"
+
+namespace LB
+{
+	// First fit allocator for contiguous ranges of descriptor indices. Free ranges
+	// are kept sorted by index and merged with their neighbours when returned.
+	class DescriptorFreeList
+	{
+	public:
+		static const uint32_t InvalidIndex = ~0u;
+
+		DescriptorFreeList(uint32_t base, uint32_t count);
+
+		// Returns the first index of count contiguous descriptors or InvalidIndex.
+		uint32_t Allocate(uint32_t count);
+		void Free(uint32_t index, uint32_t count);
+
+		uint32_t GetFreeCount() const { return _freeCount; }
+		uint32_t GetLargestFreeRange() const;
+		size_t GetFreeRangeCount() const { return _ranges.size(); }
+
+	private:
+		struct Range
+		{
+			uint32_t index;
+			uint32_t count;
+		};
+
+		std::vector<Range> _ranges;
+		uint32_t _freeCount;
+	};
+
+	struct DescriptorStatistics
+	{
+		// Churn since the last ResetStatistics, usually one frame.
+		uint32_t persistentAllocations;
+		uint32_t persistentFrees;
+		uint32_t transientDescriptors;
+		uint32_t failedAllocations;
+
+		uint32_t persistentInUse;
+		uint32_t transientInUse;
+	};
+
+	// Splits one shader visible heap into a persistent region at the start, for
+	// descriptors living across many frames, and a ring behind it that per frame
+	// descriptor tables are copied into. Frees and ring space are only handed
+	// back once the fence passed the frame that could still reference them.
+	// Works on indices only, whoever owns the heap maps them to handles.
+	class DescriptorAllocator
+	{
+	public:
+		static const uint32_t InvalidIndex = DescriptorFreeList::InvalidIndex;
+
+		DescriptorAllocator(uint32_t persistentCount, uint32_t transientCount);
+
+		uint32_t AllocatePersistent(uint32_t count = 1);
+
+		// The range is reused after the fence reached fenceValue.
+		void FreePersistent(uint32_t index, uint32_t count, uint64_t fenceValue);
+
+		// Returns the first heap index of count contiguous ring descriptors, or
+		// InvalidIndex if the ring is full until older frames complete.
+		uint32_t AllocateTransient(uint32_t count);
+
+		// Everything freed or allocated from the ring since the last call is in
+		// use until the fence reaches fenceValue.
+		void FinishFrame(uint64_t fenceValue);
+		void Reclaim(uint64_t completedFenceValue);
+
+		uint64_t GetOldestPendingFence() const;
+
+		uint32_t GetCount() const { return _persistentCount + _transientCount; }
+		uint32_t GetPersistentCount() const { return _persistentCount; }
+		uint32_t GetTransientCount() const { return _transientCount; }
+
+		DescriptorStatistics GetStatistics() const;
+		void ResetStatistics();
+
+	private:
+		struct PendingFree
+		{
+			uint64_t fenceValue;
+			uint32_t index;
+			uint32_t count;
+		};
+
+		uint32_t _persistentCount;
+		uint32_t _transientCount;
+
+		DescriptorFreeList _persistent;
+		UploadRing _transient;
+		std::deque<PendingFree> _pendingFrees;
+
+		DescriptorStatistics _statistics;
+	};
+}
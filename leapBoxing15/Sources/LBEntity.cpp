@@ -1,9 +1,12 @@
+#if defined(_WIN32)
 #include "stdafx.h"
+#endif
+
 #include "LBEntity.h"
 
 namespace LB
 {
-	Entity::Entity(Model *model) : _model(model)
+	Entity::Entity(Model *model) : _model(model), _boundsMin(-1.0f), _boundsMax(1.0f), _isStatic(false)
 	{
 
 	}
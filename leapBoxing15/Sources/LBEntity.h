@@ -12,7 +12,42 @@ namespace LB
 		friend Renderer;
 		Entity(Model *model);
 
+		inline Model *GetModel() const
+		{
+			return _model;
+		}
+
+		inline void SetBounds(const RN::Vector3 &min, const RN::Vector3 &max)
+		{
+			_boundsMin = min;
+			_boundsMax = max;
+		}
+
+		inline const RN::Vector3 &GetBoundsMin() const
+		{
+			return _boundsMin;
+		}
+
+		inline const RN::Vector3 &GetBoundsMax() const
+		{
+			return _boundsMax;
+		}
+
+		// Static entities never move and get merged into batches by the scene.
+		inline void SetStatic(bool isStatic)
+		{
+			_isStatic = isStatic;
+		}
+
+		inline bool IsStatic() const
+		{
+			return _isStatic;
+		}
+
 	private:
 		Model *_model;
+		RN::Vector3 _boundsMin;
+		RN::Vector3 _boundsMax;
+		bool _isStatic;
 	};
 }
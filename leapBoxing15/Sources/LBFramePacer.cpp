@@ -0,0 +1,92 @@
+#if defined(_WIN32)
+#include "stdafx.h"
+#endif
+
+#include "LBFramePacer.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+namespace LB
+{
+	const uint32_t FramePacer::MinFrameCount;
+	const uint32_t FramePacer::MaxFrameCount;
+
+	FramePacer::FramePacer(uint32_t frameCount, uint32_t maxFrameLatency) : _submittedValue(0), _completedValue(0), _pendingStart(0), _pendingCount(0), _currentIndex(0), _currentStartTime(0.0), _inFrame(false)
+	{
+		_frameCount = std::min(std::max(frameCount, MinFrameCount), MaxFrameCount);
+		_maxFrameLatency = std::min(std::max(maxFrameLatency, 1u), _frameCount);
+
+		memset(_indexFenceValues, 0, sizeof(_indexFenceValues));
+		memset(_pending, 0, sizeof(_pending));
+		memset(&_statistics, 0, sizeof(_statistics));
+	}
+
+	uint64_t FramePacer::GetWaitValue(uint32_t frameIndex) const
+	{
+		assert(frameIndex < _frameCount);
+
+		// The frame about to start will signal _submittedValue + 1, the one
+		// _maxFrameLatency frames before it has to be done.
+		const uint64_t latencyValue = (_submittedValue + 1 > _maxFrameLatency) ? _submittedValue + 1 - _maxFrameLatency : 0;
+		return std::max(latencyValue, _indexFenceValues[frameIndex]);
+	}
+
+	void FramePacer::BeginFrame(uint32_t frameIndex, double time, double waitMilliseconds)
+	{
+		assert(!_inFrame && frameIndex < _frameCount);
+
+		_currentIndex = frameIndex;
+		_currentStartTime = time;
+		_inFrame = true;
+
+		_statistics.waitMilliseconds = waitMilliseconds;
+		_statistics.framesInFlight = _pendingCount;
+	}
+
+	uint64_t FramePacer::EndFrame(double time)
+	{
+		assert(_inFrame);
+
+		const uint64_t fenceValue = ++_submittedValue;
+		_indexFenceValues[_currentIndex] = fenceValue;
+		_inFrame = false;
+
+		// Waiting for GetWaitValue keeps this below the frame count, the oldest
+		// entry is only dropped if frames are submitted without waiting.
+		if(_pendingCount == MaxFrameCount)
+		{
+			_pendingStart = (_pendingStart + 1) % MaxFrameCount;
+			_pendingCount--;
+		}
+
+		_pending[(_pendingStart + _pendingCount) % MaxFrameCount] = { fenceValue, _currentStartTime };
+		_pendingCount++;
+
+		_statistics.cpuMilliseconds = (time - _currentStartTime) * 1000.0;
+		return fenceValue;
+	}
+
+	uint64_t FramePacer::Flush()
+	{
+		return ++_submittedValue;
+	}
+
+	void FramePacer::Complete(uint64_t completedValue, double time)
+	{
+		_completedValue = std::max(_completedValue, completedValue);
+
+		while(_pendingCount > 0 && _pending[_pendingStart].fenceValue <= _completedValue)
+		{
+			const double latency = (time - _pending[_pendingStart].startTime) * 1000.0;
+
+			_statistics.framesCompleted++;
+			_statistics.latencyMilliseconds = latency;
+			_statistics.averageLatencyMilliseconds += (latency - _statistics.averageLatencyMilliseconds) / static_cast<double>(std::min<uint64_t>(_statistics.framesCompleted, 60));
+
+			_pendingStart = (_pendingStart + 1) % MaxFrameCount;
+			_pendingCount--;
+		}
+	}
+}
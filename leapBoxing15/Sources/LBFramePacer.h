@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstdint>
+
+namespace LB
+{
+	struct FramePacerStatistics
+	{
+		uint32_t framesInFlight;		// Submitted but not completed when the last frame started
+		uint64_t framesCompleted;
+		double cpuMilliseconds;			// Frame start to submission of the last frame
+		double waitMilliseconds;		// Time the last frame waited before it could start
+		double latencyMilliseconds;		// Frame start to observed GPU completion, last completed frame
+		double averageLatencyMilliseconds;	// Moving average over about 60 frames
+	};
+
+	// Decides how long the CPU may run ahead of the GPU and tracks per frame
+	// latency. Frames signal consecutive fence values starting at 1, before a
+	// frame starts the fence has to reach the value returned by GetWaitValue.
+	// That covers both the back buffer the frame renders into, whose resources
+	// were last used frameCount frames ago, and the latency limit: with a
+	// maximum latency of N, at most N frames including the one being recorded
+	// are in flight at once. Times are passed in so the pacing can be driven
+	// by a simulated clock and fence.
+	class FramePacer
+	{
+	public:
+		static const uint32_t MinFrameCount = 2;
+		static const uint32_t MaxFrameCount = 4;
+
+		// Both are clamped, maxFrameLatency to [1, frameCount].
+		FramePacer(uint32_t frameCount, uint32_t maxFrameLatency);
+
+		uint64_t GetWaitValue(uint32_t frameIndex) const;
+
+		// Called once the waits are done, time is when the frame starts sampling
+		// input. waitMilliseconds is how long the frame was held back.
+		void BeginFrame(uint32_t frameIndex, double time, double waitMilliseconds);
+
+		// Returns the fence value to signal after the frame's command lists.
+		uint64_t EndFrame(double time);
+
+		// Returns a fence value for work outside of frames, waiting for it waits
+		// for everything submitted so far.
+		uint64_t Flush();
+
+		// Records completion of all frames up to completedValue, observed at time.
+		void Complete(uint64_t completedValue, double time);
+
+		uint32_t GetFrameCount() const { return _frameCount; }
+		uint32_t GetMaxFrameLatency() const { return _maxFrameLatency; }
+		uint64_t GetSubmittedValue() const { return _submittedValue; }
+		uint64_t GetCompletedValue() const { return _completedValue; }
+		const FramePacerStatistics &GetStatistics() const { return _statistics; }
+
+	private:
+		struct FrameTiming
+		{
+			uint64_t fenceValue;
+			double startTime;
+		};
+
+		uint32_t _frameCount;
+		uint32_t _maxFrameLatency;
+
+		uint64_t _submittedValue;
+		uint64_t _completedValue;
+		uint64_t _indexFenceValues[MaxFrameCount];
+
+		// Frames still on the GPU, oldest first. Flushes are not frames and don't
+		// get an entry.
+		FrameTiming _pending[MaxFrameCount];
+		uint32_t _pendingStart;
+		uint32_t _pendingCount;
+
+		uint32_t _currentIndex;
+		double _currentStartTime;
+		bool _inFrame;
+
+		FramePacerStatistics _statistics;
+	};
+}
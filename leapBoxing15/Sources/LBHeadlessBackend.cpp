@@ -0,0 +1,343 @@
+#if defined(_WIN32)
+#include "stdafx.h"
+#endif
+
+#include "LBHeadlessBackend.h"
+#include "LBFramePacer.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <stdexcept>
+
+namespace LB
+{
+	HeadlessBackend::HeadlessBackend(uint32_t width, uint32_t height, uint32_t frameCount) : _width(width), _height(height), _sourceWidth(width), _sourceHeight(height), _backBufferIndex(0), _depthBuffer(nullptr), _nextAddress(AddressAlignment), _descriptors(0, FrameDescriptorCount)
+	{
+		_frameCount = std::min(std::max(frameCount, FramePacer::MinFrameCount), FramePacer::MaxFrameCount);
+
+		memset(_completedValues, 0, sizeof(_completedValues));
+		memset(&_statistics, 0, sizeof(_statistics));
+
+		CreateFramebuffers();
+	}
+
+	HeadlessBackend::~HeadlessBackend()
+	{
+		ReleaseFramebuffers();
+
+		for(auto &entry : _buffers)
+			delete entry.second;
+	}
+
+	const void *HeadlessBackend::GetBackBuffer(uint32_t index)
+	{
+		return _backBuffers[index];
+	}
+
+	const void *HeadlessBackend::GetDepthBuffer()
+	{
+		return _depthBuffer;
+	}
+
+	void HeadlessBackend::CreateFramebuffers()
+	{
+		for(uint32_t i = 0; i < _frameCount; i++)
+		{
+			Resource *resource = new Resource();
+			resource->data.resize(static_cast<size_t>(_width) * _height * 4, 0);
+			resource->address = 0;
+			resource->heap = BufferHeap::Default;
+			resource->width = _width;
+			resource->height = _height;
+
+			_backBuffers.push_back(resource);
+		}
+
+		_depthBuffer = new Resource();
+		_depthBuffer->data.resize(static_cast<size_t>(_width) * _height * sizeof(float), 0);
+		_depthBuffer->address = 0;
+		_depthBuffer->heap = BufferHeap::Default;
+		_depthBuffer->width = _width;
+		_depthBuffer->height = _height;
+	}
+
+	void HeadlessBackend::ReleaseFramebuffers()
+	{
+		for(Resource *resource : _backBuffers)
+			delete resource;
+
+		_backBuffers.clear();
+
+		delete _depthBuffer;
+		_depthBuffer = nullptr;
+	}
+
+	void HeadlessBackend::Resize(uint32_t width, uint32_t height)
+	{
+		_width = width;
+		_height = height;
+		_sourceWidth = width;
+		_sourceHeight = height;
+		_backBufferIndex = 0;
+
+		ReleaseFramebuffers();
+		CreateFramebuffers();
+	}
+
+	void HeadlessBackend::Present()
+	{
+		std::lock_guard<std::mutex> lock(_lock);
+
+		_presentedCommands.swap(_frameCommands);
+		_frameCommands.clear();
+
+		_backBufferIndex = (_backBufferIndex + 1) % _frameCount;
+		_statistics.frames++;
+	}
+
+	void HeadlessBackend::SetSourceSize(uint32_t width, uint32_t height)
+	{
+		if(width == 0 || height == 0 || width > _width || height > _height)
+			throw std::invalid_argument("Source size outside of the back buffers");
+
+		_sourceWidth = width;
+		_sourceHeight = height;
+	}
+
+	DescriptorStatistics HeadlessBackend::TakeDescriptorStatistics()
+	{
+		std::lock_guard<std::mutex> lock(_lock);
+
+		const DescriptorStatistics statistics = _descriptors.GetStatistics();
+		_descriptors.ResetStatistics();
+		return statistics;
+	}
+
+	const void *HeadlessBackend::CreateBuffer(uint64_t size, BufferHeap heap, uint32_t /*initialState*/)
+	{
+		std::lock_guard<std::mutex> lock(_lock);
+
+		Resource *resource = new Resource();
+		resource->data.resize(static_cast<size_t>(size), 0);
+		resource->address = _nextAddress;
+		resource->heap = heap;
+		resource->width = 0;
+		resource->height = 0;
+
+		// Never reused, so stale addresses don't resolve to new buffers.
+		_nextAddress += (std::max<uint64_t>(size, 1) + AddressAlignment - 1) & ~(AddressAlignment - 1);
+		_buffers[resource->address] = resource;
+
+		_statistics.buffers++;
+		_statistics.bufferBytes += size;
+
+		return resource;
+	}
+
+	void HeadlessBackend::ReleaseResource(const void *resource)
+	{
+		std::lock_guard<std::mutex> lock(_lock);
+
+		Resource *buffer = GetResource(resource);
+		assert(_buffers.find(buffer->address) != _buffers.end());
+
+		_statistics.buffers--;
+		_statistics.bufferBytes -= buffer->data.size();
+
+		_buffers.erase(buffer->address);
+		delete buffer;
+	}
+
+	uint8_t *HeadlessBackend::MapBuffer(const void *buffer)
+	{
+		Resource *resource = GetResource(buffer);
+		assert(resource->heap == BufferHeap::Upload);
+
+		return resource->data.data();
+	}
+
+	uint64_t HeadlessBackend::GetBufferAddress(const void *buffer)
+	{
+		return GetResource(buffer)->address;
+	}
+
+	uint8_t *HeadlessBackend::ResolveAddress(uint64_t address, uint64_t size)
+	{
+		std::lock_guard<std::mutex> lock(_lock);
+
+		auto iterator = _buffers.upper_bound(address);
+		if(iterator == _buffers.begin())
+			return nullptr;
+
+		Resource *resource = (--iterator)->second;
+		if(address + size > resource->address + resource->data.size())
+			return nullptr;
+
+		return resource->data.data() + (address - resource->address);
+	}
+
+	const void *HeadlessBackend::GetPipelineState(const PipelineDescription &description, uint32_t *pipelineID)
+	{
+		PipelineKey key;
+		key.AddBytes(description.shaderFile.data(), description.shaderFile.size() * sizeof(wchar_t));
+		key.AddUInt32(static_cast<uint32_t>(description.depthMode));
+		key.AddUInt32(static_cast<uint32_t>(description.instanceFormat));
+
+		return _pipelineCache.GetOrCreate(key, [&]() -> const void * {
+			std::lock_guard<std::mutex> lock(_lock);
+
+			Pipeline pipeline;
+			pipeline.description = description;
+			_pipelines.push_back(pipeline);
+			_statistics.pipelines++;
+
+			return &_pipelines.back();
+		}, pipelineID);
+	}
+
+	const PipelineDescription &HeadlessBackend::GetPipelineDescription(const void *pipelineState) const
+	{
+		return static_cast<const Pipeline *>(pipelineState)->description;
+	}
+
+	RenderCommandList *HeadlessBackend::CreateCommandList(BackendQueue /*queue*/)
+	{
+		std::lock_guard<std::mutex> lock(_lock);
+
+		_commandLists.emplace_back(new RecordingCommandEncoder());
+		return _commandLists.back().get();
+	}
+
+	RenderCommandList *HeadlessBackend::CreateBundle()
+	{
+		std::lock_guard<std::mutex> lock(_lock);
+
+		_bundles.emplace_back(new RecordingCommandEncoder());
+		return _bundles.back().get();
+	}
+
+	void HeadlessBackend::ExecuteCommandLists(BackendQueue queue, RenderCommandList *const *commandLists, uint32_t count)
+	{
+		for(uint32_t i = 0; i < count; i++)
+		{
+			const std::vector<EncodedCommand> &commands = static_cast<RecordingCommandEncoder *>(commandLists[i])->GetCommands();
+			Execute(queue, commands);
+
+			std::lock_guard<std::mutex> lock(_lock);
+
+			if(queue == BackendQueue::Graphics)
+				_frameCommands.insert(_frameCommands.end(), commands.begin(), commands.end());
+
+			_statistics.commandLists++;
+			_statistics.commands += commands.size();
+		}
+	}
+
+	void HeadlessBackend::Execute(BackendQueue queue, const std::vector<EncodedCommand> &commands)
+	{
+		for(const EncodedCommand &command : commands)
+			ExecuteCommand(queue, command);
+	}
+
+	void HeadlessBackend::ExecuteCommand(BackendQueue queue, const EncodedCommand &command)
+	{
+		switch(command.type)
+		{
+			case EncodedCommandType::DrawInstanced:
+			case EncodedCommandType::DrawIndexedInstanced:
+				_statistics.draws++;
+				break;
+
+			case EncodedCommandType::ResourceBarrier:
+				_statistics.barriers++;
+				break;
+
+			case EncodedCommandType::SetConstantBuffer:
+			{
+				if(command.arguments[0] != ConstantSlotFrame)
+					break;
+
+				// The GPU completes everything right away, a ring full of views is
+				// signaled work that nobody waited for.
+				std::lock_guard<std::mutex> lock(_lock);
+				if(_descriptors.AllocateTransient(1) == DescriptorAllocator::InvalidIndex)
+					throw std::logic_error("Frame descriptor ring is full");
+				break;
+			}
+
+			case EncodedCommandType::ExecuteBundle:
+			{
+				// Same restrictions as D3D12 bundles, so what runs here runs there.
+				// Draw state and draws are the first command types.
+				const std::vector<EncodedCommand> &commands = static_cast<const RecordingCommandEncoder *>(command.resources[0])->GetCommands();
+				for(const EncodedCommand &bundleCommand : commands)
+				{
+					if(bundleCommand.type > EncodedCommandType::DrawIndexedInstanced)
+						throw std::logic_error("Bundles can only contain draw state and draws");
+
+					ExecuteCommand(queue, bundleCommand);
+				}
+
+				_statistics.bundles++;
+				break;
+			}
+
+			case EncodedCommandType::CopyBufferRegion:
+			{
+				Resource *destination = GetResource(command.resources[0]);
+				Resource *source = GetResource(command.resources[1]);
+
+				if(command.location + command.size > destination->data.size() || command.sourceOffset + command.size > source->data.size())
+					throw std::out_of_range("Copy outside of the buffer");
+
+				memmove(destination->data.data() + command.location, source->data.data() + command.sourceOffset, static_cast<size_t>(command.size));
+
+				_statistics.copies++;
+				_statistics.bytesCopied += command.size;
+				break;
+			}
+
+			default:
+				break;
+		}
+	}
+
+	void HeadlessBackend::Signal(BackendQueue queue, uint64_t value)
+	{
+		std::lock_guard<std::mutex> lock(_lock);
+
+		uint64_t &completed = _completedValues[static_cast<uint32_t>(queue)];
+		completed = std::max(completed, value);
+
+		if(queue == BackendQueue::Graphics)
+		{
+			_descriptors.FinishFrame(value);
+			_descriptors.Reclaim(completed);
+		}
+	}
+
+	void HeadlessBackend::Wait(BackendQueue /*queue*/, BackendQueue signalQueue, uint64_t value)
+	{
+		std::lock_guard<std::mutex> lock(_lock);
+
+		// Everything executes in submission order, a wait for a value that was
+		// never signaled would hang a GPU forever.
+		if(_completedValues[static_cast<uint32_t>(signalQueue)] < value)
+			throw std::logic_error("Queue waits for a fence value that is never signaled");
+
+		_statistics.queueWaits++;
+	}
+
+	uint64_t HeadlessBackend::GetCompletedValue(BackendQueue queue)
+	{
+		std::lock_guard<std::mutex> lock(_lock);
+		return _completedValues[static_cast<uint32_t>(queue)];
+	}
+
+	void HeadlessBackend::WaitForValue(BackendQueue queue, uint64_t value)
+	{
+		if(GetCompletedValue(queue) < value)
+			throw std::logic_error("CPU waits for a fence value that is never signaled");
+	}
+}
@@ -0,0 +1,157 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "LBRenderBackend.h"
+#include "LBPipelineCache.h"
+
+namespace LB
+{
+	struct HeadlessBackendStatistics
+	{
+		uint64_t frames;
+		uint64_t commandLists;
+		uint64_t commands;
+		uint64_t draws;						// Including those of bundles
+		uint64_t bundles;					// Bundles executed
+		uint64_t barriers;
+		uint64_t copies;
+		uint64_t bytesCopied;
+		uint64_t queueWaits;
+		uint64_t bufferBytes;			// Currently allocated
+		uint32_t buffers;
+		uint32_t pipelines;
+	};
+
+	// Backend without a GPU. Command lists record into memory and executing them
+	// appends their commands to the stream of the frame, applies copies between
+	// buffers and completes right away, so fences are reached as soon as they
+	// are signaled. Buffers live in memory at made up GPU addresses, back buffers
+	// are RGBA8 images and the depth buffer 32 bit floats, nothing draws into
+	// them, SoftwareBackend adds rasterization.
+	//
+	// Runs the renderer and everything above it anywhere, for tests, CI and
+	// benchmarks of the CPU side of a frame.
+	class HeadlessBackend : public RenderBackend
+	{
+	public:
+		HeadlessBackend(uint32_t width, uint32_t height, uint32_t frameCount = 2);
+		~HeadlessBackend();
+
+		uint32_t GetFrameCount() const override { return _frameCount; }
+		uint32_t GetWidth() const override { return _width; }
+		uint32_t GetHeight() const override { return _height; }
+
+		uint32_t GetBackBufferIndex() override { return _backBufferIndex; }
+		const void *GetBackBuffer(uint32_t index) override;
+		const void *GetDepthBuffer() override;
+
+		void Resize(uint32_t width, uint32_t height) override;
+		void ToggleFullscreen() override {}
+
+		void WaitForPresent(uint32_t /*timeoutMilliseconds*/) override {}
+		void Present() override;
+
+		void SetSourceSize(uint32_t width, uint32_t height) override;
+		double GetGpuMilliseconds() override { return 0.0; }
+		DescriptorStatistics TakeDescriptorStatistics() override;
+
+		uint32_t GetSourceWidth() const { return _sourceWidth; }
+		uint32_t GetSourceHeight() const { return _sourceHeight; }
+
+		const void *CreateBuffer(uint64_t size, BufferHeap heap, uint32_t initialState) override;
+		void ReleaseResource(const void *resource) override;
+
+		uint8_t *MapBuffer(const void *buffer) override;
+		uint64_t GetBufferAddress(const void *buffer) override;
+
+		const void *GetPipelineState(const PipelineDescription &description, uint32_t *pipelineID) override;
+
+		RenderCommandList *CreateCommandList(BackendQueue queue) override;
+		RenderCommandList *CreateBundle() override;
+		void ExecuteCommandLists(BackendQueue queue, RenderCommandList *const *commandLists, uint32_t count) override;
+
+		void Signal(BackendQueue queue, uint64_t value) override;
+		void Wait(BackendQueue queue, BackendQueue signalQueue, uint64_t value) override;
+		uint64_t GetCompletedValue(BackendQueue queue) override;
+		void WaitForValue(BackendQueue queue, uint64_t value) override;
+
+		// Graphics commands of the last presented frame in submission order, bundles
+		// show up as the one command executing them.
+		const std::vector<EncodedCommand> &GetFrameCommands() const { return _presentedCommands; }
+
+		const PipelineDescription &GetPipelineDescription(const void *pipelineState) const;
+
+		// Memory behind a GPU address range, nullptr if it isn't inside one buffer.
+		uint8_t *ResolveAddress(uint64_t address, uint64_t size);
+
+		const HeadlessBackendStatistics &GetStatistics() const { return _statistics; }
+
+	protected:
+		struct Resource
+		{
+			std::vector<uint8_t> data;
+			uint64_t address;
+			BufferHeap heap;
+			uint32_t width;			// Back buffers and depth buffer only
+			uint32_t height;
+		};
+
+		struct Pipeline
+		{
+			PipelineDescription description;
+		};
+
+		// Runs the commands of one command list in order.
+		virtual void Execute(BackendQueue queue, const std::vector<EncodedCommand> &commands);
+
+		// Runs a single command, copies are applied here and the commands of
+		// bundles run in place of the command executing them.
+		virtual void ExecuteCommand(BackendQueue queue, const EncodedCommand &command);
+
+		Resource *GetResource(const void *resource) { return static_cast<Resource *>(const_cast<void *>(resource)); }
+
+	private:
+		static const uint32_t QueueCount = 2;
+		static const uint64_t AddressAlignment = 64 * 1024;
+		static const uint32_t FrameDescriptorCount = 16384;
+
+		void CreateFramebuffers();
+		void ReleaseFramebuffers();
+
+		uint32_t _width;
+		uint32_t _height;
+		uint32_t _sourceWidth;
+		uint32_t _sourceHeight;
+		uint32_t _frameCount;
+		uint32_t _backBufferIndex;
+		std::vector<Resource *> _backBuffers;
+		Resource *_depthBuffer;
+
+		uint64_t _nextAddress;
+		std::map<uint64_t, Resource *> _buffers;
+
+		std::deque<Pipeline> _pipelines;
+		PipelineCache<const void *> _pipelineCache;
+
+		std::vector<std::unique_ptr<RecordingCommandEncoder>> _commandLists;
+		std::vector<std::unique_ptr<RecordingCommandEncoder>> _bundles;
+
+		uint64_t _completedValues[QueueCount];
+
+		// Same bookkeeping as the D3D12 descriptor ring, without the views.
+		DescriptorAllocator _descriptors;
+
+		std::vector<EncodedCommand> _frameCommands;
+		std::vector<EncodedCommand> _presentedCommands;
+
+		HeadlessBackendStatistics _statistics;
+
+		std::mutex _lock;
+	};
+}
@@ -0,0 +1,98 @@
+#if defined(_WIN32)
+#include "stdafx.h"
+#endif
+
+#include "LBImageFile.h"
+
+#include <cstdlib>
+#include <cstring>
+
+namespace LB
+{
+	static const uint8_t ImageTypeTrueColor = 2;
+	static const uint8_t ImageDescriptorAlphaBits = 8;
+	static const uint8_t ImageDescriptorTopLeft = (1 << 5);
+
+	std::vector<uint8_t> WriteImageFile(uint32_t width, uint32_t height, const uint8_t *pixels)
+	{
+		const size_t pixelCount = static_cast<size_t>(width) * height;
+
+		std::vector<uint8_t> data(ImageFileHeaderSize + pixelCount * 4, 0);
+		data[2] = ImageTypeTrueColor;
+		data[12] = static_cast<uint8_t>(width);
+		data[13] = static_cast<uint8_t>(width >> 8);
+		data[14] = static_cast<uint8_t>(height);
+		data[15] = static_cast<uint8_t>(height >> 8);
+		data[16] = 32;
+		data[17] = ImageDescriptorAlphaBits | ImageDescriptorTopLeft;
+
+		// TGA stores BGRA.
+		uint8_t *target = data.data() + ImageFileHeaderSize;
+		for(size_t i = 0; i < pixelCount; i++)
+		{
+			target[i * 4 + 0] = pixels[i * 4 + 2];
+			target[i * 4 + 1] = pixels[i * 4 + 1];
+			target[i * 4 + 2] = pixels[i * 4 + 0];
+			target[i * 4 + 3] = pixels[i * 4 + 3];
+		}
+
+		return data;
+	}
+
+	bool ReadImageFile(const void *data, size_t size, uint32_t *width, uint32_t *height, std::vector<uint8_t> *pixels)
+	{
+		if(size < ImageFileHeaderSize)
+			return false;
+
+		const uint8_t *header = static_cast<const uint8_t *>(data);
+		if(header[0] != 0 || header[1] != 0 || header[2] != ImageTypeTrueColor || header[16] != 32)
+			return false;
+
+		const uint32_t imageWidth = header[12] | (header[13] << 8);
+		const uint32_t imageHeight = header[14] | (header[15] << 8);
+		const size_t pixelCount = static_cast<size_t>(imageWidth) * imageHeight;
+
+		if(size < ImageFileHeaderSize + pixelCount * 4)
+			return false;
+
+		const bool topLeft = (header[17] & ImageDescriptorTopLeft) != 0;
+		const uint8_t *source = header + ImageFileHeaderSize;
+
+		pixels->resize(pixelCount * 4);
+		for(uint32_t y = 0; y < imageHeight; y++)
+		{
+			const uint8_t *sourceRow = source + static_cast<size_t>(topLeft ? y : imageHeight - 1 - y) * imageWidth * 4;
+			uint8_t *targetRow = pixels->data() + static_cast<size_t>(y) * imageWidth * 4;
+
+			for(uint32_t x = 0; x < imageWidth; x++)
+			{
+				targetRow[x * 4 + 0] = sourceRow[x * 4 + 2];
+				targetRow[x * 4 + 1] = sourceRow[x * 4 + 1];
+				targetRow[x * 4 + 2] = sourceRow[x * 4 + 0];
+				targetRow[x * 4 + 3] = sourceRow[x * 4 + 3];
+			}
+		}
+
+		*width = imageWidth;
+		*height = imageHeight;
+		return true;
+	}
+
+	uint64_t CountDifferentPixels(const uint8_t *pixels, const uint8_t *reference, size_t pixelCount, uint8_t tolerance)
+	{
+		uint64_t count = 0;
+		for(size_t i = 0; i < pixelCount; i++)
+		{
+			for(int channel = 0; channel < 4; channel++)
+			{
+				if(std::abs(pixels[i * 4 + channel] - reference[i * 4 + channel]) > tolerance)
+				{
+					count++;
+					break;
+				}
+			}
+		}
+
+		return count;
+	}
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+namespace LB
+{
+	// RGBA8 images as uncompressed 32 bit TGA files with the origin at the top
+	// left, which any image viewer opens. Pixels are stored row after row without
+	// padding.
+
+	static const uint32_t ImageFileHeaderSize = 18;
+
+	std::vector<uint8_t> WriteImageFile(uint32_t width, uint32_t height, const uint8_t *pixels);
+
+	// Only reads the kind of file WriteImageFile writes, with either origin.
+	// Returns false for anything else.
+	bool ReadImageFile(const void *data, size_t size, uint32_t *width, uint32_t *height, std::vector<uint8_t> *pixels);
+
+	// Pixels with a channel differing by more than tolerance, for comparing
+	// rendered images against golden ones.
+	uint64_t CountDifferentPixels(const uint8_t *pixels, const uint8_t *reference, size_t pixelCount, uint8_t tolerance);
+}
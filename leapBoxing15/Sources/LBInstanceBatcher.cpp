@@ -0,0 +1,111 @@
+#if defined(_WIN32)
+#include "stdafx.h"
+#endif
+
+#include "LBInstanceBatcher.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace LB
+{
+	void InstanceBatcher::Build(const RenderItem *items, size_t count, const float *sortOrigin, float sortRange)
+	{
+		_lookup.clear();
+		_batches.clear();
+		_itemBatches.resize(count);
+		_order.resize(count);
+
+		if(sortOrigin)
+			SortByDistance(items, count, sortOrigin, sortRange);
+
+		// Count the instances per batch.
+		for(size_t i = 0; i < count; i++)
+		{
+			const BatchKey key = { items[i].mesh, items[i].material };
+
+			auto iterator = _lookup.find(key);
+			if(iterator == _lookup.end())
+			{
+				const InstanceBatch batch = { key.mesh, key.material, 0, 0, 0.0f };
+				iterator = _lookup.emplace(key, static_cast<uint32_t>(_batches.size())).first;
+				_batches.push_back(batch);
+			}
+
+			_itemBatches[i] = iterator->second;
+			_batches[iterator->second].instanceCount++;
+		}
+
+		// Prefix sum into the first instance of every batch.
+		uint32_t firstInstance = 0;
+		for(InstanceBatch &batch : _batches)
+		{
+			batch.firstInstance = firstInstance;
+			firstInstance += batch.instanceCount;
+			batch.instanceCount = 0;
+		}
+
+		// Scatter the items into their batch ranges, nearest first if sorted.
+		for(size_t i = 0; i < count; i++)
+		{
+			const uint32_t item = sortOrigin ? _sortedItems[i] : static_cast<uint32_t>(i);
+
+			InstanceBatch &batch = _batches[_itemBatches[item]];
+			if(sortOrigin && batch.instanceCount == 0)
+				batch.depth = _itemDepths[item] / 65535.0f;
+
+			_order[batch.firstInstance + batch.instanceCount++] = item;
+		}
+
+		_statistics.items = static_cast<uint32_t>(count);
+		_statistics.batches = static_cast<uint32_t>(_batches.size());
+		_statistics.drawsSaved = _statistics.items - _statistics.batches;
+	}
+
+	void InstanceBatcher::SortByDistance(const RenderItem *items, size_t count, const float *sortOrigin, float sortRange)
+	{
+		_itemDepths.resize(count);
+		_sortedItems.resize(count);
+		_sortScratch.resize(count);
+
+		const float scale = (sortRange > 0.0f) ? 65535.0f / sortRange : 0.0f;
+
+		for(size_t i = 0; i < count; i++)
+		{
+			const float *matrix = items[i].worldMatrix;
+			const float dx = matrix[12] - sortOrigin[0];
+			const float dy = matrix[13] - sortOrigin[1];
+			const float dz = matrix[14] - sortOrigin[2];
+
+			_itemDepths[i] = static_cast<uint16_t>(std::min(sqrtf(dx * dx + dy * dy + dz * dz) * scale, 65535.0f));
+		}
+
+		// Two stable counting sort passes, low byte first.
+		uint32_t histogram[256];
+
+		for(int pass = 0; pass < 2; pass++)
+		{
+			const int shift = pass * 8;
+			std::fill(histogram, histogram + 256, 0);
+
+			for(size_t i = 0; i < count; i++)
+				histogram[(_itemDepths[i] >> shift) & 0xff]++;
+
+			uint32_t offset = 0;
+			for(uint32_t &bucket : histogram)
+			{
+				const uint32_t size = bucket;
+				bucket = offset;
+				offset += size;
+			}
+
+			for(size_t i = 0; i < count; i++)
+			{
+				const uint32_t item = (pass == 0) ? static_cast<uint32_t>(i) : _sortScratch[i];
+				uint32_t *target = (pass == 0) ? _sortScratch.data() : _sortedItems.data();
+
+				target[histogram[(_itemDepths[item] >> shift) & 0xff]++] = item;
+			}
+		}
+	}
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+#include "LBRenderSnapshot.h"
+
+namespace LB
+{
+	struct InstanceBatch
+	{
+		Mesh *mesh;
+		Material *material;
+		uint32_t firstInstance;
+		uint32_t instanceCount;
+		float depth;			// Of the nearest instance, 0 to 1 over the sort range
+	};
+
+	struct InstanceBatchStatistics
+	{
+		uint32_t items;
+		uint32_t batches;
+		uint32_t drawsSaved;
+	};
+
+	// Groups render items sharing mesh and material into instanced draws. The items
+	// are bucketed in two linear passes, batches keep the order in which their
+	// first item appeared and GetInstanceOrder lists the items batch by batch,
+	// which is the order their per instance data has to be written in.
+	//
+	// With a sort origin the instances of every batch are ordered front to back,
+	// so opaque instances mostly hide the ones drawn after them. Distances are
+	// quantized to 16 bit over the sort range and counting sorted up front, the
+	// bucketing keeps that order.
+	class InstanceBatcher
+	{
+	public:
+		void Build(const RenderItem *items, size_t count, const float *sortOrigin = nullptr, float sortRange = 0.0f);
+
+		const std::vector<InstanceBatch> &GetBatches() const { return _batches; }
+		const std::vector<uint32_t> &GetInstanceOrder() const { return _order; }
+		const InstanceBatchStatistics &GetStatistics() const { return _statistics; }
+
+	private:
+		struct BatchKey
+		{
+			Mesh *mesh;
+			Material *material;
+
+			bool operator== (const BatchKey &other) const
+			{
+				return mesh == other.mesh && material == other.material;
+			}
+		};
+
+		struct BatchKeyHash
+		{
+			size_t operator() (const BatchKey &key) const
+			{
+				return std::hash<void *>()(key.mesh) ^ (std::hash<void *>()(key.material) * 31);
+			}
+		};
+
+		void SortByDistance(const RenderItem *items, size_t count, const float *sortOrigin, float sortRange);
+
+		std::unordered_map<BatchKey, uint32_t, BatchKeyHash> _lookup;
+		std::vector<uint32_t> _itemBatches;
+		std::vector<uint16_t> _itemDepths;
+		std::vector<uint32_t> _sortedItems;
+		std::vector<uint32_t> _sortScratch;
+		std::vector<InstanceBatch> _batches;
+		std::vector<uint32_t> _order;
+		InstanceBatchStatistics _statistics;
+	};
+}
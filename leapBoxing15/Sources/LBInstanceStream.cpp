@@ -0,0 +1,258 @@
+#if defined(_WIN32)
+#include "stdafx.h"
+#endif
+
+#include "LBInstanceStream.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define LB_INSTANCE_STREAM_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace LB
+{
+	namespace
+	{
+		const uint32_t MaxInstanceSize = sizeof(float) * 16;
+
+		// Round to nearest even, overflow becomes infinity.
+		uint16_t FloatToHalf(float value)
+		{
+			uint32_t bits;
+			memcpy(&bits, &value, sizeof(bits));
+
+			const uint16_t sign = static_cast<uint16_t>((bits >> 16) & 0x8000);
+			bits &= 0x7fffffff;
+
+			// Infinity and NaN, and everything rounding to 65520 or more.
+			if(bits >= 0x7f800000)
+				return sign | 0x7c00 | ((bits > 0x7f800000) ? 0x200 : 0);
+			if(bits >= 0x477ff000)
+				return sign | 0x7c00;
+
+			// Below the smallest normal half, adding 0.5 leaves the value rounded to
+			// the spacing of the half subnormals in the low mantissa bits.
+			if(bits < 0x38800000)
+			{
+				float magnitude;
+				memcpy(&magnitude, &bits, sizeof(magnitude));
+				magnitude += 0.5f;
+				memcpy(&bits, &magnitude, sizeof(bits));
+
+				return sign | static_cast<uint16_t>(bits - 0x3f000000);
+			}
+
+			// Rebias the exponent and round away the low 13 mantissa bits, a carry
+			// moves into the exponent.
+			bits -= 0x38000000;
+			bits += 0xfff + ((bits >> 13) & 1);
+
+			return sign | static_cast<uint16_t>(bits >> 13);
+		}
+
+		float HalfToFloat(uint16_t half)
+		{
+			const uint32_t sign = static_cast<uint32_t>(half & 0x8000) << 16;
+			const uint32_t exponent = (half >> 10) & 0x1f;
+			const uint32_t mantissa = half & 0x3ff;
+
+			uint32_t bits;
+			if(exponent == 0)
+			{
+				// Zero and subnormals, exact in float.
+				const float value = static_cast<float>(mantissa) * (1.0f / 16777216.0f);
+				memcpy(&bits, &value, sizeof(bits));
+				bits |= sign;
+			}
+			else if(exponent == 31)
+			{
+				bits = sign | 0x7f800000 | (mantissa << 13);
+			}
+			else
+			{
+				bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+			}
+
+			float result;
+			memcpy(&result, &bits, sizeof(result));
+			return result;
+		}
+	}
+
+	InstanceStream::InstanceStream() : _statistics()
+	{
+
+	}
+
+	uint32_t InstanceStream::GetInstanceSize(InstanceFormat format)
+	{
+		switch(format)
+		{
+			case InstanceFormat::Matrix:
+				return sizeof(float) * 16;
+			case InstanceFormat::Affine:
+				return sizeof(float) * 12;
+			case InstanceFormat::AffineHalf:
+				return sizeof(float) * 3 + sizeof(uint16_t) * 12;
+		}
+
+		throw std::invalid_argument("Unknown instance format");
+	}
+
+	void InstanceStream::EncodeInstance(InstanceFormat format, const float *matrix, uint8_t *instance)
+	{
+		switch(format)
+		{
+			case InstanceFormat::Matrix:
+				memcpy(instance, matrix, sizeof(float) * 16);
+				break;
+
+			case InstanceFormat::Affine:
+				for(uint32_t row = 0; row < 4; row++)
+					memcpy(instance + row * sizeof(float) * 3, matrix + row * 4, sizeof(float) * 3);
+				break;
+
+			case InstanceFormat::AffineHalf:
+			{
+				// Translation first, it needs the range and precision of float.
+				memcpy(instance, matrix + 12, sizeof(float) * 3);
+
+				uint16_t rows[12];
+				for(uint32_t row = 0; row < 3; row++)
+				{
+					for(uint32_t column = 0; column < 3; column++)
+						rows[row * 4 + column] = FloatToHalf(matrix[row * 4 + column]);
+
+					rows[row * 4 + 3] = 0;
+				}
+
+				memcpy(instance + sizeof(float) * 3, rows, sizeof(rows));
+				break;
+			}
+
+			default:
+				throw std::invalid_argument("Unknown instance format");
+		}
+	}
+
+	void InstanceStream::DecodeInstance(InstanceFormat format, const uint8_t *instance, float *matrix)
+	{
+		switch(format)
+		{
+			case InstanceFormat::Matrix:
+				memcpy(matrix, instance, sizeof(float) * 16);
+				return;
+
+			case InstanceFormat::Affine:
+				for(uint32_t row = 0; row < 4; row++)
+					memcpy(matrix + row * 4, instance + row * sizeof(float) * 3, sizeof(float) * 3);
+				break;
+
+			case InstanceFormat::AffineHalf:
+			{
+				memcpy(matrix + 12, instance, sizeof(float) * 3);
+
+				uint16_t rows[12];
+				memcpy(rows, instance + sizeof(float) * 3, sizeof(rows));
+
+				for(uint32_t row = 0; row < 3; row++)
+				{
+					for(uint32_t column = 0; column < 3; column++)
+						matrix[row * 4 + column] = HalfToFloat(rows[row * 4 + column]);
+				}
+				break;
+			}
+
+			default:
+				throw std::invalid_argument("Unknown instance format");
+		}
+
+		matrix[3] = 0.0f;
+		matrix[7] = 0.0f;
+		matrix[11] = 0.0f;
+		matrix[15] = 1.0f;
+	}
+
+	void InstanceStream::Write(WorkerPool *workerPool, InstanceFormat format, uint8_t *data, const RenderItem *items, const uint32_t *order, uint32_t count)
+	{
+		std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+
+		const uint32_t instanceSize = GetInstanceSize(format);
+		const uint32_t jobs = std::max(1u, std::min(workerPool->GetThreadCount(), count / MinJobInstances));
+
+		if(jobs == 1)
+		{
+			WriteRange(format, data, items, order, count);
+		}
+		else
+		{
+			workerPool->ParallelFor(jobs, [&](uint32_t job) {
+				const uint32_t begin = static_cast<uint32_t>(static_cast<uint64_t>(count) * job / jobs);
+				const uint32_t end = static_cast<uint32_t>(static_cast<uint64_t>(count) * (job + 1) / jobs);
+
+				WriteRange(format, data + static_cast<size_t>(begin) * instanceSize, items, order + begin, end - begin);
+			});
+		}
+
+		_statistics.instances = count;
+		_statistics.jobs = jobs;
+		_statistics.bytesWritten = static_cast<uint64_t>(count) * instanceSize;
+		_statistics.writeMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+		_statistics.gigabytesPerSecond = (_statistics.writeMilliseconds > 0.0) ? _statistics.bytesWritten / (_statistics.writeMilliseconds * 1000000.0) : 0.0;
+	}
+
+	void InstanceStream::WriteRange(InstanceFormat format, uint8_t *data, const RenderItem *items, const uint32_t *order, uint32_t count)
+	{
+		const uint32_t instanceSize = GetInstanceSize(format);
+
+#if defined(LB_INSTANCE_STREAM_SSE2)
+		// Whole 16 byte stores need every instance to start aligned, which the
+		// float formats do in a buffer that starts aligned. The half format and
+		// other buffers are written 4 bytes at a time, still non-temporal.
+		const bool vectorStores = (instanceSize % 16) == 0 && (reinterpret_cast<uintptr_t>(data) % 16) == 0;
+
+		for(uint32_t i = 0; i < count; i++)
+		{
+			const float *matrix = items[order[i]].worldMatrix;
+			uint8_t *instance = data + static_cast<size_t>(i) * instanceSize;
+
+			if(format == InstanceFormat::Matrix && vectorStores)
+			{
+				for(uint32_t row = 0; row < 4; row++)
+					_mm_stream_ps(reinterpret_cast<float *>(instance) + row * 4, _mm_loadu_ps(matrix + row * 4));
+				continue;
+			}
+
+			alignas(16) uint8_t encoded[MaxInstanceSize];
+			EncodeInstance(format, matrix, encoded);
+
+			if(vectorStores)
+			{
+				for(uint32_t offset = 0; offset < instanceSize; offset += 16)
+					_mm_stream_si128(reinterpret_cast<__m128i *>(instance + offset), _mm_load_si128(reinterpret_cast<const __m128i *>(encoded + offset)));
+			}
+			else
+			{
+				for(uint32_t offset = 0; offset < instanceSize; offset += 4)
+				{
+					int value;
+					memcpy(&value, encoded + offset, sizeof(value));
+					_mm_stream_si32(reinterpret_cast<int *>(instance + offset), value);
+				}
+			}
+		}
+
+		// Non-temporal stores are weakly ordered, make them visible before
+		// anything that publishes the data.
+		_mm_sfence();
+#else
+		for(uint32_t i = 0; i < count; i++)
+			EncodeInstance(format, items[order[i]].worldMatrix, data + static_cast<size_t>(i) * instanceSize);
+#endif
+	}
+}
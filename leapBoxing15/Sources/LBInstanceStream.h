@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "LBRenderBackend.h"
+#include "LBRenderSnapshot.h"
+#include "LBWorkerPool.h"
+
+namespace LB
+{
+	struct InstanceStreamStatistics
+	{
+		uint32_t instances;
+		uint32_t jobs;
+		uint64_t bytesWritten;
+		double writeMilliseconds;
+		double gigabytesPerSecond;
+	};
+
+	// Writes the per instance transforms of a frame into persistently mapped
+	// upload memory, which is write combined: reading it back is very slow and
+	// partially written cache lines cost bus transactions. Every instance is
+	// encoded in registers and stored with non-temporal stores, the memory is
+	// written once and strictly in order, without a staging copy.
+	//
+	// Write splits the instances into contiguous ranges written by jobs on the
+	// worker pool, WriteRange is the same for a single range and can be called
+	// from jobs that produce the transforms themselves. Both fence their stores
+	// before returning, so the data is visible to the GPU once the command list
+	// using it is submitted.
+	class InstanceStream
+	{
+	public:
+		InstanceStream();
+
+		static uint32_t GetInstanceSize(InstanceFormat format);
+
+		// Converts a row major float4x4 to an instance and back. The half format
+		// rounds the upper 3x3 part to 11 significant bits.
+		static void EncodeInstance(InstanceFormat format, const float *matrix, uint8_t *instance);
+		static void DecodeInstance(InstanceFormat format, const uint8_t *instance, float *matrix);
+
+		// Writes the world matrices of items[order[0]] to items[order[count - 1]]
+		// to data, which receives count instances.
+		void Write(WorkerPool *workerPool, InstanceFormat format, uint8_t *data, const RenderItem *items, const uint32_t *order, uint32_t count);
+		static void WriteRange(InstanceFormat format, uint8_t *data, const RenderItem *items, const uint32_t *order, uint32_t count);
+
+		// Of the last Write.
+		const InstanceStreamStatistics &GetStatistics() const { return _statistics; }
+
+	private:
+		// Fewer instances aren't worth waking a worker for.
+		static const uint32_t MinJobInstances = 2048;
+
+		InstanceStreamStatistics _statistics;
+	};
+}
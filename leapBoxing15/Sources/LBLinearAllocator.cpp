@@ -0,0 +1,42 @@
+#if defined(_WIN32)
+#include "stdafx.h"
+#endif
+
+#include "LBLinearAllocator.h"
+
+#include <algorithm>
+#include <cassert>
+
+namespace LB
+{
+	LinearAllocator::LinearAllocator(uint64_t alignment) : _alignment(alignment), _capacity(0), _offset(0), _allocationCount(0)
+	{
+		assert(alignment > 0 && (alignment & (alignment - 1)) == 0);
+	}
+
+	void LinearAllocator::Reset(uint64_t capacity)
+	{
+		_capacity = capacity;
+		_offset.store(0, std::memory_order_relaxed);
+		_allocationCount.store(0, std::memory_order_relaxed);
+	}
+
+	uint64_t LinearAllocator::Allocate(uint64_t size)
+	{
+		size = GetAlignedSize(size);
+
+		// A failed allocation still moves the offset, which is harmless as nothing
+		// can fit anymore after it either way.
+		const uint64_t offset = _offset.fetch_add(size, std::memory_order_relaxed);
+		if(offset + size > _capacity)
+			return InvalidOffset;
+
+		_allocationCount.fetch_add(1, std::memory_order_relaxed);
+		return offset;
+	}
+
+	uint64_t LinearAllocator::GetUsedSize() const
+	{
+		return std::min(_offset.load(std::memory_order_relaxed), _capacity);
+	}
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+namespace LB
+{
+	// Bump allocator over a fixed amount of memory owned by the caller. Sizes are
+	// rounded up to the alignment, so a single atomic add per allocation keeps
+	// every offset aligned and allocating from several threads at once is safe.
+	// Memory is only ever given back as a whole by Reset.
+	class LinearAllocator
+	{
+	public:
+		static const uint64_t InvalidOffset = ~0ull;
+
+		LinearAllocator(uint64_t alignment);
+
+		// Starts over with capacity bytes, must not race with Allocate.
+		void Reset(uint64_t capacity);
+
+		// Returns InvalidOffset if the remaining capacity is too small.
+		uint64_t Allocate(uint64_t size);
+
+		uint64_t GetAlignedSize(uint64_t size) const { return (size + _alignment - 1) & ~(_alignment - 1); }
+		uint64_t GetCapacity() const { return _capacity; }
+		uint64_t GetUsedSize() const;
+		uint32_t GetAllocationCount() const { return _allocationCount.load(std::memory_order_relaxed); }
+
+	private:
+		uint64_t _alignment;
+		uint64_t _capacity;
+		std::atomic<uint64_t> _offset;
+		std::atomic<uint32_t> _allocationCount;
+	};
+}
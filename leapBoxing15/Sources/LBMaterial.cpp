@@ -1,52 +1,31 @@
+#if defined(_WIN32)
 #include "stdafx.h"
+#endif
+
 #include "LBMaterial.h"
-#include "LBApplication.h"
 #include "LBRenderer.h"
 
+#include <atomic>
+
 namespace LB
 {
-	Material::Material(LPCWSTR shaderfile)
+	Material::Material(Renderer *renderer, const wchar_t *shaderfile)
 	{
-		// Create the pipeline state, which includes compiling and loading shaders.
-		{
-			using namespace Microsoft::WRL;
-			ComPtr<ID3DBlob> vertexShader;
-			ComPtr<ID3DBlob> pixelShader;
-
-#ifdef _DEBUG
-			// Enable better shader debugging with the graphics debugging tools.
-			UINT compileFlags = D3DCOMPILE_DEBUG | D3DCOMPILE_SKIP_OPTIMIZATION;
-#else
-			UINT compileFlags = 0;
-#endif
+		static std::atomic<uint32_t> nextSortID(0);
+		_sortID = nextSortID++;
+
+		// The backend compiles or loads the shaders and creates the pipeline state,
+		// or hands out the one it already has for this shader.
+		PipelineDescription description;
+		description.shaderFile = shaderfile;
+
+		_pipelineState = renderer->GetPipelineState(description, &_pipelineID);
+
+		description.depthMode = DepthMode::DepthOnly;
+		_depthOnlyPipelineState = renderer->GetPipelineState(description);
 
-			ThrowIfFailed(D3DCompileFromFile(Application::GetInstance().GetPathForAsset(shaderfile).c_str(), nullptr, nullptr, "VSMain", "vs_5_0", compileFlags, 0, &vertexShader, nullptr));
-			ThrowIfFailed(D3DCompileFromFile(Application::GetInstance().GetPathForAsset(shaderfile).c_str(), nullptr, nullptr, "PSMain", "ps_5_0", compileFlags, 0, &pixelShader, nullptr));
-
-			// Define the vertex input layout.
-			D3D12_INPUT_ELEMENT_DESC inputElementDescs[] =
-			{
-				{ "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
-				{ "COLOR", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 0, 12, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 }
-			};
-
-			// Describe and create the graphics pipeline state object (PSO).
-			D3D12_GRAPHICS_PIPELINE_STATE_DESC psoDesc = {};
-			psoDesc.InputLayout = { inputElementDescs, _countof(inputElementDescs) };
-			psoDesc.VS = { reinterpret_cast<UINT8*>(vertexShader->GetBufferPointer()), vertexShader->GetBufferSize() };
-			psoDesc.PS = { reinterpret_cast<UINT8*>(pixelShader->GetBufferPointer()), pixelShader->GetBufferSize() };
-			psoDesc.RasterizerState = CD3DX12_RASTERIZER_DESC(D3D12_DEFAULT);
-			psoDesc.BlendState = CD3DX12_BLEND_DESC(D3D12_DEFAULT);
-			psoDesc.DepthStencilState.DepthEnable = FALSE;
-			psoDesc.DepthStencilState.StencilEnable = FALSE;
-			psoDesc.SampleMask = UINT_MAX;
-			psoDesc.PrimitiveTopologyType = D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE;
-			psoDesc.NumRenderTargets = 1;
-			psoDesc.RTVFormats[0] = DXGI_FORMAT_R8G8B8A8_UNORM;
-			psoDesc.SampleDesc.Count = 1;
-
-			_pipelineState = Application::GetInstance().GetRenderer()->GetPSOForDescription(&psoDesc);
-		}
+		description.depthMode = DepthMode::ReadOnly;
+		_depthReadOnlyPipelineState = renderer->GetPipelineState(description);
 	}
 
 	Material::~Material()
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <cstdint>
+
 namespace LB
 {
 	class Renderer;
@@ -7,10 +9,15 @@ namespace LB
 	{
 	public:
 		friend Renderer;
-		Material(LPCWSTR shaderfile);
+		Material(Renderer *renderer, const wchar_t *shaderfile);
 		~Material();
 
 	private:
-		Microsoft::WRL::ComPtr<ID3D12PipelineState> _pipelineState;
+		// Depth tested and written, and the pair used with the depth pre-pass.
+		const void *_pipelineState;
+		const void *_depthOnlyPipelineState;
+		const void *_depthReadOnlyPipelineState;
+		uint32_t _sortID;
+		uint32_t _pipelineID;
 	};
 }
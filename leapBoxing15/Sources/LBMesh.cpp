@@ -1,56 +1,29 @@
+#if defined(_WIN32)
 #include "stdafx.h"
+#endif
+
 #include "LBMesh.h"
-#include "LBApplication.h"
 #include "LBRenderer.h"
 
+#include <atomic>
+#include <stdexcept>
+
 namespace LB
 {
-	Mesh *Mesh::WithTriangle()
+	Mesh *Mesh::WithTriangle(Renderer *renderer)
 	{
-		Mesh *mesh = new Mesh();
-
 		float data[] = { 0.0f, 1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f, 1.0f, -1.0f, 0.0f, 0.0f, 1.0f, 0.0f, 1.0f, -1.0f, -1.0f, 0.0f, 0.0f, 0.0f, 1.0f, 1.0f};
-		const UINT dataSize = sizeof(data);
-		const UINT stride = 4 * 7;
-
-		mesh->_vertexBuffer = Application::GetInstance().GetRenderer()->UploadVertexData(data, dataSize);
-
-		// Initialize the vertex buffer views.
-		mesh->_vertexBufferView.BufferLocation = mesh->_vertexBuffer->GetGPUVirtualAddress();
-		mesh->_vertexBufferView.StrideInBytes = stride;
-		mesh->_vertexBufferView.SizeInBytes = dataSize;
-
-		mesh->_vertexCount = dataSize / stride;
-		mesh->_topology = D3D_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP;
-
-		return mesh;
+		return WithData(renderer, data, sizeof(data) / (4 * 7), nullptr, 0, PrimitiveTopology::TriangleStrip);
 	}
 
-	Mesh *Mesh::WithQuad()
+	Mesh *Mesh::WithQuad(Renderer *renderer)
 	{
-		Mesh *mesh = new Mesh();
-
 		float data[] = { -1.0f, -1.0f, 0.5f, 0.0f, 0.0f, 1.0f, 1.0f,  -1.0f, 1.0f, 0.5f, 1.0f, 0.0f, 0.0f, 1.0f,   1.0f, -1.0f, 0.5f, 0.0f, 1.0f, 0.0f, 1.0f,   1.0f, 1.0f, 0.5f, 1.0f, 0.0f, 0.0f, 1.0f };
-		const UINT dataSize = sizeof(data);
-		const UINT stride = 4 * 7;
-
-		mesh->_vertexBuffer = Application::GetInstance().GetRenderer()->UploadVertexData(data, dataSize);
-
-		// Initialize the vertex buffer views.
-		mesh->_vertexBufferView.BufferLocation = mesh->_vertexBuffer->GetGPUVirtualAddress();
-		mesh->_vertexBufferView.StrideInBytes = stride;
-		mesh->_vertexBufferView.SizeInBytes = dataSize;
-
-		mesh->_vertexCount = dataSize / stride;
-		mesh->_topology = D3D_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP;
-
-		return mesh;
+		return WithData(renderer, data, sizeof(data) / (4 * 7), nullptr, 0, PrimitiveTopology::TriangleStrip);
 	}
 
-	Mesh *Mesh::WithCube()
+	Mesh *Mesh::WithCube(Renderer *renderer)
 	{
-		Mesh *mesh = new Mesh();
-
 		float data[] = { 1.0f, 1.0f, 1.0f,   1.0f, 0.0f, 0.0f, 1.0f,
 						 1.0f, -1.0f, 1.0f,  0.0f, 1.0f, 0.0f, 1.0f, 
 						 1.0f, 1.0f, -1.0f,  0.0f, 0.0f, 1.0f, 1.0f,
@@ -59,30 +32,93 @@ namespace LB
 						 -1.0f, -1.0f, 1.0f,  0.0f, 1.0f, 0.0f, 1.0f,
 						 -1.0f, 1.0f, -1.0f,  0.0f, 0.0f, 1.0f, 1.0f,
 						 -1.0f, -1.0f, -1.0f,  0.0f, 0.0f, 1.0f, 1.0f };
-		const UINT dataSize = sizeof(data);
-		const UINT stride = 4 * 7;
 
-		mesh->_vertexBuffer = Application::GetInstance().GetRenderer()->UploadVertexData(data, dataSize);
+		uint32_t indices[] = { 0, 1, 2, 1, 2, 3,   4, 5, 6, 5, 6, 7,   0, 2, 4, 2, 4, 6,   1, 3, 5, 3, 5, 7,   0, 4, 1, 1, 4, 5,   2, 3, 6, 6, 3, 7 };
 
-		// Initialize the vertex buffer views.
-		mesh->_vertexBufferView.BufferLocation = mesh->_vertexBuffer->GetGPUVirtualAddress();
-		mesh->_vertexBufferView.StrideInBytes = stride;
-		mesh->_vertexBufferView.SizeInBytes = dataSize;
+		return WithData(renderer, data, sizeof(data) / (4 * 7), indices, sizeof(indices) / sizeof(indices[0]), PrimitiveTopology::TriangleList);
+	}
 
-		mesh->_vertexCount = dataSize / stride;
-		mesh->_topology = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+	Mesh *Mesh::WithName(Renderer *renderer, const std::string &name)
+	{
+		if(name == "triangle")
+			return WithTriangle(renderer);
+		if(name == "quad")
+			return WithQuad(renderer);
+		if(name == "cube")
+			return WithCube(renderer);
+
+		throw std::invalid_argument("Unknown mesh " + name);
+	}
+
+	Mesh *Mesh::WithData(Renderer *renderer, const float *vertices, uint32_t vertexCount, const uint32_t *indices, uint32_t indexCount, uint32_t topology)
+	{
+		static std::atomic<uint32_t> nextSortID(0);
+
+		Mesh *mesh = new Mesh();
+		mesh->_renderer = renderer;
+		mesh->_sortID = nextSortID++;
+
+		const uint32_t stride = 4 * 7;
+		const uint32_t dataSize = vertexCount * stride;
+
+		mesh->_vertexData.assign(vertices, vertices + vertexCount * 7);
+		mesh->_vertexAllocation = renderer->UploadVertexData(mesh, mesh->_vertexData.data(), dataSize, &mesh->_uploadTicket);
+
+		// Initialize the vertex buffer binding.
+		mesh->_vertexBinding.location = renderer->GetBufferAddress(mesh->_vertexAllocation);
+		mesh->_vertexBinding.stride = stride;
+		mesh->_vertexBinding.size = dataSize;
 
-		UINT16 indices[] = { 0, 1, 2, 1, 2, 3,   4, 5, 6, 5, 6, 7,   0, 2, 4, 2, 4, 6,   1, 3, 5, 3, 5, 7,   0, 4, 1, 1, 4, 5,   2, 3, 6, 6, 3, 7 };
-		const UINT indicesSize = sizeof(indices);
+		mesh->_vertexCount = vertexCount;
+		mesh->_indexCount = 0;
+		mesh->_topology = topology;
 
-		mesh->_indexBuffer = Application::GetInstance().GetRenderer()->UploadIndexData(indices, indicesSize);
+		if(indices && indexCount > 0)
+		{
+			mesh->_indexData.assign(indices, indices + indexCount);
 
-		mesh->_indexBufferView.BufferLocation = mesh->_indexBuffer->GetGPUVirtualAddress();
-		mesh->_indexBufferView.SizeInBytes = indicesSize;
-		mesh->_indexBufferView.Format = DXGI_FORMAT_R16_UINT;
+			// Use 16 bit indices on the GPU whenever they are sufficient.
+			const bool shortIndices = vertexCount <= 0xffff;
+			std::vector<uint16_t> shortIndexData;
+			void *indexData = mesh->_indexData.data();
+			uint32_t indicesSize = indexCount * sizeof(uint32_t);
 
-		mesh->_indexCount = indicesSize / 2;
+			if(shortIndices)
+			{
+				shortIndexData.assign(indices, indices + indexCount);
+				indexData = shortIndexData.data();
+				indicesSize = indexCount * sizeof(uint16_t);
+			}
+
+			// Tickets increase monotonically, the index buffer's covers the vertex buffer too.
+			mesh->_indexAllocation = renderer->UploadIndexData(mesh, indexData, indicesSize, &mesh->_uploadTicket);
+
+			mesh->_indexBinding.location = renderer->GetBufferAddress(mesh->_indexAllocation);
+			mesh->_indexBinding.size = indicesSize;
+			mesh->_indexBinding.format = shortIndices ? IndexFormat::UInt16 : IndexFormat::UInt32;
+
+			mesh->_indexCount = indexCount;
+		}
 
 		return mesh;
 	}
-}
+
+	Mesh::~Mesh()
+	{
+		_renderer->FreeBuffer(_vertexAllocation, _uploadTicket);
+		if(_indexCount > 0)
+			_renderer->FreeBuffer(_indexAllocation, _uploadTicket);
+	}
+
+	StaticGeometry Mesh::GetGeometry() const
+	{
+		StaticGeometry geometry;
+		geometry.vertices = _vertexData.data();
+		geometry.vertexCount = static_cast<uint32_t>(_vertexCount);
+		geometry.stride = 7;
+		geometry.indices = _indexData.empty() ? nullptr : _indexData.data();
+		geometry.indexCount = static_cast<uint32_t>(_indexData.size());
+		geometry.triangleStrip = (_topology == PrimitiveTopology::TriangleStrip);
+		return geometry;
+	}
+}
\ No newline at end of file
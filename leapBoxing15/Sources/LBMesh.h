@@ -1,5 +1,14 @@
 #pragma once
 
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "LBStaticBatcher.h"
+#include "LBUploadScheduler.h"
+#include "LBBufferAllocator.h"
+#include "LBCommandEncoder.h"
+
 namespace LB
 {
 	class Renderer;
@@ -7,17 +16,35 @@ namespace LB
 	{
 	public:
 		friend Renderer;
-		static Mesh *WithTriangle();
-		static Mesh *WithQuad();
-		static Mesh *WithCube();
+		static Mesh *WithTriangle(Renderer *renderer);
+		static Mesh *WithQuad(Renderer *renderer);
+		static Mesh *WithCube(Renderer *renderer);
+		static Mesh *WithName(Renderer *renderer, const std::string &name);
+
+		// Vertices are POSITION + COLOR (7 floats), indices are optional. Topology
+		// is one of PrimitiveTopology.
+		static Mesh *WithData(Renderer *renderer, const float *vertices, uint32_t vertexCount, const uint32_t *indices, uint32_t indexCount, uint32_t topology);
+
+		// Frees the buffers without waiting for the GPU, frames in flight may still
+		// draw the mesh. Has to happen before the renderer goes away.
+		~Mesh();
+
+		// CPU copy of the geometry, used for static batching.
+		StaticGeometry GetGeometry() const;
 
 	private:
-		Microsoft::WRL::ComPtr<ID3D12Resource> _vertexBuffer;
-		Microsoft::WRL::ComPtr<ID3D12Resource> _indexBuffer;
-		D3D12_VERTEX_BUFFER_VIEW _vertexBufferView;
-		D3D12_INDEX_BUFFER_VIEW _indexBufferView;
-		D3D_PRIMITIVE_TOPOLOGY _topology;
+		Renderer *_renderer;
+		BufferAllocation _vertexAllocation;
+		BufferAllocation _indexAllocation;
+		VertexBufferBinding _vertexBinding;
+		IndexBufferBinding _indexBinding;
+		uint32_t _topology;
 		int _vertexCount;
 		int _indexCount;
+		uint32_t _sortID;
+		UploadTicket _uploadTicket;
+
+		std::vector<float> _vertexData;
+		std::vector<uint32_t> _indexData;
 	};
-}
+}
\ No newline at end of file
@@ -1,4 +1,7 @@
+#if defined(_WIN32)
 #include "stdafx.h"
+#endif
+
 #include "LBModel.h"
 
 namespace LB
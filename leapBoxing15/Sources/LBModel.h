@@ -9,7 +9,10 @@ namespace LB
 	{
 	public:
 		friend Renderer;
-		Model::Model(Mesh *mesh, Material *material);
+		Model(Mesh *mesh, Material *material);
+
+		Mesh *GetMesh() const { return _mesh; }
+		Material *GetMaterial() const { return _material; }
 
 	private:
 		Mesh *_mesh;
@@ -0,0 +1,51 @@
+#if defined(_WIN32)
+#include "stdafx.h"
+#endif
+
+#include "LBParallelRecorder.h"
+#include "LBWorkerPool.h"
+
+#include <algorithm>
+
+namespace LB
+{
+	ParallelRecorder::ParallelRecorder(WorkerPool *pool, size_t minimumDrawsPerChunk) : _pool(pool), _minimumDrawsPerChunk(std::max<size_t>(minimumDrawsPerChunk, 1))
+	{}
+
+	void ParallelRecorder::Record(size_t count, uint32_t maxChunks, const std::function<void (uint32_t chunk, size_t begin, size_t end)> &record)
+	{
+		_chunks.clear();
+
+		if(count == 0 || maxChunks == 0)
+			return;
+
+		// Every chunk costs a command list submission, so small lists stay on fewer threads.
+		size_t chunkCount = std::min<size_t>(maxChunks, _pool ? _pool->GetThreadCount() : 1);
+		chunkCount = std::max<size_t>(std::min(chunkCount, count / _minimumDrawsPerChunk), 1);
+
+		const size_t chunkSize = count / chunkCount;
+		const size_t remainder = count % chunkCount;
+
+		size_t begin = 0;
+		for(size_t i = 0; i < chunkCount; i++)
+		{
+			const size_t end = begin + chunkSize + (i < remainder ? 1 : 0);
+			_chunks.push_back({ begin, end });
+			begin = end;
+		}
+
+		auto task = [&](uint32_t chunk) {
+			record(chunk, _chunks[chunk].begin, _chunks[chunk].end);
+		};
+
+		if(_pool)
+		{
+			_pool->ParallelFor(static_cast<uint32_t>(chunkCount), task);
+		}
+		else
+		{
+			for(uint32_t i = 0; i < chunkCount; i++)
+				task(i);
+		}
+	}
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace LB
+{
+	class WorkerPool;
+
+	struct RecordChunk
+	{
+		size_t begin;
+		size_t end;
+	};
+
+	// Splits an ordered list of draws into contiguous chunks and records them
+	// concurrently, one command list per chunk. Chunks cover the list in order, so
+	// submitting their command lists by chunk index reproduces the serial order.
+	// What a chunk records into is up to the caller, which keeps this independent
+	// of the graphics API.
+	class ParallelRecorder
+	{
+	public:
+		ParallelRecorder(WorkerPool *pool, size_t minimumDrawsPerChunk = 128);
+
+		// Calls record once per chunk, possibly from several threads at once, and
+		// returns after all chunks are recorded. maxChunks limits the number of
+		// command lists the caller has available.
+		void Record(size_t count, uint32_t maxChunks, const std::function<void (uint32_t chunk, size_t begin, size_t end)> &record);
+
+		const std::vector<RecordChunk> &GetChunks() const { return _chunks; }
+
+	private:
+		WorkerPool *_pool;
+		size_t _minimumDrawsPerChunk;
+		std::vector<RecordChunk> _chunks;
+	};
+}
@@ -0,0 +1,79 @@
+#if defined(_WIN32)
+#include "stdafx.h"
+#endif
+
+#include "LBPipelineCache.h"
+
+#include <cstring>
+
+namespace LB
+{
+	static const uint64_t FNVOffsetBasis = 14695981039346656037ull;
+	static const uint64_t FNVPrime = 1099511628211ull;
+
+	PipelineKey::PipelineKey() : _hash(FNVOffsetBasis)
+	{}
+
+	void PipelineKey::AddBytes(const void *data, size_t size)
+	{
+		const uint8_t *bytes = static_cast<const uint8_t *>(data);
+		_data.insert(_data.end(), bytes, bytes + size);
+
+		for(size_t i = 0; i < size; i++)
+		{
+			_hash ^= bytes[i];
+			_hash *= FNVPrime;
+		}
+	}
+
+	void PipelineKey::AddUInt32(uint32_t value)
+	{
+		const uint8_t bytes[4] = { uint8_t(value), uint8_t(value >> 8), uint8_t(value >> 16), uint8_t(value >> 24) };
+		AddBytes(bytes, sizeof(bytes));
+	}
+
+	void PipelineKey::AddUInt64(uint64_t value)
+	{
+		AddUInt32(static_cast<uint32_t>(value));
+		AddUInt32(static_cast<uint32_t>(value >> 32));
+	}
+
+	void PipelineKey::AddFloat(float value)
+	{
+		uint32_t bits;
+		memcpy(&bits, &value, sizeof(bits));
+		AddUInt32(bits);
+	}
+
+	// Strings are length prefixed so neighbouring fields can't run into each other,
+	// a null pointer is told apart from an empty string.
+	void PipelineKey::AddString(const char *string)
+	{
+		if(!string)
+		{
+			AddUInt32(~0u);
+			return;
+		}
+
+		const uint32_t length = static_cast<uint32_t>(strlen(string));
+		AddUInt32(length);
+		AddBytes(string, length);
+	}
+
+	void PipelineKey::Clear()
+	{
+		_data.clear();
+		_hash = FNVOffsetBasis;
+	}
+
+	std::wstring PipelineKey::GetName() const
+	{
+		static const wchar_t digits[] = L"0123456789abcdef";
+
+		std::wstring name(16, L'0');
+		for(int i = 0; i < 16; i++)
+			name[15 - i] = digits[(_hash >> (i * 4)) & 0xf];
+
+		return name;
+	}
+}
@@ -0,0 +1,166 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace LB
+{
+	// Serialized pipeline description and its hash. Values are stored at fixed
+	// width in little endian order and pointers are replaced by what they point
+	// to, so equal descriptions give equal keys on every compiler and across
+	// launches, which the on disk pipeline library relies on.
+	class PipelineKey
+	{
+	public:
+		PipelineKey();
+
+		void AddBytes(const void *data, size_t size);
+		void AddUInt32(uint32_t value);
+		void AddUInt64(uint64_t value);
+		void AddFloat(float value);
+		void AddString(const char *string);
+
+		void Clear();
+
+		// 64 bit FNV-1a over the serialized data.
+		uint64_t GetHash() const { return _hash; }
+		const std::vector<uint8_t> &GetData() const { return _data; }
+
+		// Hash as 16 hex digits, used to name pipelines in the library.
+		std::wstring GetName() const;
+
+		bool operator ==(const PipelineKey &other) const { return _hash == other._hash && _data == other._data; }
+
+	private:
+		std::vector<uint8_t> _data;
+		uint64_t _hash;
+	};
+
+	struct PipelineCacheStatistics
+	{
+		uint32_t hits;
+		uint32_t misses;
+		uint32_t waits;			// Lookups that waited for another thread creating the same pipeline
+		uint32_t collisions;	// Different keys with the same hash
+	};
+
+	// Maps pipeline keys to pipelines created by the caller. Every key is created
+	// only once, threads asking for a key that is still being created wait for it
+	// instead. If creation throws, the key is dropped again so a later lookup can
+	// retry, and everyone waiting for it gets the exception. Keys are numbered in
+	// the order they were first seen, equal pipelines share the same id.
+	template<typename Pipeline>
+	class PipelineCache
+	{
+	public:
+		PipelineCache() : _nextID(0), _statistics() {}
+
+		Pipeline GetOrCreate(const PipelineKey &key, const std::function<Pipeline()> &create, uint32_t *id = nullptr)
+		{
+			std::shared_future<Pipeline> pipeline;
+			std::promise<Pipeline> promise;
+
+			{
+				std::lock_guard<std::mutex> lock(_lock);
+
+				std::vector<Entry> &bucket = _entries[key.GetHash()];
+				for(const Entry &entry : bucket)
+				{
+					if(entry.key.GetData() == key.GetData())
+					{
+						pipeline = entry.pipeline;
+						if(id)
+							*id = entry.id;
+						break;
+					}
+				}
+
+				if(pipeline.valid())
+				{
+					if(pipeline.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+						_statistics.hits++;
+					else
+						_statistics.waits++;
+				}
+				else
+				{
+					_statistics.misses++;
+					_statistics.collisions += bucket.empty() ? 0 : 1;
+
+					if(id)
+						*id = _nextID;
+
+					bucket.push_back({ key, promise.get_future().share(), _nextID++ });
+				}
+			}
+
+			if(pipeline.valid())
+				return pipeline.get();
+
+			try
+			{
+				Pipeline created = create();
+				promise.set_value(created);
+				return created;
+			}
+			catch(...)
+			{
+				promise.set_exception(std::current_exception());
+				Remove(key);
+				throw;
+			}
+		}
+
+		size_t GetCount()
+		{
+			std::lock_guard<std::mutex> lock(_lock);
+
+			size_t count = 0;
+			for(const auto &bucket : _entries)
+				count += bucket.second.size();
+
+			return count;
+		}
+
+		PipelineCacheStatistics GetStatistics()
+		{
+			std::lock_guard<std::mutex> lock(_lock);
+			return _statistics;
+		}
+
+	private:
+		struct Entry
+		{
+			PipelineKey key;
+			std::shared_future<Pipeline> pipeline;
+			uint32_t id;
+		};
+
+		void Remove(const PipelineKey &key)
+		{
+			std::lock_guard<std::mutex> lock(_lock);
+
+			std::vector<Entry> &bucket = _entries[key.GetHash()];
+			for(size_t i = 0; i < bucket.size(); i++)
+			{
+				if(bucket[i].key.GetData() == key.GetData())
+				{
+					bucket.erase(bucket.begin() + i);
+					break;
+				}
+			}
+		}
+
+		std::mutex _lock;
+		std::unordered_map<uint64_t, std::vector<Entry>> _entries;
+		uint32_t _nextID;
+		PipelineCacheStatistics _statistics;
+	};
+}
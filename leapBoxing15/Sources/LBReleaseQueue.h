@@ -0,0 +1,81 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+
+namespace LB
+{
+	struct ReleaseQueueStatistics
+	{
+		uint64_t queued;
+		uint64_t released;
+	};
+
+	// Parks things the GPU may still be using, each with the fence value of the
+	// last submission that could reference it, and hands them back once the
+	// fence passed that value. Values only go up, one lower than an earlier one
+	// is raised to it, so the queue stays sorted and releasing means popping
+	// from the front. Only deals in fence values, what releasing means and where
+	// the completed value comes from is up to the caller, it is not thread safe.
+	template<typename Item>
+	class ReleaseQueue
+	{
+	public:
+		ReleaseQueue() : _lastFenceValue(0), _statistics() {}
+
+		void Push(const Item &item, uint64_t fenceValue)
+		{
+			_lastFenceValue = std::max(_lastFenceValue, fenceValue);
+			_entries.push_back({ _lastFenceValue, item });
+			_statistics.queued++;
+		}
+
+		// Calls release for every item up to completedValue, oldest first, and
+		// returns how many there were.
+		template<typename Release>
+		size_t Reclaim(uint64_t completedValue, Release release)
+		{
+			size_t count = 0;
+			while(!_entries.empty() && _entries.front().fenceValue <= completedValue)
+			{
+				// Popped first, an item whose release throws isn't released twice.
+				const Item item = _entries.front().item;
+				_entries.pop_front();
+				_statistics.released++;
+				count++;
+
+				release(item);
+			}
+
+			return count;
+		}
+
+		// Everything regardless of the fence, the GPU has to be idle.
+		template<typename Release>
+		size_t ReleaseAll(Release release)
+		{
+			return Reclaim(UINT64_MAX, release);
+		}
+
+		size_t GetCount() const { return _entries.size(); }
+
+		// 0 if nothing is pending.
+		uint64_t GetOldestPendingFence() const { return _entries.empty() ? 0 : _entries.front().fenceValue; }
+
+		const ReleaseQueueStatistics &GetStatistics() const { return _statistics; }
+
+	private:
+		struct Entry
+		{
+			uint64_t fenceValue;
+			Item item;
+		};
+
+		std::deque<Entry> _entries;
+		uint64_t _lastFenceValue;
+
+		ReleaseQueueStatistics _statistics;
+	};
+}
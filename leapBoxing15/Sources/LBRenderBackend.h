@@ -0,0 +1,184 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "LBCommandEncoder.h"
+#include "LBDescriptorAllocator.h"
+
+namespace LB
+{
+	// Layouts of the per instance world transform in the second vertex buffer.
+	// Transforms are affine, the last column of the matrix is implied by all but
+	// the first one.
+	enum class InstanceFormat : uint32_t
+	{
+		Matrix,			// float4x4, 64 bytes
+		Affine,			// First three columns of the rows as float3, 48 bytes
+		AffineHalf		// Translation as float3 and the other rows as half4, 36 bytes
+	};
+
+	struct RendererSettings
+	{
+		RendererSettings() : frameCount(2), maxFrameLatency(2), syncInterval(0), allowTearing(false), depthPrePass(false), instanceFormat(InstanceFormat::Affine), workerThreads(0) {}
+
+		uint32_t frameCount;		// Back buffers and sets of per frame resources, 2 to 4
+		uint32_t maxFrameLatency;	// Frames in flight including the one being recorded
+		uint32_t syncInterval;		// 0 presents immediately, 1 to 4 wait for as many vertical blanks
+		bool allowTearing;			// Lets sync interval 0 tear in windowed mode where supported
+		bool depthPrePass;			// Lays down the depth of all opaque draws before shading them
+		InstanceFormat instanceFormat;	// Layout of the per instance transforms, see LBInstanceStream.h
+		uint32_t workerThreads;		// Threads sorting, writing instances and recording, the render thread included, 0 for one per hardware thread
+	};
+
+	enum class BackendQueue : uint32_t
+	{
+		Graphics,
+		Copy
+	};
+
+	enum class BufferHeap : uint32_t
+	{
+		Default,		// GPU memory, filled through copies
+		Upload			// CPU writable, stays mapped
+	};
+
+	// Values match D3D_PRIMITIVE_TOPOLOGY.
+	namespace PrimitiveTopology
+	{
+		enum : uint32_t
+		{
+			TriangleList = 4,
+			TriangleStrip = 5
+		};
+	}
+
+	// Index formats, the values match DXGI_FORMAT.
+	namespace IndexFormat
+	{
+		enum : uint32_t
+		{
+			UInt32 = 42,
+			UInt16 = 57
+		};
+	}
+
+	// Constant buffers the shaders expect, matrices are row major and transform
+	// row vectors.
+	enum ConstantSlot : uint32_t
+	{
+		ConstantSlotFrame,
+		ConstantSlotDraw
+	};
+
+	struct FrameConstants
+	{
+		float viewProjection[16];
+	};
+
+	struct DrawConstants
+	{
+		float model[16];
+	};
+
+	// Depth test and writes of a pipeline, against the backend's depth buffer.
+	enum class DepthMode : uint32_t
+	{
+		Disabled,
+		ReadWrite,		// Passes if less, writes depth and color
+		DepthOnly,		// Passes if less, writes only depth, for the pre-pass
+		ReadOnly		// Passes if less or equal, writes only color, after the pre-pass
+	};
+
+	// Vertices are POSITION + COLOR in the first vertex buffer and instances a
+	// WORLD matrix in instanceFormat in the second one, the shader file has
+	// VSMain and PSMain.
+	struct PipelineDescription
+	{
+		PipelineDescription() : depthMode(DepthMode::ReadWrite), instanceFormat(InstanceFormat::Matrix) {}
+
+		std::wstring shaderFile;
+		DepthMode depthMode;
+		InstanceFormat instanceFormat;
+	};
+
+	// What the renderer needs from a graphics API, so everything above it runs
+	// on any backend: D3D12 for the application and a headless one recording
+	// into memory for tests and benchmarks.
+	//
+	// Resources are opaque handles that double as their identity for state
+	// tracking. Each queue has its own fence, driven by the renderer through
+	// Signal with increasing values. Command lists and resources stay with the
+	// backend, the renderer has to release resources only once the fence passed
+	// their last use.
+	class RenderBackend
+	{
+	public:
+		virtual ~RenderBackend() {}
+
+		virtual uint32_t GetFrameCount() const = 0;
+		virtual uint32_t GetWidth() const = 0;
+		virtual uint32_t GetHeight() const = 0;
+
+		virtual uint32_t GetBackBufferIndex() = 0;
+		virtual const void *GetBackBuffer(uint32_t index) = 0;
+
+		// 32 bit float depth buffer the size of the back buffers, shared by all
+		// frames since they run one after another on the graphics queue. It is
+		// created in the DepthWrite state and recreated with the back buffers.
+		virtual const void *GetDepthBuffer() = 0;
+
+		// Recreates the back buffers and the depth buffer, which the GPU must not
+		// be using anymore.
+		virtual void Resize(uint32_t width, uint32_t height) = 0;
+		virtual void ToggleFullscreen() = 0;
+
+		// Blocks until the presentation queue can take another frame.
+		virtual void WaitForPresent(uint32_t timeoutMilliseconds) = 0;
+		virtual void Present() = 0;
+
+		// Presents only the top left width x height pixels of the back buffers,
+		// upscaled to their full size, so rendering at a lower resolution just
+		// needs a smaller viewport. Resize goes back to the full size.
+		virtual void SetSourceSize(uint32_t width, uint32_t height) = 0;
+
+		// GPU time of the most recent frame whose timing is known, which can lag
+		// a few frames behind. 0 if the backend can't measure it.
+		virtual double GetGpuMilliseconds() = 0;
+
+		// Descriptors allocated and freed since the last call and those still in
+		// use by frames in flight. The frame constants are bound through a view
+		// in the ring, one per command list setting them.
+		virtual DescriptorStatistics TakeDescriptorStatistics() = 0;
+
+		virtual const void *CreateBuffer(uint64_t size, BufferHeap heap, uint32_t initialState) = 0;
+		virtual void ReleaseResource(const void *resource) = 0;
+
+		// Upload heap buffers only, the pointer stays valid until release.
+		virtual uint8_t *MapBuffer(const void *buffer) = 0;
+		virtual uint64_t GetBufferAddress(const void *buffer) = 0;
+
+		// Identical descriptions share one pipeline state, pipelineID receives an
+		// id shared by them for sorting. Safe to call from any thread.
+		virtual const void *GetPipelineState(const PipelineDescription &description, uint32_t *pipelineID) = 0;
+
+		virtual RenderCommandList *CreateCommandList(BackendQueue queue) = 0;
+
+		// Command list for draw state and draws only, replayed with ExecuteBundle
+		// by graphics command lists. It inherits their render target and the
+		// constant buffers it doesn't set, and the state it sets stays bound after
+		// it. Before recording it again it has to be retired with a fence value
+		// covering all frames that executed it.
+		virtual RenderCommandList *CreateBundle() = 0;
+
+		virtual void ExecuteCommandLists(BackendQueue queue, RenderCommandList *const *commandLists, uint32_t count) = 0;
+
+		// Signal marks everything executed on the queue so far with value, Wait
+		// makes the queue wait for another queue's fence on the GPU and
+		// WaitForValue blocks the CPU.
+		virtual void Signal(BackendQueue queue, uint64_t value) = 0;
+		virtual void Wait(BackendQueue queue, BackendQueue signalQueue, uint64_t value) = 0;
+		virtual uint64_t GetCompletedValue(BackendQueue queue) = 0;
+		virtual void WaitForValue(BackendQueue queue, uint64_t value) = 0;
+	};
+}
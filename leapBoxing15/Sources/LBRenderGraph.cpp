@@ -0,0 +1,376 @@
+#if defined(_WIN32)
+#include "stdafx.h"
+#endif
+
+#include "LBRenderGraph.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+namespace LB
+{
+	void RenderGraph::Reset()
+	{
+		_passes.clear();
+		_resources.clear();
+		_order.clear();
+		_barriers.clear();
+		memset(&_statistics, 0, sizeof(_statistics));
+	}
+
+	RenderGraphResource RenderGraph::ImportResource(const char *name, uint32_t initialState, uint32_t finalState)
+	{
+		Resource resource;
+		resource.name = name;
+		resource.transient = false;
+		resource.initialState = initialState;
+		resource.finalState = finalState;
+		resource.size = 0;
+		resource.alignment = 1;
+		resource.firstUse = InvalidIndex;
+		resource.lastUse = InvalidIndex;
+		resource.heapOffset = 0;
+
+		_resources.push_back(resource);
+		return static_cast<RenderGraphResource>(_resources.size() - 1);
+	}
+
+	RenderGraphResource RenderGraph::CreateTransient(const char *name, uint64_t size, uint64_t alignment)
+	{
+		assert(alignment > 0 && (alignment & (alignment - 1)) == 0);
+
+		// States are only known once the first access is.
+		RenderGraphResource handle = ImportResource(name, ResourceState::Common, ResourceState::Common);
+
+		Resource &resource = _resources[handle];
+		resource.transient = true;
+		resource.size = size;
+		resource.alignment = alignment;
+
+		return handle;
+	}
+
+	RenderGraphPass RenderGraph::AddPass(const char *name, const std::function<void()> &execute)
+	{
+		Pass pass;
+		pass.name = name;
+		pass.execute = execute;
+		pass.sideEffect = false;
+		pass.culled = false;
+
+		_passes.push_back(pass);
+		return static_cast<RenderGraphPass>(_passes.size() - 1);
+	}
+
+	void RenderGraph::SetSideEffect(RenderGraphPass pass)
+	{
+		_passes[pass].sideEffect = true;
+	}
+
+	void RenderGraph::Read(RenderGraphPass pass, RenderGraphResource resource, uint32_t state)
+	{
+		_passes[pass].accesses.push_back({ resource, state, false });
+	}
+
+	void RenderGraph::Write(RenderGraphPass pass, RenderGraphResource resource, uint32_t state)
+	{
+		_passes[pass].accesses.push_back({ resource, state, true });
+
+		if(!_resources[resource].transient)
+			_passes[pass].sideEffect = true;
+	}
+
+	void RenderGraph::Compile()
+	{
+		memset(&_statistics, 0, sizeof(_statistics));
+		_statistics.passes = static_cast<uint32_t>(_passes.size());
+
+		Cull();
+		Order();
+		PlaceTransients();
+		BuildBarriers();
+	}
+
+	// Walks the passes backwards, a pass is needed if it has side effects or
+	// writes something a needed pass after it accesses. Writes keep the previous
+	// writer alive as well, as passes may load what was there before.
+	void RenderGraph::Cull()
+	{
+		std::vector<bool> resourceNeeded(_resources.size(), false);
+
+		for(size_t i = _passes.size(); i-- > 0;)
+		{
+			Pass &pass = _passes[i];
+
+			bool needed = pass.sideEffect;
+			for(const Access &access : pass.accesses)
+			{
+				if(access.write && resourceNeeded[access.resource])
+					needed = true;
+			}
+
+			pass.culled = !needed;
+			if(!needed)
+			{
+				_statistics.culledPasses++;
+				continue;
+			}
+
+			for(const Access &access : pass.accesses)
+				resourceNeeded[access.resource] = true;
+		}
+	}
+
+	// Dependencies are derived from the order passes were added in, which is
+	// always a valid order, so the passes that survived culling run in it.
+	void RenderGraph::Order()
+	{
+		_order.clear();
+
+		for(Resource &resource : _resources)
+		{
+			resource.firstUse = InvalidIndex;
+			resource.lastUse = InvalidIndex;
+		}
+
+		for(size_t i = 0; i < _passes.size(); i++)
+		{
+			if(_passes[i].culled)
+				continue;
+
+			const uint32_t position = static_cast<uint32_t>(_order.size());
+			_order.push_back(static_cast<RenderGraphPass>(i));
+
+			for(const Access &access : _passes[i].accesses)
+			{
+				Resource &resource = _resources[access.resource];
+				if(resource.firstUse == InvalidIndex)
+				{
+					resource.firstUse = position;
+
+					if(resource.transient)
+					{
+						resource.initialState = access.state;
+						resource.finalState = access.state;
+					}
+				}
+
+				resource.lastUse = position;
+			}
+		}
+	}
+
+	// Greedy placement, largest first, each at the lowest offset not overlapping
+	// any already placed resource that is alive at the same time.
+	void RenderGraph::PlaceTransients()
+	{
+		std::vector<RenderGraphResource> transients;
+		for(size_t i = 0; i < _resources.size(); i++)
+		{
+			const Resource &resource = _resources[i];
+			if(resource.transient && resource.firstUse != InvalidIndex)
+			{
+				transients.push_back(static_cast<RenderGraphResource>(i));
+				_statistics.transientBytes += resource.size;
+			}
+		}
+
+		std::stable_sort(transients.begin(), transients.end(), [&](RenderGraphResource a, RenderGraphResource b) {
+			return _resources[a].size > _resources[b].size;
+		});
+
+		std::vector<RenderGraphResource> placed;
+		for(RenderGraphResource handle : transients)
+		{
+			Resource &resource = _resources[handle];
+
+			std::vector<const Resource *> overlapping;
+			for(RenderGraphResource other : placed)
+			{
+				const Resource &otherResource = _resources[other];
+				if(otherResource.firstUse <= resource.lastUse && resource.firstUse <= otherResource.lastUse)
+					overlapping.push_back(&otherResource);
+			}
+
+			// Candidates are the start of the heap and the end of every overlapping
+			// resource, the lowest one that fits wins.
+			uint64_t best = ~0ull;
+			for(size_t candidate = 0; candidate <= overlapping.size(); candidate++)
+			{
+				uint64_t offset = (candidate == 0) ? 0 : overlapping[candidate - 1]->heapOffset + overlapping[candidate - 1]->size;
+				offset = (offset + resource.alignment - 1) & ~(resource.alignment - 1);
+
+				if(offset >= best)
+					continue;
+
+				bool fits = true;
+				for(const Resource *other : overlapping)
+				{
+					if(offset < other->heapOffset + other->size && other->heapOffset < offset + resource.size)
+					{
+						fits = false;
+						break;
+					}
+				}
+
+				if(fits)
+					best = offset;
+			}
+
+			resource.heapOffset = best;
+			_statistics.heapBytes = std::max(_statistics.heapBytes, best + resource.size);
+			placed.push_back(handle);
+		}
+	}
+
+	void RenderGraph::BuildBarriers()
+	{
+		// One batch in front of every pass and a final one.
+		_barriers.assign(_order.size() + 1, std::vector<RenderBarrier>());
+
+		std::vector<uint32_t> states(_resources.size());
+		std::vector<bool> unorderedWritten(_resources.size(), false);
+
+		for(size_t i = 0; i < _resources.size(); i++)
+			states[i] = _resources[i].initialState;
+
+		// Transient resources taking over memory from ones that died before them.
+		for(size_t i = 0; i < _resources.size(); i++)
+		{
+			const Resource &resource = _resources[i];
+			if(!resource.transient || resource.firstUse == InvalidIndex)
+				continue;
+
+			RenderGraphResource previous = InvalidIndex;
+			uint32_t previousCount = 0;
+
+			for(size_t j = 0; j < _resources.size(); j++)
+			{
+				const Resource &other = _resources[j];
+				if(j == i || !other.transient || other.firstUse == InvalidIndex || other.lastUse >= resource.firstUse)
+					continue;
+
+				if(resource.heapOffset < other.heapOffset + other.size && other.heapOffset < resource.heapOffset + resource.size)
+				{
+					previous = static_cast<RenderGraphResource>(j);
+					previousCount++;
+				}
+			}
+
+			// With several predecessors the barrier doesn't name one, which covers
+			// all of them.
+			if(previousCount > 0)
+				_barriers[resource.firstUse].push_back({ RenderBarrierType::Aliasing, static_cast<RenderGraphResource>(i), (previousCount == 1) ? previous : InvalidIndex, 0, 0 });
+		}
+
+		for(size_t position = 0; position < _order.size(); position++)
+		{
+			const Pass &pass = _passes[_order[position]];
+			std::vector<RenderBarrier> &batch = _barriers[position];
+
+			// Combine all accesses of the pass per resource, reads in several states
+			// become a single transition into all of them.
+			std::vector<std::pair<RenderGraphResource, uint32_t>> required;
+			std::vector<bool> writes;
+
+			for(const Access &access : pass.accesses)
+			{
+				size_t index = 0;
+				while(index < required.size() && required[index].first != access.resource)
+					index++;
+
+				if(index == required.size())
+				{
+					required.push_back(std::make_pair(access.resource, access.state));
+					writes.push_back(access.write);
+					continue;
+				}
+
+				if(access.write || writes[index])
+				{
+					// A write decides the state, a resource can't be in a write and a
+					// read state at once.
+					assert(!writes[index] || !access.write || required[index].second == access.state);
+					if(access.write)
+						required[index].second = access.state;
+					writes[index] = true;
+				}
+				else if((required[index].second | access.state) != required[index].second)
+				{
+					required[index].second |= access.state;
+					_statistics.barriersMerged++;
+				}
+			}
+
+			for(size_t k = 0; k < required.size(); k++)
+			{
+				const RenderGraphResource resource = required[k].first;
+				const uint32_t state = required[k].second;
+				uint32_t &current = states[resource];
+
+				if(state == ResourceState::UnorderedAccess && current == ResourceState::UnorderedAccess)
+				{
+					// Consecutive unordered access needs the earlier writes to finish.
+					if(unorderedWritten[resource])
+						batch.push_back({ RenderBarrierType::UnorderedAccess, resource, InvalidIndex, state, state });
+				}
+				else if(current != state)
+				{
+					// Already readable in everything needed, no need to narrow it down.
+					const bool covered = !writes[k] && (current & ~ResourceState::ReadStates) == 0 && current != ResourceState::Common && (current & state) == state;
+					if(!covered)
+					{
+						batch.push_back({ RenderBarrierType::Transition, resource, InvalidIndex, current, state });
+						current = state;
+					}
+				}
+
+				unorderedWritten[resource] = writes[k] && state == ResourceState::UnorderedAccess;
+			}
+
+			// Transient resources go back to their initial state right after their
+			// last use, ahead of aliasing barriers handing their memory to another.
+			for(const std::pair<RenderGraphResource, uint32_t> &entry : required)
+			{
+				const Resource &resource = _resources[entry.first];
+				if(resource.transient && resource.lastUse == position && states[entry.first] != resource.initialState)
+				{
+					std::vector<RenderBarrier> &next = _barriers[position + 1];
+					next.insert(next.begin(), { RenderBarrierType::Transition, entry.first, InvalidIndex, states[entry.first], resource.initialState });
+					states[entry.first] = resource.initialState;
+				}
+			}
+		}
+
+		for(size_t i = 0; i < _resources.size(); i++)
+		{
+			const Resource &resource = _resources[i];
+			if(!resource.transient && states[i] != resource.finalState)
+				_barriers.back().push_back({ RenderBarrierType::Transition, static_cast<RenderGraphResource>(i), InvalidIndex, states[i], resource.finalState });
+		}
+
+		for(const std::vector<RenderBarrier> &batch : _barriers)
+		{
+			_statistics.barriers += static_cast<uint32_t>(batch.size());
+			_statistics.barrierBatches += batch.empty() ? 0 : 1;
+		}
+	}
+
+	void RenderGraph::Execute(const std::function<void(const RenderBarrier *barriers, size_t count)> &submitBarriers) const
+	{
+		for(size_t position = 0; position < _order.size(); position++)
+		{
+			const std::vector<RenderBarrier> &batch = _barriers[position];
+			if(!batch.empty())
+				submitBarriers(batch.data(), batch.size());
+
+			const Pass &pass = _passes[_order[position]];
+			if(pass.execute)
+				pass.execute();
+		}
+
+		if(!_barriers.empty() && !_barriers.back().empty())
+			submitBarriers(_barriers.back().data(), _barriers.back().size());
+	}
+}
@@ -0,0 +1,159 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace LB
+{
+	// Resource states, the values match D3D12_RESOURCE_STATES so they can be
+	// passed through. Read states can be combined.
+	namespace ResourceState
+	{
+		enum : uint32_t
+		{
+			Common = 0,
+			Present = 0,
+			VertexAndConstantBuffer = 0x1,
+			IndexBuffer = 0x2,
+			RenderTarget = 0x4,
+			UnorderedAccess = 0x8,
+			DepthWrite = 0x10,
+			DepthRead = 0x20,
+			NonPixelShaderResource = 0x40,
+			PixelShaderResource = 0x80,
+			IndirectArgument = 0x200,
+			CopyDest = 0x400,
+			CopySource = 0x800,
+
+			ReadStates = VertexAndConstantBuffer | IndexBuffer | DepthRead | NonPixelShaderResource | PixelShaderResource | IndirectArgument | CopySource,
+
+			// The one state upload heap buffers can be in.
+			GenericRead = VertexAndConstantBuffer | IndexBuffer | NonPixelShaderResource | PixelShaderResource | IndirectArgument | CopySource
+		};
+	}
+
+	typedef uint32_t RenderGraphResource;
+	typedef uint32_t RenderGraphPass;
+
+	enum class RenderBarrierType : uint32_t
+	{
+		Transition,
+		Aliasing,		// resource takes over memory used by before
+		UnorderedAccess
+	};
+
+	struct RenderBarrier
+	{
+		RenderBarrierType type;
+		RenderGraphResource resource;
+		RenderGraphResource aliasBefore;
+		uint32_t stateBefore;
+		uint32_t stateAfter;
+	};
+
+	struct RenderGraphStatistics
+	{
+		uint32_t passes;
+		uint32_t culledPasses;
+		uint32_t barriers;
+		uint32_t barrierBatches;		// ResourceBarrier calls, one per pass at most plus the final one
+		uint32_t barriersMerged;		// Read states folded into one transition
+		uint64_t transientBytes;		// Transient resources without aliasing
+		uint64_t heapBytes;				// Transient heap size with aliasing
+	};
+
+	// Frame description as passes reading and writing resources. Compile orders
+	// the passes by their dependencies, culls the ones nothing depends on, batches
+	// the state transitions each pass needs into one list and places transient
+	// resources whose lifetimes don't overlap at the same heap offsets. Execute
+	// then hands each batch to the backend followed by the pass.
+	//
+	// Imported resources live outside the graph and are returned in their final
+	// state. Transient resources only exist during the frame, they start every
+	// frame in the state of their first use and are transitioned back after their
+	// last one, so the backend can create them once in that state. A transient
+	// resource's first use has to overwrite it completely, as its memory may have
+	// been used by another one.
+	class RenderGraph
+	{
+	public:
+		static const uint32_t InvalidIndex = ~0u;
+
+		void Reset();
+
+		RenderGraphResource ImportResource(const char *name, uint32_t initialState, uint32_t finalState);
+		RenderGraphResource CreateTransient(const char *name, uint64_t size, uint64_t alignment);
+
+		RenderGraphPass AddPass(const char *name, const std::function<void()> &execute);
+
+		// Passes with side effects are never culled, writing an imported resource
+		// counts as one.
+		void SetSideEffect(RenderGraphPass pass);
+		void Read(RenderGraphPass pass, RenderGraphResource resource, uint32_t state);
+		void Write(RenderGraphPass pass, RenderGraphResource resource, uint32_t state);
+
+		void Compile();
+		void Execute(const std::function<void(const RenderBarrier *barriers, size_t count)> &submitBarriers) const;
+
+		// Compile results.
+		const std::vector<RenderGraphPass> &GetExecutionOrder() const { return _order; }
+		const std::vector<RenderBarrier> &GetBarriers(size_t orderIndex) const { return _barriers[orderIndex]; }
+		const std::vector<RenderBarrier> &GetFinalBarriers() const { return _barriers.back(); }
+
+		bool IsTransient(RenderGraphResource resource) const { return _resources[resource].transient; }
+		uint64_t GetHeapOffset(RenderGraphResource resource) const { return _resources[resource].heapOffset; }
+		uint32_t GetInitialState(RenderGraphResource resource) const { return _resources[resource].initialState; }
+		uint64_t GetHeapSize() const { return _statistics.heapBytes; }
+		const char *GetName(RenderGraphResource resource) const { return _resources[resource].name.c_str(); }
+
+		const RenderGraphStatistics &GetStatistics() const { return _statistics; }
+
+	private:
+		struct Access
+		{
+			RenderGraphResource resource;
+			uint32_t state;
+			bool write;
+		};
+
+		struct Pass
+		{
+			std::string name;
+			std::function<void()> execute;
+			std::vector<Access> accesses;
+			bool sideEffect;
+			bool culled;
+		};
+
+		struct Resource
+		{
+			std::string name;
+			bool transient;
+			uint32_t initialState;
+			uint32_t finalState;
+			uint64_t size;
+			uint64_t alignment;
+
+			// Filled by Compile, positions in the execution order.
+			uint32_t firstUse;
+			uint32_t lastUse;
+			uint64_t heapOffset;
+		};
+
+		void Cull();
+		void Order();
+		void PlaceTransients();
+		void BuildBarriers();
+
+		std::vector<Pass> _passes;
+		std::vector<Resource> _resources;
+
+		std::vector<RenderGraphPass> _order;
+		std::vector<std::vector<RenderBarrier>> _barriers;
+
+		RenderGraphStatistics _statistics;
+	};
+}
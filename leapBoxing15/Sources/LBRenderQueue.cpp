@@ -0,0 +1,132 @@
+#if defined(_WIN32)
+#include "stdafx.h"
+#endif
+
+#include "LBRenderQueue.h"
+#include "LBWorkerPool.h"
+
+#include <algorithm>
+#include <functional>
+
+namespace LB
+{
+	namespace
+	{
+		// Below this many packets per thread, splitting the sort costs more than it saves.
+		const size_t MinimumPacketsPerThread = 4096;
+	}
+
+	uint64_t RenderQueue::MakeKey(RenderPass pass, uint32_t pipeline, uint32_t material, uint32_t mesh, float depth)
+	{
+		uint64_t quantizedDepth = static_cast<uint64_t>(std::min(std::max(depth, 0.0f), 1.0f) * 65535.0f);
+
+		// Transparent geometry has to be drawn back to front.
+		if(pass == RenderPass::Transparent)
+			quantizedDepth = 0xffff - quantizedDepth;
+
+		return (static_cast<uint64_t>(pass) << 62) |
+			(static_cast<uint64_t>(pipeline & 0xfff) << 50) |
+			(static_cast<uint64_t>(material & 0xfff) << 38) |
+			(static_cast<uint64_t>(mesh & 0xffff) << 22) |
+			(quantizedDepth << 6);
+	}
+
+	void RenderQueue::Reset()
+	{
+		_packets.clear();
+		_keys.clear();
+		_indices.clear();
+	}
+
+	void RenderQueue::Push(uint64_t key, const DrawPacket &packet)
+	{
+		_indices.push_back(static_cast<uint32_t>(_packets.size()));
+		_packets.push_back(packet);
+		_keys.push_back(key);
+	}
+
+	void RenderQueue::Sort(WorkerPool *pool)
+	{
+		const size_t count = _keys.size();
+		if(count < 2)
+			return;
+
+		size_t threads = pool ? std::min<size_t>(pool->GetThreadCount(), count / MinimumPacketsPerThread) : 1;
+		threads = std::max<size_t>(threads, 1);
+
+		const size_t chunkSize = (count + threads - 1) / threads;
+
+		_sortKeys.resize(count);
+		_sortIndices.resize(count);
+		_histograms.resize(threads * 256);
+
+		auto forEachChunk = [&](const std::function<void (uint32_t thread, size_t begin, size_t end)> &function) {
+			auto task = [&](uint32_t thread) {
+				const size_t begin = thread * chunkSize;
+				const size_t end = std::min(begin + chunkSize, count);
+				function(thread, begin, end);
+			};
+
+			if(threads > 1)
+			{
+				pool->ParallelFor(static_cast<uint32_t>(threads), task);
+			}
+			else
+			{
+				task(0);
+			}
+		};
+
+		for(uint32_t shift = 0; shift < 64; shift += 8)
+		{
+			std::fill(_histograms.begin(), _histograms.end(), 0);
+
+			const uint64_t *keys = _keys.data();
+			const uint32_t *indices = _indices.data();
+			uint64_t *sortKeys = _sortKeys.data();
+			uint32_t *sortIndices = _sortIndices.data();
+			uint32_t *histograms = _histograms.data();
+
+			forEachChunk([&](uint32_t thread, size_t begin, size_t end) {
+				uint32_t *histogram = histograms + thread * 256;
+				for(size_t i = begin; i < end; i++)
+					histogram[(keys[i] >> shift) & 0xff]++;
+			});
+
+			// If every key has the same digit this pass would not move anything.
+			const uint32_t digit = (keys[0] >> shift) & 0xff;
+			uint32_t sameDigit = 0;
+			for(size_t thread = 0; thread < threads; thread++)
+				sameDigit += histograms[thread * 256 + digit];
+
+			if(sameDigit == count)
+				continue;
+
+			// Turn the histograms into scatter offsets, digit major and thread minor so
+			// the sort stays stable.
+			uint32_t offset = 0;
+			for(uint32_t bucket = 0; bucket < 256; bucket++)
+			{
+				for(size_t thread = 0; thread < threads; thread++)
+				{
+					const uint32_t bucketCount = histograms[thread * 256 + bucket];
+					histograms[thread * 256 + bucket] = offset;
+					offset += bucketCount;
+				}
+			}
+
+			forEachChunk([&](uint32_t thread, size_t begin, size_t end) {
+				uint32_t *offsets = histograms + thread * 256;
+				for(size_t i = begin; i < end; i++)
+				{
+					const uint32_t target = offsets[(keys[i] >> shift) & 0xff]++;
+					sortKeys[target] = keys[i];
+					sortIndices[target] = indices[i];
+				}
+			});
+
+			_keys.swap(_sortKeys);
+			_indices.swap(_sortIndices);
+		}
+	}
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace LB
+{
+	class Mesh;
+	class Material;
+	class WorkerPool;
+
+	enum class RenderPass : uint32_t
+	{
+		Opaque = 0,
+		Transparent = 1,
+		Overlay = 2
+	};
+
+	// Everything the backend needs to issue one (instanced) draw.
+	struct DrawPacket
+	{
+		Mesh *mesh;
+		Material *material;
+		uint32_t firstInstance;
+		uint32_t instanceCount;
+	};
+
+	// Draw packets tagged with 64 bit sort keys. Keys are ordered by pass, pipeline
+	// state, material, mesh and finally a quantized depth, so sorting them groups
+	// draws by decreasing state change cost:
+	//
+	//   63..62 pass | 61..50 pipeline | 49..38 material | 37..22 mesh | 21..6 depth | 5..0 unused
+	class RenderQueue
+	{
+	public:
+		static uint64_t MakeKey(RenderPass pass, uint32_t pipeline, uint32_t material, uint32_t mesh, float depth);
+
+		void Reset();
+		void Push(uint64_t key, const DrawPacket &packet);
+
+		// Stable LSD radix sort over the keys, passes where all keys share the same
+		// byte are skipped. Histograms and scatters are split across the pool.
+		void Sort(WorkerPool *pool = nullptr);
+
+		size_t GetCount() const { return _keys.size(); }
+		uint64_t GetSortedKey(size_t index) const { return _keys[index]; }
+		const DrawPacket &GetSortedPacket(size_t index) const { return _packets[_indices[index]]; }
+
+	private:
+		std::vector<DrawPacket> _packets;
+		std::vector<uint64_t> _keys;
+		std::vector<uint32_t> _indices;
+
+		std::vector<uint64_t> _sortKeys;
+		std::vector<uint32_t> _sortIndices;
+		std::vector<uint32_t> _histograms;
+	};
+}
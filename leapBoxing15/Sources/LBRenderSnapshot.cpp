@@ -0,0 +1,92 @@
+#if defined(_WIN32)
+#include "stdafx.h"
+#endif
+
+#include "LBRenderSnapshot.h"
+
+#include <chrono>
+
+namespace LB
+{
+	RenderSnapshotBuffer::RenderSnapshotBuffer() : _writeIndex(0), _hasNewSnapshot(false), _reading(false), _shutdown(false), _frame(0), _publishWaits(0)
+	{
+
+	}
+
+	RenderSnapshot &RenderSnapshotBuffer::BeginWrite()
+	{
+		RenderSnapshot &snapshot = _snapshots[_writeIndex];
+		snapshot.frame = _frame;
+		snapshot.items.clear();
+
+		return snapshot;
+	}
+
+	void RenderSnapshotBuffer::Publish()
+	{
+		{
+			std::unique_lock<std::mutex> lock(_lock);
+
+			// After the swap the simulation writes into the slot the renderer is reading
+			// from, so that one has to be released first.
+			if(_reading || _hasNewSnapshot)
+			{
+				_publishWaits++;
+				_condition.wait(lock, [this] { return (!_reading && !_hasNewSnapshot) || _shutdown; });
+			}
+
+			_writeIndex = 1 - _writeIndex;
+			_hasNewSnapshot = true;
+			_frame++;
+		}
+
+		_condition.notify_all();
+	}
+
+	const RenderSnapshot *RenderSnapshotBuffer::TryAcquire()
+	{
+		std::lock_guard<std::mutex> lock(_lock);
+
+		if(!_hasNewSnapshot)
+			return nullptr;
+
+		_hasNewSnapshot = false;
+		_reading = true;
+
+		return &_snapshots[1 - _writeIndex];
+	}
+
+	const RenderSnapshot *RenderSnapshotBuffer::Acquire(uint32_t timeoutMilliseconds)
+	{
+		std::unique_lock<std::mutex> lock(_lock);
+
+		_condition.wait_for(lock, std::chrono::milliseconds(timeoutMilliseconds), [this] { return _hasNewSnapshot || _shutdown; });
+		if(!_hasNewSnapshot)
+			return nullptr;
+
+		_hasNewSnapshot = false;
+		_reading = true;
+
+		return &_snapshots[1 - _writeIndex];
+	}
+
+	void RenderSnapshotBuffer::Release()
+	{
+		{
+			std::lock_guard<std::mutex> lock(_lock);
+			_reading = false;
+		}
+
+		_condition.notify_all();
+	}
+
+	void RenderSnapshotBuffer::Shutdown()
+	{
+		{
+			std::lock_guard<std::mutex> lock(_lock);
+			_shutdown = true;
+		}
+
+		_condition.notify_all();
+	}
+}
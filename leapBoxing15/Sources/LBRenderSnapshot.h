@@ -0,0 +1,78 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace LB
+{
+	class Mesh;
+	class Material;
+
+	// Everything the renderer needs to know about one entity, copied out of the
+	// scene so the simulation can keep mutating it while the frame is drawn.
+	struct RenderItem
+	{
+		float worldMatrix[16];
+		float boundsMin[3];
+		float boundsMax[3];
+		Mesh *mesh;
+		Material *material;
+	};
+
+	struct RenderSnapshot
+	{
+		uint64_t frame;
+		float viewMatrix[16];
+		float cameraPosition[3];
+		std::vector<RenderItem> items;
+
+		// Items that never move, shared by all snapshots and never modified. The
+		// renderer records them once and replays them every frame, a new list
+		// replaces this one whenever the static set changes.
+		std::shared_ptr<const std::vector<RenderItem>> staticItems;
+
+		double extractMilliseconds;
+	};
+
+	// Two snapshots, one being written by the simulation and one being read by
+	// the renderer. Publish hands the written one over and blocks until the renderer
+	// picked up the previous one and is done reading the slot that gets written next,
+	// so simulation runs at most one frame ahead of rendering.
+	class RenderSnapshotBuffer
+	{
+	public:
+		RenderSnapshotBuffer();
+
+		RenderSnapshot &BeginWrite();
+		void Publish();
+
+		// Returns the latest published snapshot or nullptr if there is none that
+		// hasn't been rendered yet, has to be followed by Release.
+		const RenderSnapshot *TryAcquire();
+
+		// Like TryAcquire, but waits up to timeoutMilliseconds for the simulation
+		// to publish one. Returns nullptr on timeout and after Shutdown.
+		const RenderSnapshot *Acquire(uint32_t timeoutMilliseconds);
+		void Release();
+
+		// Wakes a simulation thread blocked in Publish, used on shutdown.
+		void Shutdown();
+
+		uint64_t GetPublishWaits() const { return _publishWaits; }
+
+	private:
+		RenderSnapshot _snapshots[2];
+		uint32_t _writeIndex;
+		bool _hasNewSnapshot;
+		bool _reading;
+		bool _shutdown;
+		uint64_t _frame;
+		uint64_t _publishWaits;
+
+		std::mutex _lock;
+		std::condition_variable _condition;
+	};
+}
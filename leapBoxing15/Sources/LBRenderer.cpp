@@ -1,536 +1,1036 @@
+#if defined(_WIN32)
 #include "stdafx.h"
+#endif
+
 #include "LBRenderer.h"
-#include "LBEntity.h"
-#include "LBModel.h"
+#include "LBRenderSnapshot.h"
 #include "LBMesh.h"
 #include "LBMaterial.h"
 
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
 namespace LB
 {
-	Renderer::Renderer(HWND hwnd, bool useWARPDevice) : _windowWidth(0), _windowHeight(0), _needsUpdateForWindowSizeChange(true), _windowVisible(true), _rtvDescriptorSize(0)
+	const float Renderer::MaxSortDistance = 1000.0f;
+
+	static double GetTime()
+	{
+		return std::chrono::duration<double>(std::chrono::high_resolution_clock::now().time_since_epoch()).count();
+	}
+
+	// Row major and for row vectors, like the matrices in the constant buffers.
+	static void MultiplyMatrices(const float *a, const float *b, float *result)
+	{
+		for(int row = 0; row < 4; row++)
+		{
+			for(int column = 0; column < 4; column++)
+			{
+				float sum = 0.0f;
+				for(int i = 0; i < 4; i++)
+					sum += a[row * 4 + i] * b[i * 4 + column];
+
+				result[row * 4 + column] = sum;
+			}
+		}
+	}
+
+	// Same as XMMatrixPerspectiveFovRH.
+	static void MakePerspective(float fovY, float aspect, float nearZ, float farZ, float *result)
+	{
+		const float height = 1.0f / tanf(fovY * 0.5f);
+		const float width = height / aspect;
+		const float range = farZ / (nearZ - farZ);
+
+		memset(result, 0, sizeof(float) * 16);
+		result[0] = width;
+		result[5] = height;
+		result[10] = range;
+		result[11] = -1.0f;
+		result[14] = range * nearZ;
+	}
+
+	static void MakeIdentity(float *result)
+	{
+		memset(result, 0, sizeof(float) * 16);
+		result[0] = result[5] = result[10] = result[15] = 1.0f;
+	}
+
+	Renderer::Renderer(RenderBackend *backend, const RendererSettings &settings) : _backend(backend), _windowVisible(true), _depthPrePass(settings.depthPrePass), _dynamicResolution(false), _renderWidth(backend->GetWidth()), _renderHeight(backend->GetHeight()), _buildMilliseconds(0.0), _framePacer(backend->GetFrameCount(), settings.maxFrameLatency), _frameStarted(false), _instanceFormat(settings.instanceFormat), _instanceSize(InstanceStream::GetInstanceSize(settings.instanceFormat)), _constantAllocator(ConstantAlignment), _frameConstants(0), _drawConstants(0), _workerPool((settings.workerThreads > 0) ? static_cast<int32_t>(settings.workerThreads) - 1 : -1), _commandList(nullptr), _parallelRecorder(&_workerPool), _frameCommandListCount(0), _staticBuffer(nullptr), _uploadRing(UploadRingSize), _uploadBuffer(nullptr), _uploadBufferData(nullptr), _uploadCommandList(nullptr), _copyWaitValue(0), _uploadBatchOpen(false), _bufferAllocator(BufferPageSize, BufferGranularity), _releaseCopyTicket(0), _statistics()
 	{
-		ZeroMemory(_fenceValues, sizeof(_fenceValues));
-		CreatePipeline(hwnd, useWARPDevice);
-		LoadAssets();
+		_frameCount = _framePacer.GetFrameCount();
+		_frameIndex = _backend->GetBackBufferIndex();
+
+		memset(_instanceBuffers, 0, sizeof(_instanceBuffers));
+		memset(_instanceBufferData, 0, sizeof(_instanceBufferData));
+		memset(_instanceBufferCapacity, 0, sizeof(_instanceBufferCapacity));
+		memset(_constantBuffers, 0, sizeof(_constantBuffers));
+		memset(_constantBufferData, 0, sizeof(_constantBufferData));
+		memset(_constantBufferCapacity, 0, sizeof(_constantBufferCapacity));
+
+		// The command list starting the frame and one per pass and recording thread.
+		_commandList = _backend->CreateCommandList(BackendQueue::Graphics);
+
+		for(uint32_t pass = 0; pass < RecordedPassCount; pass++)
+		{
+			for(uint32_t i = 0; i < MaxRecordingThreads; i++)
+			{
+				RecordingContext &context = _recordingContexts[pass][i];
+				context.commandList = _backend->CreateCommandList(BackendQueue::Graphics);
+				context.stateFilter.SetTarget(context.commandList);
+			}
+		}
+
+		for(uint32_t variant = 0; variant < PipelineVariantCount; variant++)
+		{
+			_staticBundles[variant] = _backend->CreateBundle();
+			_staticBundleRecorded[variant] = false;
+			_staticRecordMilliseconds[variant] = 0.0;
+		}
+
+		// Create the upload ring, it stays mapped for its whole lifetime.
+		_uploadBuffer = _backend->CreateBuffer(UploadRingSize, BufferHeap::Upload, ResourceState::GenericRead);
+		_uploadBufferData = _backend->MapBuffer(_uploadBuffer);
+
+		// Uploads are recorded for their own copy queue.
+		_uploadCommandList = _backend->CreateCommandList(BackendQueue::Copy);
+
+		TrackFramebuffers();
 	}
 
 	Renderer::~Renderer()
 	{
 		// Wait for the GPU to be done with all resources.
 		WaitForGpu();
+		_backend->WaitForValue(BackendQueue::Copy, _uploadScheduler.GetSubmittedValue());
+
+		for(uint32_t n = 0; n < MaxFrameCount; n++)
+		{
+			if(_instanceBuffers[n])
+				_backend->ReleaseResource(_instanceBuffers[n]);
+			if(_constantBuffers[n])
+				_backend->ReleaseResource(_constantBuffers[n]);
+		}
+
+		if(_staticBuffer)
+			_backend->ReleaseResource(_staticBuffer);
 
-		// Fullscreen state should always be false before exiting the app.
-		ThrowIfFailed(_swapChain->SetFullscreenState(FALSE, nullptr));
+		_oversizedUploads.ReleaseAll([this](const void *staging) { _backend->ReleaseResource(staging); });
+		_resourceReleases.ReleaseAll([this](const void *resource) { _backend->ReleaseResource(resource); });
 
-		CloseHandle(_fenceEvent);
+		for(const void *page : _bufferPages)
+			_backend->ReleaseResource(page);
+
+		_backend->ReleaseResource(_uploadBuffer);
+	}
+
+	void Renderer::WaitForNextFrame()
+	{
+		std::lock_guard<std::mutex> lock(_lock);
+
+		if(_frameStarted)
+			return;
+
+		const double start = GetTime();
+
+		// Returns once the presentation queue has fewer frames than the maximum
+		// frame latency, with a timeout so a lost present can't hang the loop.
+		_backend->WaitForPresent(1000);
+
+		// The resources of this back buffer and the latency limit.
+		_backend->WaitForValue(BackendQueue::Graphics, _framePacer.GetWaitValue(_frameIndex));
+
+		const uint64_t completedValue = _backend->GetCompletedValue(BackendQueue::Graphics);
+		const double now = GetTime();
+
+		_framePacer.Complete(completedValue, now);
+		_framePacer.BeginFrame(_frameIndex, now, (now - start) * 1000.0);
+		_frameStarted = true;
 	}
 
 	// Render the scene.
-	void Renderer::Render(const std::vector<Entity*> &entities)
+	void Renderer::Render(const RenderSnapshot &snapshot)
 	{
+		WaitForNextFrame();
+
+		std::lock_guard<std::mutex> lock(_lock);
+		const std::chrono::high_resolution_clock::time_point frameStart = std::chrono::high_resolution_clock::now();
+
+		// Copies recorded since the last frame go out now, draws using their
+		// buffers wait for them below.
+		SubmitUploads();
+		ReclaimUploads();
+
+		_statistics.releases = 0;
+		ReclaimReleases();
+
 		if(!_windowVisible)
 			return;
 
-		// Command list allocators can only be reset when the associated 
-		// command lists have finished execution on the GPU; apps should use 
-		// fences to determine GPU execution progress.
-		ThrowIfFailed(_commandAllocators[_frameIndex]->Reset());
+		_commandList->Begin();
 
-		// However, when ExecuteCommandList() is called on a particular command 
-		// list, that command list can then be reset at any time and must be before 
-		// re-recording.
-		ThrowIfFailed(_commandList->Reset(_commandAllocators[_frameIndex].Get(), NULL));
+		// Both axes are scaled alike, so the aspect ratio and the projection stay.
+		const float resolutionScale = _dynamicResolution ? _resolutionScaler.GetScale() : 1.0f;
+		_renderWidth = std::min(std::max(static_cast<uint32_t>(_backend->GetWidth() * resolutionScale + 0.5f), 1u), _backend->GetWidth());
+		_renderHeight = std::min(std::max(static_cast<uint32_t>(_backend->GetHeight() * resolutionScale + 0.5f), 1u), _backend->GetHeight());
 
-		if(_needsUpdateForWindowSizeChange)
-		{
-			CreateFramebuffers();
-		}
+		// Entities sharing mesh and material are drawn as one instanced draw, the
+		// instance buffer stays bound and batches select their range through the
+		// start instance location.
+		const VertexBufferBinding instanceBinding = WriteInstanceData(snapshot);
 
-		// Set necessary state.
-		_commandList->SetGraphicsRootSignature(_rootSignature.Get());
+		BuildRenderQueue();
+		UpdateStaticDraws(snapshot);
+		PrepareConstants(snapshot);
 
-		ID3D12DescriptorHeap* ppHeaps[] = { _cbvHeap.Get() };
-		_commandList->SetDescriptorHeaps(_countof(ppHeaps), ppHeaps);
-		_commandList->SetGraphicsRootDescriptorTable(0, _cbvHeap->GetGPUDescriptorHandleForHeapStart());
+		// Set necessary state, the first pass recorded into the list decides the targets.
+		SetFrameState(_commandList, _depthPrePass ? RecordedPassDepth : RecordedPassOpaque);
 
-		_commandList->RSSetViewports(1, &_viewport);
-		_commandList->RSSetScissorRects(1, &_scissorRect);
+		// The frame's passes and the resources they use, barriers between them come
+		// from the graph and go into whichever command list is recorded last.
+		_renderGraph.Reset();
+		_graphResources.clear();
 
-		// Indicate that the back buffer will be used as a render target.
-		_commandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(_renderTargets[_frameIndex].Get(), D3D12_RESOURCE_STATE_PRESENT, D3D12_RESOURCE_STATE_RENDER_TARGET));
+		const void *backBufferResource = _backend->GetBackBuffer(_frameIndex);
+		const void *depthBufferResource = _backend->GetDepthBuffer();
+		const RenderGraphResource backBuffer = ImportGraphResource("Back buffer", backBufferResource, ResourceState::Present);
+		const RenderGraphResource depthBuffer = ImportGraphResource("Depth buffer", depthBufferResource, ResourceState::DepthWrite);
 
-		CD3DX12_CPU_DESCRIPTOR_HANDLE rtvHandle(_rtvHeap->GetCPUDescriptorHandleForHeapStart(), _frameIndex, _rtvDescriptorSize);
-		_commandList->OMSetRenderTargets(1, &rtvHandle, FALSE, nullptr);
+		_frameCommandLists[0] = _commandList;
+		_frameCommandListCount = 1;
 
-		// Record commands.
-		const float clearColor[] = { 0.0f, 0.6f, 0.8f, 1.0f };
-		_commandList->ClearRenderTargetView(rtvHandle, clearColor, 0, nullptr);
+		const std::chrono::high_resolution_clock::time_point recordStart = std::chrono::high_resolution_clock::now();
+		_statistics.staticRecordMilliseconds = 0.0;
+		_statistics.recordMillisecondsSaved = 0.0;
 
-		for(Entity *ent : entities)
+		// Clears and static draws go into the last command list as well, after the
+		// barriers the pass needs.
+		if(_depthPrePass)
 		{
-			_commandList->SetPipelineState(ent->_model->_material->_pipelineState.Get());
-			_commandList->IASetPrimitiveTopology(ent->_model->_mesh->_topology);
-			_commandList->IASetVertexBuffers(0, 1, &(ent->_model->_mesh->_vertexBufferView));
-			if(ent->_model->_mesh->_indexBuffer)
-			{
-				_commandList->IASetIndexBuffer(&(ent->_model->_mesh->_indexBufferView));
-				_commandList->DrawIndexedInstanced(ent->_model->_mesh->_indexCount, 1, 0, 0, 0);
-			}
-			else
+			const RenderGraphPass depthPass = _renderGraph.AddPass("Depth pre-pass", [&]() {
+				RenderCommandList *commandList = _frameCommandLists[_frameCommandListCount - 1];
+
+				commandList->ClearDepthBuffer(depthBufferResource, 1.0f);
+				ExecuteStaticDraws(RecordedPassDepth, commandList);
+				RecordDraws(RecordedPassDepth, instanceBinding);
+			});
+			_renderGraph.Write(depthPass, depthBuffer, ResourceState::DepthWrite);
+		}
+
+		const RenderGraphPass opaquePass = _renderGraph.AddPass("Opaque", [&]() {
+			RenderCommandList *commandList = _frameCommandLists[_frameCommandListCount - 1];
+
+			// After a depth pre-pass the last list only has the depth buffer bound.
+			if(_depthPrePass)
+				SetFrameState(commandList, RecordedPassOpaque);
+
+			const float clearColor[] = { 0.0f, 0.6f, 0.8f, 1.0f };
+			commandList->ClearRenderTarget(backBufferResource, clearColor);
+			if(!_depthPrePass)
+				commandList->ClearDepthBuffer(depthBufferResource, 1.0f);
+
+			ExecuteStaticDraws(RecordedPassOpaque, commandList);
+			RecordDraws(RecordedPassOpaque, instanceBinding);
+		});
+		_renderGraph.Write(opaquePass, backBuffer, ResourceState::RenderTarget);
+		_renderGraph.Write(opaquePass, depthBuffer, ResourceState::DepthWrite);
+
+		_renderGraph.Compile();
+		_renderGraph.Execute([&](const RenderBarrier *barriers, size_t count) {
+			SubmitBarriers(_frameCommandLists[_frameCommandListCount - 1], barriers, count);
+		});
+
+		const ResourceStateStatistics &stateStatistics = _stateTracker.GetStatistics();
+		_statistics.barriers = stateStatistics.barriersEmitted;
+		_statistics.barrierBatches = stateStatistics.flushes;
+		_statistics.transitionsRequested = stateStatistics.transitionsRequested;
+		_statistics.transitionsEmitted = stateStatistics.transitionsEmitted;
+		_stateTracker.ResetStatistics();
+
+		_statistics.recordMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - recordStart).count();
+		_statistics.recordingThreads = static_cast<uint32_t>(_parallelRecorder.GetChunks().size());
+		_statistics.constantAllocations = _constantAllocator.GetAllocationCount();
+		_statistics.constantBytes = _constantAllocator.GetUsedSize();
+		_statistics.stateChangesIssued = 0;
+		_statistics.stateChangesSkipped = 0;
+
+		// The depth pass contexts still hold the counts of the last frame using them.
+		for(uint32_t pass = 0; pass < RecordedPassCount; pass++)
+		{
+			if(pass == RecordedPassDepth && !_depthPrePass)
+				continue;
+
+			for(uint32_t i = 0; i < _statistics.recordingThreads; i++)
 			{
-				_commandList->DrawInstanced(ent->_model->_mesh->_vertexCount, 1, 0, 0);
+				const CommandEncoderStatistics &encoderStatistics = _recordingContexts[pass][i].stateFilter.GetStatistics();
+				_statistics.stateChangesIssued += encoderStatistics.stateChangesIssued;
+				_statistics.stateChangesSkipped += encoderStatistics.stateChangesSkipped;
 			}
 		}
 
-		// Indicate that the back buffer will now be used to present.
-		_commandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(_renderTargets[_frameIndex].Get(), D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_PRESENT));
-
-		ThrowIfFailed(_commandList->Close());
+		const InstanceBatchStatistics &batchStatistics = _instanceBatcher.GetStatistics();
+		_statistics.drawCalls = batchStatistics.batches;
+		_statistics.staticDraws = static_cast<uint32_t>(_staticQueue.GetCount());
+		_statistics.instances = batchStatistics.items;
+		_statistics.drawsSaved = batchStatistics.drawsSaved;
+
+		// The stream is only written for frames with instances.
+		const InstanceStreamStatistics streamStatistics = (batchStatistics.items > 0) ? _instanceStream.GetStatistics() : InstanceStreamStatistics();
+		_statistics.instanceWriteJobs = streamStatistics.jobs;
+		_statistics.instanceBytes = streamStatistics.bytesWritten;
+		_statistics.instanceWriteMilliseconds = streamStatistics.writeMilliseconds;
+		_statistics.instanceGigabytesPerSecond = streamStatistics.gigabytesPerSecond;
+
+		for(uint32_t i = 0; i < _frameCommandListCount; i++)
+			_frameCommandLists[i]->Close();
+
+		// Only wait for the copy queue if the frame uses buffers that may not have
+		// arrived yet.
+		_statistics.copyWaits = 0;
+		if(_copyWaitValue > 0)
+		{
+			_backend->Wait(BackendQueue::Graphics, BackendQueue::Copy, _copyWaitValue);
+			_statistics.copyWaits++;
+		}
 
-		// Execute the command list.
-		ID3D12CommandList* ppCommandLists[] = { _commandList.Get() };
-		_commandQueue->ExecuteCommandLists(_countof(ppCommandLists), ppCommandLists);
+		_buildMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - frameStart).count();
 
-		// Present the frame.
-		ThrowIfFailed(_swapChain->Present(0, 0));
+		// Execute the command lists in pass and chunk order.
+		_backend->ExecuteCommandLists(BackendQueue::Graphics, _frameCommandLists, _frameCommandListCount);
+		_backend->SetSourceSize(_renderWidth, _renderHeight);
+		_backend->Present();
 
 		MoveToNextFrame();
 	}
 
-	void Renderer::SetWindowSize(int width, int height, bool minimized)
+	VertexBufferBinding Renderer::WriteInstanceData(const RenderSnapshot &snapshot)
 	{
-		// Determine if the swap buffers and other resources need to be resized or not.
-		if((width != _windowWidth || height != _windowHeight) && !minimized)
+		_instanceBatcher.Build(snapshot.items.data(), snapshot.items.size(), snapshot.cameraPosition, MaxSortDistance);
+
+		const std::vector<uint32_t> &order = _instanceBatcher.GetInstanceOrder();
+		const uint32_t instanceCount = static_cast<uint32_t>(order.size());
+
+		VertexBufferBinding binding = {};
+		if(instanceCount == 0)
+			return binding;
+
+		// The buffer of this frame index is no longer in use by the GPU once we get
+		// here, so it can be replaced if it is too small.
+		if(instanceCount > _instanceBufferCapacity[_frameIndex])
 		{
-			_windowWidth = width;
-			_windowHeight = height;
+			const uint32_t capacity = std::max(instanceCount, std::max(_instanceBufferCapacity[_frameIndex] * 2, 1024u));
 
-			// Flush all current GPU commands.
-			WaitForGpu();
+			if(_instanceBuffers[_frameIndex])
+				_backend->ReleaseResource(_instanceBuffers[_frameIndex]);
 
-			// Release the resources holding references to the swap chain (requirement of
-			// IDXGISwapChain::ResizeBuffers) and reset the frame fence values to the
-			// current fence value.
-			for(UINT n = 0; n < FrameCount; n++)
-			{
-				_renderTargets[n].Reset();
-				_fenceValues[n] = _fenceValues[_frameIndex];
-			}
+			// Keep it mapped for its whole lifetime, we never read from it on the CPU.
+			_instanceBuffers[_frameIndex] = _backend->CreateBuffer(static_cast<uint64_t>(capacity) * _instanceSize, BufferHeap::Upload, ResourceState::GenericRead);
+			_instanceBufferData[_frameIndex] = _backend->MapBuffer(_instanceBuffers[_frameIndex]);
+			_instanceBufferCapacity[_frameIndex] = capacity;
+		}
 
-			// Resize the swap chain to the desired dimensions.
-			DXGI_SWAP_CHAIN_DESC desc = {};
-			_swapChain->GetDesc(&desc);
-			ThrowIfFailed(_swapChain->ResizeBuffers(FrameCount, width, height, desc.BufferDesc.Format, desc.Flags));
+		// Upload heaps are write combined, the stream writes them sequentially
+		// from the worker pool with non-temporal stores.
+		_instanceStream.Write(&_workerPool, _instanceFormat, _instanceBufferData[_frameIndex], snapshot.items.data(), order.data(), instanceCount);
 
-			// Reset the frame index to the current back buffer index.
-			_frameIndex = _swapChain->GetCurrentBackBufferIndex();
+		binding.location = _backend->GetBufferAddress(_instanceBuffers[_frameIndex]);
+		binding.size = instanceCount * _instanceSize;
+		binding.stride = _instanceSize;
 
-			_needsUpdateForWindowSizeChange = true;
+		return binding;
+	}
+
+	void Renderer::BuildRenderQueue()
+	{
+		std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+
+		_renderQueue.Reset();
+
+		const uint64_t completedCopyValue = _backend->GetCompletedValue(BackendQueue::Copy);
+		_copyWaitValue = 0;
+
+		for(const InstanceBatch &batch : _instanceBatcher.GetBatches())
+		{
+			// Meshes used for the first time may still be on their way.
+			_copyWaitValue = std::max(_copyWaitValue, _uploadScheduler.RequireForGraphics(batch.mesh->_uploadTicket, completedCopyValue));
+
+			// Batches are keyed by their nearest instance, the instances within them
+			// are already sorted front to back.
+			const DrawPacket packet = { batch.mesh, batch.material, batch.firstInstance, batch.instanceCount };
+			const uint64_t key = RenderQueue::MakeKey(RenderPass::Opaque, batch.material->_pipelineID, batch.material->_sortID, batch.mesh->_sortID, batch.depth);
+
+			_renderQueue.Push(key, packet);
 		}
 
-		_windowVisible = !minimized;
+		_renderQueue.Sort(&_workerPool);
+
+		_statistics.sortMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
 	}
 
-	void Renderer::ToggleFullscreen()
+	void Renderer::PrepareConstants(const RenderSnapshot &snapshot)
 	{
-		BOOL fullscreenState;
-		ThrowIfFailed(_swapChain->GetFullscreenState(&fullscreenState, nullptr));
-		if(FAILED(_swapChain->SetFullscreenState(!fullscreenState, nullptr)))
+		// Room for the frame and the draw constants.
+		const uint64_t requiredSize = _constantAllocator.GetAlignedSize(sizeof(FrameConstants)) + _constantAllocator.GetAlignedSize(sizeof(DrawConstants));
+
+		// The buffer of this frame index is no longer in use by the GPU once we get
+		// here, so it can be replaced if it is too small.
+		if(requiredSize > _constantBufferCapacity[_frameIndex])
 		{
-			// Transitions to fullscreen mode can fail when running apps over
-			// terminal services or for some other unexpected reason.  Consider
-			// notifying the user in some way when this happens.
-			OutputDebugString(L"Fullscreen transition failed");
-			assert(false);
+			const uint64_t capacity = std::max(requiredSize, std::max<uint64_t>(_constantBufferCapacity[_frameIndex] * 2, 64 * 1024));
+
+			if(_constantBuffers[_frameIndex])
+				_backend->ReleaseResource(_constantBuffers[_frameIndex]);
+
+			_constantBuffers[_frameIndex] = _backend->CreateBuffer(capacity, BufferHeap::Upload, ResourceState::GenericRead);
+			_constantBufferData[_frameIndex] = _backend->MapBuffer(_constantBuffers[_frameIndex]);
+			_constantBufferCapacity[_frameIndex] = capacity;
 		}
+
+		_constantAllocator.Reset(_constantBufferCapacity[_frameIndex]);
+
+		// The view matrix is stored the way DirectXMath expects for row vectors.
+		const float width = static_cast<float>(_backend->GetWidth());
+		const float height = static_cast<float>(_backend->GetHeight());
+		const float aspect = (height > 0.0f) ? width / height : 1.0f;
+
+		float projection[16];
+		MakePerspective(60.0f * 3.14159265f / 180.0f, aspect, 0.1f, MaxSortDistance, projection);
+
+		FrameConstants frameConstants;
+		MultiplyMatrices(snapshot.viewMatrix, projection, frameConstants.viewProjection);
+
+		_frameConstants = AllocateConstants(&frameConstants, sizeof(frameConstants));
+
+		// Batches carry their instances' transforms, the draw transform applies on
+		// top of all of them and is the same for every dynamic draw.
+		DrawConstants drawConstants;
+		MakeIdentity(drawConstants.model);
+
+		_drawConstants = AllocateConstants(&drawConstants, sizeof(drawConstants));
 	}
 
-	Microsoft::WRL::ComPtr<ID3D12PipelineState> Renderer::GetPSOForDescription(D3D12_GRAPHICS_PIPELINE_STATE_DESC *desc)
+	// Safe to call from the recording threads.
+	uint64_t Renderer::AllocateConstants(const void *data, uint32_t size)
 	{
-		desc->pRootSignature = _rootSignature.Get();
-		Microsoft::WRL::ComPtr<ID3D12PipelineState> pso;
-		ThrowIfFailed(_device->CreateGraphicsPipelineState(desc, IID_PPV_ARGS(&pso)));
-		return pso;
+		const uint64_t offset = _constantAllocator.Allocate(size);
+		if(offset == LinearAllocator::InvalidOffset)
+			throw std::runtime_error("Constant buffer of the frame is full");
+
+		memcpy(_constantBufferData[_frameIndex] + offset, data, size);
+		return _backend->GetBufferAddress(_constantBuffers[_frameIndex]) + offset;
 	}
 
-	Microsoft::WRL::ComPtr<ID3D12Resource> Renderer::UploadVertexData(void *data, long dataSize)
+	// The graph starts out from whatever state the tracker knows the resource in.
+	RenderGraphResource Renderer::ImportGraphResource(const char *name, const void *resource, uint32_t finalState)
 	{
-		WaitForGpu();
+		const RenderGraphResource handle = _renderGraph.ImportResource(name, _stateTracker.GetState(resource), finalState);
+		_graphResources.resize(handle + 1, nullptr);
+		_graphResources[handle] = resource;
+		return handle;
+	}
 
-		// Command list allocators can only be reset when the associated 
-		// command lists have finished execution on the GPU; apps should use 
-		// fences to determine GPU execution progress.
-		ThrowIfFailed(_commandAllocators[_frameIndex]->Reset());
-
-		// However, when ExecuteCommandList() is called on a particular command 
-		// list, that command list can then be reset at any time and must be before 
-		// re-recording.
-		ThrowIfFailed(_commandList->Reset(_commandAllocators[_frameIndex].Get(), NULL));
-
-		Microsoft::WRL::ComPtr<ID3D12Resource> vertexBuffer;
-		Microsoft::WRL::ComPtr<ID3D12Resource> vertexBufferUpload;
-
-		ThrowIfFailed(_device->CreateCommittedResource(
-			&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
-			D3D12_HEAP_FLAG_NONE,
-			&CD3DX12_RESOURCE_DESC::Buffer(dataSize),
-			D3D12_RESOURCE_STATE_COPY_DEST,
-			nullptr,
-			IID_PPV_ARGS(&vertexBuffer)));
-
-		ThrowIfFailed(_device->CreateCommittedResource(
-			&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
-			D3D12_HEAP_FLAG_NONE,
-			&CD3DX12_RESOURCE_DESC::Buffer(dataSize),
-			D3D12_RESOURCE_STATE_GENERIC_READ,
-			nullptr,
-			IID_PPV_ARGS(&vertexBufferUpload)));
-
-		// Copy data to the intermediate upload heap and then schedule a copy 
-		// from the upload heap to the vertex buffer.
-		UINT8* pVertexDataBegin;
-		ThrowIfFailed(vertexBufferUpload->Map(0, &CD3DX12_RANGE(0, dataSize), reinterpret_cast<void**>(&pVertexDataBegin)));
-		memcpy(pVertexDataBegin, data, dataSize);
-		vertexBufferUpload->Unmap(0, nullptr);
-
-		_commandList->CopyBufferRegion(vertexBuffer.Get(), 0, vertexBufferUpload.Get(), 0, dataSize);
-		_commandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(vertexBuffer.Get(), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER));
-
-		// Close the command list and execute it to begin the vertex buffer copy into
-		// the default heap.
-		ThrowIfFailed(_commandList->Close());
-		ID3D12CommandList* ppCommandLists[] = { _commandList.Get() };
-		_commandQueue->ExecuteCommandLists(_countof(ppCommandLists), ppCommandLists);
+	// One batch of the render graph, the tracker drops what is redundant with
+	// the states it knows and the rest goes out in a single ResourceBarrier call.
+	void Renderer::SubmitBarriers(RenderCommandList *commandList, const RenderBarrier *barriers, size_t count)
+	{
+		for(size_t i = 0; i < count; i++)
+		{
+			const RenderBarrier &barrier = barriers[i];
+			const void *resource = _graphResources[barrier.resource];
 
-		WaitForGpu();
+			switch(barrier.type)
+			{
+				case RenderBarrierType::Transition:
+					_stateTracker.Transition(resource, barrier.stateAfter);
+					break;
+				case RenderBarrierType::Aliasing:
+					_stateTracker.Aliasing((barrier.aliasBefore != RenderGraph::InvalidIndex) ? _graphResources[barrier.aliasBefore] : nullptr, resource);
+					break;
+				case RenderBarrierType::UnorderedAccess:
+					_stateTracker.UnorderedAccess(resource);
+					break;
+			}
+		}
 
-		return vertexBuffer;
+		FlushBarriers(commandList, _stateTracker);
 	}
 
-	Microsoft::WRL::ComPtr<ID3D12Resource> Renderer::UploadIndexData(void *data, long dataSize)
+	void Renderer::FlushBarriers(RenderCommandList *commandList, ResourceStateTracker &tracker)
 	{
-		WaitForGpu();
+		tracker.Flush([&](const ResourceStateBarrier *barriers, size_t count) {
+			commandList->ResourceBarrier(barriers, count);
+		});
+	}
 
-		// Command list allocators can only be reset when the associated 
-		// command lists have finished execution on the GPU; apps should use 
-		// fences to determine GPU execution progress.
-		ThrowIfFailed(_commandAllocators[_frameIndex]->Reset());
-
-		// However, when ExecuteCommandList() is called on a particular command 
-		// list, that command list can then be reset at any time and must be before 
-		// re-recording.
-		ThrowIfFailed(_commandList->Reset(_commandAllocators[_frameIndex].Get(), NULL));
-
-		Microsoft::WRL::ComPtr<ID3D12Resource> indexBuffer;
-		Microsoft::WRL::ComPtr<ID3D12Resource> indexBufferUpload;
-
-		ThrowIfFailed(_device->CreateCommittedResource(
-			&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
-			D3D12_HEAP_FLAG_NONE,
-			&CD3DX12_RESOURCE_DESC::Buffer(dataSize),
-			D3D12_RESOURCE_STATE_COPY_DEST,
-			nullptr,
-			IID_PPV_ARGS(&indexBuffer)));
-
-		ThrowIfFailed(_device->CreateCommittedResource(
-			&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
-			D3D12_HEAP_FLAG_NONE,
-			&CD3DX12_RESOURCE_DESC::Buffer(dataSize),
-			D3D12_RESOURCE_STATE_GENERIC_READ,
-			nullptr,
-			IID_PPV_ARGS(&indexBufferUpload)));
-
-		// Copy data to the intermediate upload heap and then schedule a copy 
-		// from the upload heap to the vertex buffer.
-		UINT8* pIndexDataBegin;
-		ThrowIfFailed(indexBufferUpload->Map(0, &CD3DX12_RANGE(0, dataSize), reinterpret_cast<void**>(&pIndexDataBegin)));
-		memcpy(pIndexDataBegin, data, dataSize);
-		indexBufferUpload->Unmap(0, nullptr);
-
-		_commandList->CopyBufferRegion(indexBuffer.Get(), 0, indexBufferUpload.Get(), 0, dataSize);
-		_commandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(indexBuffer.Get(), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_INDEX_BUFFER));
-
-		// Close the command list and execute it to begin the vertex buffer copy into
-		// the default heap.
-		ThrowIfFailed(_commandList->Close());
-		ID3D12CommandList* ppCommandLists[] = { _commandList.Get() };
-		_commandQueue->ExecuteCommandLists(_countof(ppCommandLists), ppCommandLists);
+	// The depth pass doesn't bind the back buffer, it is only a render target
+	// once the opaque pass transitioned it.
+	void Renderer::SetFrameState(RenderCommandList *commandList, uint32_t pass)
+	{
+		const void *target = (pass == RecordedPassDepth) ? nullptr : _backend->GetBackBuffer(_frameIndex);
+		commandList->SetRenderTarget(target, _backend->GetDepthBuffer(), _renderWidth, _renderHeight);
+		commandList->SetConstantBuffer(ConstantSlotFrame, _frameConstants);
+	}
 
-		WaitForGpu();
+	// The sorted draws are split into chunks recorded in parallel, each into its
+	// own command list following the last one of the frame so far.
+	void Renderer::RecordDraws(uint32_t pass, const VertexBufferBinding &instanceBinding)
+	{
+		_parallelRecorder.Record(_renderQueue.GetCount(), MaxRecordingThreads, [&](uint32_t chunk, size_t begin, size_t end) {
+			RecordDrawChunk(pass, chunk, begin, end, instanceBinding);
+		});
 
-		return indexBuffer;
+		const uint32_t chunkCount = static_cast<uint32_t>(_parallelRecorder.GetChunks().size());
+		for(uint32_t i = 0; i < chunkCount; i++)
+			_frameCommandLists[_frameCommandListCount++] = _recordingContexts[pass][i].commandList;
 	}
 
-/*	Renderer::CreateConstantBufferView()
+	// Runs on the worker pool, only touches the context of its own chunk.
+	void Renderer::RecordDrawChunk(uint32_t pass, uint32_t chunk, size_t begin, size_t end, const VertexBufferBinding &instanceBinding)
 	{
-		ComPtr<ID3D12Resource> constantBuffer;
-	ConstantBuffer m_constantBufferData;
-	UINT8* m_pCbvDataBegin;
+		RecordingContext &context = _recordingContexts[pass][chunk];
+		const uint32_t variant = GetPipelineVariant(pass);
 
-		// Create the constant buffer.
-		{
-			ThrowIfFailed(m_device->CreateCommittedResource(
-			&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
-				D3D12_HEAP_FLAG_NONE,
-				&CD3DX12_RESOURCE_DESC::Buffer(1024 * 64),
-				D3D12_RESOURCE_STATE_GENERIC_READ,
-				nullptr,
-				IID_PPV_ARGS(&constantBuffer)));
-
-			 // Describe and create a constant buffer view.
-			 D3D12_CONSTANT_BUFFER_VIEW_DESC cbvDesc = {};
-			 cbvDesc.BufferLocation = constantBuffer->GetGPUVirtualAddress();
-			 cbvDesc.SizeInBytes = (sizeof(ConstantBuffer) + 255) & ~255;	// CB size is required to be 256-byte aligned.
-			 m_device->CreateConstantBufferView(&cbvDesc, m_cbvHeap->GetCPUDescriptorHandleForHeapStart());
-
-			 // Initialize and map the constant buffers. We don't unmap this until the
-			 // app closes. Keeping things mapped for the lifetime of the resource is okay.
-			 ZeroMemory(&m_constantBufferData, sizeof(m_constantBufferData));
-			 ThrowIfFailed(constantBuffer->Map(0, nullptr, reinterpret_cast<void**>(&m_pCbvDataBegin)));
-			 memcpy(m_pCbvDataBegin, &m_constantBufferData, sizeof(m_constantBufferData));
-		}
-	}*/
+		// Command lists don't inherit any state from the ones before them.
+		context.commandList->Begin();
+		SetFrameState(context.commandList, pass);
 
-	void Renderer::CreateFramebuffers()
-	{
-		_viewport.Width = static_cast<float>(_windowWidth);
-		_viewport.Height = static_cast<float>(_windowHeight);
-		_viewport.MaxDepth = 1.0f;
+		context.stateFilter.Reset();
 
-		_scissorRect.right = static_cast<LONG>(_windowWidth);
-		_scissorRect.bottom = static_cast<LONG>(_windowHeight);
+		StateFilter &stateFilter = context.stateFilter;
 
-		CD3DX12_CPU_DESCRIPTOR_HANDLE rtvHandle(_rtvHeap->GetCPUDescriptorHandleForHeapStart());
+		if(instanceBinding.size > 0)
+			stateFilter.SetVertexBuffer(1, instanceBinding);
 
-		// Create a RTV for each frame.
-		for(UINT n = 0; n < FrameCount; n++)
-		{
-			ThrowIfFailed(_swapChain->GetBuffer(n, IID_PPV_ARGS(&_renderTargets[n])));
-			_device->CreateRenderTargetView(_renderTargets[n].Get(), nullptr, rtvHandle);
-			rtvHandle.Offset(1, _rtvDescriptorSize);
-		}
+		stateFilter.SetConstantBuffer(ConstantSlotDraw, _drawConstants);
 
-		_needsUpdateForWindowSizeChange = false;
+		for(size_t i = begin; i < end; i++)
+			RecordPacket(stateFilter, _renderQueue.GetSortedPacket(i), variant);
 	}
 
-	void Renderer::CreatePipeline(HWND hwnd, bool useWARPDevice)
+	// With a depth pre-pass the opaque pass only shades what ends up visible.
+	uint32_t Renderer::GetPipelineVariant(uint32_t pass) const
 	{
-		using namespace Microsoft::WRL;
+		if(pass == RecordedPassDepth)
+			return PipelineVariantDepthOnly;
+
+		return _depthPrePass ? PipelineVariantShaded : PipelineVariantDefault;
+	}
 
-#ifdef _DEBUG
-		// Enable the D3D12 debug layer.
+	void Renderer::RecordPacket(StateFilter &stateFilter, const DrawPacket &packet, uint32_t variant)
+	{
+		switch(variant)
 		{
-			ComPtr<ID3D12Debug> debugController;
-			if(SUCCEEDED(D3D12GetDebugInterface(IID_PPV_ARGS(&debugController))))
-			{
-				debugController->EnableDebugLayer();
-			}
+			case PipelineVariantDepthOnly:
+				stateFilter.SetPipelineState(packet.material->_depthOnlyPipelineState);
+				break;
+			case PipelineVariantShaded:
+				stateFilter.SetPipelineState(packet.material->_depthReadOnlyPipelineState);
+				break;
+			default:
+				stateFilter.SetPipelineState(packet.material->_pipelineState);
+				break;
 		}
-#endif
 
-		ComPtr<IDXGIFactory4> factory;
-		ThrowIfFailed(CreateDXGIFactory1(IID_PPV_ARGS(&factory)));
-
-		if(useWARPDevice)
+		stateFilter.SetPrimitiveTopology(packet.mesh->_topology);
+		stateFilter.SetVertexBuffer(0, packet.mesh->_vertexBinding);
+		if(packet.mesh->_indexCount > 0)
 		{
-			ComPtr<IDXGIAdapter> warpAdapter;
-			ThrowIfFailed(factory->EnumWarpAdapter(IID_PPV_ARGS(&warpAdapter)));
-
-			ThrowIfFailed(D3D12CreateDevice(
-				warpAdapter.Get(),
-				D3D_FEATURE_LEVEL_11_0,
-				IID_PPV_ARGS(&_device)
-				));
+			stateFilter.SetIndexBuffer(packet.mesh->_indexBinding);
+			stateFilter.DrawIndexedInstanced(packet.mesh->_indexCount, packet.instanceCount, 0, 0, packet.firstInstance);
 		}
 		else
 		{
-			ComPtr<IDXGIAdapter1> hardwareAdapter;
-			GetHardwareAdapter(factory.Get(), &hardwareAdapter);
-
-			ThrowIfFailed(D3D12CreateDevice(
-				hardwareAdapter.Get(),
-				D3D_FEATURE_LEVEL_11_0,
-				IID_PPV_ARGS(&_device)
-				));
+			stateFilter.DrawInstanced(packet.mesh->_vertexCount, packet.instanceCount, 0, packet.firstInstance);
 		}
+	}
 
-		// Describe and create the command queue.
-		D3D12_COMMAND_QUEUE_DESC queueDesc = {};
-		queueDesc.Flags = D3D12_COMMAND_QUEUE_FLAG_NONE;
-		queueDesc.Type = D3D12_COMMAND_LIST_TYPE_DIRECT;
-
-		ThrowIfFailed(_device->CreateCommandQueue(&queueDesc, IID_PPV_ARGS(&_commandQueue)));
-
-		RECT windowRect;
-		GetClientRect(hwnd, &windowRect);
-		_windowWidth = windowRect.right - windowRect.left;
-		_windowHeight = windowRect.bottom - windowRect.top;
-
-		// Describe and create the swap chain.
-		DXGI_SWAP_CHAIN_DESC swapChainDesc = {};
-		swapChainDesc.BufferCount = FrameCount;
-		swapChainDesc.BufferDesc.Width = _windowWidth;
-		swapChainDesc.BufferDesc.Height = _windowHeight;
-		swapChainDesc.BufferDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
-		swapChainDesc.BufferUsage = DXGI_USAGE_RENDER_TARGET_OUTPUT;
-		swapChainDesc.SwapEffect = DXGI_SWAP_EFFECT_FLIP_DISCARD;
-		swapChainDesc.OutputWindow = hwnd;
-		swapChainDesc.SampleDesc.Count = 1;
-		swapChainDesc.Windowed = TRUE;
-
-		ComPtr<IDXGISwapChain> swapChain;
-		ThrowIfFailed(factory->CreateSwapChain(
-			_commandQueue.Get(),		// Swap chain needs the queue so that it can force a flush on it.
-			&swapChainDesc,
-			&swapChain
-			));
-
-		ThrowIfFailed(swapChain.As(&_swapChain));
-
-		_frameIndex = _swapChain->GetCurrentBackBufferIndex();
-
-		// Create descriptor heaps.
+	// The static items get their own instance buffer, which starts with the
+	// draw constants all of their draws share, so the bundles recording them
+	// reference nothing that changes from frame to frame.
+	void Renderer::UpdateStaticDraws(const RenderSnapshot &snapshot)
+	{
+		if(snapshot.staticItems != _staticItems)
 		{
-			// Describe and create a render target view (RTV) descriptor heap.
-			D3D12_DESCRIPTOR_HEAP_DESC rtvHeapDesc = {};
-			rtvHeapDesc.NumDescriptors = FrameCount;
-			rtvHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_RTV;
-			rtvHeapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_NONE;
-			ThrowIfFailed(_device->CreateDescriptorHeap(&rtvHeapDesc, IID_PPV_ARGS(&_rtvHeap)));
-
-			_rtvDescriptorSize = _device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_RTV);
-
-			// Describe and create a constant buffer view (CBV) descriptor heap.
-			// Flags indicate that this descriptor heap can be bound to the pipeline 
-			// and that descriptors contained in it can be referenced by a root table.
-			D3D12_DESCRIPTOR_HEAP_DESC cbvHeapDesc = {};
-			cbvHeapDesc.NumDescriptors = 1;
-			cbvHeapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
-			cbvHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
-			ThrowIfFailed(_device->CreateDescriptorHeap(&cbvHeapDesc, IID_PPV_ARGS(&_cbvHeap)));
-		}
+			// Frames in flight may still execute the bundles and read the buffer, it
+			// is released once they completed. The bundles keep their commands alive
+			// as long, see InvalidateStaticBundles.
+			if(_staticBuffer)
+			{
+				_resourceReleases.Push(_staticBuffer, GetReleaseFenceValue());
+				_staticBuffer = nullptr;
+			}
 
-		// Create a command allocator for each frame.
-		for(UINT n = 0; n < FrameCount; n++)
-		{
-			ThrowIfFailed(_device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT, IID_PPV_ARGS(&_commandAllocators[n])));
+			_staticItems = snapshot.staticItems;
+			_staticQueue.Reset();
+			InvalidateStaticBundles();
+
+			const size_t count = _staticItems ? _staticItems->size() : 0;
+			if(count > 0)
+			{
+				_staticBatcher.Build(_staticItems->data(), count);
+
+				_staticBuffer = _backend->CreateBuffer(ConstantAlignment + count * _instanceSize, BufferHeap::Upload, ResourceState::GenericRead);
+				uint8_t *data = _backend->MapBuffer(_staticBuffer);
+
+				DrawConstants drawConstants;
+				MakeIdentity(drawConstants.model);
+				memcpy(data, &drawConstants, sizeof(drawConstants));
+
+				const std::vector<uint32_t> &order = _staticBatcher.GetInstanceOrder();
+				InstanceStream::WriteRange(_instanceFormat, data + ConstantAlignment, _staticItems->data(), order.data(), static_cast<uint32_t>(order.size()));
+
+				for(const InstanceBatch &batch : _staticBatcher.GetBatches())
+				{
+					const DrawPacket packet = { batch.mesh, batch.material, batch.firstInstance, batch.instanceCount };
+					_staticQueue.Push(RenderQueue::MakeKey(RenderPass::Opaque, batch.material->_pipelineID, batch.material->_sortID, batch.mesh->_sortID, 0.0f), packet);
+				}
+
+				_staticQueue.Sort(&_workerPool);
+			}
 		}
+
+		// Their meshes may not have arrived yet either.
+		const uint64_t completedCopyValue = _backend->GetCompletedValue(BackendQueue::Copy);
+		for(size_t i = 0; i < _staticQueue.GetCount(); i++)
+			_copyWaitValue = std::max(_copyWaitValue, _uploadScheduler.RequireForGraphics(_staticQueue.GetSortedPacket(i).mesh->_uploadTicket, completedCopyValue));
 	}
 
-	// Load the sample assets.
-	void Renderer::LoadAssets()
+	// Static draws come first in their pass, the command list has the frame
+	// state set, which the bundle inherits.
+	void Renderer::ExecuteStaticDraws(uint32_t pass, RenderCommandList *commandList)
 	{
-		// Create an empty root signature.
-		{
-			using namespace Microsoft::WRL;
+		if(_staticQueue.GetCount() == 0)
+			return;
 
-			CD3DX12_DESCRIPTOR_RANGE ranges[1];
-			CD3DX12_ROOT_PARAMETER rootParameters[1];
+		const uint32_t variant = GetPipelineVariant(pass);
 
-			ranges[0].Init(D3D12_DESCRIPTOR_RANGE_TYPE_CBV, 1, 0);
-			rootParameters[0].InitAsDescriptorTable(1, &ranges[0], D3D12_SHADER_VISIBILITY_VERTEX);
+		if(_staticBundleRecorded[variant])
+			_statistics.recordMillisecondsSaved += _staticRecordMilliseconds[variant];
+		else
+			RecordStaticBundle(variant);
 
-			CD3DX12_ROOT_SIGNATURE_DESC rootSignatureDesc;
-			rootSignatureDesc.Init(_countof(rootParameters), rootParameters, 0, nullptr, D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT);
+		commandList->ExecuteBundle(_staticBundles[variant]);
+	}
 
-			ComPtr<ID3DBlob> signature;
-			ComPtr<ID3DBlob> error;
-			ThrowIfFailed(D3D12SerializeRootSignature(&rootSignatureDesc, D3D_ROOT_SIGNATURE_VERSION_1, &signature, &error));
-			ThrowIfFailed(_device->CreateRootSignature(0, signature->GetBufferPointer(), signature->GetBufferSize(), IID_PPV_ARGS(&_rootSignature)));
-		}
+	void Renderer::RecordStaticBundle(uint32_t variant)
+	{
+		std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+
+		RenderCommandList *bundle = _staticBundles[variant];
+		bundle->Begin();
+
+		StateFilter stateFilter(bundle);
 
-		// Create the command list.
-		ThrowIfFailed(_device->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_DIRECT, _commandAllocators[_frameIndex].Get(), nullptr, IID_PPV_ARGS(&_commandList)));
+		const uint64_t address = _backend->GetBufferAddress(_staticBuffer);
+		const VertexBufferBinding instanceBinding = { address + ConstantAlignment, static_cast<uint32_t>(_staticItems->size() * _instanceSize), _instanceSize };
 
-		CreateFramebuffers();
+		stateFilter.SetConstantBuffer(ConstantSlotDraw, address);
+		stateFilter.SetVertexBuffer(1, instanceBinding);
 
-		// Close the command list and execute it to begin the vertex buffer copy into
-		// the default heap.
-		ThrowIfFailed(_commandList->Close());
-		ID3D12CommandList* ppCommandLists[] = { _commandList.Get() };
-		_commandQueue->ExecuteCommandLists(_countof(ppCommandLists), ppCommandLists);
+		for(size_t i = 0; i < _staticQueue.GetCount(); i++)
+			RecordPacket(stateFilter, _staticQueue.GetSortedPacket(i), variant);
 
-		// Create synchronization objects and wait until assets have been uploaded to the GPU.
+		bundle->Close();
+
+		_staticRecordMilliseconds[variant] = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+		_staticBundleRecorded[variant] = true;
+
+		_statistics.staticRecordMilliseconds += _staticRecordMilliseconds[variant];
+	}
+
+	// Frames in flight may still execute the bundles, the memory of what they
+	// recorded is only reused once those frames completed.
+	void Renderer::InvalidateStaticBundles()
+	{
+		for(uint32_t variant = 0; variant < PipelineVariantCount; variant++)
 		{
-			ThrowIfFailed(_device->CreateFence(_fenceValues[_frameIndex], D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&_fence)));
-			_fenceValues[_frameIndex]++;
+			if(_staticBundleRecorded[variant])
+				_staticBundles[variant]->Retire(GetReleaseFenceValue());
 
-			// Create an event handle to use for frame synchronization.
-			_fenceEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
-			if(_fenceEvent == nullptr)
-			{
-				ThrowIfFailed(HRESULT_FROM_WIN32(GetLastError()));
-			}
+			_staticBundleRecorded[variant] = false;
+		}
+	}
 
-			// Wait for the command list to execute; we are reusing the same command 
-			// list in our main loop but for now, we just want to wait for setup to 
-			// complete before continuing.
+	void Renderer::SetWindowSize(int width, int height, bool minimized)
+	{
+		std::lock_guard<std::mutex> lock(_lock);
+
+		// Determine if the swap buffers and other resources need to be resized or not.
+		if((static_cast<uint32_t>(width) != _backend->GetWidth() || static_cast<uint32_t>(height) != _backend->GetHeight()) && !minimized)
+		{
+			// Flush all current GPU commands, the frame buffers get recreated.
 			WaitForGpu();
+
+			UntrackFramebuffers();
+			_backend->Resize(width, height);
+			TrackFramebuffers();
+
+			// Reset the frame index to the current back buffer index.
+			_frameIndex = _backend->GetBackBufferIndex();
 		}
+
+		_windowVisible = !minimized;
 	}
 
-	// Wait for pending GPU work to complete.
-	void Renderer::WaitForGpu()
+	void Renderer::ToggleFullscreen()
+	{
+		_backend->ToggleFullscreen();
+	}
+
+	void Renderer::SetDepthPrePass(bool enabled)
 	{
-		// Schedule a Signal command in the queue.
-		ThrowIfFailed(_commandQueue->Signal(_fence.Get(), _fenceValues[_frameIndex]));
+		std::lock_guard<std::mutex> lock(_lock);
+		_depthPrePass = enabled;
+	}
 
-		// Wait until the fence has been processed.
-		ThrowIfFailed(_fence->SetEventOnCompletion(_fenceValues[_frameIndex], _fenceEvent));
-		WaitForSingleObjectEx(_fenceEvent, INFINITE, FALSE);
+	void Renderer::SetDynamicResolution(bool enabled, const ResolutionScalerSettings &settings)
+	{
+		std::lock_guard<std::mutex> lock(_lock);
 
-		// Increment the fence value for the current frame.
-		_fenceValues[_frameIndex]++;
+		_dynamicResolution = enabled;
+		_resolutionScaler.SetSettings(settings);
 	}
 
-	// Prepare to render the next frame.
-	void Renderer::MoveToNextFrame()
+	void Renderer::TrackFramebuffers()
 	{
-		// Schedule a Signal command in the queue.
-		const UINT64 currentFenceValue = _fenceValues[_frameIndex];
-		ThrowIfFailed(_commandQueue->Signal(_fence.Get(), currentFenceValue));
+		for(uint32_t n = 0; n < _frameCount; n++)
+			_stateTracker.Track(_backend->GetBackBuffer(n), ResourceState::Present);
 
-		// Update the frame index.
-		_frameIndex = _swapChain->GetCurrentBackBufferIndex();
+		_stateTracker.Track(_backend->GetDepthBuffer(), ResourceState::DepthWrite);
+	}
+
+	void Renderer::UntrackFramebuffers()
+	{
+		for(uint32_t n = 0; n < _frameCount; n++)
+			_stateTracker.Untrack(_backend->GetBackBuffer(n));
+
+		_stateTracker.Untrack(_backend->GetDepthBuffer());
+	}
+
+	const void *Renderer::GetPipelineState(const PipelineDescription &description, uint32_t *pipelineID)
+	{
+		PipelineDescription instanceDescription = description;
+		instanceDescription.instanceFormat = _instanceFormat;
+
+		return _backend->GetPipelineState(instanceDescription, pipelineID);
+	}
 
-		// If the next frame is not ready to be rendered yet, wait until it is ready.
-		if(_fence->GetCompletedValue() < _fenceValues[_frameIndex])
+	BufferAllocation Renderer::UploadVertexData(Mesh *owner, const void *data, uint64_t dataSize, UploadTicket *ticket)
+	{
+		return UploadBufferData(owner, data, dataSize, ticket);
+	}
+
+	BufferAllocation Renderer::UploadIndexData(Mesh *owner, const void *data, uint64_t dataSize, UploadTicket *ticket)
+	{
+		return UploadBufferData(owner, data, dataSize, ticket);
+	}
+
+	bool Renderer::IsUploadComplete(UploadTicket ticket)
+	{
+		return _uploadScheduler.IsComplete(ticket, _backend->GetCompletedValue(BackendQueue::Copy));
+	}
+
+	void Renderer::WaitForUpload(UploadTicket ticket)
+	{
 		{
-			ThrowIfFailed(_fence->SetEventOnCompletion(_fenceValues[_frameIndex], _fenceEvent));
-			WaitForSingleObjectEx(_fenceEvent, INFINITE, FALSE);
+			std::lock_guard<std::mutex> lock(_lock);
+			if(!_uploadScheduler.IsSubmitted(ticket))
+				SubmitUploads();
 		}
 
-		// Set the fence value for the next frame.
-		_fenceValues[_frameIndex] = currentFenceValue + 1;
+		_backend->WaitForValue(BackendQueue::Copy, ticket);
+	}
+
+	// Only records the copy, the buffer can be used by anything that waited for
+	// the returned ticket on the GPU.
+	BufferAllocation Renderer::UploadBufferData(Mesh *owner, const void *data, uint64_t dataSize, UploadTicket *ticket)
+	{
+		std::lock_guard<std::mutex> lock(_lock);
+
+		BufferAllocation allocation = _bufferAllocator.Allocate(dataSize, owner);
+		CreateBufferPages();
+
+		// Allocating may have to submit the current batch, so it has to happen
+		// before the batch is opened for the copy.
+		const void *uploadResource;
+		uint64_t uploadOffset;
+		const void *staging = nullptr;
+		uint8_t *uploadData = AllocateUpload(dataSize, &uploadResource, &uploadOffset, &staging);
+		memcpy(uploadData, data, static_cast<size_t>(dataSize));
+
+		BeginUploadBatch();
+
+		// Pages live in the common state, they are promoted to COPY_DEST on the copy
+		// queue, decay back once the copy completed and are promoted again to
+		// whatever read state the graphics queue uses them in, so no barriers are
+		// needed.
+		_uploadCommandList->CopyBufferRegion(_bufferPages[allocation.page], allocation.offset, uploadResource, uploadOffset, dataSize);
+
+		const UploadTicket uploadTicket = _uploadScheduler.Enqueue();
+		if(staging)
+			_oversizedUploads.Push(staging, uploadTicket);
+
+		if(ticket)
+			*ticket = uploadTicket;
+
+		return allocation;
+	}
+
+	void Renderer::CreateBufferPages()
+	{
+		while(_bufferPages.size() < _bufferAllocator.GetPageCount())
+		{
+			const uint64_t pageSize = _bufferAllocator.GetPageSize(static_cast<uint32_t>(_bufferPages.size()));
+			_bufferPages.push_back(_backend->CreateBuffer(pageSize, BufferHeap::Default, ResourceState::Common));
+		}
+	}
+
+	uint64_t Renderer::GetBufferAddress(const BufferAllocation &allocation)
+	{
+		std::lock_guard<std::mutex> lock(_lock);
+		return _backend->GetBufferAddress(_bufferPages[allocation.page]) + allocation.offset;
+	}
+
+	void Renderer::FreeBuffer(const BufferAllocation &allocation, UploadTicket ticket)
+	{
+		std::lock_guard<std::mutex> lock(_lock);
+
+		_bufferReleases.Push(allocation, GetReleaseFenceValue());
+		_releaseCopyTicket = std::max(_releaseCopyTicket, ticket);
+	}
+
+	void Renderer::ReleaseResource(const void *resource)
+	{
+		std::lock_guard<std::mutex> lock(_lock);
+		_resourceReleases.Push(resource, GetReleaseFenceValue());
+	}
+
+	BufferAllocatorStatistics Renderer::GetBufferStatistics()
+	{
+		std::lock_guard<std::mutex> lock(_lock);
+		return _bufferAllocator.GetStatistics();
 	}
 
-	// Helper function for acquiring the first available hardware adapter that supports Direct3D 12.
-	// If no such adapter can be found, *ppAdapter will be set to nullptr.
-	void Renderer::GetHardwareAdapter(_In_ IDXGIFactory4* pFactory, _Outptr_result_maybenull_ IDXGIAdapter1** ppAdapter)
+	uint32_t Renderer::DefragmentBuffers(uint32_t maxMoves)
 	{
-		IDXGIAdapter1* pAdapter = nullptr;
-		*ppAdapter = nullptr;
+		std::lock_guard<std::mutex> lock(_lock);
+
+		// Nothing may read or write the pages while ranges move around.
+		SubmitUploads();
+		WaitForGpu();
+		_backend->WaitForValue(BackendQueue::Copy, _uploadScheduler.GetSubmittedValue());
+
+		// Freed ranges go back first, their owners may be gone already.
+		ReclaimReleases();
+
+		std::vector<BufferMove> moves;
+		const uint32_t moveCount = _bufferAllocator.Defragment(maxMoves, moves);
+		if(moveCount == 0)
+			return 0;
+
+		// Moves may overlap their own or other old ranges, so everything is copied
+		// to a scratch buffer first and then back to the new locations.
+		uint64_t scratchSize = 0;
+		for(const BufferMove &move : moves)
+			scratchSize += move.from.size;
+
+		const void *scratch = _backend->CreateBuffer(scratchSize, BufferHeap::Default, ResourceState::Common);
+
+		BeginUploadBatch();
+
+		std::vector<bool> pageMoved(_bufferPages.size(), false);
+		uint64_t scratchOffset = 0;
+		for(const BufferMove &move : moves)
+		{
+			_uploadCommandList->CopyBufferRegion(scratch, scratchOffset, _bufferPages[move.from.page], move.from.offset, move.from.size);
+			scratchOffset += move.from.size;
+			pageMoved[move.from.page] = true;
+		}
+
+		// The copies promoted the scratch buffer to COPY_DEST and the pages moved
+		// from to COPY_SOURCE. Those receiving a range need to be a destination,
+		// pages still in the common state get promoted again by the copy.
+		_copyStateTracker.Track(scratch, ResourceState::CopyDest);
+		for(size_t page = 0; page < pageMoved.size(); page++)
+		{
+			if(pageMoved[page])
+				_copyStateTracker.Track(_bufferPages[page], ResourceState::CopySource);
+		}
+
+		_copyStateTracker.Transition(scratch, ResourceState::CopySource);
+		for(const BufferMove &move : moves)
+		{
+			if(pageMoved[move.to.page])
+				_copyStateTracker.Transition(_bufferPages[move.to.page], ResourceState::CopyDest);
+		}
+
+		FlushBarriers(_uploadCommandList, _copyStateTracker);
+
+		scratchOffset = 0;
+		for(const BufferMove &move : moves)
+		{
+			_uploadCommandList->CopyBufferRegion(_bufferPages[move.to.page], move.to.offset, scratch, scratchOffset, move.from.size);
+			scratchOffset += move.from.size;
+		}
+
+		const UploadTicket ticket = _uploadScheduler.Enqueue();
+		SubmitUploads();
+		_backend->WaitForValue(BackendQueue::Copy, ticket);
+		_copyStateTracker.Clear();
+		_backend->ReleaseResource(scratch);
 
-		for(UINT adapterIndex = 0; DXGI_ERROR_NOT_FOUND != pFactory->EnumAdapters1(adapterIndex, &pAdapter); ++adapterIndex)
+		// Point the owners at the new locations.
+		for(const BufferMove &move : moves)
 		{
-			DXGI_ADAPTER_DESC1 desc;
-			pAdapter->GetDesc1(&desc);
+			Mesh *mesh = static_cast<Mesh *>(move.userData);
+			const uint64_t address = _backend->GetBufferAddress(_bufferPages[move.to.page]) + move.to.offset;
 
-			if(desc.Flags & DXGI_ADAPTER_FLAG_SOFTWARE)
+			if(mesh->_vertexAllocation.page == move.from.page && mesh->_vertexAllocation.block == move.from.block)
 			{
-				// Don't select the Basic Render Driver adapter.
-				// If you want a software adapter, pass in "/warp" on the command line.
-				continue;
+				mesh->_vertexAllocation.offset = move.to.offset;
+				mesh->_vertexBinding.location = address;
+			}
+			else
+			{
+				mesh->_indexAllocation.offset = move.to.offset;
+				mesh->_indexBinding.location = address;
 			}
+		}
 
-			// Check to see if the adapter supports Direct3D 12, but don't create the
-			// actual device yet.
-			if(SUCCEEDED(D3D12CreateDevice(pAdapter, D3D_FEATURE_LEVEL_12_1, _uuidof(ID3D12Device), nullptr)))
+		// The bundles reference the old locations, the GPU is idle already.
+		InvalidateStaticBundles();
+
+		return moveCount;
+	}
+
+	uint8_t *Renderer::AllocateUpload(uint64_t dataSize, const void **resource, uint64_t *offset, const void **staging)
+	{
+		if(dataSize > _uploadRing.GetCapacity())
+		{
+			// Too large for the ring, gets its own staging buffer that lives until the
+			// batch it is used in completed.
+			*staging = _backend->CreateBuffer(dataSize, BufferHeap::Upload, ResourceState::GenericRead);
+
+			*resource = *staging;
+			*offset = 0;
+			return _backend->MapBuffer(*staging);
+		}
+
+		uint64_t ringOffset = _uploadRing.Allocate(dataSize, UploadAlignment);
+		if(ringOffset == UploadRing::InvalidOffset)
+		{
+			// The ring is full, submit what we have and wait for the oldest batches to
+			// complete until there is enough space.
+			SubmitUploads();
+
+			while((ringOffset = _uploadRing.Allocate(dataSize, UploadAlignment)) == UploadRing::InvalidOffset)
 			{
-				break;
+				_backend->WaitForValue(BackendQueue::Copy, _uploadRing.GetOldestPendingFence());
+				ReclaimUploads();
 			}
 		}
 
-		*ppAdapter = pAdapter;
+		*resource = _uploadBuffer;
+		*offset = ringOffset;
+		return _uploadBufferData + ringOffset;
+	}
+
+	void Renderer::BeginUploadBatch()
+	{
+		if(_uploadBatchOpen)
+			return;
+
+		_uploadCommandList->Begin();
+		_uploadBatchOpen = true;
+	}
+
+	void Renderer::SubmitUploads()
+	{
+		if(!_uploadBatchOpen)
+			return;
+
+		_uploadCommandList->Close();
+		_backend->ExecuteCommandLists(BackendQueue::Copy, &_uploadCommandList, 1);
+
+		const uint64_t fenceValue = _uploadScheduler.Submit();
+		_backend->Signal(BackendQueue::Copy, fenceValue);
+
+		_uploadRing.FinishBatch(fenceValue);
+		_uploadBatchOpen = false;
+	}
+
+	void Renderer::ReclaimUploads()
+	{
+		const uint64_t completedValue = _backend->GetCompletedValue(BackendQueue::Copy);
+		_uploadRing.Reclaim(completedValue);
+
+		_oversizedUploads.Reclaim(completedValue, [this](const void *staging) { _backend->ReleaseResource(staging); });
+	}
+
+	// The frame being recorded, or the next one if none is, may still use what
+	// was released, it could come from a snapshot taken before. Frames signal
+	// consecutive values, so that is the one after the last signaled value.
+	uint64_t Renderer::GetReleaseFenceValue() const
+	{
+		return _framePacer.GetSubmittedValue() + 1;
+	}
+
+	void Renderer::ReclaimReleases()
+	{
+		const uint64_t completedValue = _backend->GetCompletedValue(BackendQueue::Graphics);
+
+		size_t releases = _resourceReleases.Reclaim(completedValue, [this](const void *resource) { _backend->ReleaseResource(resource); });
+
+		// A range may be freed before its upload went out, the copy into it must
+		// not land in whatever is allocated there next.
+		if(_uploadScheduler.IsComplete(_releaseCopyTicket, _backend->GetCompletedValue(BackendQueue::Copy)))
+			releases += _bufferReleases.Reclaim(completedValue, [this](const BufferAllocation &allocation) { _bufferAllocator.Free(allocation); });
+
+		_statistics.releases += static_cast<uint32_t>(releases);
+	}
+
+	// Wait for pending GPU work to complete.
+	void Renderer::WaitForGpu()
+	{
+		const uint64_t fenceValue = _framePacer.Flush();
+		_backend->Signal(BackendQueue::Graphics, fenceValue);
+		_backend->WaitForValue(BackendQueue::Graphics, fenceValue);
+
+		_framePacer.Complete(fenceValue, GetTime());
+	}
+
+	// Prepare to render the next frame, the wait for it happens in
+	// WaitForNextFrame right before the frame starts.
+	void Renderer::MoveToNextFrame()
+	{
+		const uint64_t fenceValue = _framePacer.EndFrame(GetTime());
+		_backend->Signal(BackendQueue::Graphics, fenceValue);
+
+		// Update the frame index.
+		_frameIndex = _backend->GetBackBufferIndex();
+		_frameStarted = false;
+
+		const FramePacerStatistics &pacerStatistics = _framePacer.GetStatistics();
+		_statistics.framesInFlight = pacerStatistics.framesInFlight;
+		_statistics.pendingReleases = static_cast<uint32_t>(_resourceReleases.GetCount() + _bufferReleases.GetCount());
+		_statistics.cpuMilliseconds = pacerStatistics.cpuMilliseconds;
+		_statistics.waitMilliseconds = pacerStatistics.waitMilliseconds;
+		_statistics.latencyMilliseconds = pacerStatistics.latencyMilliseconds;
+		_statistics.averageLatencyMilliseconds = pacerStatistics.averageLatencyMilliseconds;
+
+		const DescriptorStatistics descriptorStatistics = _backend->TakeDescriptorStatistics();
+		_statistics.frameDescriptors = descriptorStatistics.transientDescriptors;
+		_statistics.descriptorsInUse = descriptorStatistics.persistentInUse + descriptorStatistics.transientInUse;
+
+		// The next frame's resolution follows from this one's times. Submitting
+		// and presenting aren't counted as CPU time, backends without a GPU do
+		// the GPU's work in them.
+		_statistics.gpuMilliseconds = _backend->GetGpuMilliseconds();
+		_statistics.renderWidth = _renderWidth;
+		_statistics.renderHeight = _renderHeight;
+		_statistics.resolutionScale = _dynamicResolution ? _resolutionScaler.Update(_buildMilliseconds, _statistics.gpuMilliseconds) : 1.0f;
 	}
 }
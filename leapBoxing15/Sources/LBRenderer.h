@@ -1,59 +1,302 @@
 #pragma once
 
-#include "vector"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "LBRenderBackend.h"
+#include "LBInstanceBatcher.h"
+#include "LBInstanceStream.h"
+#include "LBRenderQueue.h"
+#include "LBWorkerPool.h"
+#include "LBParallelRecorder.h"
+#include "LBUploadRing.h"
+#include "LBUploadScheduler.h"
+#include "LBBufferAllocator.h"
+#include "LBLinearAllocator.h"
+#include "LBFramePacer.h"
+#include "LBRenderGraph.h"
+#include "LBResourceStateTracker.h"
+#include "LBResolutionScaler.h"
+#include "LBReleaseQueue.h"
 
 namespace LB
 {
-	class Entity;
+	struct RenderSnapshot;
+	class Mesh;
+
+	struct RendererStatistics
+	{
+		uint32_t drawCalls;
+		uint32_t staticDraws;				// Replayed from bundles
+		uint32_t instances;
+		uint32_t drawsSaved;
+		uint32_t instanceWriteJobs;
+		uint64_t instanceBytes;				// Streamed into the frame's instance buffer
+		double instanceWriteMilliseconds;
+		double instanceGigabytesPerSecond;
+		uint32_t stateChangesIssued;
+		uint32_t stateChangesSkipped;
+		uint32_t recordingThreads;
+		uint32_t copyWaits;
+		uint32_t constantAllocations;
+		uint64_t constantBytes;
+		double sortMilliseconds;
+		double recordMilliseconds;
+		double staticRecordMilliseconds;	// Recording bundles, only when the static items changed
+		double recordMillisecondsSaved;		// What recording the replayed bundles took
+		uint32_t barriers;
+		uint32_t barrierBatches;
+		uint32_t transitionsRequested;
+		uint32_t transitionsEmitted;
+		uint32_t framesInFlight;
+		uint32_t pendingReleases;			// Resources and buffer ranges waiting for the frames using them
+		uint32_t releases;					// Handed back since the last frame
+		uint32_t frameDescriptors;			// Views created in the backend's descriptor ring this frame
+		uint32_t descriptorsInUse;			// Including those of frames in flight
+		uint32_t renderWidth;				// Of the viewport, below the back buffers with dynamic resolution
+		uint32_t renderHeight;
+		float resolutionScale;				// For the next frame
+		double gpuMilliseconds;				// Of the most recent frame the backend timed
+		double cpuMilliseconds;
+		double waitMilliseconds;
+		double latencyMilliseconds;
+		double averageLatencyMilliseconds;
+	};
+
+	// Turns snapshots into frames. Batching, sorting, constants, barriers,
+	// parallel recording, uploads and frame pacing happen here, everything API
+	// specific goes through the backend, which has to outlive the renderer.
 	class Renderer
 	{
 	public:
-		Renderer(HWND hwnd, bool useWARPDevice);
+		Renderer(RenderBackend *backend, const RendererSettings &settings = RendererSettings());
 		~Renderer();
 
-		void Render(const std::vector<Entity*> &entities);
+		// Blocks until the next frame may start, on the backend's presentation
+		// queue and the frame fence. Call it right before sampling input for the
+		// frame to keep the input to display latency short, Render calls it itself
+		// otherwise.
+		void WaitForNextFrame();
+
+		// Safe to call from the render thread while another thread uploads data, all
+		// command list access is serialized on _lock.
+		void Render(const RenderSnapshot &snapshot);
+
+		const RendererStatistics &GetStatistics() const { return _statistics; }
+		RenderBackend *GetBackend() const { return _backend; }
 
 		void SetWindowSize(int width, int height, bool minimized);
 		void ToggleFullscreen();
-		Microsoft::WRL::ComPtr<ID3D12PipelineState> GetPSOForDescription(D3D12_GRAPHICS_PIPELINE_STATE_DESC *desc);
-		Microsoft::WRL::ComPtr<ID3D12Resource> UploadVertexData(void *data, long dataSize);
-		Microsoft::WRL::ComPtr<ID3D12Resource> UploadIndexData(void *data, long dataSize);
+
+		// Draws the opaque geometry twice, depth only and then shaded against the
+		// finished depth buffer, so every pixel is shaded once. Pays off when
+		// shading costs more than the extra vertex work.
+		void SetDepthPrePass(bool enabled);
+
+		// Renders into the top left part of the back buffers, sized by the scaler
+		// from the frame times, which the backend upscales when presenting.
+		// Disabled renders at full size.
+		void SetDynamicResolution(bool enabled, const ResolutionScalerSettings &settings = ResolutionScalerSettings());
+
+		// Identical descriptions share one pipeline state, pipelineID receives an id
+		// shared by them for sorting. Safe to call from any thread.
+		const void *GetPipelineState(const PipelineDescription &description, uint32_t *pipelineID = nullptr);
+
+		// Uploads are copied asynchronously, ticket receives what has to complete
+		// before the buffer can be read. Draws wait for it on the GPU automatically.
+		// Buffers are ranges in shared pages, owner is the mesh whose bindings get
+		// updated when the range moves.
+		BufferAllocation UploadVertexData(Mesh *owner, const void *data, uint64_t dataSize, UploadTicket *ticket = nullptr);
+		BufferAllocation UploadIndexData(Mesh *owner, const void *data, uint64_t dataSize, UploadTicket *ticket = nullptr);
+		bool IsUploadComplete(UploadTicket ticket);
+		void WaitForUpload(UploadTicket ticket);
+
+		uint64_t GetBufferAddress(const BufferAllocation &allocation);
+
+		// Both can be called while frames in flight still use what is released, it
+		// is handed back once they completed, instead of waiting for the GPU. Frames
+		// recorded afterwards must not use it anymore. The range is also held until
+		// the copy of ticket completed.
+		void FreeBuffer(const BufferAllocation &allocation, UploadTicket ticket = 0);
+		void ReleaseResource(const void *resource);
+
+		// Compacts the buffer pages, moving at most maxMoves buffers. Waits for the
+		// GPU to be idle, so it is meant for loading screens and level transitions.
+		uint32_t DefragmentBuffers(uint32_t maxMoves);
+		BufferAllocatorStatistics GetBufferStatistics();
 
 	private:
-		void CreatePipeline(HWND hwnd, bool useWARPDevice);
-		void LoadAssets();
-		void CreateFramebuffers();
-		void GetHardwareAdapter(_In_ IDXGIFactory4* pFactory, _Outptr_result_maybenull_ IDXGIAdapter1** ppAdapter);
 		void WaitForGpu();
 		void MoveToNextFrame();
+		uint64_t GetReleaseFenceValue() const;
+		void ReclaimReleases();
+		void TrackFramebuffers();
+		void UntrackFramebuffers();
+		VertexBufferBinding WriteInstanceData(const RenderSnapshot &snapshot);
+		void BuildRenderQueue();
+		void SetFrameState(RenderCommandList *commandList, uint32_t pass);
+		RenderGraphResource ImportGraphResource(const char *name, const void *resource, uint32_t finalState);
+		void SubmitBarriers(RenderCommandList *commandList, const RenderBarrier *barriers, size_t count);
+		void FlushBarriers(RenderCommandList *commandList, ResourceStateTracker &tracker);
+		void PrepareConstants(const RenderSnapshot &snapshot);
+		uint64_t AllocateConstants(const void *data, uint32_t size);
+		void RecordDraws(uint32_t pass, const VertexBufferBinding &instanceBinding);
+		void RecordDrawChunk(uint32_t pass, uint32_t chunk, size_t begin, size_t end, const VertexBufferBinding &instanceBinding);
+		uint32_t GetPipelineVariant(uint32_t pass) const;
+		void UpdateStaticDraws(const RenderSnapshot &snapshot);
+		void ExecuteStaticDraws(uint32_t pass, RenderCommandList *commandList);
+		void RecordStaticBundle(uint32_t variant);
+		void InvalidateStaticBundles();
+
+		static void RecordPacket(StateFilter &stateFilter, const DrawPacket &packet, uint32_t variant);
+
+		BufferAllocation UploadBufferData(Mesh *owner, const void *data, uint64_t dataSize, UploadTicket *ticket);
+		void CreateBufferPages();
+		uint8_t *AllocateUpload(uint64_t dataSize, const void **resource, uint64_t *offset, const void **staging);
+		void BeginUploadBatch();
+		void SubmitUploads();
+		void ReclaimUploads();
+
+		static const uint32_t MaxFrameCount = FramePacer::MaxFrameCount;
+
+		// Upper limit for command lists the draws of a pass get split into.
+		static const uint32_t MaxRecordingThreads = 8;
 
-		static const UINT FrameCount = 2;
+		// Passes recording the render queue, each with its own command lists.
+		enum RecordedPass : uint32_t
+		{
+			RecordedPassDepth,
+			RecordedPassOpaque,
+			RecordedPassCount
+		};
 
-		int _windowWidth;
-		int _windowHeight;
+		// Pipeline states of a material, the shaded one depth tests against
+		// what the pre-pass laid down.
+		enum PipelineVariant : uint32_t
+		{
+			PipelineVariantDefault,
+			PipelineVariantDepthOnly,
+			PipelineVariantShaded,
+			PipelineVariantCount
+		};
 
-		bool _needsUpdateForWindowSizeChange;
+		static const uint64_t UploadRingSize = 16 * 1024 * 1024;
+		static const uint64_t UploadAlignment = 16;
+
+		static const uint64_t BufferPageSize = 32 * 1024 * 1024;
+		static const uint64_t BufferGranularity = 16;
+
+		// Constant buffer placement alignment of D3D12, the strictest backend.
+		static const uint64_t ConstantAlignment = 256;
+
+		// Distance mapped to the far end of the depth range of the sort keys.
+		static const float MaxSortDistance;
+
+		RenderBackend *_backend;
 		bool _windowVisible;
+		bool _depthPrePass;
 
-		D3D12_VIEWPORT _viewport;
-		D3D12_RECT _scissorRect;
-
-		// Pipeline objects.
-		Microsoft::WRL::ComPtr<IDXGISwapChain3> _swapChain;
-		Microsoft::WRL::ComPtr<ID3D12Device> _device;
-		Microsoft::WRL::ComPtr<ID3D12Resource> _renderTargets[FrameCount];
-		Microsoft::WRL::ComPtr<ID3D12CommandAllocator> _commandAllocators[FrameCount];
-		Microsoft::WRL::ComPtr<ID3D12CommandQueue> _commandQueue;
-		Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> _rtvHeap;
-		Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> _cbvHeap;
-		Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList> _commandList;
-		Microsoft::WRL::ComPtr<ID3D12RootSignature> _rootSignature;
-		UINT _rtvDescriptorSize;
+		// Size of the viewport of the current frame.
+		ResolutionScaler _resolutionScaler;
+		bool _dynamicResolution;
+		uint32_t _renderWidth;
+		uint32_t _renderHeight;
+		double _buildMilliseconds;			// CPU time up to the submission
 
 		// Synchronization objects.
-		UINT _frameIndex;
-		HANDLE _fenceEvent;
-		Microsoft::WRL::ComPtr<ID3D12Fence> _fence;
-		UINT64 _fenceValues[FrameCount];
+		uint32_t _frameIndex;
+		uint32_t _frameCount;
+		FramePacer _framePacer;
+		bool _frameStarted;
+
+		// Per frame instance data, persistently mapped upload heap memory. Every
+		// pipeline state reads the instances in _instanceFormat.
+		InstanceBatcher _instanceBatcher;
+		InstanceStream _instanceStream;
+		InstanceFormat _instanceFormat;
+		uint32_t _instanceSize;
+		const void *_instanceBuffers[MaxFrameCount];
+		uint8_t *_instanceBufferData[MaxFrameCount];
+		uint32_t _instanceBufferCapacity[MaxFrameCount];
+
+		// Per frame constants, persistently mapped upload heap memory handed out
+		// linearly and reset once the frame's fence passed.
+		const void *_constantBuffers[MaxFrameCount];
+		uint8_t *_constantBufferData[MaxFrameCount];
+		uint64_t _constantBufferCapacity[MaxFrameCount];
+		LinearAllocator _constantAllocator;
+		uint64_t _frameConstants;
+		uint64_t _drawConstants;
+
+		// Rebuilt every frame, _graphResources maps its resources to ours.
+		RenderGraph _renderGraph;
+		std::vector<const void *> _graphResources;
+
+		// Current states of the resources used on the graphics queue, and of those
+		// the current upload batch has moved out of the common state. Buffers
+		// decay back to it once a batch completed on the copy queue.
+		ResourceStateTracker _stateTracker;
+		ResourceStateTracker _copyStateTracker;
+
+		RenderQueue _renderQueue;
+		WorkerPool _workerPool;
+
+		// The frame starts with _commandList, draws are recorded on the worker
+		// pool, every chunk of a pass into its own command list. Draw state goes
+		// through the filter so redundant binds never reach the command list.
+		// _frameCommandLists collects them in submission order.
+		struct RecordingContext
+		{
+			RenderCommandList *commandList;
+			StateFilter stateFilter;
+		};
+
+		RenderCommandList *_commandList;
+		ParallelRecorder _parallelRecorder;
+		RecordingContext _recordingContexts[RecordedPassCount][MaxRecordingThreads];
+		RenderCommandList *_frameCommandLists[RecordedPassCount * MaxRecordingThreads + 1];
+		uint32_t _frameCommandListCount;
+
+		// Static items are batched and written to their own buffer once, bundles
+		// record their draws for each pipeline variant the first time it is
+		// needed. Both are redone when a snapshot brings a different list.
+		std::shared_ptr<const std::vector<RenderItem>> _staticItems;
+		InstanceBatcher _staticBatcher;
+		RenderQueue _staticQueue;
+		const void *_staticBuffer;
+		RenderCommandList *_staticBundles[PipelineVariantCount];
+		bool _staticBundleRecorded[PipelineVariantCount];
+		double _staticRecordMilliseconds[PipelineVariantCount];
+
+		// Buffer uploads are staged in a persistently mapped ring and their copies
+		// collected in one command list, which is submitted to the copy queue with
+		// the next frame or when the ring runs full. Oversized staging buffers are
+		// parked with the batch they were used in, on the copy fence.
+		UploadScheduler _uploadScheduler;
+		UploadRing _uploadRing;
+		const void *_uploadBuffer;
+		uint8_t *_uploadBufferData;
+		RenderCommandList *_uploadCommandList;
+		ReleaseQueue<const void *> _oversizedUploads;
+		uint64_t _copyWaitValue;
+		bool _uploadBatchOpen;
+
+		// Vertex and index buffers are sub-allocated from large buffers, instead of
+		// one resource with 64 KB alignment per mesh.
+		BufferAllocator _bufferAllocator;
+		std::vector<const void *> _bufferPages;
+
+		// Released resources and freed buffer ranges, on the frame fence. Ranges
+		// also wait for the copy fence to reach the newest ticket of any of them.
+		ReleaseQueue<const void *> _resourceReleases;
+		ReleaseQueue<BufferAllocation> _bufferReleases;
+		UploadTicket _releaseCopyTicket;
+
+		RendererStatistics _statistics;
+
+		std::mutex _lock;
 	};
-}
\ No newline at end of file
+}
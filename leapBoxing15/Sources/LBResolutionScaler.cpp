@@ -0,0 +1,96 @@
+#if defined(_WIN32)
+#include "stdafx.h"
+#endif
+
+#include "LBResolutionScaler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace LB
+{
+	const double ResolutionScaler::FilterWeight = 0.25;
+
+	ResolutionScaler::ResolutionScaler(const ResolutionScalerSettings &settings) : _statistics()
+	{
+		SetSettings(settings);
+	}
+
+	void ResolutionScaler::SetSettings(const ResolutionScalerSettings &settings)
+	{
+		if(!(settings.targetMilliseconds > 0.0) || !(settings.minScale > 0.0f) || settings.minScale > settings.maxScale || settings.maxScale > 1.0f)
+			throw std::invalid_argument("Resolution scale bounds or target out of range");
+
+		_settings = settings;
+		Reset();
+	}
+
+	void ResolutionScaler::Reset()
+	{
+		_scale = _settings.maxScale;
+		_area = static_cast<double>(_scale) * _scale;
+		_errors[0] = 0.0;
+		_errors[1] = 0.0;
+		_headroomFrames = 0;
+		_filtered = 0.0;
+	}
+
+	float ResolutionScaler::Update(double cpuMilliseconds, double gpuMilliseconds)
+	{
+		_statistics.frames++;
+
+		const bool gpuMeasured = gpuMilliseconds > 0.0;
+		const double measured = gpuMeasured ? gpuMilliseconds : cpuMilliseconds;
+		const bool cpuBound = gpuMeasured && cpuMilliseconds > gpuMilliseconds;
+
+		if(measured > _settings.targetMilliseconds)
+			_statistics.framesOverTarget++;
+		if(cpuBound)
+			_statistics.cpuBoundFrames++;
+
+		// Rises are taken at once, drops smoothed, so noise mostly makes the
+		// controller more careful instead of making it twitch.
+		_filtered = (measured > _filtered) ? measured : _filtered + FilterWeight * (measured - _filtered);
+
+		// Aims for the middle of the deadband below the target.
+		const double setpoint = _settings.targetMilliseconds * (1.0 - _settings.deadband);
+
+		double error = std::min(std::max((setpoint - _filtered) / _settings.targetMilliseconds, -1.0), 1.0);
+		if(std::fabs(error) < _settings.deadband)
+			error = 0.0;
+
+		_headroomFrames = (error > 0.0) ? _headroomFrames + 1 : 0;
+
+		// Incremental form, the area itself is the integral and clamping it keeps
+		// the controller from winding up. Relative to the current area the gains
+		// work the same at every scale.
+		const double change = _area * (_settings.integralGain * error + _settings.proportionalGain * (error - _errors[0]) + _settings.derivativeGain * (error - 2.0 * _errors[0] + _errors[1]));
+
+		_errors[1] = _errors[0];
+		_errors[0] = error;
+
+		// Only steps towards the target are taken, the proportional and derivative
+		// terms alone would also undo a step once the error shrinks.
+		const bool held = (change < 0.0 && (error >= 0.0 || cpuBound)) || (change > 0.0 && _headroomFrames < _settings.raiseDelay);
+		if(!held)
+		{
+			const double minArea = static_cast<double>(_settings.minScale) * _settings.minScale;
+			const double maxArea = static_cast<double>(_settings.maxScale) * _settings.maxScale;
+			_area = std::min(std::max(_area + change, minArea), maxArea);
+		}
+
+		// Small steps are collected until they add up, only the bounds are always
+		// reached exactly.
+		const float scale = std::min(std::max(static_cast<float>(std::sqrt(_area)), _settings.minScale), _settings.maxScale);
+		const bool atBound = scale == _settings.minScale || scale == _settings.maxScale;
+
+		if(scale != _scale && (std::fabs(scale - _scale) >= _settings.minStep || atBound))
+		{
+			_scale = scale;
+			_statistics.scaleChanges++;
+		}
+
+		return _scale;
+	}
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstdint>
+
+namespace LB
+{
+	struct ResolutionScalerSettings
+	{
+		ResolutionScalerSettings() : targetMilliseconds(1000.0 / 60.0), minScale(0.5f), maxScale(1.0f), proportionalGain(0.3), integralGain(0.2), derivativeGain(0.05), deadband(0.1), minStep(0.02f), raiseDelay(10) {}
+
+		double targetMilliseconds;	// GPU time a frame may take
+		float minScale;				// Bounds of the scale of both axes
+		float maxScale;
+		double proportionalGain;	// Gains on the relative error to the target
+		double integralGain;
+		double derivativeGain;
+		double deadband;			// Relative error that counts as on target
+		float minStep;				// Smaller scale changes are not applied
+		uint32_t raiseDelay;		// Frames with headroom before the scale goes up
+	};
+
+	struct ResolutionScalerStatistics
+	{
+		uint64_t frames;
+		uint64_t framesOverTarget;
+		uint64_t cpuBoundFrames;
+		uint64_t scaleChanges;
+	};
+
+	// Picks the resolution scale of the next frame from the measured times of
+	// the last ones. GPU time follows the number of pixels, so the controller is
+	// an incremental PID on the pixel count with the relative error to the target
+	// time as input: e = (target - measured) / target.
+	//
+	// Hysteresis keeps the resolution from flickering. Errors within the deadband
+	// count as zero, the scale only goes up after raiseDelay frames in a row had
+	// headroom and changes smaller than minStep are held back. Frames where the
+	// CPU took longer than the GPU never lower the scale, fewer pixels wouldn't
+	// make them any faster. Without a GPU time the CPU time is controlled.
+	//
+	// Depends on nothing but the times passed in, so it can be run against
+	// recorded frame time traces.
+	class ResolutionScaler
+	{
+	public:
+		ResolutionScaler(const ResolutionScalerSettings &settings = ResolutionScalerSettings());
+
+		void SetSettings(const ResolutionScalerSettings &settings);
+		const ResolutionScalerSettings &GetSettings() const { return _settings; }
+
+		// Starts over at the maximum scale.
+		void Reset();
+
+		// Takes the times of a frame, a GPU time of 0 means it wasn't measured.
+		// Returns the scale for the next frame.
+		float Update(double cpuMilliseconds, double gpuMilliseconds);
+
+		float GetScale() const { return _scale; }
+		const ResolutionScalerStatistics &GetStatistics() const { return _statistics; }
+
+	private:
+		static const double FilterWeight;
+
+		ResolutionScalerSettings _settings;
+
+		float _scale;
+		double _area;		// Unrounded pixel fraction the PID works on
+		double _filtered;	// Measured time
+		double _errors[2];	// Of the last two frames
+		uint32_t _headroomFrames;
+
+		ResolutionScalerStatistics _statistics;
+	};
+}
@@ -0,0 +1,197 @@
+#if defined(_WIN32)
+#include "stdafx.h"
+#endif
+
+#include "LBResourceStateTracker.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+namespace LB
+{
+	static bool IsReadState(uint32_t state)
+	{
+		return state != ResourceState::Common && (state & ~ResourceState::ReadStates) == 0;
+	}
+
+	static bool IsCancelled(const ResourceStateBarrier &barrier)
+	{
+		return barrier.type == RenderBarrierType::Transition && barrier.stateBefore == barrier.stateAfter;
+	}
+
+	ResourceStateTracker::ResourceStateTracker() : _pendingCount(0)
+	{
+		ResetStatistics();
+	}
+
+	void ResourceStateTracker::Track(const void *resource, uint32_t state)
+	{
+		assert(resource);
+
+		auto result = _states.insert(std::make_pair(resource, State()));
+		State &tracked = result.first->second;
+
+		// Tracking again drops whatever was pending for the resource.
+		if(!result.second && tracked.pending != InvalidPending)
+		{
+			_pending[tracked.pending].stateAfter = _pending[tracked.pending].stateBefore;
+			_pendingCount--;
+		}
+
+		tracked.current = state;
+		tracked.pending = InvalidPending;
+	}
+
+	// Pending barriers of the resource are dropped, as it is about to go away.
+	void ResourceStateTracker::Untrack(const void *resource)
+	{
+		if(_states.erase(resource) == 0)
+			return;
+
+		_pending.erase(std::remove_if(_pending.begin(), _pending.end(), [&](const ResourceStateBarrier &barrier) {
+			return barrier.resource == resource;
+		}), _pending.end());
+
+		_pendingCount = 0;
+		for(size_t i = 0; i < _pending.size(); i++)
+		{
+			ResourceStateBarrier &barrier = _pending[i];
+			if(barrier.aliasBefore == resource)
+				barrier.aliasBefore = nullptr;
+
+			if(IsCancelled(barrier))
+				continue;
+
+			if(barrier.type == RenderBarrierType::Transition)
+				_states[barrier.resource].pending = static_cast<uint32_t>(i);
+
+			_pendingCount++;
+		}
+	}
+
+	void ResourceStateTracker::Clear()
+	{
+		_states.clear();
+		_pending.clear();
+		_pendingCount = 0;
+	}
+
+	uint32_t ResourceStateTracker::GetState(const void *resource) const
+	{
+		auto iterator = _states.find(resource);
+		assert(iterator != _states.end());
+
+		const State &tracked = iterator->second;
+		return (tracked.pending != InvalidPending) ? _pending[tracked.pending].stateAfter : tracked.current;
+	}
+
+	void ResourceStateTracker::Transition(const void *resource, uint32_t state)
+	{
+		auto iterator = _states.find(resource);
+		assert(iterator != _states.end());
+
+		State &tracked = iterator->second;
+		_statistics.transitionsRequested++;
+
+		if(tracked.pending != InvalidPending)
+		{
+			ResourceStateBarrier &barrier = _pending[tracked.pending];
+
+			uint32_t after = state;
+			if(IsReadState(barrier.stateAfter) && IsReadState(state))
+				after |= barrier.stateAfter;
+
+			if(after == barrier.stateBefore)
+			{
+				barrier.stateAfter = after;
+				tracked.pending = InvalidPending;
+				_pendingCount--;
+				_statistics.transitionsCancelled++;
+				return;
+			}
+
+			barrier.stateAfter = after;
+			_statistics.transitionsMerged++;
+			return;
+		}
+
+		// Already readable in everything needed, no need to narrow it down.
+		if(tracked.current == state || (IsReadState(tracked.current) && IsReadState(state) && (tracked.current & state) == state))
+		{
+			_statistics.transitionsSkipped++;
+			return;
+		}
+
+		// Reads relying on the current state may have been skipped, so it is widened
+		// rather than replaced.
+		uint32_t after = state;
+		if(IsReadState(tracked.current) && IsReadState(state))
+			after |= tracked.current;
+
+		tracked.pending = static_cast<uint32_t>(_pending.size());
+		_pending.push_back({ RenderBarrierType::Transition, resource, nullptr, tracked.current, after });
+		_pendingCount++;
+	}
+
+	void ResourceStateTracker::UnorderedAccess(const void *resource)
+	{
+		assert(IsTracked(resource));
+
+		// One is enough per batch.
+		for(const ResourceStateBarrier &barrier : _pending)
+		{
+			if(barrier.type == RenderBarrierType::UnorderedAccess && barrier.resource == resource)
+				return;
+		}
+
+		_pending.push_back({ RenderBarrierType::UnorderedAccess, resource, nullptr, ResourceState::UnorderedAccess, ResourceState::UnorderedAccess });
+		_pendingCount++;
+	}
+
+	void ResourceStateTracker::Aliasing(const void *before, const void *after)
+	{
+		_pending.push_back({ RenderBarrierType::Aliasing, after, before, 0, 0 });
+		_pendingCount++;
+	}
+
+	void ResourceStateTracker::Flush(const std::function<void(const ResourceStateBarrier *barriers, size_t count)> &submitBarriers)
+	{
+		if(_pendingCount == 0)
+		{
+			_pending.clear();
+			return;
+		}
+
+		_batch.clear();
+
+		for(const ResourceStateBarrier &barrier : _pending)
+		{
+			if(IsCancelled(barrier))
+				continue;
+
+			if(barrier.type == RenderBarrierType::Transition)
+			{
+				State &tracked = _states[barrier.resource];
+				tracked.current = barrier.stateAfter;
+				tracked.pending = InvalidPending;
+				_statistics.transitionsEmitted++;
+			}
+
+			_batch.push_back(barrier);
+		}
+
+		_pending.clear();
+		_pendingCount = 0;
+
+		_statistics.barriersEmitted += static_cast<uint32_t>(_batch.size());
+		_statistics.flushes++;
+
+		submitBarriers(_batch.data(), _batch.size());
+	}
+
+	void ResourceStateTracker::ResetStatistics()
+	{
+		memset(&_statistics, 0, sizeof(_statistics));
+	}
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+#include "LBRenderGraph.h"
+
+namespace LB
+{
+	struct ResourceStateBarrier
+	{
+		RenderBarrierType type;
+		const void *resource;
+		const void *aliasBefore;		// nullptr for any resource
+		uint32_t stateBefore;
+		uint32_t stateAfter;
+	};
+
+	struct ResourceStateStatistics
+	{
+		uint32_t transitionsRequested;
+		uint32_t transitionsEmitted;
+		uint32_t transitionsSkipped;	// Resource already was in the state
+		uint32_t transitionsMerged;		// Folded into a pending transition of the same resource
+		uint32_t transitionsCancelled;	// Pending transition ended up in the state it started in
+		uint32_t barriersEmitted;		// Including aliasing and unordered access barriers
+		uint32_t flushes;				// ResourceBarrier calls
+	};
+
+	// Knows the current state of every tracked resource and collects the
+	// barriers requested for them until Flush hands them to the backend as one
+	// batch. A resource only gets one transition per batch, later requests
+	// change where it goes and one returning to where it started drops it, so
+	// the before states always come from the tracker instead of the caller.
+	//
+	// Read states are combined where a transition for the resource is pending
+	// already, and reads the current state covers don't need one at all.
+	// Flush before every draw or copy that depends on the requested states.
+	class ResourceStateTracker
+	{
+	public:
+		ResourceStateTracker();
+
+		void Track(const void *resource, uint32_t state);
+		void Untrack(const void *resource);
+		void Clear();
+
+		// State after the pending barriers.
+		uint32_t GetState(const void *resource) const;
+		bool IsTracked(const void *resource) const { return _states.find(resource) != _states.end(); }
+
+		void Transition(const void *resource, uint32_t state);
+		void UnorderedAccess(const void *resource);
+		void Aliasing(const void *before, const void *after);
+
+		bool HasPendingBarriers() const { return _pendingCount > 0; }
+		void Flush(const std::function<void(const ResourceStateBarrier *barriers, size_t count)> &submitBarriers);
+
+		const ResourceStateStatistics &GetStatistics() const { return _statistics; }
+		void ResetStatistics();
+
+	private:
+		struct State
+		{
+			uint32_t current;
+			uint32_t pending;		// Index into _pending or InvalidPending
+		};
+
+		static const uint32_t InvalidPending = ~0u;
+
+		std::unordered_map<const void *, State> _states;
+
+		// Cancelled transitions stay in place with equal states, so the indices of
+		// the others remain valid, and are skipped by Flush.
+		std::vector<ResourceStateBarrier> _pending;
+		std::vector<ResourceStateBarrier> _batch;
+		size_t _pendingCount;
+
+		ResourceStateStatistics _statistics;
+	};
+}
@@ -1,20 +1,290 @@
+#if defined(_WIN32)
 #include "stdafx.h"
+#endif
+
 #include "LBScene.h"
+#include "LBSceneFile.h"
+#include "LBSceneStreamer.h"
+#include "LBRenderSnapshot.h"
 #include "LBEntity.h"
 #include "LBModel.h"
 #include "LBMaterial.h"
 #include "LBMesh.h"
-#include "LBApplication.h"
+#include "LBRenderer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <unordered_set>
 
 namespace LB
 {
-	Scene::Scene()
+	static void ExtractItem(Entity *entity, RenderItem *item)
 	{
-		Material *material = new Material(L"shaders.hlsl");
-		Mesh *mesh = Mesh::WithCube();
-		Model *model = new Model(mesh, material);
-		Entity *entity = new Entity(model);
+		const RN::Matrix worldMatrix = entity->GetWorldMatrix();
+		const RN::Vector3 &boundsMin = entity->GetBoundsMin();
+		const RN::Vector3 &boundsMax = entity->GetBoundsMax();
+
+		memcpy(item->worldMatrix, worldMatrix.m, sizeof(item->worldMatrix));
+		item->boundsMin[0] = boundsMin.x;
+		item->boundsMin[1] = boundsMin.y;
+		item->boundsMin[2] = boundsMin.z;
+		item->boundsMax[0] = boundsMax.x;
+		item->boundsMax[1] = boundsMax.y;
+		item->boundsMax[2] = boundsMax.z;
+		item->mesh = entity->GetModel()->GetMesh();
+		item->material = entity->GetModel()->GetMaterial();
+	}
+
+	Scene::Scene(Renderer *renderer) : _renderer(renderer), _staticBatchStatistics()
+	{
+		Entity *entity = new Entity(GetModel(GetMesh("cube"), GetMaterial("shaders.hlsl")));
 
 		_entities.push_back(entity);
+
+		// The camera looks down the negative z axis, step back to see the cube.
+		_camera.SetPosition(RN::Vector3(0.0f, 0.0f, 5.0f));
+	}
+
+	Scene::Scene(Renderer *renderer, const std::string &path) : _renderer(renderer), _staticBatchStatistics()
+	{
+		LoadFromFile(path);
+		BuildStaticBatches();
+	}
+
+	Scene::~Scene()
+	{
+		// Stop the loader threads before the entities they feed go away.
+		_streamer.reset();
+
+		for(Entity *entity : _entities)
+			delete entity;
+		for(Entity *entity : _staticEntities)
+			delete entity;
+		for(Entity *entity : _staticClusters)
+			delete entity;
+
+		// Meshes hand their buffers back to the renderer, frames still in flight
+		// keep drawing from them until they completed.
+		for(const auto &model : _models)
+			delete model.second;
+		for(Mesh *mesh : _clusterMeshes)
+			delete mesh;
+		for(const auto &mesh : _meshes)
+			delete mesh.second;
+		for(const auto &material : _materials)
+			delete material.second;
+	}
+
+	void Scene::Update(float)
+	{
+		if(_streamer)
+		{
+			const RN::Vector3 position = _camera.GetPosition();
+			const float viewer[3] = { position.x, position.y, position.z };
+
+			_streamer->Update(viewer);
+			_streamer->Integrate();
+		}
+	}
+
+	void Scene::Extract(RenderSnapshot &snapshot)
+	{
+		std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+
+		const RN::Matrix viewMatrix = _camera.GetWorldMatrix().GetInverse();
+		const RN::Vector3 cameraPosition = _camera.GetPosition();
+
+		memcpy(snapshot.viewMatrix, viewMatrix.m, sizeof(snapshot.viewMatrix));
+		snapshot.cameraPosition[0] = cameraPosition.x;
+		snapshot.cameraPosition[1] = cameraPosition.y;
+		snapshot.cameraPosition[2] = cameraPosition.z;
+
+		snapshot.items.resize(_entities.size());
+		RenderItem *item = snapshot.items.data();
+
+		for(Entity *entity : _entities)
+			ExtractItem(entity, item++);
+
+		// Shared, the renderer only looks at them again once this is replaced.
+		snapshot.staticItems = _staticItems;
+
+		snapshot.extractMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	}
+
+	void Scene::BuildStaticBatches(float clusterSize)
+	{
+		StaticBatcher batcher(clusterSize);
+		std::vector<Entity *> dynamicEntities;
+
+		std::unordered_set<Entity *> chunkEntities;
+		for(const auto &chunk : _chunkEntities)
+			chunkEntities.insert(chunk.second.begin(), chunk.second.end());
+
+		for(Entity *entity : _entities)
+		{
+			if(!entity->IsStatic() || chunkEntities.count(entity) > 0)
+			{
+				dynamicEntities.push_back(entity);
+				continue;
+			}
+
+			const RN::Matrix worldMatrix = entity->GetWorldMatrix();
+			Model *model = entity->GetModel();
+			batcher.Add(model->GetMesh()->GetGeometry(), worldMatrix.m, model->GetMaterial());
+
+			_staticEntities.push_back(entity);
+		}
+
+		if(dynamicEntities.size() == _entities.size())
+			return;
+
+		batcher.Build();
+		_entities.swap(dynamicEntities);
+
+		std::shared_ptr<std::vector<RenderItem>> staticItems = std::make_shared<std::vector<RenderItem>>();
+		if(_staticItems)
+			*staticItems = *_staticItems;
+
+		for(const StaticCluster &cluster : batcher.GetClusters())
+		{
+			Material *material = const_cast<Material *>(static_cast<const Material *>(cluster.material));
+			Mesh *mesh = Mesh::WithData(_renderer, cluster.vertices.data(), static_cast<uint32_t>(cluster.vertices.size() / 7), cluster.indices.data(), static_cast<uint32_t>(cluster.indices.size()), PrimitiveTopology::TriangleList);
+
+			_clusterMeshes.push_back(mesh);
+
+			Entity *entity = new Entity(GetModel(mesh, material));
+			entity->SetBounds(RN::Vector3(cluster.boundsMin[0], cluster.boundsMin[1], cluster.boundsMin[2]), RN::Vector3(cluster.boundsMax[0], cluster.boundsMax[1], cluster.boundsMax[2]));
+			entity->SetStatic(true);
+
+			staticItems->emplace_back();
+			ExtractItem(entity, &staticItems->back());
+
+			_staticClusters.push_back(entity);
+		}
+
+		_staticItems = staticItems;
+
+		_staticBatchStatistics = batcher.GetStatistics();
+	}
+
+	uint32_t Scene::AddStreamingChunk(const std::string &path, const RN::Vector3 &center, float radius)
+	{
+		if(!_streamer)
+		{
+			auto integrate = [this](uint32_t chunk, const SceneFile &file, uint32_t first, uint32_t count) {
+				AddEntities(file, first, count, _chunkEntities[chunk]);
+			};
+
+			auto unload = [this](uint32_t chunk) {
+				auto iterator = _chunkEntities.find(chunk);
+				if(iterator != _chunkEntities.end())
+				{
+					RemoveEntities(iterator->second);
+					_chunkEntities.erase(iterator);
+				}
+			};
+
+			_streamer.reset(new SceneStreamer(integrate, unload));
+		}
+
+		const float position[3] = { center.x, center.y, center.z };
+		return _streamer->AddChunk(path, position, radius);
+	}
+
+	SceneStreamer *Scene::GetStreamer()
+	{
+		return _streamer.get();
+	}
+
+	void Scene::LoadFromFile(const std::string &path)
+	{
+		SceneFile file;
+		file.Open(path.c_str());
+
+		std::vector<Entity *> fileEntities;
+		AddEntities(file, 0, file.GetEntityCount(), fileEntities);
+	}
+
+	void Scene::AddEntities(const SceneFile &file, uint32_t first, uint32_t count, std::vector<Entity *> &fileEntities)
+	{
+		// fileEntities maps file indices to the entities created so far, parents are
+		// always stored before their children so they are already in there.
+		fileEntities.reserve(first + count);
+		_entities.reserve(_entities.size() + count);
+
+		// Names are resolved once per call, entities only index into them.
+		std::vector<Mesh *> meshes(file.GetMeshCount(), nullptr);
+		std::vector<Material *> materials(file.GetMaterialCount(), nullptr);
+
+		for(uint32_t i = first; i < first + count; i++)
+		{
+			const SceneFileEntity &data = file.GetEntity(i);
+
+			if(!meshes[data.mesh])
+				meshes[data.mesh] = GetMesh(file.GetMeshName(data.mesh));
+			if(!materials[data.material])
+				materials[data.material] = GetMaterial(file.GetMaterialName(data.material));
+
+			Entity *entity = new Entity(GetModel(meshes[data.mesh], materials[data.material]));
+			entity->SetPosition(RN::Vector3(data.position[0], data.position[1], data.position[2]));
+			entity->SetScale(RN::Vector3(data.scale[0], data.scale[1], data.scale[2]));
+			entity->SetRotation(RN::Quaternion(data.rotation[0], data.rotation[1], data.rotation[2], data.rotation[3]));
+			entity->SetBounds(RN::Vector3(data.boundsMin[0], data.boundsMin[1], data.boundsMin[2]), RN::Vector3(data.boundsMax[0], data.boundsMax[1], data.boundsMax[2]));
+			entity->SetStatic((data.flags & SceneFileEntityFlagStatic) != 0);
+
+			if(data.parent != SceneFileNoParent)
+				entity->SetParent(fileEntities[data.parent]);
+
+			fileEntities.push_back(entity);
+			_entities.push_back(entity);
+		}
+	}
+
+	void Scene::RemoveEntities(const std::vector<Entity *> &entities)
+	{
+		std::unordered_set<Entity *> removed(entities.begin(), entities.end());
+		_entities.erase(std::remove_if(_entities.begin(), _entities.end(), [&](Entity *entity) {
+			return removed.count(entity) > 0;
+		}), _entities.end());
+
+		for(Entity *entity : entities)
+			delete entity;
+	}
+
+	Mesh *Scene::GetMesh(const std::string &name)
+	{
+		auto iterator = _meshes.find(name);
+		if(iterator != _meshes.end())
+			return iterator->second;
+
+		Mesh *mesh = Mesh::WithName(_renderer, name);
+		_meshes[name] = mesh;
+		return mesh;
+	}
+
+	Material *Scene::GetMaterial(const std::string &name)
+	{
+		auto iterator = _materials.find(name);
+		if(iterator != _materials.end())
+			return iterator->second;
+
+		std::wstring shaderfile(name.begin(), name.end());
+		Material *material = new Material(_renderer, shaderfile.c_str());
+		_materials[name] = material;
+		return material;
+	}
+
+	Model *Scene::GetModel(Mesh *mesh, Material *material)
+	{
+		std::pair<Mesh *, Material *> key(mesh, material);
+
+		auto iterator = _models.find(key);
+		if(iterator != _models.end())
+			return iterator->second;
+
+		Model *model = new Model(mesh, material);
+		_models[key] = model;
+		return model;
 	}
-}
+}
\ No newline at end of file
@@ -1,18 +1,87 @@
 #pragma once
 
 #include <vector>
+#include <string>
+#include <unordered_map>
+#include <map>
+#include <memory>
+
+#include "LBSceneNode.h"
+#include "LBStaticBatcher.h"
 
 namespace LB
 {
 	class Entity;
 	class Application;
+	class Renderer;
+	class Mesh;
+	class Material;
+	class Model;
+	class SceneFile;
+	class SceneStreamer;
+	struct RenderSnapshot;
+	struct RenderItem;
 	class Scene
 	{
 	public:
 		friend Application;
-		Scene();
+		// Meshes and materials are created with renderer, which has to outlive the
+		// scene. The scene owns them and frees them again when it is deleted. Paths are passed on to the scene file as they are, resolving asset
+		// names is up to the caller.
+		Scene(Renderer *renderer);
+		Scene(Renderer *renderer, const std::string &path);
+		~Scene();
+
+		void Update(float delta);
+
+		// Copies the render relevant state of all entities into snapshot.
+		void Extract(RenderSnapshot &snapshot);
+
+		// Merges all static entities sharing a material into pre-transformed meshes,
+		// split into clusters of clusterSize units. The static entities stay alive for
+		// their children but are no longer rendered themselves, the clusters are
+		// extracted as the snapshots' static items. Entities of streamed chunks are
+		// left alone, they are deleted again with their chunk.
+		void BuildStaticBatches(float clusterSize = 16.0f);
+		const StaticBatchStatistics &GetStaticBatchStatistics() const
+		{
+			return _staticBatchStatistics;
+		}
+
+		// Registers a scene file that is streamed in once the camera gets close to
+		// the sphere described by center and radius.
+		uint32_t AddStreamingChunk(const std::string &path, const RN::Vector3 &center, float radius);
+		SceneStreamer *GetStreamer();
+
+		SceneNode &GetCamera()
+		{
+			return _camera;
+		}
 
 	private:
+		void LoadFromFile(const std::string &path);
+		void AddEntities(const SceneFile &file, uint32_t first, uint32_t count, std::vector<Entity *> &fileEntities);
+		void RemoveEntities(const std::vector<Entity *> &entities);
+
+		Mesh *GetMesh(const std::string &name);
+		Material *GetMaterial(const std::string &name);
+		Model *GetModel(Mesh *mesh, Material *material);
+
+		Renderer *_renderer;
+
 		std::vector<Entity *>_entities;
+		std::vector<Entity *>_staticEntities;
+		std::vector<Entity *>_staticClusters;
+		std::shared_ptr<const std::vector<RenderItem>> _staticItems;
+		SceneNode _camera;
+		StaticBatchStatistics _staticBatchStatistics;
+
+		std::unordered_map<std::string, Mesh *> _meshes;
+		std::unordered_map<std::string, Material *> _materials;
+		std::map<std::pair<Mesh *, Material *>, Model *> _models;
+		std::vector<Mesh *> _clusterMeshes;
+
+		std::unique_ptr<SceneStreamer> _streamer;
+		std::unordered_map<uint32_t, std::vector<Entity *>> _chunkEntities;
 	};
-}
+}
\ No newline at end of file
@@ -0,0 +1,402 @@
+#if defined(_WIN32)
+#include "stdafx.h"
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "LBSceneFile.h"
+
+#include <cstring>
+#include <cstdio>
+#include <stdexcept>
+
+namespace LB
+{
+	namespace
+	{
+		const uint32_t SceneFileAlignment = 16;
+
+		inline uint32_t AlignSceneOffset(uint32_t offset)
+		{
+			return (offset + SceneFileAlignment - 1) & ~(SceneFileAlignment - 1);
+		}
+
+		bool ValidateSection(const SceneFileHeader *header, uint32_t offset, uint64_t size, const char *name, std::string *error)
+		{
+			if((offset % SceneFileAlignment) != 0)
+			{
+				if(error)
+					*error = std::string(name) + " section is not aligned";
+				return false;
+			}
+
+			if(offset < sizeof(SceneFileHeader) || offset + size > header->fileSize)
+			{
+				if(error)
+					*error = std::string(name) + " section is out of bounds";
+				return false;
+			}
+
+			return true;
+		}
+
+		bool ValidateHeader(const void *data, size_t size, std::string *error)
+		{
+			if(size < sizeof(SceneFileHeader))
+			{
+				if(error)
+					*error = "File is smaller than the scene header";
+				return false;
+			}
+
+			const SceneFileHeader *header = reinterpret_cast<const SceneFileHeader *>(data);
+			if(header->magic != SceneFileMagic)
+			{
+				if(error)
+					*error = "Not a scene file";
+				return false;
+			}
+
+			if(header->version != SceneFileVersion)
+			{
+				if(error)
+					*error = "Unsupported scene file version " + std::to_string(header->version);
+				return false;
+			}
+
+			if(header->fileSize != size)
+			{
+				if(error)
+					*error = "File size does not match the header";
+				return false;
+			}
+
+			if(!ValidateSection(header, header->entityOffset, uint64_t(header->entityCount) * sizeof(SceneFileEntity), "Entity", error))
+				return false;
+			if(!ValidateSection(header, header->meshOffset, uint64_t(header->meshCount) * sizeof(uint32_t), "Mesh", error))
+				return false;
+			if(!ValidateSection(header, header->materialOffset, uint64_t(header->materialCount) * sizeof(uint32_t), "Material", error))
+				return false;
+			if(!ValidateSection(header, header->stringOffset, header->stringSize, "String", error))
+				return false;
+
+			const char *strings = reinterpret_cast<const char *>(data) + header->stringOffset;
+			if(header->stringSize > 0 && strings[header->stringSize - 1] != '\0')
+			{
+				if(error)
+					*error = "String table is not terminated";
+				return false;
+			}
+
+			return true;
+		}
+	}
+
+	SceneFile::SceneFile() :
+		_data(nullptr),
+		_size(0),
+#if defined(_WIN32)
+		_file(INVALID_HANDLE_VALUE),
+		_mapping(nullptr),
+#else
+		_file(-1),
+#endif
+		_header(nullptr),
+		_entities(nullptr),
+		_meshNames(nullptr),
+		_materialNames(nullptr),
+		_strings(nullptr)
+	{}
+
+	SceneFile::~SceneFile()
+	{
+		Close();
+	}
+
+#if defined(_WIN32)
+	void SceneFile::Open(const char *path)
+	{
+		std::wstring widePath(path, path + strlen(path));
+		Open(widePath.c_str());
+	}
+
+	void SceneFile::Open(const wchar_t *path)
+	{
+		Close();
+
+		_file = CreateFileW(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_RANDOM_ACCESS, nullptr);
+		if(_file == INVALID_HANDLE_VALUE)
+			throw std::runtime_error("Failed to open scene file");
+
+		LARGE_INTEGER fileSize;
+		if(!GetFileSizeEx(_file, &fileSize) || fileSize.HighPart != 0)
+		{
+			Close();
+			throw std::runtime_error("Invalid scene file size");
+		}
+
+		_mapping = CreateFileMappingW(_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		const void *data = _mapping ? MapViewOfFile(_mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+		if(!data)
+		{
+			Close();
+			throw std::runtime_error("Failed to map scene file");
+		}
+
+		Map(data, static_cast<size_t>(fileSize.QuadPart));
+	}
+
+	void SceneFile::Close()
+	{
+		if(_data)
+			UnmapViewOfFile(_data);
+		if(_mapping)
+			CloseHandle(_mapping);
+		if(_file != INVALID_HANDLE_VALUE)
+			CloseHandle(_file);
+
+		_data = nullptr;
+		_mapping = nullptr;
+		_file = INVALID_HANDLE_VALUE;
+		_size = 0;
+		_header = nullptr;
+	}
+#else
+	void SceneFile::Open(const char *path)
+	{
+		Close();
+
+		_file = open(path, O_RDONLY);
+		if(_file < 0)
+			throw std::runtime_error("Failed to open scene file");
+
+		struct stat info;
+		if(fstat(_file, &info) != 0 || info.st_size <= 0)
+		{
+			Close();
+			throw std::runtime_error("Invalid scene file size");
+		}
+
+		void *data = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, _file, 0);
+		if(data == MAP_FAILED)
+		{
+			Close();
+			throw std::runtime_error("Failed to map scene file");
+		}
+
+		_size = static_cast<size_t>(info.st_size);
+		_data = reinterpret_cast<const uint8_t *>(data);
+		Map(data, _size);
+	}
+
+	void SceneFile::Close()
+	{
+		if(_data)
+			munmap(const_cast<uint8_t *>(_data), _size);
+		if(_file >= 0)
+			close(_file);
+
+		_data = nullptr;
+		_file = -1;
+		_size = 0;
+		_header = nullptr;
+	}
+#endif
+
+	void SceneFile::Map(const void *data, size_t size)
+	{
+		_data = reinterpret_cast<const uint8_t *>(data);
+		_size = size;
+
+		// Entities index the name tables and their parents without further checks,
+		// so release builds validate everything as well. It is one pass of integer
+		// compares over memory that is touched on load anyway.
+		std::string error;
+		if(!Validate(data, size, &error))
+		{
+			Close();
+			throw std::runtime_error(error);
+		}
+
+		// Pointer fixups, the only work done on load.
+		_header = reinterpret_cast<const SceneFileHeader *>(_data);
+		_entities = reinterpret_cast<const SceneFileEntity *>(_data + _header->entityOffset);
+		_meshNames = reinterpret_cast<const uint32_t *>(_data + _header->meshOffset);
+		_materialNames = reinterpret_cast<const uint32_t *>(_data + _header->materialOffset);
+		_strings = reinterpret_cast<const char *>(_data + _header->stringOffset);
+	}
+
+	void SceneFile::Prefault() const
+	{
+		volatile uint8_t sink = 0;
+		for(size_t offset = 0; offset < _size; offset += 4096)
+			sink ^= _data[offset];
+		(void)sink;
+	}
+
+	bool SceneFile::Validate(const void *data, size_t size, std::string *error)
+	{
+		if(!ValidateHeader(data, size, error))
+			return false;
+
+		const uint8_t *bytes = reinterpret_cast<const uint8_t *>(data);
+		const SceneFileHeader *header = reinterpret_cast<const SceneFileHeader *>(bytes);
+		const SceneFileEntity *entities = reinterpret_cast<const SceneFileEntity *>(bytes + header->entityOffset);
+		const uint32_t *meshNames = reinterpret_cast<const uint32_t *>(bytes + header->meshOffset);
+		const uint32_t *materialNames = reinterpret_cast<const uint32_t *>(bytes + header->materialOffset);
+
+		for(uint32_t i = 0; i < header->meshCount; i++)
+		{
+			if(meshNames[i] >= header->stringSize)
+			{
+				if(error)
+					*error = "Mesh " + std::to_string(i) + " has an invalid name";
+				return false;
+			}
+		}
+
+		for(uint32_t i = 0; i < header->materialCount; i++)
+		{
+			if(materialNames[i] >= header->stringSize)
+			{
+				if(error)
+					*error = "Material " + std::to_string(i) + " has an invalid name";
+				return false;
+			}
+		}
+
+		for(uint32_t i = 0; i < header->entityCount; i++)
+		{
+			const SceneFileEntity &entity = entities[i];
+
+			if(entity.parent != SceneFileNoParent && (entity.parent < 0 || static_cast<uint32_t>(entity.parent) >= i))
+			{
+				if(error)
+					*error = "Entity " + std::to_string(i) + " references a parent that does not precede it";
+				return false;
+			}
+
+			if(entity.mesh >= header->meshCount || entity.material >= header->materialCount)
+			{
+				if(error)
+					*error = "Entity " + std::to_string(i) + " references an unknown mesh or material";
+				return false;
+			}
+
+			for(int n = 0; n < 3; n++)
+			{
+				if(!(entity.boundsMin[n] <= entity.boundsMax[n]))
+				{
+					if(error)
+						*error = "Entity " + std::to_string(i) + " has inverted bounds";
+					return false;
+				}
+			}
+		}
+
+		return true;
+	}
+
+
+	uint32_t SceneFileWriter::AddName(std::vector<std::string> &names, const std::string &name)
+	{
+		for(size_t i = 0; i < names.size(); i++)
+		{
+			if(names[i] == name)
+				return static_cast<uint32_t>(i);
+		}
+
+		names.push_back(name);
+		return static_cast<uint32_t>(names.size() - 1);
+	}
+
+	uint32_t SceneFileWriter::AddMesh(const std::string &name)
+	{
+		return AddName(_meshes, name);
+	}
+
+	uint32_t SceneFileWriter::AddMaterial(const std::string &name)
+	{
+		return AddName(_materials, name);
+	}
+
+	uint32_t SceneFileWriter::AddEntity(const SceneFileEntity &entity)
+	{
+		const uint32_t index = static_cast<uint32_t>(_entities.size());
+		if(entity.parent != SceneFileNoParent && (entity.parent < 0 || static_cast<uint32_t>(entity.parent) >= index))
+			throw std::invalid_argument("Scene entities must be added after their parent");
+
+		_entities.push_back(entity);
+		return index;
+	}
+
+	std::vector<uint8_t> SceneFileWriter::Serialize() const
+	{
+		std::vector<char> strings;
+		std::vector<uint32_t> meshNames;
+		std::vector<uint32_t> materialNames;
+
+		for(const std::string &name : _meshes)
+		{
+			meshNames.push_back(static_cast<uint32_t>(strings.size()));
+			strings.insert(strings.end(), name.begin(), name.end());
+			strings.push_back('\0');
+		}
+
+		for(const std::string &name : _materials)
+		{
+			materialNames.push_back(static_cast<uint32_t>(strings.size()));
+			strings.insert(strings.end(), name.begin(), name.end());
+			strings.push_back('\0');
+		}
+
+		SceneFileHeader header = {};
+		header.magic = SceneFileMagic;
+		header.version = SceneFileVersion;
+		header.entityCount = static_cast<uint32_t>(_entities.size());
+		header.meshCount = static_cast<uint32_t>(_meshes.size());
+		header.materialCount = static_cast<uint32_t>(_materials.size());
+		header.entityOffset = AlignSceneOffset(sizeof(SceneFileHeader));
+		header.meshOffset = AlignSceneOffset(header.entityOffset + header.entityCount * sizeof(SceneFileEntity));
+		header.materialOffset = AlignSceneOffset(header.meshOffset + header.meshCount * sizeof(uint32_t));
+		header.stringOffset = AlignSceneOffset(header.materialOffset + header.materialCount * sizeof(uint32_t));
+		header.stringSize = static_cast<uint32_t>(strings.size());
+		header.fileSize = AlignSceneOffset(header.stringOffset + header.stringSize);
+
+		std::vector<uint8_t> data(header.fileSize, 0);
+		memcpy(data.data(), &header, sizeof(header));
+		if(!_entities.empty())
+			memcpy(data.data() + header.entityOffset, _entities.data(), _entities.size() * sizeof(SceneFileEntity));
+		if(!meshNames.empty())
+			memcpy(data.data() + header.meshOffset, meshNames.data(), meshNames.size() * sizeof(uint32_t));
+		if(!materialNames.empty())
+			memcpy(data.data() + header.materialOffset, materialNames.data(), materialNames.size() * sizeof(uint32_t));
+		if(!strings.empty())
+			memcpy(data.data() + header.stringOffset, strings.data(), strings.size());
+
+		return data;
+	}
+
+	void SceneFileWriter::Write(const char *path) const
+	{
+		std::vector<uint8_t> data = Serialize();
+
+		FILE *file = nullptr;
+#if defined(_WIN32)
+		fopen_s(&file, path, "wb");
+#else
+		file = fopen(path, "wb");
+#endif
+		if(!file)
+			throw std::runtime_error("Failed to create scene file");
+
+		const size_t written = fwrite(data.data(), 1, data.size(), file);
+		fclose(file);
+
+		if(written != data.size())
+			throw std::runtime_error("Failed to write scene file");
+	}
+}
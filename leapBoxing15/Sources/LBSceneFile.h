@@ -0,0 +1,136 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace LB
+{
+	// Binary scene layout, version 1. Everything is little endian and every section
+	// starts on a 16 byte boundary so the file can be mapped and used in place.
+	//
+	//   SceneFileHeader
+	//   SceneFileEntity[entityCount]     parents always precede their children
+	//   uint32_t meshNames[meshCount]    offsets into the string table
+	//   uint32_t materialNames[materialCount]
+	//   char strings[stringSize]         NUL terminated names
+
+	static const uint32_t SceneFileMagic = 0x4353424C; // "LBSC"
+	static const uint32_t SceneFileVersion = 1;
+	static const int32_t SceneFileNoParent = -1;
+
+	enum SceneFileEntityFlags : uint32_t
+	{
+		SceneFileEntityFlagStatic = (1 << 0)
+	};
+
+	struct SceneFileHeader
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint32_t fileSize;
+		uint32_t entityCount;
+		uint32_t meshCount;
+		uint32_t materialCount;
+		uint32_t entityOffset;
+		uint32_t meshOffset;
+		uint32_t materialOffset;
+		uint32_t stringOffset;
+		uint32_t stringSize;
+		uint32_t reserved;
+	};
+
+	struct SceneFileEntity
+	{
+		float position[3];
+		float scale[3];
+		float rotation[4];
+		int32_t parent;
+		uint32_t mesh;
+		uint32_t material;
+		uint32_t flags;
+		float boundsMin[3];
+		float boundsMax[3];
+	};
+
+	static_assert(sizeof(SceneFileHeader) == 48, "SceneFileHeader layout changed");
+	static_assert(sizeof(SceneFileEntity) == 80, "SceneFileEntity layout changed");
+
+	// Read only view of a mapped scene file. Opening validates the file and
+	// resolves the section offsets into pointers, the entity data is never copied.
+	class SceneFile
+	{
+	public:
+		SceneFile();
+		~SceneFile();
+
+		void Open(const char *path);
+#if defined(_WIN32)
+		void Open(const wchar_t *path);
+#endif
+		void Close();
+
+		// Reads one byte of every page so later accesses don't fault, used by
+		// background loaders to keep page faults off the main thread.
+		void Prefault() const;
+
+		// Checks a scene image for structural consistency, returns false and fills
+		// error with the first problem found.
+		static bool Validate(const void *data, size_t size, std::string *error);
+
+		uint32_t GetEntityCount() const { return _header ? _header->entityCount : 0; }
+		uint32_t GetMeshCount() const { return _header ? _header->meshCount : 0; }
+		uint32_t GetMaterialCount() const { return _header ? _header->materialCount : 0; }
+
+		const SceneFileEntity &GetEntity(uint32_t index) const { return _entities[index]; }
+		const SceneFileEntity *GetEntities() const { return _entities; }
+		const char *GetMeshName(uint32_t index) const { return _strings + _meshNames[index]; }
+		const char *GetMaterialName(uint32_t index) const { return _strings + _materialNames[index]; }
+
+		size_t GetSize() const { return _size; }
+
+	private:
+		SceneFile(const SceneFile &) = delete;
+		void operator=(const SceneFile &) = delete;
+
+		void Map(const void *data, size_t size);
+
+		const uint8_t *_data;
+		size_t _size;
+
+#if defined(_WIN32)
+		void *_file;
+		void *_mapping;
+#else
+		int _file;
+#endif
+
+		const SceneFileHeader *_header;
+		const SceneFileEntity *_entities;
+		const uint32_t *_meshNames;
+		const uint32_t *_materialNames;
+		const char *_strings;
+	};
+
+	class SceneFileWriter
+	{
+	public:
+		uint32_t AddMesh(const std::string &name);
+		uint32_t AddMaterial(const std::string &name);
+
+		// Entities have to be added parents first, the returned index is what
+		// children reference as their parent.
+		uint32_t AddEntity(const SceneFileEntity &entity);
+
+		std::vector<uint8_t> Serialize() const;
+		void Write(const char *path) const;
+
+	private:
+		static uint32_t AddName(std::vector<std::string> &names, const std::string &name);
+
+		std::vector<std::string> _meshes;
+		std::vector<std::string> _materials;
+		std::vector<SceneFileEntity> _entities;
+	};
+}
@@ -1,8 +1,21 @@
+#if defined(_WIN32)
 #include "stdafx.h"
+#endif
+
 #include "LBSceneNode.h"
 
 namespace LB
 {
+	SceneNode::SceneNode() : _parent(nullptr), _scale(1.0f), _modelMatrixIsDirty(true)
+	{
+
+	}
+
+	SceneNode::~SceneNode()
+	{
+
+	}
+
 	const RN::Matrix &SceneNode::GetModelMatrix()
 	{
 		if(_modelMatrixIsDirty)
@@ -10,8 +23,17 @@ namespace LB
 			_modelMatrix = RN::Matrix::WithTranslation(_position);
 			_modelMatrix *= RN::Matrix::WithRotation(_rotation);
 			_modelMatrix *= RN::Matrix::WithScaling(_scale);
+			_modelMatrixIsDirty = false;
 		}
 
 		return _modelMatrix;
 	}
+
+	RN::Matrix SceneNode::GetWorldMatrix()
+	{
+		if(!_parent)
+			return GetModelMatrix();
+
+		return _parent->GetWorldMatrix() * GetModelMatrix();
+	}
 }
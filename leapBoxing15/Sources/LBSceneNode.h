@@ -9,7 +9,21 @@ namespace LB
 	class SceneNode
 	{
 	public:
+		SceneNode();
+		virtual ~SceneNode();
+
 		const RN::Matrix &GetModelMatrix();
+		RN::Matrix GetWorldMatrix();
+
+		inline void SetParent(SceneNode *parent)
+		{
+			_parent = parent;
+		}
+
+		inline SceneNode *GetParent() const
+		{
+			return _parent;
+		}
 
 		inline void SetRotation(const RN::Quaternion &rotation)
 		{
@@ -45,6 +59,8 @@ namespace LB
 		}
 
 	private:
+		SceneNode *_parent;
+
 		RN::Vector3 _position;
 		RN::Vector3 _scale;
 		RN::Quaternion _rotation;
@@ -0,0 +1,325 @@
+#if defined(_WIN32)
+#include "stdafx.h"
+#endif
+
+#include "LBSceneStreamer.h"
+#include "LBSceneFile.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+namespace LB
+{
+	namespace
+	{
+		// Number of entities handed to the integrate callback between budget checks.
+		const uint32_t IntegrationSlice = 64;
+
+		// Integration is only checked between slices, so small overshoots are expected
+		// and a frame only counts as a hitch once it overruns the budget noticeably.
+		const double HitchFactor = 1.5;
+	}
+
+	SceneStreamer::SceneStreamer(IntegrateCallback integrate, UnloadCallback unload, uint32_t loaderThreads) :
+		_integrate(integrate),
+		_unload(unload),
+		_loadDistance(50.0f),
+		_unloadDistance(60.0f),
+		_budgetMilliseconds(2.0),
+		_budgetBytes(1024 * 1024),
+		_integrating(nullptr),
+		_loading(0),
+		_shutdown(false),
+		_statistics()
+	{
+		for(uint32_t i = 0; i < std::max(loaderThreads, 1u); i++)
+			_threads.emplace_back(&SceneStreamer::LoaderThread, this);
+	}
+
+	SceneStreamer::~SceneStreamer()
+	{
+		{
+			std::lock_guard<std::mutex> lock(_lock);
+			_shutdown = true;
+		}
+
+		_condition.notify_all();
+
+		for(std::thread &thread : _threads)
+			thread.join();
+	}
+
+	uint32_t SceneStreamer::AddChunk(const std::string &path, const float center[3], float radius)
+	{
+		std::unique_ptr<Chunk> chunk(new Chunk());
+		chunk->index = static_cast<uint32_t>(_chunks.size());
+		chunk->path = path;
+		std::copy(center, center + 3, chunk->center);
+		chunk->radius = radius;
+		chunk->distance = 0.0f;
+		chunk->state = ChunkState::Unloaded;
+		chunk->cancelled = false;
+		chunk->size = 0;
+		chunk->integrated = 0;
+
+		std::lock_guard<std::mutex> lock(_lock);
+		_chunks.push_back(std::move(chunk));
+
+		return _chunks.back()->index;
+	}
+
+	void SceneStreamer::SetStreamingDistances(float loadDistance, float unloadDistance)
+	{
+		_loadDistance = loadDistance;
+		_unloadDistance = std::max(loadDistance, unloadDistance);
+	}
+
+	void SceneStreamer::SetFrameBudget(double milliseconds, uint64_t bytes)
+	{
+		_budgetMilliseconds = milliseconds;
+		_budgetBytes = bytes;
+	}
+
+	void SceneStreamer::Update(const float viewerPosition[3])
+	{
+		std::vector<uint32_t> unload;
+		bool requested = false;
+
+		{
+			std::lock_guard<std::mutex> lock(_lock);
+
+			for(std::unique_ptr<Chunk> &chunk : _chunks)
+			{
+				const float dx = viewerPosition[0] - chunk->center[0];
+				const float dy = viewerPosition[1] - chunk->center[1];
+				const float dz = viewerPosition[2] - chunk->center[2];
+				chunk->distance = std::max(std::sqrt(dx * dx + dy * dy + dz * dz) - chunk->radius, 0.0f);
+
+				if(chunk->distance <= _loadDistance)
+				{
+					if(chunk->state == ChunkState::Unloaded)
+					{
+						chunk->state = ChunkState::Queued;
+						_pending.push_back(chunk.get());
+						requested = true;
+					}
+					else if(chunk->state == ChunkState::Loading)
+					{
+						chunk->cancelled = false;
+					}
+				}
+				else if(chunk->distance > _unloadDistance)
+				{
+					switch(chunk->state)
+					{
+						case ChunkState::Queued:
+							_pending.erase(std::find(_pending.begin(), _pending.end(), chunk.get()));
+							chunk->state = ChunkState::Unloaded;
+							break;
+
+						case ChunkState::Loading:
+							chunk->cancelled = true;
+							break;
+
+						case ChunkState::Loaded:
+							_loaded.erase(std::find(_loaded.begin(), _loaded.end(), chunk.get()));
+							_statistics.bytesInFlight -= chunk->size;
+							chunk->file.reset();
+							chunk->state = ChunkState::Unloaded;
+							break;
+
+						case ChunkState::Integrating:
+						case ChunkState::Resident:
+							unload.push_back(chunk->index);
+							break;
+
+						default:
+							break;
+					}
+				}
+			}
+		}
+
+		if(requested)
+			_condition.notify_all();
+
+		for(uint32_t index : unload)
+			UnloadChunk(index);
+	}
+
+	void SceneStreamer::Integrate()
+	{
+		typedef std::chrono::high_resolution_clock Clock;
+
+		const Clock::time_point start = Clock::now();
+		uint64_t bytes = 0;
+		bool exhausted = false;
+
+		while(!exhausted)
+		{
+			if(!_integrating)
+			{
+				std::lock_guard<std::mutex> lock(_lock);
+				_integrating = PopNearest(_loaded);
+
+				if(!_integrating)
+					break;
+
+				_integrating->state = ChunkState::Integrating;
+			}
+
+			Chunk *chunk = _integrating;
+			const uint32_t total = chunk->file->GetEntityCount();
+
+			while(chunk->integrated < total)
+			{
+				const uint32_t count = std::min(IntegrationSlice, total - chunk->integrated);
+				_integrate(chunk->index, *chunk->file, chunk->integrated, count);
+
+				chunk->integrated += count;
+				bytes += count * sizeof(SceneFileEntity);
+
+				const double elapsed = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+				if(elapsed >= _budgetMilliseconds || bytes >= _budgetBytes)
+				{
+					exhausted = true;
+					break;
+				}
+			}
+
+			if(chunk->integrated == total)
+			{
+				std::lock_guard<std::mutex> lock(_lock);
+				chunk->state = ChunkState::Resident;
+				chunk->file.reset();
+				_statistics.bytesInFlight -= chunk->size;
+				_statistics.residentChunks++;
+				_statistics.chunksLoaded++;
+				_integrating = nullptr;
+			}
+		}
+
+		const double elapsed = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+		std::lock_guard<std::mutex> lock(_lock);
+		_statistics.bytesIntegratedLastFrame = bytes;
+		_statistics.integrationMillisecondsLastFrame = elapsed;
+		_statistics.integrationMillisecondsMax = std::max(_statistics.integrationMillisecondsMax, elapsed);
+
+		if(elapsed > _budgetMilliseconds * HitchFactor)
+			_statistics.hitches++;
+	}
+
+	bool SceneStreamer::IsChunkResident(uint32_t chunk) const
+	{
+		std::lock_guard<std::mutex> lock(_lock);
+		return _chunks[chunk]->state == ChunkState::Resident;
+	}
+
+	SceneStreamingStatistics SceneStreamer::GetStatistics() const
+	{
+		std::lock_guard<std::mutex> lock(_lock);
+
+		SceneStreamingStatistics statistics = _statistics;
+		statistics.queueDepth = static_cast<uint32_t>(_pending.size() + _loaded.size()) + _loading + (_integrating ? 1 : 0);
+		return statistics;
+	}
+
+	void SceneStreamer::LoaderThread()
+	{
+		while(true)
+		{
+			Chunk *chunk;
+			std::string path;
+
+			{
+				std::unique_lock<std::mutex> lock(_lock);
+				_condition.wait(lock, [this] { return _shutdown || !_pending.empty(); });
+
+				if(_shutdown)
+					return;
+
+				chunk = PopNearest(_pending);
+				chunk->state = ChunkState::Loading;
+				chunk->cancelled = false;
+				path = chunk->path;
+				_loading++;
+			}
+
+			std::unique_ptr<SceneFile> file(new SceneFile());
+
+			try
+			{
+				file->Open(path.c_str());
+				file->Prefault();
+			}
+			catch(std::exception &)
+			{
+				file.reset();
+			}
+
+			std::lock_guard<std::mutex> lock(_lock);
+			_loading--;
+
+			if(!file)
+			{
+				chunk->state = ChunkState::Failed;
+				continue;
+			}
+
+			if(chunk->cancelled)
+			{
+				chunk->state = ChunkState::Unloaded;
+				chunk->cancelled = false;
+				continue;
+			}
+
+			chunk->size = file->GetSize();
+			chunk->file = std::move(file);
+			chunk->integrated = 0;
+			chunk->state = ChunkState::Loaded;
+
+			_loaded.push_back(chunk);
+			_statistics.bytesInFlight += chunk->size;
+		}
+	}
+
+	SceneStreamer::Chunk *SceneStreamer::PopNearest(std::vector<Chunk *> &chunks)
+	{
+		if(chunks.empty())
+			return nullptr;
+
+		auto nearest = std::min_element(chunks.begin(), chunks.end(), [](const Chunk *a, const Chunk *b) {
+			return a->distance < b->distance;
+		});
+
+		Chunk *chunk = *nearest;
+		chunks.erase(nearest);
+		return chunk;
+	}
+
+	void SceneStreamer::UnloadChunk(uint32_t index)
+	{
+		Chunk *chunk = _chunks[index].get();
+
+		_unload(index);
+
+		std::lock_guard<std::mutex> lock(_lock);
+
+		if(chunk->state == ChunkState::Resident)
+		{
+			_statistics.residentChunks--;
+		}
+		else
+		{
+			_statistics.bytesInFlight -= chunk->size;
+			_integrating = nullptr;
+		}
+
+		chunk->file.reset();
+		chunk->integrated = 0;
+		chunk->state = ChunkState::Unloaded;
+		_statistics.chunksUnloaded++;
+	}
+}
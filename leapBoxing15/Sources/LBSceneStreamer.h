@@ -0,0 +1,105 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace LB
+{
+	class SceneFile;
+
+	struct SceneStreamingStatistics
+	{
+		uint32_t queueDepth;				// Chunks waiting for a loader or for integration
+		uint64_t bytesInFlight;				// File bytes loaded or loading but not integrated yet
+		uint32_t residentChunks;
+		uint32_t hitches;					// Frames whose integration step overran the time budget
+		uint64_t chunksLoaded;
+		uint64_t chunksUnloaded;
+		uint64_t bytesIntegratedLastFrame;
+		double integrationMillisecondsLastFrame;
+		double integrationMillisecondsMax;
+	};
+
+	// Streams scene file chunks in and out around a viewer position. Files are opened
+	// and prefaulted on background threads, the main thread then integrates the
+	// loaded entities in slices capped by a per frame time and byte budget.
+	class SceneStreamer
+	{
+	public:
+		typedef std::function<void (uint32_t chunk, const SceneFile &file, uint32_t first, uint32_t count)> IntegrateCallback;
+		typedef std::function<void (uint32_t chunk)> UnloadCallback;
+
+		SceneStreamer(IntegrateCallback integrate, UnloadCallback unload, uint32_t loaderThreads = 2);
+		~SceneStreamer();
+
+		uint32_t AddChunk(const std::string &path, const float center[3], float radius);
+
+		void SetStreamingDistances(float loadDistance, float unloadDistance);
+		void SetFrameBudget(double milliseconds, uint64_t bytes);
+
+		// Main thread only. Update reprioritizes and requests or drops chunks for the
+		// viewer position, Integrate then spends at most one frame budget.
+		void Update(const float viewerPosition[3]);
+		void Integrate();
+
+		bool IsChunkResident(uint32_t chunk) const;
+		SceneStreamingStatistics GetStatistics() const;
+
+	private:
+		enum class ChunkState
+		{
+			Unloaded,
+			Queued,
+			Loading,
+			Loaded,
+			Integrating,
+			Resident,
+			Failed
+		};
+
+		struct Chunk
+		{
+			uint32_t index;
+			std::string path;
+			float center[3];
+			float radius;
+			float distance;
+			ChunkState state;
+			bool cancelled;
+			uint64_t size;
+			uint32_t integrated;
+			std::unique_ptr<SceneFile> file;
+		};
+
+		void LoaderThread();
+		Chunk *PopNearest(std::vector<Chunk *> &chunks);
+		void UnloadChunk(uint32_t index);
+
+		IntegrateCallback _integrate;
+		UnloadCallback _unload;
+
+		float _loadDistance;
+		float _unloadDistance;
+		double _budgetMilliseconds;
+		uint64_t _budgetBytes;
+
+		std::vector<std::unique_ptr<Chunk>> _chunks;
+		std::vector<Chunk *> _pending;
+		std::vector<Chunk *> _loaded;
+		Chunk *_integrating;
+		uint32_t _loading;
+
+		mutable std::mutex _lock;
+		std::condition_variable _condition;
+		std::vector<std::thread> _threads;
+		bool _shutdown;
+
+		SceneStreamingStatistics _statistics;
+	};
+}
@@ -0,0 +1,66 @@
+#include "stdafx.h"
+#include "LBShaderCache.h"
+
+#include <memory>
+#include <vector>
+
+namespace LB
+{
+	static std::string NarrowPath(const std::wstring &path)
+	{
+		const int length = WideCharToMultiByte(CP_UTF8, 0, path.c_str(), -1, nullptr, 0, nullptr, nullptr);
+		if(length <= 0)
+			return std::string();
+
+		std::string narrowPath(length, '\0');
+		WideCharToMultiByte(CP_UTF8, 0, path.c_str(), -1, &narrowPath[0], length, nullptr, nullptr);
+		narrowPath.resize(length - 1);
+
+		return narrowPath;
+	}
+
+	ShaderCache::ShaderCache(const std::wstring &directory) : _cache(NarrowPath(directory))
+	{
+		CreateDirectoryW(directory.c_str(), nullptr);
+	}
+
+	Microsoft::WRL::ComPtr<ID3DBlob> ShaderCache::GetShader(const std::wstring &path, const char *entryPoint, const char *target, UINT flags, const D3D_SHADER_MACRO *defines)
+	{
+		byte *source = nullptr;
+		UINT sourceSize = 0;
+		ThrowIfFailed(ReadDataFromFile(path.c_str(), &source, &sourceSize));
+		std::unique_ptr<byte, void (*)(void *)> sourceData(source, free);
+
+		std::vector<ShaderDefine> keyDefines;
+		for(const D3D_SHADER_MACRO *define = defines; define && define->Name; define++)
+			keyDefines.push_back({ define->Name, define->Definition });
+
+		PipelineKey key;
+		BuildShaderKey(source, sourceSize, entryPoint, target, keyDefines.data(), keyDefines.size(), flags, D3D_COMPILER_VERSION, key);
+
+		std::shared_ptr<const ShaderBytecodeCache::Bytecode> bytecode = _cache.Get(key, [&]() {
+			const std::string sourceName = NarrowPath(path);
+
+			Microsoft::WRL::ComPtr<ID3DBlob> shader;
+			Microsoft::WRL::ComPtr<ID3DBlob> errors;
+			const HRESULT result = D3DCompile(source, sourceSize, sourceName.c_str(), defines, nullptr, entryPoint, target, flags, 0, &shader, &errors);
+			if(FAILED(result) && errors)
+				OutputDebugStringA(static_cast<const char *>(errors->GetBufferPointer()));
+			ThrowIfFailed(result);
+
+			const uint8_t *data = static_cast<const uint8_t *>(shader->GetBufferPointer());
+			return ShaderBytecodeCache::Bytecode(data, data + shader->GetBufferSize());
+		});
+
+		Microsoft::WRL::ComPtr<ID3DBlob> shader;
+		ThrowIfFailed(D3DCreateBlob(bytecode->size(), &shader));
+		memcpy(shader->GetBufferPointer(), bytecode->data(), bytecode->size());
+
+		return shader;
+	}
+
+	ShaderCacheStatistics ShaderCache::GetStatistics()
+	{
+		return _cache.GetStatistics();
+	}
+}
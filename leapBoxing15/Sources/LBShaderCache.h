@@ -0,0 +1,26 @@
+#pragma once
+
+#include <string>
+
+#include "LBShaderCacheFile.h"
+
+namespace LB
+{
+	// Compiled shaders by a hash of their source, entry point, profile, defines
+	// and flags. Bytecode is kept in memory for the run and in one file per key
+	// in the cache directory, shaders are only compiled if neither has them. The
+	// build runs the application with -precompileshaders to fill the directory,
+	// so a fresh build starts without compiling.
+	class ShaderCache
+	{
+	public:
+		ShaderCache(const std::wstring &directory);
+
+		Microsoft::WRL::ComPtr<ID3DBlob> GetShader(const std::wstring &path, const char *entryPoint, const char *target, UINT flags, const D3D_SHADER_MACRO *defines = nullptr);
+
+		ShaderCacheStatistics GetStatistics();
+
+	private:
+		ShaderBytecodeCache _cache;
+	};
+}
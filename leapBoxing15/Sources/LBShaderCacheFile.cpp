@@ -0,0 +1,236 @@
+#if defined(_WIN32)
+#include "stdafx.h"
+#endif
+
+#include "LBShaderCacheFile.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+#include <thread>
+
+namespace LB
+{
+	static uint64_t ChecksumBytecode(const void *bytecode, size_t size)
+	{
+		PipelineKey checksum;
+		checksum.AddBytes(bytecode, size);
+		return checksum.GetHash();
+	}
+
+#if defined(_WIN32)
+	static std::wstring WidenPath(const std::string &path)
+	{
+		const int length = MultiByteToWideChar(CP_UTF8, 0, path.c_str(), -1, nullptr, 0);
+		if(length <= 0)
+			return std::wstring();
+
+		std::wstring widePath(length, L'\0');
+		MultiByteToWideChar(CP_UTF8, 0, path.c_str(), -1, &widePath[0], length);
+		widePath.resize(length - 1);
+
+		return widePath;
+	}
+#endif
+
+	static FILE *OpenPath(const std::string &path, const char *mode)
+	{
+		FILE *file = nullptr;
+#if defined(_WIN32)
+		const std::wstring wideMode(mode, mode + strlen(mode));
+		_wfopen_s(&file, WidenPath(path).c_str(), wideMode.c_str());
+#else
+		file = fopen(path.c_str(), mode);
+#endif
+		return file;
+	}
+
+	// Returns false if the file doesn't exist or can't be read completely.
+	static bool LoadPath(const std::string &path, std::vector<uint8_t> &data)
+	{
+		FILE *file = OpenPath(path, "rb");
+		if(!file)
+			return false;
+
+		fseek(file, 0, SEEK_END);
+		const long size = ftell(file);
+		fseek(file, 0, SEEK_SET);
+
+		size_t read = 0;
+		if(size > 0)
+		{
+			data.resize(static_cast<size_t>(size));
+			read = fread(data.data(), 1, data.size(), file);
+		}
+
+		fclose(file);
+		return size >= 0 && read == static_cast<size_t>(size);
+	}
+
+	static bool MovePath(const std::string &from, const std::string &to)
+	{
+#if defined(_WIN32)
+		return MoveFileExW(WidenPath(from).c_str(), WidenPath(to).c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+		return rename(from.c_str(), to.c_str()) == 0;
+#endif
+	}
+
+	static void RemovePath(const std::string &path)
+	{
+#if defined(_WIN32)
+		_wremove(WidenPath(path).c_str());
+#else
+		remove(path.c_str());
+#endif
+	}
+
+	void BuildShaderKey(const void *source, size_t sourceSize, const char *entryPoint, const char *target, const ShaderDefine *defines, size_t defineCount, uint32_t flags, uint32_t compilerVersion, PipelineKey &key)
+	{
+		key.Clear();
+		key.AddUInt32(ShaderCacheFileVersion);
+		key.AddUInt32(compilerVersion);
+		key.AddUInt64(sourceSize);
+		key.AddBytes(source, sourceSize);
+		key.AddString(entryPoint);
+		key.AddString(target);
+
+		key.AddUInt32(static_cast<uint32_t>(defineCount));
+		for(size_t i = 0; i < defineCount; i++)
+		{
+			key.AddString(defines[i].name);
+			key.AddString(defines[i].value);
+		}
+
+		key.AddUInt32(flags);
+	}
+
+	std::vector<uint8_t> WriteShaderCacheFile(uint64_t keyHash, const void *bytecode, size_t bytecodeSize)
+	{
+		ShaderCacheFileHeader header;
+		memset(&header, 0, sizeof(header));
+		header.magic = ShaderCacheFileMagic;
+		header.version = ShaderCacheFileVersion;
+		header.keyHash = keyHash;
+		header.checksum = ChecksumBytecode(bytecode, bytecodeSize);
+		header.bytecodeSize = static_cast<uint32_t>(bytecodeSize);
+
+		std::vector<uint8_t> data(sizeof(header) + bytecodeSize);
+		memcpy(data.data(), &header, sizeof(header));
+		if(bytecodeSize > 0)
+			memcpy(data.data() + sizeof(header), bytecode, bytecodeSize);
+
+		return data;
+	}
+
+	bool ReadShaderCacheFile(const void *data, size_t size, uint64_t keyHash, const uint8_t **bytecode, size_t *bytecodeSize)
+	{
+		if(size < sizeof(ShaderCacheFileHeader))
+			return false;
+
+		ShaderCacheFileHeader header;
+		memcpy(&header, data, sizeof(header));
+
+		if(header.magic != ShaderCacheFileMagic || header.version != ShaderCacheFileVersion || header.keyHash != keyHash)
+			return false;
+
+		if(header.bytecodeSize != size - sizeof(header))
+			return false;
+
+		const uint8_t *payload = static_cast<const uint8_t *>(data) + sizeof(header);
+		if(ChecksumBytecode(payload, header.bytecodeSize) != header.checksum)
+			return false;
+
+		*bytecode = payload;
+		*bytecodeSize = header.bytecodeSize;
+		return true;
+	}
+
+	ShaderBytecodeCache::ShaderBytecodeCache(const std::string &directory) : _directory(directory), _statistics()
+	{
+
+	}
+
+	std::shared_ptr<const ShaderBytecodeCache::Bytecode> ShaderBytecodeCache::Get(const PipelineKey &key, const std::function<Bytecode ()> &compile)
+	{
+		std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+
+		{
+			std::lock_guard<std::mutex> lock(_lock);
+
+			auto iterator = _shaders.find(key.GetHash());
+			if(iterator != _shaders.end())
+			{
+				_statistics.memoryHits++;
+				return iterator->second;
+			}
+		}
+
+		const std::string path = GetPath(key);
+		std::shared_ptr<const Bytecode> shader;
+
+		std::vector<uint8_t> data;
+		if(LoadPath(path, data))
+		{
+			const uint8_t *bytecode = nullptr;
+			size_t bytecodeSize = 0;
+			if(ReadShaderCacheFile(data.data(), data.size(), key.GetHash(), &bytecode, &bytecodeSize))
+				shader = std::make_shared<const Bytecode>(bytecode, bytecode + bytecodeSize);
+
+			std::lock_guard<std::mutex> lock(_lock);
+			if(shader)
+			{
+				_statistics.diskHits++;
+				_statistics.loadMilliseconds += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+			}
+			else
+			{
+				_statistics.rejected++;
+			}
+		}
+
+		if(!shader)
+		{
+			shader = std::make_shared<const Bytecode>(compile());
+
+			// Written under a name of its own first, so a concurrent writer or reader
+			// never sees a partial file.
+			const std::vector<uint8_t> file = WriteShaderCacheFile(key.GetHash(), shader->data(), shader->size());
+
+			std::stringstream temporaryPath;
+			temporaryPath << path << "." << std::this_thread::get_id();
+
+			FILE *temporary = OpenPath(temporaryPath.str(), "wb");
+			if(temporary)
+			{
+				const size_t written = fwrite(file.data(), 1, file.size(), temporary);
+				fclose(temporary);
+
+				if(written != file.size() || !MovePath(temporaryPath.str(), path))
+					RemovePath(temporaryPath.str());
+			}
+
+			std::lock_guard<std::mutex> lock(_lock);
+			_statistics.misses++;
+			_statistics.compileMilliseconds += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+		}
+
+		// Another thread may have added the same key meanwhile, everyone gets the
+		// first one.
+		std::lock_guard<std::mutex> lock(_lock);
+		return _shaders.emplace(key.GetHash(), shader).first->second;
+	}
+
+	std::string ShaderBytecodeCache::GetPath(const PipelineKey &key) const
+	{
+		const std::wstring name = key.GetName();
+		return _directory + "/" + std::string(name.begin(), name.end()) + ".cso";
+	}
+
+	ShaderCacheStatistics ShaderBytecodeCache::GetStatistics()
+	{
+		std::lock_guard<std::mutex> lock(_lock);
+		return _statistics;
+	}
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "LBPipelineCache.h"
+
+namespace LB
+{
+	// Compiled shader cache entry, version 1, little endian.
+	//
+	//   ShaderCacheFileHeader
+	//   uint8_t bytecode[bytecodeSize]
+	//
+	// Files are named after the key hash, the hash is repeated in the header so a
+	// renamed or stale file is never used. The checksum catches truncated writes.
+
+	static const uint32_t ShaderCacheFileMagic = 0x4353534C; // "LSSC"
+	static const uint32_t ShaderCacheFileVersion = 1;
+
+	struct ShaderCacheFileHeader
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint64_t keyHash;
+		uint64_t checksum;
+		uint32_t bytecodeSize;
+		uint32_t reserved;
+	};
+
+	static_assert(sizeof(ShaderCacheFileHeader) == 32, "ShaderCacheFileHeader layout changed");
+
+	struct ShaderDefine
+	{
+		const char *name;
+		const char *value;
+	};
+
+	// Everything that changes the compiled bytecode goes into the key: the full
+	// source, entry point, target profile, defines, compile flags and the
+	// compiler version.
+	void BuildShaderKey(const void *source, size_t sourceSize, const char *entryPoint, const char *target, const ShaderDefine *defines, size_t defineCount, uint32_t flags, uint32_t compilerVersion, PipelineKey &key);
+
+	std::vector<uint8_t> WriteShaderCacheFile(uint64_t keyHash, const void *bytecode, size_t bytecodeSize);
+
+	// Returns false if data is no valid entry for keyHash.
+	bool ReadShaderCacheFile(const void *data, size_t size, uint64_t keyHash, const uint8_t **bytecode, size_t *bytecodeSize);
+
+	struct ShaderCacheStatistics
+	{
+		uint32_t memoryHits;		// Already loaded or compiled in this run
+		uint32_t diskHits;			// Loaded from the cache directory
+		uint32_t misses;			// Compiled
+		uint32_t rejected;			// Cache files that didn't match their key
+		double loadMilliseconds;
+		double compileMilliseconds;
+	};
+
+	// Bytecode by shader key, kept in memory for the run and in one file per key
+	// in the directory, which has to exist. The compile function is only called
+	// if neither has the key, and its result is written to the directory. A file
+	// that doesn't match its key is compiled again and replaced. Paths are UTF-8.
+	class ShaderBytecodeCache
+	{
+	public:
+		typedef std::vector<uint8_t> Bytecode;
+
+		ShaderBytecodeCache(const std::string &directory);
+
+		std::shared_ptr<const Bytecode> Get(const PipelineKey &key, const std::function<Bytecode ()> &compile);
+
+		std::string GetPath(const PipelineKey &key) const;
+		ShaderCacheStatistics GetStatistics();
+
+	private:
+		std::string _directory;
+
+		std::mutex _lock;
+		std::unordered_map<uint64_t, std::shared_ptr<const Bytecode>> _shaders;
+		ShaderCacheStatistics _statistics;
+	};
+}
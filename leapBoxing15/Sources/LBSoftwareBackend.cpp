@@ -0,0 +1,438 @@
+#if defined(_WIN32)
+#include "stdafx.h"
+#endif
+
+#include "LBSoftwareBackend.h"
+#include "LBImageFile.h"
+#include "LBInstanceStream.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+
+namespace LB
+{
+	// Row major and for row vectors, like the matrices in the constant buffers.
+	static void MultiplyMatrices(const float *a, const float *b, float *result)
+	{
+		for(int row = 0; row < 4; row++)
+		{
+			for(int column = 0; column < 4; column++)
+			{
+				float sum = 0.0f;
+				for(int i = 0; i < 4; i++)
+					sum += a[row * 4 + i] * b[i * 4 + column];
+
+				result[row * 4 + column] = sum;
+			}
+		}
+	}
+
+	SoftwareBackend::SoftwareBackend(uint32_t width, uint32_t height, uint32_t frameCount, int32_t workers) : HeadlessBackend(width, height, frameCount), _workerPool(workers), _rasterizer(&_workerPool), _renderTarget(nullptr), _depthBuffer(nullptr), _presentedImage(nullptr), _upscaled(false), _framePixelsWritten(0), _overdraw(0.0), _frameMilliseconds(0.0), _gpuMilliseconds(0.0)
+	{
+		memset(&_state, 0, sizeof(_state));
+	}
+
+	void SoftwareBackend::Resize(uint32_t width, uint32_t height)
+	{
+		_rasterizer.Flush();
+
+		HeadlessBackend::Resize(width, height);
+
+		_renderTarget = nullptr;
+		_presentedImage = nullptr;
+	}
+
+	void SoftwareBackend::Present()
+	{
+		std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+
+		_rasterizer.Flush();
+		_presentedImage = GetBackBuffer(GetBackBufferIndex());
+
+		_upscaled = GetSourceWidth() != GetWidth() || GetSourceHeight() != GetHeight();
+		if(_upscaled)
+			Upscale(GetResource(_presentedImage));
+
+		const uint64_t pixelsWritten = _rasterizer.GetStatistics().pixelsWritten;
+		_overdraw = static_cast<double>(pixelsWritten - _framePixelsWritten) / (static_cast<double>(GetSourceWidth()) * GetSourceHeight());
+		_framePixelsWritten = pixelsWritten;
+
+		_frameMilliseconds += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+		_gpuMilliseconds = _frameMilliseconds;
+		_frameMilliseconds = 0.0;
+
+		HeadlessBackend::Present();
+	}
+
+	// Bilinear, with pixel centers of the source and the presented image lined
+	// up as the presentation engines do it.
+	void SoftwareBackend::Upscale(const Resource *image)
+	{
+		const uint32_t width = GetWidth();
+		const uint32_t height = GetHeight();
+		const uint32_t sourceWidth = GetSourceWidth();
+		const uint32_t sourceHeight = GetSourceHeight();
+
+		_upscaledImage.resize(static_cast<size_t>(width) * height * 4);
+
+		const float scaleX = static_cast<float>(sourceWidth) / width;
+		const float scaleY = static_cast<float>(sourceHeight) / height;
+
+		_workerPool.ParallelFor(height, [&](uint32_t y) {
+			const float sourceY = std::min(std::max((y + 0.5f) * scaleY - 0.5f, 0.0f), static_cast<float>(sourceHeight - 1));
+			const uint32_t y0 = static_cast<uint32_t>(sourceY);
+			const uint32_t y1 = std::min(y0 + 1, sourceHeight - 1);
+			const float fy = sourceY - y0;
+
+			const uint8_t *row0 = image->data.data() + static_cast<size_t>(y0) * image->width * 4;
+			const uint8_t *row1 = image->data.data() + static_cast<size_t>(y1) * image->width * 4;
+			uint8_t *output = _upscaledImage.data() + static_cast<size_t>(y) * width * 4;
+
+			for(uint32_t x = 0; x < width; x++)
+			{
+				const float sourceX = std::min(std::max((x + 0.5f) * scaleX - 0.5f, 0.0f), static_cast<float>(sourceWidth - 1));
+				const uint32_t x0 = static_cast<uint32_t>(sourceX);
+				const uint32_t x1 = std::min(x0 + 1, sourceWidth - 1);
+				const float fx = sourceX - x0;
+
+				for(uint32_t channel = 0; channel < 4; channel++)
+				{
+					const float top = row0[x0 * 4 + channel] + (row0[x1 * 4 + channel] - row0[x0 * 4 + channel]) * fx;
+					const float bottom = row1[x0 * 4 + channel] + (row1[x1 * 4 + channel] - row1[x0 * 4 + channel]) * fx;
+
+					output[x * 4 + channel] = static_cast<uint8_t>(top + (bottom - top) * fy + 0.5f);
+				}
+			}
+		});
+	}
+
+	void SoftwareBackend::ResetRasterizerStatistics()
+	{
+		_rasterizer.ResetStatistics();
+		_framePixelsWritten = 0;
+	}
+
+	const uint8_t *SoftwareBackend::GetPresentedImage()
+	{
+		if(!_presentedImage)
+			return nullptr;
+
+		return _upscaled ? _upscaledImage.data() : GetResource(_presentedImage)->data.data();
+	}
+
+	void SoftwareBackend::SaveImage(const char *path)
+	{
+		if(!_presentedImage)
+			throw std::logic_error("No frame presented yet");
+
+		const Resource *image = GetResource(_presentedImage);
+		std::vector<uint8_t> data = WriteImageFile(image->width, image->height, GetPresentedImage());
+
+		FILE *file = nullptr;
+#if defined(_WIN32)
+		fopen_s(&file, path, "wb");
+#else
+		file = fopen(path, "wb");
+#endif
+		if(!file)
+			throw std::runtime_error("Failed to create image file");
+
+		const size_t written = fwrite(data.data(), 1, data.size(), file);
+		fclose(file);
+
+		if(written != data.size())
+			throw std::runtime_error("Failed to write image file");
+	}
+
+	void SoftwareBackend::Execute(BackendQueue queue, const std::vector<EncodedCommand> &commands)
+	{
+		// Every command list starts without any state bound.
+		memset(&_state, 0, sizeof(_state));
+		_rasterizer.SetState(RasterState());
+		_renderTarget = nullptr;
+		_depthBuffer = nullptr;
+
+		// What a GPU would have to do is done here and in Present.
+		if(queue != BackendQueue::Graphics)
+		{
+			HeadlessBackend::Execute(queue, commands);
+			return;
+		}
+
+		std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+		HeadlessBackend::Execute(queue, commands);
+		_frameMilliseconds += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	}
+
+	void SoftwareBackend::ExecuteCommand(BackendQueue queue, const EncodedCommand &command)
+	{
+		if(queue == BackendQueue::Graphics)
+		{
+			switch(command.type)
+			{
+				case EncodedCommandType::SetPrimitiveTopology:
+					_state.topology = command.arguments[0];
+					break;
+
+				case EncodedCommandType::SetVertexBuffer:
+					if(command.arguments[0] < MaxVertexBuffers)
+						_state.vertexBuffers[command.arguments[0]] = command.vertexBuffer;
+					break;
+
+				case EncodedCommandType::SetIndexBuffer:
+					_state.indexBuffer = command.indexBuffer;
+					break;
+
+				case EncodedCommandType::SetConstantBuffer:
+					if(command.arguments[0] < MaxConstantBuffers)
+						_state.constantBuffers[command.arguments[0]] = command.location;
+					break;
+
+				case EncodedCommandType::SetPipelineState:
+				{
+					const PipelineDescription &description = GetPipelineDescription(command.pipelineState);
+					_state.instanceFormat = description.instanceFormat;
+					_state.depthOnly = (description.depthMode == DepthMode::DepthOnly);
+
+					// Same test and writes as the D3D12 pipeline states of each mode.
+					RasterState state;
+					switch(description.depthMode)
+					{
+						case DepthMode::Disabled:
+							state.depthTest = RasterDepthTest::Always;
+							state.depthWrite = false;
+							break;
+						case DepthMode::DepthOnly:
+							state.colorWrite = false;
+							break;
+						case DepthMode::ReadOnly:
+							state.depthTest = RasterDepthTest::LessEqual;
+							state.depthWrite = false;
+							break;
+						default:
+							break;
+					}
+
+					_rasterizer.SetState(state);
+					break;
+				}
+
+				case EncodedCommandType::SetRenderTarget:
+				{
+					// Without a render target only the depth buffer is bound.
+					Resource *target = command.resources[0] ? GetResource(command.resources[0]) : nullptr;
+					Resource *depthBuffer = command.resources[1] ? GetResource(command.resources[1]) : nullptr;
+
+					if(!target && !depthBuffer)
+						throw std::invalid_argument("Neither render target nor depth buffer bound");
+
+					if(target && depthBuffer && (depthBuffer->width != target->width || depthBuffer->height != target->height))
+						throw std::invalid_argument("Depth buffer and render target differ in size");
+
+					// Draws go to the viewport at the top left of the target.
+					const Resource *size = target ? target : depthBuffer;
+					const uint32_t width = command.arguments[0];
+					const uint32_t height = command.arguments[1];
+					if(width > size->width || height > size->height)
+						throw std::invalid_argument("Viewport larger than the render target");
+
+					uint8_t *pixels = target ? target->data.data() : nullptr;
+					float *depth = depthBuffer ? reinterpret_cast<float *>(depthBuffer->data.data()) : nullptr;
+
+					_rasterizer.SetTarget(pixels, depth, width, height, size->width);
+					_renderTarget = command.resources[0];
+					_depthBuffer = command.resources[1];
+					break;
+				}
+
+				case EncodedCommandType::ClearRenderTarget:
+					ClearTarget(command.resources[0], command.color);
+					break;
+
+				case EncodedCommandType::ClearDepthBuffer:
+					ClearDepth(command.resources[0], command.color[0]);
+					break;
+
+				case EncodedCommandType::DrawInstanced:
+					Draw(command, false);
+					break;
+
+				case EncodedCommandType::DrawIndexedInstanced:
+					Draw(command, true);
+					break;
+
+				default:
+					break;
+			}
+		}
+
+		HeadlessBackend::ExecuteCommand(queue, command);
+	}
+
+	void SoftwareBackend::ClearTarget(const void *target, const float color[4])
+	{
+		// Binned triangles might go to the same target.
+		_rasterizer.Flush();
+
+		Resource *resource = GetResource(target);
+		uint32_t *pixels = reinterpret_cast<uint32_t *>(resource->data.data());
+
+		std::fill(pixels, pixels + static_cast<size_t>(resource->width) * resource->height, TileRasterizer::PackColor(color));
+	}
+
+	void SoftwareBackend::ClearDepth(const void *depthBuffer, float depth)
+	{
+		_rasterizer.Flush();
+
+		Resource *resource = GetResource(depthBuffer);
+		float *values = reinterpret_cast<float *>(resource->data.data());
+
+		std::fill(values, values + static_cast<size_t>(resource->width) * resource->height, depth);
+	}
+
+	void SoftwareBackend::Draw(const EncodedCommand &command, bool indexed)
+	{
+		const uint32_t count = command.arguments[0];
+		const uint32_t instanceCount = command.arguments[1];
+		const uint32_t first = command.arguments[2];
+		const int32_t baseVertex = indexed ? static_cast<int32_t>(command.arguments[3]) : 0;
+		const uint32_t firstInstance = indexed ? command.arguments[4] : command.arguments[3];
+
+		// The pipeline state has to match the bound targets, as the debug layer
+		// checks on D3D12.
+		if(_state.depthOnly)
+		{
+			if(_renderTarget)
+				throw std::logic_error("Depth only draw with a render target bound");
+			if(!_depthBuffer)
+				throw std::logic_error("Depth only draw without a depth buffer");
+		}
+		else if(!_renderTarget)
+		{
+			throw std::logic_error("Draw without a render target");
+		}
+
+		if(_state.topology != PrimitiveTopology::TriangleList && _state.topology != PrimitiveTopology::TriangleStrip)
+			throw std::invalid_argument("Only triangle lists and strips can be drawn");
+
+		if(count < 3 || instanceCount == 0)
+			return;
+
+		const VertexBufferBinding &vertexBinding = _state.vertexBuffers[0];
+		const VertexBufferBinding &instanceBinding = _state.vertexBuffers[1];
+
+		const uint32_t instanceSize = InstanceStream::GetInstanceSize(_state.instanceFormat);
+		if(vertexBinding.stride < VertexSize || instanceBinding.stride < instanceSize)
+			throw std::invalid_argument("Vertex buffer stride too small for the input layout");
+
+		const uint8_t *vertices = ResolveAddress(vertexBinding.location, vertexBinding.size);
+		const uint8_t *instances = ResolveAddress(instanceBinding.location, instanceBinding.size);
+		const FrameConstants *frameConstants = reinterpret_cast<const FrameConstants *>(ResolveAddress(_state.constantBuffers[ConstantSlotFrame], sizeof(FrameConstants)));
+		const DrawConstants *drawConstants = reinterpret_cast<const DrawConstants *>(ResolveAddress(_state.constantBuffers[ConstantSlotDraw], sizeof(DrawConstants)));
+
+		if(!vertices || !instances || !frameConstants || !drawConstants)
+			throw std::out_of_range("Draw reads outside of a buffer");
+
+		// Vertex numbers of the draw, so both kinds of draws assemble the same way.
+		_vertexNumbers.resize(count);
+
+		if(indexed)
+		{
+			const IndexBufferBinding &indexBinding = _state.indexBuffer;
+			const uint32_t indexSize = (indexBinding.format == IndexFormat::UInt16) ? 2 : 4;
+
+			if((static_cast<uint64_t>(first) + count) * indexSize > indexBinding.size)
+				throw std::out_of_range("Draw reads outside of the index buffer");
+
+			const uint8_t *indices = ResolveAddress(indexBinding.location, indexBinding.size);
+			if(!indices)
+				throw std::out_of_range("Draw reads outside of a buffer");
+
+			for(uint32_t i = 0; i < count; i++)
+			{
+				uint32_t index;
+				if(indexSize == 2)
+				{
+					uint16_t value;
+					memcpy(&value, indices + (static_cast<size_t>(first) + i) * 2, sizeof(value));
+					index = value;
+				}
+				else
+				{
+					memcpy(&index, indices + (static_cast<size_t>(first) + i) * 4, sizeof(index));
+				}
+
+				_vertexNumbers[i] = static_cast<uint32_t>(static_cast<int64_t>(index) + baseVertex);
+			}
+		}
+		else
+		{
+			for(uint32_t i = 0; i < count; i++)
+				_vertexNumbers[i] = first + i;
+		}
+
+		const uint32_t firstVertex = *std::min_element(_vertexNumbers.begin(), _vertexNumbers.end());
+		const uint32_t lastVertex = *std::max_element(_vertexNumbers.begin(), _vertexNumbers.end());
+
+		if(static_cast<uint64_t>(lastVertex) * vertexBinding.stride + VertexSize > vertexBinding.size)
+			throw std::out_of_range("Draw reads outside of the vertex buffer");
+
+		if(static_cast<uint64_t>(firstInstance + instanceCount - 1) * instanceBinding.stride + instanceSize > instanceBinding.size)
+			throw std::out_of_range("Draw reads outside of the instance buffer");
+
+		float modelViewProjection[16];
+		MultiplyMatrices(drawConstants->model, frameConstants->viewProjection, modelViewProjection);
+
+		for(uint32_t instance = 0; instance < instanceCount; instance++)
+		{
+			float world[16];
+			InstanceStream::DecodeInstance(_state.instanceFormat, instances + static_cast<size_t>(firstInstance + instance) * instanceBinding.stride, world);
+
+			float transform[16];
+			MultiplyMatrices(world, modelViewProjection, transform);
+
+			// Every vertex in the range the draw uses is shaded once per instance.
+			ShadeVertices(vertices, vertexBinding.stride, firstVertex, lastVertex - firstVertex + 1, transform);
+
+			if(_state.topology == PrimitiveTopology::TriangleList)
+			{
+				for(uint32_t i = 0; i + 2 < count; i += 3)
+					_rasterizer.DrawTriangle(_shadedVertices[_vertexNumbers[i] - firstVertex], _shadedVertices[_vertexNumbers[i + 1] - firstVertex], _shadedVertices[_vertexNumbers[i + 2] - firstVertex]);
+			}
+			else
+			{
+				// Every other triangle of a strip has its first two vertices swapped
+				// to keep the winding.
+				for(uint32_t i = 0; i + 2 < count; i++)
+				{
+					const uint32_t a = _vertexNumbers[(i & 1) ? i + 1 : i] - firstVertex;
+					const uint32_t b = _vertexNumbers[(i & 1) ? i : i + 1] - firstVertex;
+					const uint32_t c = _vertexNumbers[i + 2] - firstVertex;
+
+					_rasterizer.DrawTriangle(_shadedVertices[a], _shadedVertices[b], _shadedVertices[c]);
+				}
+			}
+		}
+	}
+
+	// The vertex shader, position times world, model and view projection.
+	void SoftwareBackend::ShadeVertices(const uint8_t *vertices, uint32_t stride, uint32_t first, uint32_t count, const float *transform)
+	{
+		_shadedVertices.resize(count);
+
+		for(uint32_t i = 0; i < count; i++)
+		{
+			float input[7];
+			memcpy(input, vertices + static_cast<size_t>(first + i) * stride, sizeof(input));
+
+			RasterVertex &output = _shadedVertices[i];
+			for(int column = 0; column < 4; column++)
+				output.position[column] = input[0] * transform[column] + input[1] * transform[4 + column] + input[2] * transform[8 + column] + transform[12 + column];
+
+			memcpy(output.color, input + 3, sizeof(output.color));
+		}
+	}
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "LBHeadlessBackend.h"
+#include "LBTileRasterizer.h"
+#include "LBWorkerPool.h"
+
+namespace LB
+{
+	// Headless backend that draws. Runs the vertex and pixel shader of
+	// shaders.hlsl on the CPU for every draw: POSITION and COLOR from vertex
+	// buffer slot 0, the world matrix of the instance from slot 1 and the model
+	// and view projection matrix from the constant buffers, as triangle lists and
+	// strips, indexed or not. Of the pipeline state only the depth mode and the
+	// instance format are looked at, every pipeline is assumed to use that shader
+	// and otherwise the default states.
+	//
+	// Vertices are transformed and triangles binned while a command list
+	// executes, the tiles are rasterized in parallel before the frame is
+	// presented. The images are deterministic, for golden image tests and
+	// renderer benchmarks without a GPU.
+	//
+	// A source size smaller than the back buffers is upscaled bilinearly when
+	// presenting. The time spent executing graphics command lists and presenting
+	// is reported as GPU time.
+	class SoftwareBackend : public HeadlessBackend
+	{
+	public:
+		// A negative worker count uses every hardware thread.
+		SoftwareBackend(uint32_t width, uint32_t height, uint32_t frameCount = 2, int32_t workers = -1);
+
+		void Resize(uint32_t width, uint32_t height) override;
+		void Present() override;
+		double GetGpuMilliseconds() override { return _gpuMilliseconds; }
+
+		// RGBA8 pixels of the last presented frame at the size of the back buffers,
+		// nullptr before the first one.
+		const uint8_t *GetPresentedImage();
+
+		// Writes the last presented frame as an image file, see LBImageFile.h.
+		void SaveImage(const char *path);
+
+		const TileRasterizerStatistics &GetRasterizerStatistics() const { return _rasterizer.GetStatistics(); }
+		void ResetRasterizerStatistics();
+
+		// Color writes of the last presented frame per pixel of the target, 1 if
+		// every pixel was shaded exactly once.
+		double GetOverdraw() const { return _overdraw; }
+
+	protected:
+		void Execute(BackendQueue queue, const std::vector<EncodedCommand> &commands) override;
+		void ExecuteCommand(BackendQueue queue, const EncodedCommand &command) override;
+
+	private:
+		static const uint32_t MaxVertexBuffers = 2;
+		static const uint32_t MaxConstantBuffers = 2;
+
+		// POSITION float3 and COLOR float4.
+		static const uint32_t VertexSize = sizeof(float) * 7;
+
+		struct DrawState
+		{
+			uint32_t topology;
+			InstanceFormat instanceFormat;		// Of the pipeline state
+			bool depthOnly;						// Pipeline state without render targets
+			VertexBufferBinding vertexBuffers[MaxVertexBuffers];
+			IndexBufferBinding indexBuffer;
+			uint64_t constantBuffers[MaxConstantBuffers];
+		};
+
+		void Draw(const EncodedCommand &command, bool indexed);
+		void ShadeVertices(const uint8_t *vertices, uint32_t stride, uint32_t first, uint32_t count, const float *transform);
+		void ClearTarget(const void *target, const float color[4]);
+		void ClearDepth(const void *depthBuffer, float depth);
+		void Upscale(const Resource *image);
+
+		WorkerPool _workerPool;
+		TileRasterizer _rasterizer;
+
+		DrawState _state;
+		std::vector<uint32_t> _vertexNumbers;
+		std::vector<RasterVertex> _shadedVertices;
+
+		// Bound by the executing command list, the target is null for depth only.
+		const void *_renderTarget;
+		const void *_depthBuffer;
+
+		// Back buffer of the last presented frame, or its upscaled copy.
+		const void *_presentedImage;
+		std::vector<uint8_t> _upscaledImage;
+		bool _upscaled;
+
+		uint64_t _framePixelsWritten;		// Rasterizer count at the start of the frame
+		double _overdraw;
+
+		double _frameMilliseconds;			// Of the frame being executed
+		double _gpuMilliseconds;
+	};
+}
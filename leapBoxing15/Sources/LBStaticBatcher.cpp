@@ -0,0 +1,131 @@
+#if defined(_WIN32)
+#include "stdafx.h"
+#endif
+
+#include "LBStaticBatcher.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <set>
+
+namespace LB
+{
+	StaticBatcher::StaticBatcher(float clusterSize) : _clusterSize(clusterSize), _statistics()
+	{
+
+	}
+
+	void StaticBatcher::Add(const StaticGeometry &geometry, const float worldMatrix[16], const void *material)
+	{
+		Instance instance;
+		instance.geometry = geometry;
+		instance.material = material;
+		memcpy(instance.worldMatrix, worldMatrix, sizeof(instance.worldMatrix));
+
+		_instances.push_back(instance);
+	}
+
+	void StaticBatcher::Build()
+	{
+		_clusters.clear();
+		_statistics = StaticBatchStatistics();
+
+		std::map<ClusterKey, uint32_t> lookup;
+		std::set<const float *> sourceMeshes;
+
+		for(const Instance &instance : _instances)
+		{
+			const float *matrix = instance.worldMatrix;
+			const ClusterKey key(instance.material,
+				static_cast<int32_t>(std::floor(matrix[12] / _clusterSize)),
+				static_cast<int32_t>(std::floor(matrix[13] / _clusterSize)),
+				static_cast<int32_t>(std::floor(matrix[14] / _clusterSize)));
+
+			auto iterator = lookup.find(key);
+			if(iterator == lookup.end())
+			{
+				StaticCluster cluster;
+				cluster.material = instance.material;
+				std::fill(cluster.boundsMin, cluster.boundsMin + 3, std::numeric_limits<float>::max());
+				std::fill(cluster.boundsMax, cluster.boundsMax + 3, -std::numeric_limits<float>::max());
+
+				iterator = lookup.emplace(key, static_cast<uint32_t>(_clusters.size())).first;
+				_clusters.push_back(cluster);
+			}
+
+			Append(_clusters[iterator->second], instance);
+
+			const StaticGeometry &geometry = instance.geometry;
+			if(sourceMeshes.insert(geometry.vertices).second)
+			{
+				_statistics.buffersBefore += geometry.indices ? 2 : 1;
+				_statistics.bytesBefore += geometry.vertexCount * geometry.stride * sizeof(float);
+				_statistics.bytesBefore += geometry.indexCount * sizeof(uint32_t);
+			}
+		}
+
+		_statistics.entities = static_cast<uint32_t>(_instances.size());
+		_statistics.drawsBefore = _statistics.entities;
+		_statistics.drawsAfter = static_cast<uint32_t>(_clusters.size());
+		_statistics.buffersAfter = _statistics.drawsAfter * 2;
+
+		for(const StaticCluster &cluster : _clusters)
+			_statistics.bytesAfter += cluster.vertices.size() * sizeof(float) + cluster.indices.size() * sizeof(uint32_t);
+
+		_instances.clear();
+	}
+
+	void StaticBatcher::Append(StaticCluster &cluster, const Instance &instance)
+	{
+		const StaticGeometry &geometry = instance.geometry;
+		const float *m = instance.worldMatrix;
+		const uint32_t baseVertex = static_cast<uint32_t>(cluster.vertices.size() / geometry.stride);
+
+		// Pre-transform the positions, everything else is copied as is.
+		for(uint32_t i = 0; i < geometry.vertexCount; i++)
+		{
+			const float *source = geometry.vertices + i * geometry.stride;
+			const float x = source[0];
+			const float y = source[1];
+			const float z = source[2];
+
+			const float position[3] = {
+				m[0] * x + m[4] * y + m[8] * z + m[12],
+				m[1] * x + m[5] * y + m[9] * z + m[13],
+				m[2] * x + m[6] * y + m[10] * z + m[14]
+			};
+
+			for(int n = 0; n < 3; n++)
+			{
+				cluster.boundsMin[n] = std::min(cluster.boundsMin[n], position[n]);
+				cluster.boundsMax[n] = std::max(cluster.boundsMax[n], position[n]);
+			}
+
+			cluster.vertices.insert(cluster.vertices.end(), position, position + 3);
+			cluster.vertices.insert(cluster.vertices.end(), source + 3, source + geometry.stride);
+		}
+
+		// Everything ends up as an indexed triangle list so clusters can mix sources.
+		const uint32_t count = geometry.indices ? geometry.indexCount : geometry.vertexCount;
+		auto index = [&](uint32_t i) { return baseVertex + (geometry.indices ? geometry.indices[i] : i); };
+
+		if(geometry.triangleStrip)
+		{
+			for(uint32_t i = 0; i + 2 < count; i++)
+			{
+				// Every other strip triangle has flipped winding.
+				const bool odd = (i & 1) != 0;
+				cluster.indices.push_back(index(odd ? i + 1 : i));
+				cluster.indices.push_back(index(odd ? i : i + 1));
+				cluster.indices.push_back(index(i + 2));
+			}
+		}
+		else
+		{
+			for(uint32_t i = 0; i < count; i++)
+				cluster.indices.push_back(index(i));
+		}
+	}
+}
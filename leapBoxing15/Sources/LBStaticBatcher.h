@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <tuple>
+#include <vector>
+
+namespace LB
+{
+	// CPU side copy of a mesh. Vertices start with a float3 position, the remaining
+	// floats of every vertex are passed through untouched.
+	struct StaticGeometry
+	{
+		const float *vertices;
+		uint32_t vertexCount;
+		uint32_t stride;			// In floats
+		const uint32_t *indices;	// nullptr for non indexed meshes
+		uint32_t indexCount;
+		bool triangleStrip;
+	};
+
+	struct StaticCluster
+	{
+		const void *material;
+		std::vector<float> vertices;
+		std::vector<uint32_t> indices;
+		float boundsMin[3];
+		float boundsMax[3];
+	};
+
+	struct StaticBatchStatistics
+	{
+		uint32_t entities;
+		uint32_t drawsBefore;
+		uint32_t drawsAfter;
+		uint32_t buffersBefore;
+		uint32_t buffersAfter;
+		uint64_t bytesBefore;		// Unique source meshes referenced by the static entities
+		uint64_t bytesAfter;		// Pre-transformed cluster geometry
+	};
+
+	// Merges static geometry sharing a material into pre-transformed triangle lists.
+	// Entities are bucketed into a uniform grid by their world position so every
+	// cluster stays spatially compact and can still be culled on its own.
+	class StaticBatcher
+	{
+	public:
+		StaticBatcher(float clusterSize);
+
+		void Add(const StaticGeometry &geometry, const float worldMatrix[16], const void *material);
+		void Build();
+
+		const std::vector<StaticCluster> &GetClusters() const { return _clusters; }
+		const StaticBatchStatistics &GetStatistics() const { return _statistics; }
+
+	private:
+		typedef std::tuple<const void *, int32_t, int32_t, int32_t> ClusterKey;
+
+		struct Instance
+		{
+			StaticGeometry geometry;
+			float worldMatrix[16];
+			const void *material;
+		};
+
+		void Append(StaticCluster &cluster, const Instance &instance);
+
+		float _clusterSize;
+		std::vector<Instance> _instances;
+		std::vector<StaticCluster> _clusters;
+		StaticBatchStatistics _statistics;
+	};
+}
@@ -1,2 +1,5 @@
+#if defined(_WIN32)
 #include "stdafx.h"
+#endif
+
 #include "LBTexture.h"
\ No newline at end of file
@@ -0,0 +1,663 @@
+#if defined(_WIN32)
+#include "stdafx.h"
+#endif
+
+#include "LBTileRasterizer.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define LB_RASTERIZER_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace LB
+{
+	enum ClipPlane : uint32_t
+	{
+		ClipPlaneNear,
+		ClipPlaneFar,
+		ClipPlaneLeft,
+		ClipPlaneRight,
+		ClipPlaneBottom,
+		ClipPlaneTop,
+		ClipPlaneW,
+		ClipPlaneCount
+	};
+
+	// Keeps the perspective divide away from zero for vertices on the eye plane.
+	static const float MinimumW = 1e-5f;
+
+	static const uint8_t CoveredPixelCount[16] = { 0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4 };
+
+	static float GetPlaneDistance(const RasterVertex &vertex, uint32_t plane, float guardBandX, float guardBandY)
+	{
+		const float *position = vertex.position;
+
+		switch(plane)
+		{
+			case ClipPlaneNear:
+				return position[2];
+			case ClipPlaneFar:
+				return position[3] - position[2];
+			case ClipPlaneLeft:
+				return position[0] + guardBandX * position[3];
+			case ClipPlaneRight:
+				return guardBandX * position[3] - position[0];
+			case ClipPlaneBottom:
+				return position[1] + guardBandY * position[3];
+			case ClipPlaneTop:
+				return guardBandY * position[3] - position[1];
+			default:
+				return position[3] - MinimumW;
+		}
+	}
+
+	static uint32_t GetOutcode(const RasterVertex &vertex, float guardBandX, float guardBandY)
+	{
+		uint32_t outcode = 0;
+		for(uint32_t plane = 0; plane < ClipPlaneCount; plane++)
+		{
+			if(GetPlaneDistance(vertex, plane, guardBandX, guardBandY) < 0.0f)
+				outcode |= (1 << plane);
+		}
+
+		return outcode;
+	}
+
+	static RasterVertex Interpolate(const RasterVertex &a, const RasterVertex &b, float t)
+	{
+		RasterVertex result;
+		for(int i = 0; i < 4; i++)
+		{
+			result.position[i] = a.position[i] + (b.position[i] - a.position[i]) * t;
+			result.color[i] = a.color[i] + (b.color[i] - a.color[i]) * t;
+		}
+
+		return result;
+	}
+
+	// Rounds towards negative infinity, unlike the division operator.
+	static int32_t FloorDivide(int32_t value, int32_t divisor)
+	{
+		const int32_t quotient = value / divisor;
+		return (value % divisor != 0 && value < 0) ? quotient - 1 : quotient;
+	}
+
+	TileRasterizer::TileRasterizer(WorkerPool *workerPool) : _workerPool(workerPool), _pixels(nullptr), _depth(nullptr), _width(0), _height(0), _pitch(0), _tilesX(0), _tilesY(0), _guardBandX(1.0f), _guardBandY(1.0f)
+	{
+		ResetStatistics();
+	}
+
+	void TileRasterizer::ResetStatistics()
+	{
+		memset(&_statistics, 0, sizeof(_statistics));
+	}
+
+	uint32_t TileRasterizer::PackColor(const float color[4])
+	{
+		uint32_t result = 0;
+		for(int i = 0; i < 4; i++)
+		{
+			const float value = std::min(1.0f, std::max(0.0f, color[i]));
+			result |= static_cast<uint32_t>(value * 255.0f + 0.5f) << (i * 8);
+		}
+
+		return result;
+	}
+
+	void TileRasterizer::SetTarget(uint8_t *pixels, float *depth, uint32_t width, uint32_t height, uint32_t pitch)
+	{
+		if(pitch == 0)
+			pitch = width;
+
+		if(pixels == _pixels && depth == _depth && width == _width && height == _height && pitch == _pitch)
+			return;
+
+		if(width == 0 || height == 0 || width > MaxTargetSize || height > MaxTargetSize || pitch < width)
+			throw std::invalid_argument("Unsupported render target size");
+
+		Flush();
+
+		_pixels = pixels;
+		_depth = depth;
+		_width = width;
+		_height = height;
+		_pitch = pitch;
+		_tilesX = (width + TileSize - 1) / TileSize;
+		_tilesY = (height + TileSize - 1) / TileSize;
+		_bins.resize(_tilesX * _tilesY);
+
+		// Screen coordinates stay within MaxTargetSize of the target center, which
+		// keeps them in 18 bit with the sub pixel bits.
+		_guardBandX = static_cast<float>(MaxTargetSize) / width;
+		_guardBandY = static_cast<float>(MaxTargetSize) / height;
+	}
+
+	void TileRasterizer::DrawTriangle(const RasterVertex &a, const RasterVertex &b, const RasterVertex &c)
+	{
+		if(!_pixels && (_state.colorWrite || !_depth))
+			throw std::logic_error("Triangle drawn without a render target");
+
+		_statistics.trianglesSubmitted++;
+
+		const RasterVertex vertices[3] = { a, b, c };
+		ClipTriangle(vertices);
+	}
+
+	void TileRasterizer::ClipTriangle(const RasterVertex *vertices)
+	{
+		const uint32_t outcodes[3] = {
+			GetOutcode(vertices[0], _guardBandX, _guardBandY),
+			GetOutcode(vertices[1], _guardBandX, _guardBandY),
+			GetOutcode(vertices[2], _guardBandX, _guardBandY)
+		};
+
+		if(outcodes[0] & outcodes[1] & outcodes[2])
+		{
+			_statistics.trianglesRejected++;
+			return;
+		}
+
+		const uint32_t crossedPlanes = outcodes[0] | outcodes[1] | outcodes[2];
+		if(crossedPlanes == 0)
+		{
+			SetupTriangle(vertices[0], vertices[1], vertices[2]);
+			return;
+		}
+
+		_statistics.trianglesClipped++;
+
+		// Sutherland-Hodgman against every plane the triangle crosses, in clip
+		// space where the colors can be interpolated linearly.
+		RasterVertex buffers[2][MaxClipVertices];
+		RasterVertex *polygon = buffers[0];
+		RasterVertex *clipped = buffers[1];
+		uint32_t count = 3;
+
+		std::copy(vertices, vertices + 3, polygon);
+
+		for(uint32_t plane = 0; plane < ClipPlaneCount && count >= 3; plane++)
+		{
+			if(!(crossedPlanes & (1 << plane)))
+				continue;
+
+			uint32_t clippedCount = 0;
+			for(uint32_t i = 0; i < count; i++)
+			{
+				const RasterVertex &current = polygon[i];
+				const RasterVertex &next = polygon[(i + 1) % count];
+
+				const float currentDistance = GetPlaneDistance(current, plane, _guardBandX, _guardBandY);
+				const float nextDistance = GetPlaneDistance(next, plane, _guardBandX, _guardBandY);
+
+				if(currentDistance >= 0.0f)
+					clipped[clippedCount++] = current;
+
+				if((currentDistance >= 0.0f) != (nextDistance >= 0.0f))
+					clipped[clippedCount++] = Interpolate(current, next, currentDistance / (currentDistance - nextDistance));
+			}
+
+			std::swap(polygon, clipped);
+			count = clippedCount;
+		}
+
+		for(uint32_t i = 2; i < count; i++)
+			SetupTriangle(polygon[0], polygon[i - 1], polygon[i]);
+	}
+
+	void TileRasterizer::SetupTriangle(const RasterVertex &a, const RasterVertex &b, const RasterVertex &c)
+	{
+		const RasterVertex *vertices[3] = { &a, &b, &c };
+
+		// Snapped to the sub pixel grid, y pointing down.
+		int32_t x[3];
+		int32_t y[3];
+		float planeValues[3][PlaneCount];
+
+		const float subpixelScale = static_cast<float>(1 << SubpixelBits);
+
+		for(int i = 0; i < 3; i++)
+		{
+			const float *position = vertices[i]->position;
+			const float inverseW = 1.0f / position[3];
+
+			const float screenX = (position[0] * inverseW + 1.0f) * 0.5f * _width;
+			const float screenY = (1.0f - position[1] * inverseW) * 0.5f * _height;
+
+			x[i] = static_cast<int32_t>(std::lrint(screenX * subpixelScale));
+			y[i] = static_cast<int32_t>(std::lrint(screenY * subpixelScale));
+
+			planeValues[i][0] = inverseW;
+			for(int channel = 0; channel < 4; channel++)
+				planeValues[i][channel + 1] = vertices[i]->color[channel] * inverseW;
+
+			planeValues[i][PlaneDepth] = position[2] * inverseW;
+		}
+
+		// Positive for triangles that are clockwise on screen, which face the front.
+		const int64_t area = static_cast<int64_t>(x[1] - x[0]) * (y[2] - y[0]) - static_cast<int64_t>(y[1] - y[0]) * (x[2] - x[0]);
+		if(area <= 0)
+		{
+			_statistics.trianglesCulled++;
+			return;
+		}
+
+		// Pixels whose center at half a pixel lies within the bounds.
+		const int32_t half = 1 << (SubpixelBits - 1);
+		const int32_t one = 1 << SubpixelBits;
+
+		Triangle triangle;
+		triangle.state = _state;
+		triangle.minX = std::max(FloorDivide(std::min(x[0], std::min(x[1], x[2])) - half + one - 1, one), 0);
+		triangle.minY = std::max(FloorDivide(std::min(y[0], std::min(y[1], y[2])) - half + one - 1, one), 0);
+		triangle.maxX = std::min(FloorDivide(std::max(x[0], std::max(x[1], x[2])) - half, one), static_cast<int32_t>(_width) - 1);
+		triangle.maxY = std::min(FloorDivide(std::max(y[0], std::max(y[1], y[2])) - half, one), static_cast<int32_t>(_height) - 1);
+
+		if(triangle.minX > triangle.maxX || triangle.minY > triangle.maxY)
+		{
+			_statistics.trianglesCulled++;
+			return;
+		}
+
+		for(int edge = 0; edge < 3; edge++)
+		{
+			const int next = (edge + 1) % 3;
+
+			// E(p) = (x1 - x0) * (py - y0) - (y1 - y0) * (px - x0), positive inside.
+			const int32_t dx = x[next] - x[edge];
+			const int32_t dy = y[next] - y[edge];
+			const int64_t constant = static_cast<int64_t>(dy) * x[edge] - static_cast<int64_t>(dx) * y[edge];
+
+			// Pixel centers exactly on an edge belong to the triangle only for top
+			// and left edges.
+			const bool topLeft = (dy < 0) || (dy == 0 && dx > 0);
+
+			triangle.stepX[edge] = -dy * one;
+			triangle.stepY[edge] = dx * one;
+			triangle.origin[edge] = static_cast<int64_t>(-dy) * half + static_cast<int64_t>(dx) * half + constant - (topLeft ? 0 : 1);
+		}
+
+		// The planes are evaluated at integer pixel coordinates, hence the half
+		// pixel offset of the reference point.
+		const float x0 = x[0] / subpixelScale;
+		const float y0 = y[0] / subpixelScale;
+		const float x1 = x[1] / subpixelScale - x0;
+		const float y1 = y[1] / subpixelScale - y0;
+		const float x2 = x[2] / subpixelScale - x0;
+		const float y2 = y[2] / subpixelScale - y0;
+		const float inverseArea = 1.0f / (x1 * y2 - x2 * y1);
+
+		triangle.referenceX = x0 - 0.5f;
+		triangle.referenceY = y0 - 0.5f;
+
+		for(uint32_t plane = 0; plane < PlaneCount; plane++)
+		{
+			const float value = planeValues[0][plane];
+			const float delta1 = planeValues[1][plane] - value;
+			const float delta2 = planeValues[2][plane] - value;
+
+			triangle.planes[plane][0] = value;
+			triangle.planes[plane][1] = (delta1 * y2 - delta2 * y1) * inverseArea;
+			triangle.planes[plane][2] = (delta2 * x1 - delta1 * x2) * inverseArea;
+		}
+
+		_triangles.push_back(triangle);
+		BinTriangle(static_cast<uint32_t>(_triangles.size() - 1));
+	}
+
+	// Range of an edge function over the pixels from x0, y0 to x1, y1.
+	static void GetEdgeRange(int64_t origin, int32_t stepX, int32_t stepY, int32_t x0, int32_t y0, int32_t x1, int32_t y1, int64_t *minimum, int64_t *maximum)
+	{
+		const int64_t left = static_cast<int64_t>(stepX) * x0;
+		const int64_t right = static_cast<int64_t>(stepX) * x1;
+		const int64_t top = static_cast<int64_t>(stepY) * y0;
+		const int64_t bottom = static_cast<int64_t>(stepY) * y1;
+
+		*minimum = origin + std::min(left, right) + std::min(top, bottom);
+		*maximum = origin + std::max(left, right) + std::max(top, bottom);
+	}
+
+	void TileRasterizer::BinTriangle(uint32_t index)
+	{
+		const Triangle &triangle = _triangles[index];
+
+		const uint32_t tileX0 = triangle.minX / TileSize;
+		const uint32_t tileY0 = triangle.minY / TileSize;
+		const uint32_t tileX1 = triangle.maxX / TileSize;
+		const uint32_t tileY1 = triangle.maxY / TileSize;
+
+		_statistics.trianglesBinned++;
+
+		if(tileX0 == tileX1 && tileY0 == tileY1)
+		{
+			_bins[tileY0 * _tilesX + tileX0].push_back(index);
+			_statistics.binEntries++;
+			return;
+		}
+
+		// Larger triangles skip the tiles of their bounds one of the edges
+		// excludes completely.
+		for(uint32_t tileY = tileY0; tileY <= tileY1; tileY++)
+		{
+			const int32_t y0 = std::max<int32_t>(tileY * TileSize, triangle.minY);
+			const int32_t y1 = std::min<int32_t>((tileY + 1) * TileSize - 1, triangle.maxY);
+
+			for(uint32_t tileX = tileX0; tileX <= tileX1; tileX++)
+			{
+				const int32_t x0 = std::max<int32_t>(tileX * TileSize, triangle.minX);
+				const int32_t x1 = std::min<int32_t>((tileX + 1) * TileSize - 1, triangle.maxX);
+
+				bool outside = false;
+				for(int edge = 0; edge < 3 && !outside; edge++)
+				{
+					int64_t minimum, maximum;
+					GetEdgeRange(triangle.origin[edge], triangle.stepX[edge], triangle.stepY[edge], x0, y0, x1, y1, &minimum, &maximum);
+					outside = (maximum < 0);
+				}
+
+				if(!outside)
+				{
+					_bins[tileY * _tilesX + tileX].push_back(index);
+					_statistics.binEntries++;
+				}
+			}
+		}
+	}
+
+	void TileRasterizer::Flush()
+	{
+		if(_triangles.empty())
+			return;
+
+		std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+
+		std::atomic<uint64_t> pixelsCovered(0);
+		std::atomic<uint64_t> pixelsDepthRejected(0);
+		std::atomic<uint64_t> pixelsWritten(0);
+
+		_workerPool->ParallelFor(_tilesX * _tilesY, [&](uint32_t tile) {
+			if(_bins[tile].empty())
+				return;
+
+			PixelCounts counts = {};
+			RasterizeTile(tile, &counts);
+
+			pixelsCovered += counts.covered;
+			pixelsDepthRejected += counts.depthRejected;
+			pixelsWritten += counts.written;
+		});
+
+		for(std::vector<uint32_t> &bin : _bins)
+			bin.clear();
+
+		_triangles.clear();
+
+		_statistics.pixelsCovered += pixelsCovered;
+		_statistics.pixelsDepthRejected += pixelsDepthRejected;
+		_statistics.pixelsWritten += pixelsWritten;
+		_statistics.flushes++;
+		_statistics.rasterMilliseconds += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	}
+
+	void TileRasterizer::RasterizeTile(uint32_t tile, PixelCounts *counts)
+	{
+		const int32_t tileX = static_cast<int32_t>((tile % _tilesX) * TileSize);
+		const int32_t tileY = static_cast<int32_t>((tile / _tilesX) * TileSize);
+		const int32_t tileRight = std::min<int32_t>(tileX + TileSize, _width) - 1;
+		const int32_t tileBottom = std::min<int32_t>(tileY + TileSize, _height) - 1;
+
+		for(uint32_t index : _bins[tile])
+		{
+			const Triangle &triangle = _triangles[index];
+
+			const int32_t x0 = std::max(tileX, triangle.minX);
+			const int32_t y0 = std::max(tileY, triangle.minY);
+			const int32_t x1 = std::min(tileRight, triangle.maxX);
+			const int32_t y1 = std::min(tileBottom, triangle.maxY);
+
+			// Groups of four pixels start at multiples of four, which are never
+			// more than three pixels left of the tile.
+			const int32_t groupX0 = x0 & ~3;
+
+			// Edges covering the whole area are left out, the others stay within 32
+			// bit inside of the tile since they cross it.
+			int32_t rowEdges[3];
+			int32_t stepX[3];
+			int32_t stepY[3];
+			bool outside = false;
+
+			for(int edge = 0; edge < 3; edge++)
+			{
+				int64_t minimum, maximum;
+				GetEdgeRange(triangle.origin[edge], triangle.stepX[edge], triangle.stepY[edge], x0, y0, x1, y1, &minimum, &maximum);
+
+				if(maximum < 0)
+				{
+					outside = true;
+					break;
+				}
+
+				if(minimum >= 0)
+				{
+					rowEdges[edge] = 0;
+					stepX[edge] = 0;
+					stepY[edge] = 0;
+				}
+				else
+				{
+					rowEdges[edge] = static_cast<int32_t>(triangle.origin[edge] + static_cast<int64_t>(triangle.stepX[edge]) * groupX0 + static_cast<int64_t>(triangle.stepY[edge]) * y0);
+					stepX[edge] = triangle.stepX[edge];
+					stepY[edge] = triangle.stepY[edge];
+				}
+			}
+
+			if(outside)
+				continue;
+
+			const float (&planes)[PlaneCount][3] = triangle.planes;
+
+			const RasterState &state = triangle.state;
+			const bool depthTest = _depth && state.depthTest != RasterDepthTest::Always;
+			const bool depthWrite = _depth && state.depthWrite;
+			const bool lessEqual = (state.depthTest == RasterDepthTest::LessEqual);
+
+#if defined(LB_RASTERIZER_SSE2)
+			const __m128i laneEdgeSteps[3] = {
+				_mm_setr_epi32(0, stepX[0], stepX[0] * 2, stepX[0] * 3),
+				_mm_setr_epi32(0, stepX[1], stepX[1] * 2, stepX[1] * 3),
+				_mm_setr_epi32(0, stepX[2], stepX[2] * 2, stepX[2] * 3)
+			};
+			const __m128i groupEdgeSteps[3] = { _mm_set1_epi32(stepX[0] * 4), _mm_set1_epi32(stepX[1] * 4), _mm_set1_epi32(stepX[2] * 4) };
+
+			__m128 planeStepsX[PlaneCount];
+			for(uint32_t plane = 0; plane < PlaneCount; plane++)
+				planeStepsX[plane] = _mm_set1_ps(planes[plane][1]);
+
+			const __m128 laneOffsets = _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f);
+			const __m128 zero = _mm_setzero_ps();
+			const __m128 one = _mm_set1_ps(1.0f);
+			const __m128 scale = _mm_set1_ps(255.0f);
+			const __m128 rounding = _mm_set1_ps(0.5f);
+#endif
+
+			for(int32_t y = y0; y <= y1; y++)
+			{
+				uint32_t *row = _pixels ? reinterpret_cast<uint32_t *>(_pixels) + static_cast<size_t>(y) * _pitch : nullptr;
+				float *depthRow = _depth ? _depth + static_cast<size_t>(y) * _pitch : nullptr;
+				const float planeY = static_cast<float>(y) - triangle.referenceY;
+
+				float rowPlanes[PlaneCount];
+				for(uint32_t plane = 0; plane < PlaneCount; plane++)
+					rowPlanes[plane] = planes[plane][0] + planes[plane][2] * planeY;
+
+#if defined(LB_RASTERIZER_SSE2)
+				__m128i edges[3];
+				for(int edge = 0; edge < 3; edge++)
+					edges[edge] = _mm_add_epi32(_mm_set1_epi32(rowEdges[edge]), laneEdgeSteps[edge]);
+
+				__m128 rowPlaneValues[PlaneCount];
+				for(uint32_t plane = 0; plane < PlaneCount; plane++)
+					rowPlaneValues[plane] = _mm_set1_ps(rowPlanes[plane]);
+#else
+				int32_t edges[3] = { rowEdges[0], rowEdges[1], rowEdges[2] };
+#endif
+
+				for(int32_t groupX = groupX0; groupX <= x1; groupX += 4)
+				{
+					uint32_t laneMask = 0xf;
+					if(groupX < x0)
+						laneMask &= 0xf << (x0 - groupX);
+					if(groupX + 3 > x1)
+						laneMask &= 0xf >> (groupX + 3 - x1);
+
+#if defined(LB_RASTERIZER_SSE2)
+					// A pixel is covered if no edge function is negative.
+					const __m128i signs = _mm_or_si128(_mm_or_si128(edges[0], edges[1]), edges[2]);
+					const uint32_t covered = ~static_cast<uint32_t>(_mm_movemask_ps(_mm_castsi128_ps(signs))) & laneMask;
+
+					for(int edge = 0; edge < 3; edge++)
+						edges[edge] = _mm_add_epi32(edges[edge], groupEdgeSteps[edge]);
+
+					if(!covered)
+						continue;
+
+					const __m128 planeX = _mm_add_ps(_mm_set1_ps(static_cast<float>(groupX) - triangle.referenceX), laneOffsets);
+
+					// Lanes outside of the coverage may lie past the end of the row, they
+					// are neither read nor written.
+					uint32_t passed = covered;
+					if(depthTest || depthWrite)
+					{
+						__m128 depth = _mm_add_ps(rowPlaneValues[PlaneDepth], _mm_mul_ps(planeStepsX[PlaneDepth], planeX));
+						depth = _mm_min_ps(_mm_max_ps(depth, zero), one);
+
+						if(depthTest)
+						{
+							float stored[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+							for(int lane = 0; lane < 4; lane++)
+							{
+								if(covered & (1 << lane))
+									stored[lane] = depthRow[groupX + lane];
+							}
+
+							const __m128 storedDepth = _mm_loadu_ps(stored);
+							const __m128 depthPassed = lessEqual ? _mm_cmple_ps(depth, storedDepth) : _mm_cmplt_ps(depth, storedDepth);
+							passed &= static_cast<uint32_t>(_mm_movemask_ps(depthPassed));
+						}
+
+						if(depthWrite && passed == 0xf)
+						{
+							_mm_storeu_ps(depthRow + groupX, depth);
+						}
+						else if(depthWrite && passed)
+						{
+							float values[4];
+							_mm_storeu_ps(values, depth);
+
+							for(int lane = 0; lane < 4; lane++)
+							{
+								if(passed & (1 << lane))
+									depthRow[groupX + lane] = values[lane];
+							}
+						}
+					}
+
+					if(state.colorWrite && passed)
+					{
+						const __m128 w = _mm_div_ps(one, _mm_add_ps(rowPlaneValues[0], _mm_mul_ps(planeStepsX[0], planeX)));
+
+						__m128i color = _mm_setzero_si128();
+						for(uint32_t channel = 0; channel < 4; channel++)
+						{
+							__m128 value = _mm_mul_ps(_mm_add_ps(rowPlaneValues[channel + 1], _mm_mul_ps(planeStepsX[channel + 1], planeX)), w);
+							value = _mm_min_ps(_mm_max_ps(value, zero), one);
+
+							const __m128i unorm = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(value, scale), rounding));
+							color = _mm_or_si128(color, _mm_slli_epi32(unorm, channel * 8));
+						}
+
+						if(passed == 0xf)
+						{
+							_mm_storeu_si128(reinterpret_cast<__m128i *>(row + groupX), color);
+						}
+						else
+						{
+							uint32_t colors[4];
+							_mm_storeu_si128(reinterpret_cast<__m128i *>(colors), color);
+
+							for(int lane = 0; lane < 4; lane++)
+							{
+								if(passed & (1 << lane))
+									row[groupX + lane] = colors[lane];
+							}
+						}
+					}
+#else
+					uint32_t covered = 0;
+					for(int lane = 0; lane < 4; lane++)
+					{
+						if(((edges[0] + stepX[0] * lane) | (edges[1] + stepX[1] * lane) | (edges[2] + stepX[2] * lane)) >= 0)
+							covered |= (1 << lane);
+					}
+
+					covered &= laneMask;
+
+					for(int edge = 0; edge < 3; edge++)
+						edges[edge] += stepX[edge] * 4;
+
+					if(!covered)
+						continue;
+
+					uint32_t passed = 0;
+					for(int lane = 0; lane < 4; lane++)
+					{
+						if(!(covered & (1 << lane)))
+							continue;
+
+						const float planeX = (static_cast<float>(groupX) - triangle.referenceX) + static_cast<float>(lane);
+
+						if(depthTest || depthWrite)
+						{
+							const float depth = std::min(1.0f, std::max(0.0f, rowPlanes[PlaneDepth] + planes[PlaneDepth][1] * planeX));
+							const float stored = depthRow[groupX + lane];
+
+							if(depthTest && !(lessEqual ? depth <= stored : depth < stored))
+								continue;
+
+							if(depthWrite)
+								depthRow[groupX + lane] = depth;
+						}
+
+						passed |= (1 << lane);
+
+						if(!state.colorWrite)
+							continue;
+
+						const float w = 1.0f / (rowPlanes[0] + planes[0][1] * planeX);
+
+						float color[4];
+						for(uint32_t channel = 0; channel < 4; channel++)
+							color[channel] = (rowPlanes[channel + 1] + planes[channel + 1][1] * planeX) * w;
+
+						row[groupX + lane] = PackColor(color);
+					}
+#endif
+
+					counts->covered += CoveredPixelCount[covered];
+					counts->depthRejected += CoveredPixelCount[covered] - CoveredPixelCount[passed];
+					if(state.colorWrite)
+						counts->written += CoveredPixelCount[passed];
+				}
+
+				for(int edge = 0; edge < 3; edge++)
+					rowEdges[edge] += stepY[edge];
+			}
+		}
+	}
+}
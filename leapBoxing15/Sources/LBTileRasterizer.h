@@ -0,0 +1,146 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "LBWorkerPool.h"
+
+namespace LB
+{
+	// Output of the vertex shader, position in clip space.
+	struct RasterVertex
+	{
+		float position[4];
+		float color[4];
+	};
+
+	enum class RasterDepthTest : uint32_t
+	{
+		Always,
+		Less,
+		LessEqual
+	};
+
+	// Output merger state of the triangles drawn after it is set.
+	struct RasterState
+	{
+		RasterState() : depthTest(RasterDepthTest::Less), depthWrite(true), colorWrite(true) {}
+
+		RasterDepthTest depthTest;
+		bool depthWrite;
+		bool colorWrite;
+	};
+
+	struct TileRasterizerStatistics
+	{
+		uint64_t trianglesSubmitted;
+		uint64_t trianglesRejected;			// Completely outside of the view volume
+		uint64_t trianglesClipped;
+		uint64_t trianglesCulled;			// Back facing or covering no pixel center
+		uint64_t trianglesBinned;
+		uint64_t binEntries;				// Triangle and tile pairs
+		uint64_t pixelsCovered;
+		uint64_t pixelsDepthRejected;
+		uint64_t pixelsWritten;				// Color writes, more than the target has pixels means overdraw
+		uint64_t flushes;
+		double rasterMilliseconds;
+	};
+
+	// Binned rasterizer for RGBA8 targets, following the D3D12 rules the default
+	// pipeline state uses: clipping against the near and far plane, back faces
+	// culled with clockwise triangles facing the front, 4 bit sub pixel precision,
+	// the top left fill rule and perspective correct colors without blending.
+	// Depth is z/w interpolated linearly in screen space and clamped to 0 to 1,
+	// tested and written per pixel against an optional 32 bit float buffer.
+	//
+	// Triangles are set up and sorted into tiles on the calling thread, Flush
+	// rasterizes the tiles in parallel. Every tile is owned by one thread and
+	// draws its triangles in submission order, so the image is the same for any
+	// thread count. Edge functions are evaluated four pixels at a time.
+	class TileRasterizer
+	{
+	public:
+		static const uint32_t TileSize = 64;
+		static const uint32_t MaxTargetSize = 8192;
+
+		TileRasterizer(WorkerPool *workerPool);
+
+		// Flushes the triangles of the previous target, pixels and depth have to
+		// stay valid until the next flush. Without a depth buffer every covered
+		// pixel passes, without pixels only triangles with color writes disabled
+		// can be drawn. Rows are pitch pixels apart, which may be more than width
+		// to draw into the top left of a larger image, 0 means width.
+		void SetTarget(uint8_t *pixels, float *depth, uint32_t width, uint32_t height, uint32_t pitch = 0);
+		void SetState(const RasterState &state) { _state = state; }
+		void DrawTriangle(const RasterVertex &a, const RasterVertex &b, const RasterVertex &c);
+
+		// Rasterizes all binned triangles.
+		void Flush();
+
+		const TileRasterizerStatistics &GetStatistics() const { return _statistics; }
+		void ResetStatistics();
+
+		// Float color to the RGBA8 value the target stores, rounded like UNORM.
+		static uint32_t PackColor(const float color[4]);
+
+	private:
+		static const uint32_t SubpixelBits = 4;
+		static const uint32_t MaxClipVertices = 10;
+
+		// Interpolated values, 1/w and the colors divided by w and last the depth,
+		// which is not perspective corrected.
+		static const uint32_t PlaneCount = 6;
+		static const uint32_t PlaneDepth = 5;
+
+		struct PixelCounts
+		{
+			uint64_t covered;
+			uint64_t depthRejected;
+			uint64_t written;
+		};
+
+		struct Triangle
+		{
+			int32_t minX;					// Covered pixels, inclusive
+			int32_t minY;
+			int32_t maxX;
+			int32_t maxY;
+
+			int32_t stepX[3];				// Edge function changes per pixel
+			int32_t stepY[3];
+			int64_t origin[3];				// Edge functions at pixel 0, 0 with the fill rule bias applied
+
+			float referenceX;				// Pixel center the planes are relative to
+			float referenceY;
+			float planes[PlaneCount][3];	// Value, x and y gradient
+
+			RasterState state;
+		};
+
+		void ClipTriangle(const RasterVertex *vertices);
+		void SetupTriangle(const RasterVertex &a, const RasterVertex &b, const RasterVertex &c);
+		void BinTriangle(uint32_t index);
+		void RasterizeTile(uint32_t tile, PixelCounts *counts);
+
+		WorkerPool *_workerPool;
+
+		uint8_t *_pixels;
+		float *_depth;
+		uint32_t _width;
+		uint32_t _height;
+		uint32_t _pitch;
+		uint32_t _tilesX;
+		uint32_t _tilesY;
+
+		// Guard band in normalized device coordinates, triangles reaching past it
+		// are clipped to keep the edge functions of a tile within 32 bit.
+		float _guardBandX;
+		float _guardBandY;
+
+		RasterState _state;
+		std::vector<Triangle> _triangles;
+		std::vector<std::vector<uint32_t>> _bins;
+
+		TileRasterizerStatistics _statistics;
+	};
+}
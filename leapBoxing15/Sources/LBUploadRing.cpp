@@ -0,0 +1,78 @@
+#if defined(_WIN32)
+#include "stdafx.h"
+#endif
+
+#include "LBUploadRing.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+namespace LB
+{
+	UploadRing::UploadRing(uint64_t capacity) : _capacity(capacity), _head(0), _allocated(0), _reclaimed(0), _batchStart(0)
+	{
+		memset(&_statistics, 0, sizeof(_statistics));
+	}
+
+	uint64_t UploadRing::Allocate(uint64_t size, uint64_t alignment)
+	{
+		assert(alignment > 0 && (alignment & (alignment - 1)) == 0);
+
+		if(size == 0 || size > _capacity)
+		{
+			_statistics.failedAllocations++;
+			return InvalidOffset;
+		}
+
+		// Nothing in use, starting over at the front leaves the whole ring free.
+		if(GetUsedSize() == 0)
+			_head = 0;
+
+		uint64_t offset = (_head + alignment - 1) & ~(alignment - 1);
+		uint64_t padding = offset - _head;
+
+		// Allocations never straddle the end, the rest of the ring is skipped instead.
+		if(offset + size > _capacity)
+		{
+			padding = _capacity - _head;
+			offset = 0;
+		}
+
+		if(GetUsedSize() + padding + size > _capacity)
+		{
+			_statistics.failedAllocations++;
+			return InvalidOffset;
+		}
+
+		_allocated += padding + size;
+		_head = offset + size;
+
+		_statistics.allocations++;
+		_statistics.bytesAllocated += size;
+		_statistics.wrapPadding += (offset == 0 && padding > 0) ? padding : 0;
+		_statistics.highWaterMark = std::max(_statistics.highWaterMark, GetUsedSize());
+
+		return offset;
+	}
+
+	void UploadRing::FinishBatch(uint64_t fenceValue)
+	{
+		if(_allocated == _batchStart)
+			return;
+
+		assert(_batches.empty() || _batches.back().fenceValue <= fenceValue);
+
+		_batches.push_back({ fenceValue, _allocated });
+		_batchStart = _allocated;
+	}
+
+	void UploadRing::Reclaim(uint64_t completedFenceValue)
+	{
+		while(!_batches.empty() && _batches.front().fenceValue <= completedFenceValue)
+		{
+			_reclaimed = _batches.front().allocatedEnd;
+			_batches.pop_front();
+		}
+	}
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+
+namespace LB
+{
+	struct UploadRingStatistics
+	{
+		uint64_t allocations;
+		uint64_t failedAllocations;		// Ring was full, caller had to wait for the GPU
+		uint64_t bytesAllocated;
+		uint64_t wrapPadding;			// Bytes skipped at the end of the ring
+		uint64_t highWaterMark;
+	};
+
+	// Bookkeeping for a ring of upload memory shared with the GPU. Allocations are
+	// handed out linearly, grouped into batches that are closed with the fence
+	// value signaled after their copies, and reclaimed in order once the fence
+	// passed that value. Works purely on offsets so it can be driven by any fence.
+	class UploadRing
+	{
+	public:
+		static const uint64_t InvalidOffset = ~0ull;
+
+		UploadRing(uint64_t capacity);
+
+		// Returns the offset of size bytes at the given power of two alignment, or
+		// InvalidOffset if there is not enough space until older batches complete.
+		uint64_t Allocate(uint64_t size, uint64_t alignment);
+
+		// Closes the current batch, everything allocated since the previous one is
+		// in use until the fence reaches fenceValue.
+		void FinishBatch(uint64_t fenceValue);
+
+		// Frees all batches whose fence value is at or below completedFenceValue.
+		void Reclaim(uint64_t completedFenceValue);
+
+		bool HasPendingBatches() const { return !_batches.empty(); }
+		uint64_t GetOldestPendingFence() const { return _batches.empty() ? 0 : _batches.front().fenceValue; }
+
+		uint64_t GetCapacity() const { return _capacity; }
+		uint64_t GetUsedSize() const { return _allocated - _reclaimed; }
+		const UploadRingStatistics &GetStatistics() const { return _statistics; }
+
+	private:
+		struct Batch
+		{
+			uint64_t fenceValue;
+			uint64_t allocatedEnd;
+		};
+
+		uint64_t _capacity;
+		uint64_t _head;
+
+		// Running totals including padding, their difference is what is in use.
+		uint64_t _allocated;
+		uint64_t _reclaimed;
+		uint64_t _batchStart;
+
+		std::deque<Batch> _batches;
+		UploadRingStatistics _statistics;
+	};
+}
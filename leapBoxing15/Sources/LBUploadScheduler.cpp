@@ -0,0 +1,51 @@
+#if defined(_WIN32)
+#include "stdafx.h"
+#endif
+
+#include "LBUploadScheduler.h"
+
+#include <cassert>
+#include <cstring>
+
+namespace LB
+{
+	UploadScheduler::UploadScheduler() : _submittedValue(0), _graphicsWaitValue(0), _openTickets(0)
+	{
+		memset(&_statistics, 0, sizeof(_statistics));
+	}
+
+	UploadTicket UploadScheduler::Enqueue()
+	{
+		_openTickets++;
+		_statistics.tickets++;
+
+		return _submittedValue + 1;
+	}
+
+	uint64_t UploadScheduler::Submit()
+	{
+		if(_openTickets == 0)
+			return 0;
+
+		_openTickets = 0;
+		_statistics.batches++;
+
+		return ++_submittedValue;
+	}
+
+	uint64_t UploadScheduler::RequireForGraphics(UploadTicket ticket, uint64_t completedValue)
+	{
+		assert(IsSubmitted(ticket));
+
+		if(ticket == 0 || ticket <= completedValue || ticket <= _graphicsWaitValue)
+		{
+			_statistics.graphicsWaitsSkipped++;
+			return 0;
+		}
+
+		_graphicsWaitValue = ticket;
+		_statistics.graphicsWaits++;
+
+		return ticket;
+	}
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstdint>
+
+namespace LB
+{
+	// Identifies the copy batch an upload was recorded into, it is the value the
+	// copy fence is signaled with once that batch completed. 0 means nothing to
+	// wait for.
+	typedef uint64_t UploadTicket;
+
+	struct UploadSchedulerStatistics
+	{
+		uint64_t tickets;
+		uint64_t batches;
+		uint64_t graphicsWaits;			// Waits inserted into the graphics queue
+		uint64_t graphicsWaitsSkipped;	// Uses that were already covered by the fence or an earlier wait
+	};
+
+	// Decides when copy batches are submitted and when the graphics queue has to
+	// wait on the copy fence. Batches are signaled with increasing fence values, so
+	// a single wait on the newest required value covers all older tickets as well.
+	// Only deals in fence values, the queues themselves are driven by the caller.
+	class UploadScheduler
+	{
+	public:
+		UploadScheduler();
+
+		// Ticket for work recorded into the currently open batch.
+		UploadTicket Enqueue();
+
+		bool HasOpenBatch() const { return _openTickets > 0; }
+		uint64_t GetSubmittedValue() const { return _submittedValue; }
+		bool IsSubmitted(UploadTicket ticket) const { return ticket <= _submittedValue; }
+		bool IsComplete(UploadTicket ticket, uint64_t completedValue) const { return ticket <= completedValue; }
+
+		// Closes the open batch and returns the value the copy fence has to be
+		// signaled with after it, 0 if there was nothing to submit.
+		uint64_t Submit();
+
+		// Called when the graphics queue is about to use resources of the ticket.
+		// Returns the copy fence value it has to wait for, or 0 if the copy already
+		// completed or an earlier wait covers it. The ticket has to be submitted.
+		uint64_t RequireForGraphics(UploadTicket ticket, uint64_t completedValue);
+
+		const UploadSchedulerStatistics &GetStatistics() const { return _statistics; }
+
+	private:
+		uint64_t _submittedValue;
+		uint64_t _graphicsWaitValue;
+		uint32_t _openTickets;
+
+		UploadSchedulerStatistics _statistics;
+	};
+}
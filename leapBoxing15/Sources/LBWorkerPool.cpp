@@ -0,0 +1,106 @@
+#if defined(_WIN32)
+#include "stdafx.h"
+#endif
+
+#include "LBWorkerPool.h"
+
+#include <algorithm>
+
+namespace LB
+{
+	WorkerPool::WorkerPool(int32_t workers) : _task(nullptr), _count(0), _next(0), _finished(0), _active(0), _generation(0), _shutdown(false)
+	{
+		if(workers < 0)
+			workers = std::max(static_cast<int32_t>(std::thread::hardware_concurrency()) - 1, 0);
+
+		for(int32_t i = 0; i < workers; i++)
+			_threads.emplace_back(&WorkerPool::WorkerThread, this);
+	}
+
+	WorkerPool::~WorkerPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(_lock);
+			_shutdown = true;
+		}
+
+		_wakeCondition.notify_all();
+
+		for(std::thread &thread : _threads)
+			thread.join();
+	}
+
+	void WorkerPool::ParallelFor(uint32_t count, const std::function<void (uint32_t index)> &task)
+	{
+		if(count == 0)
+			return;
+
+		if(_threads.empty() || count == 1)
+		{
+			for(uint32_t i = 0; i < count; i++)
+				task(i);
+
+			return;
+		}
+
+		{
+			// Workers that woke up late for the previous loop may still be reading its
+			// state, it can only be replaced once they left.
+			std::unique_lock<std::mutex> lock(_lock);
+			_doneCondition.wait(lock, [this] { return _active == 0; });
+
+			_task = &task;
+			_count = count;
+			_next = 0;
+			_finished = 0;
+			_generation++;
+		}
+
+		_wakeCondition.notify_all();
+
+		RunTasks();
+
+		std::unique_lock<std::mutex> lock(_lock);
+		_doneCondition.wait(lock, [this] { return _finished == _count && _active == 0; });
+	}
+
+	void WorkerPool::RunTasks()
+	{
+		uint32_t index;
+		while((index = _next.fetch_add(1)) < _count)
+		{
+			(*_task)(index);
+
+			if(_finished.fetch_add(1) + 1 == _count)
+			{
+				std::lock_guard<std::mutex> lock(_lock);
+				_doneCondition.notify_all();
+			}
+		}
+	}
+
+	void WorkerPool::WorkerThread()
+	{
+		uint64_t generation = 0;
+
+		while(true)
+		{
+			{
+				std::unique_lock<std::mutex> lock(_lock);
+				_wakeCondition.wait(lock, [&] { return _shutdown || _generation != generation; });
+
+				if(_shutdown)
+					return;
+
+				generation = _generation;
+				_active++;
+			}
+
+			RunTasks();
+
+			std::lock_guard<std::mutex> lock(_lock);
+			if(--_active == 0)
+				_doneCondition.notify_all();
+		}
+	}
+}
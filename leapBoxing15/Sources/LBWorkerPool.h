@@ -0,0 +1,50 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace LB
+{
+	// Fixed set of worker threads for fork/join style parallel loops. The calling
+	// thread takes part in the work, so a pool with zero workers runs everything
+	// inline.
+	class WorkerPool
+	{
+	public:
+		// A negative count creates one worker per hardware thread minus the caller.
+		WorkerPool(int32_t workers = -1);
+		~WorkerPool();
+
+		// Number of threads taking part in ParallelFor, including the caller.
+		uint32_t GetThreadCount() const
+		{
+			return static_cast<uint32_t>(_threads.size()) + 1;
+		}
+
+		// Runs task(index) for every index below count and returns once all of them
+		// finished. Not reentrant, only one thread may dispatch at a time.
+		void ParallelFor(uint32_t count, const std::function<void (uint32_t index)> &task);
+
+	private:
+		void WorkerThread();
+		void RunTasks();
+
+		std::vector<std::thread> _threads;
+		std::mutex _lock;
+		std::condition_variable _wakeCondition;
+		std::condition_variable _doneCondition;
+
+		const std::function<void (uint32_t)> *_task;
+		uint32_t _count;
+		std::atomic<uint32_t> _next;
+		std::atomic<uint32_t> _finished;
+		uint32_t _active;
+		uint64_t _generation;
+		bool _shutdown;
+	};
+}
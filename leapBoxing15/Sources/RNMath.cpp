@@ -6,15 +6,20 @@
 //  Unauthorized use is punishable by torture, mutilation, and vivisection.
 //
 
+#if defined(_WIN32)
 #include "stdafx.h"
+#endif
+
 #include "RNMath.h"
 #include "RNVector.h"
 
+#include <cstdint>
+
 namespace RN
 {
 	namespace Math
 	{
-		alignas(128) const UINT32 ITrigonometryTable[256][2] =
+		alignas(128) const uint32_t ITrigonometryTable[256][2] =
 		{
 			{0x3F800000, 0x00000000}, {0x3F7FEC43, 0x3CC90AB0}, {0x3F7FB10F, 0x3D48FB30}, {0x3F7F4E6D, 0x3D96A905}, {0x3F7EC46D, 0x3DC8BD36}, {0x3F7E1324, 0x3DFAB273}, {0x3F7D3AAC, 0x3E164083}, {0x3F7C3B28, 0x3E2F10A3},
 			{0x3F7B14BE, 0x3E47C5C2}, {0x3F79C79D, 0x3E605C13}, {0x3F7853F8, 0x3E78CFCD}, {0x3F76BA07, 0x3E888E94}, {0x3F74FA0B, 0x3E94A031}, {0x3F731447, 0x3EA09AE5}, {0x3F710908, 0x3EAC7CD4}, {0x3F6ED89E, 0x3EB8442A},
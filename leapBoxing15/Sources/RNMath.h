@@ -6,6 +6,7 @@
 //  Unauthorized use is punishable by torture, mutilation, and vivisection.
 //
 
+#include <cmath>
 #include <limits>
 
 #ifndef __RAYNE_MATH_H__
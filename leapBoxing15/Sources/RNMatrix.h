@@ -9,7 +9,8 @@
 #ifndef __RAYNE_MATRIX_H__
 #define __RAYNE_MATRIX_H__
 
-#include "stdafx.h"
+#include <cmath>
+
 #include "RNVector.h"
 #include "RNMatrixQuaternion.h"
 
@@ -845,7 +845,7 @@ namespace RN
 		return *this;
 	}
 	
-	inline Vector4 Vector4::GetNormalized(const float n) const
+	inline Vector4 Vector4::GetNormalized(const float) const
 	{
 		return Vector4(*this).Normalize();
 	}
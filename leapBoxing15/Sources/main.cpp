@@ -2,7 +2,10 @@
 #include "LBApplication.h"
 
 _Use_decl_annotations_
-int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR, int nCmdShow)
+int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR lpCmdLine, int nCmdShow)
 {
+	if(strstr(lpCmdLine, "-precompileshaders"))
+		return LB::Application::GetInstance().PrecompileShaders();
+
 	return LB::Application::GetInstance().Run(hInstance, nCmdShow);
 }
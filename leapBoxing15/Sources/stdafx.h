@@ -30,12 +30,16 @@
 #include <windows.h>
 
 #include <d3d12.h>
-#include <dxgi1_4.h>
+#include <dxgi1_5.h>
 #include <D3Dcompiler.h>
 #include <DirectXMath.h>
 #include "d3dx12.h"
 
 #include <string>
+#include <chrono>
+#include <stdexcept>
+#include <algorithm>
+#include <atomic>
 #include <wrl.h>
 
 inline void ThrowIfFailed(HRESULT hr)
@@ -0,0 +1,274 @@
+#include "TestHarness.h"
+
+#include "LBBufferAllocator.h"
+#include "LBHeadlessBackend.h"
+#include "LBMaterial.h"
+#include "LBMesh.h"
+#include "LBRenderer.h"
+#include "LBRenderSnapshot.h"
+
+#include <cstring>
+#include <map>
+#include <vector>
+
+namespace
+{
+	void TestAllocationsAreRoundedAndPacked()
+	{
+		LB::TlsfAllocator allocator(1024, 16);
+
+		const uint32_t a = allocator.Allocate(1, nullptr);
+		const uint32_t b = allocator.Allocate(17, nullptr);
+		const uint32_t c = allocator.Allocate(0, nullptr);
+
+		LB_CHECK(allocator.GetOffset(a) == 0);
+		LB_CHECK(allocator.GetOffset(b) == 16);
+		LB_CHECK(allocator.GetOffset(c) == 48);
+		LB_CHECK(allocator.GetUsedSize() == 64);
+		LB_CHECK(allocator.GetAllocationCount() == 3);
+		LB_CHECK(allocator.GetFreeBlockCount() == 1);
+	}
+
+	void TestFreeMergesNeighbours()
+	{
+		LB::TlsfAllocator allocator(1024, 16);
+
+		uint32_t blocks[4];
+		for(uint32_t &block : blocks)
+			block = allocator.Allocate(256, nullptr);
+
+		LB_CHECK(allocator.Allocate(16, nullptr) == LB::TlsfAllocator::InvalidBlock);
+		LB_CHECK(allocator.GetLargestFreeBlock() == 0);
+
+		allocator.Free(blocks[0]);
+		allocator.Free(blocks[2]);
+		LB_CHECK(allocator.GetFreeBlockCount() == 2);
+		LB_CHECK(allocator.GetLargestFreeBlock() == 256);
+		LB_CHECK(allocator.Allocate(512, nullptr) == LB::TlsfAllocator::InvalidBlock);
+
+		// Joins both free neighbours into one block.
+		allocator.Free(blocks[1]);
+		LB_CHECK(allocator.GetFreeBlockCount() == 1);
+		LB_CHECK(allocator.GetLargestFreeBlock() == 768);
+
+		const uint32_t large = allocator.Allocate(768, nullptr);
+		LB_CHECK(large != LB::TlsfAllocator::InvalidBlock);
+		LB_CHECK(allocator.GetOffset(large) == 0);
+
+		allocator.Free(large);
+		allocator.Free(blocks[3]);
+		LB_CHECK(allocator.GetUsedSize() == 0);
+		LB_CHECK(allocator.GetLargestFreeBlock() == 1024);
+	}
+
+	// A block found through its size class always fits, even if a larger free
+	// block in the same class would have to be skipped.
+	void TestSizeClassesFit()
+	{
+		LB::TlsfAllocator allocator(1 << 20, 16);
+
+		std::vector<uint32_t> blocks;
+		for(uint64_t size = 16; size < 40000; size = size * 3 / 2 + 16)
+		{
+			blocks.push_back(allocator.Allocate(size, nullptr));
+			blocks.push_back(allocator.Allocate(16, nullptr));
+		}
+
+		for(size_t i = 0; i < blocks.size(); i += 2)
+			allocator.Free(blocks[i]);
+
+		for(uint64_t size = 16; size < 40000; size = size * 3 / 2 + 16)
+		{
+			const uint32_t block = allocator.Allocate(size, nullptr);
+			LB_CHECK(block != LB::TlsfAllocator::InvalidBlock);
+
+			// No other allocation may start inside the block.
+			const uint64_t offset = allocator.GetOffset(block);
+			for(size_t i = 1; i < blocks.size(); i += 2)
+				LB_CHECK(allocator.GetOffset(blocks[i]) + 16 <= offset || allocator.GetOffset(blocks[i]) >= offset + size);
+		}
+	}
+
+	void TestDefragmentSlidesAllocationsDown()
+	{
+		LB::TlsfAllocator allocator(1024, 16);
+
+		int owners[6];
+		uint32_t blocks[6];
+		for(int i = 0; i < 6; i++)
+			blocks[i] = allocator.Allocate(64 + i * 16, &owners[i]);
+
+		allocator.Free(blocks[0]);
+		allocator.Free(blocks[2]);
+		allocator.Free(blocks[4]);
+
+		std::vector<LB::TlsfAllocator::Move> moves;
+
+		// Limited number of moves per call.
+		LB_CHECK(allocator.Defragment(1, moves) == 1);
+		LB_CHECK(moves.size() == 1);
+		LB_CHECK(moves[0].block == blocks[1]);
+		LB_CHECK(moves[0].oldOffset == 64);
+		LB_CHECK(moves[0].newOffset == 0);
+		LB_CHECK(moves[0].userData == &owners[1]);
+
+		while(allocator.Defragment(8, moves) > 0);
+
+		// Handles stay valid and the live allocations are packed at the front.
+		LB_CHECK(allocator.GetOffset(blocks[1]) == 0);
+		LB_CHECK(allocator.GetOffset(blocks[3]) == 80);
+		LB_CHECK(allocator.GetOffset(blocks[5]) == 192);
+		LB_CHECK(allocator.GetFreeBlockCount() == 1);
+		LB_CHECK(allocator.GetLargestFreeBlock() == 1024 - allocator.GetUsedSize());
+
+		// Freeing a moved block still merges correctly.
+		allocator.Free(blocks[3]);
+		allocator.Free(blocks[1]);
+		allocator.Free(blocks[5]);
+		LB_CHECK(allocator.GetLargestFreeBlock() == 1024);
+	}
+
+	void TestPagesAndStatistics()
+	{
+		LB::BufferAllocator allocator(1024, 16);
+
+		const LB::BufferAllocation a = allocator.Allocate(512, nullptr);
+		const LB::BufferAllocation b = allocator.Allocate(512, nullptr);
+		const LB::BufferAllocation c = allocator.Allocate(256, nullptr);
+		LB_CHECK(a.page == 0 && b.page == 0);
+		LB_CHECK(c.page == 1);
+
+		// Larger than a page, gets one of its own.
+		const LB::BufferAllocation large = allocator.Allocate(4000, nullptr);
+		LB_CHECK(large.page == 2);
+		LB_CHECK(allocator.GetPageSize(2) == 4000);
+
+		allocator.Free(a);
+
+		LB::BufferAllocatorStatistics statistics = allocator.GetStatistics();
+		LB_CHECK(statistics.pages == 3);
+		LB_CHECK(statistics.allocations == 3);
+		LB_CHECK(statistics.reservedBytes == 1024 + 1024 + 4000);
+		LB_CHECK(statistics.usedBytes == 512 + 256 + 4000);
+		LB_CHECK(statistics.largestFreeBlock == 768);
+		LB_CHECK(statistics.fragmentation == 0.0f);
+
+		// Fills the first page, the next one goes behind c, which leaves two free
+		// ranges in the second page once c is gone.
+		const LB::BufferAllocation d = allocator.Allocate(512, nullptr);
+		const LB::BufferAllocation e = allocator.Allocate(256, nullptr);
+		LB_CHECK(d.page == 0);
+		LB_CHECK(e.page == 1 && e.offset == 256);
+		allocator.Free(c);
+
+		statistics = allocator.GetStatistics();
+		LB_CHECK(statistics.fragmentation > 0.0f);
+
+		std::vector<LB::BufferMove> moves;
+		LB_CHECK(allocator.Defragment(16, moves) > 0);
+		LB_CHECK(allocator.GetStatistics().fragmentation == 0.0f);
+		for(const LB::BufferMove &move : moves)
+			LB_CHECK(move.from.page == move.to.page && move.from.block == move.to.block);
+	}
+
+	// Triangles with a different vertex count each, so draws can be told apart.
+	std::vector<float> MakeVertices(uint32_t vertexCount, float value)
+	{
+		std::vector<float> vertices(vertexCount * 7);
+		for(size_t i = 0; i < vertices.size(); i++)
+			vertices[i] = value + static_cast<float>(i);
+
+		return vertices;
+	}
+
+	// The renderer side of defragmentation: moved meshes get their contents copied
+	// and their bindings updated, drawing them reads the same vertices as before.
+	void TestRendererDefragmentsMeshBuffers()
+	{
+		LB::HeadlessBackend backend(64, 64);
+		LB::Renderer renderer(&backend);
+
+		LB::Material *material = new LB::Material(&renderer, L"shaders.hlsl");
+
+		std::map<uint32_t, std::vector<float>> vertexData;
+		std::vector<LB::Mesh *> meshes;
+		for(uint32_t i = 0; i < 8; i++)
+		{
+			const uint32_t vertexCount = 3 + i;
+			vertexData[vertexCount] = MakeVertices(vertexCount, static_cast<float>(i * 100));
+			meshes.push_back(LB::Mesh::WithData(&renderer, vertexData[vertexCount].data(), vertexCount, nullptr, 0, LB::PrimitiveTopology::TriangleList));
+		}
+
+		LB::RenderSnapshot snapshot = {};
+		for(int n = 0; n < 4; n++)
+			snapshot.viewMatrix[n * 5] = 1.0f;
+
+		// Every other mesh goes away, leaving holes in the page.
+		for(size_t i = 0; i < meshes.size(); i += 2)
+		{
+			vertexData.erase(3 + static_cast<uint32_t>(i));
+			delete meshes[i];
+			meshes[i] = nullptr;
+		}
+
+		for(LB::Mesh *mesh : meshes)
+		{
+			if(!mesh)
+				continue;
+
+			LB::RenderItem item = {};
+			for(int n = 0; n < 4; n++)
+				item.worldMatrix[n * 5] = 1.0f;
+			item.mesh = mesh;
+			item.material = material;
+			snapshot.items.push_back(item);
+		}
+
+		// The freed ranges return once the frames that could use them completed.
+		for(uint32_t frame = 0; frame < 3; frame++)
+			renderer.Render(snapshot);
+
+		LB_CHECK(renderer.GetBufferStatistics().fragmentation > 0.0f);
+		LB_CHECK(renderer.DefragmentBuffers(64) > 0);
+		LB_CHECK(renderer.GetBufferStatistics().fragmentation == 0.0f);
+		LB_CHECK(renderer.GetBufferStatistics().allocations == 4);
+
+		renderer.Render(snapshot);
+
+		uint32_t drawsChecked = 0;
+		LB::VertexBufferBinding binding = {};
+		for(const LB::EncodedCommand &command : backend.GetFrameCommands())
+		{
+			if(command.type == LB::EncodedCommandType::SetVertexBuffer && command.arguments[0] == 0)
+				binding = command.vertexBuffer;
+
+			if(command.type != LB::EncodedCommandType::DrawInstanced)
+				continue;
+
+			const std::vector<float> &expected = vertexData[command.arguments[0]];
+			const uint8_t *data = backend.ResolveAddress(binding.location, binding.size);
+
+			LB_CHECK(binding.size == expected.size() * sizeof(float));
+			LB_CHECK(data && memcmp(data, expected.data(), binding.size) == 0);
+			drawsChecked++;
+		}
+
+		LB_CHECK(drawsChecked == 4);
+
+		for(LB::Mesh *mesh : meshes)
+			delete mesh;
+		delete material;
+	}
+}
+
+int main()
+{
+	LB::Test::Run("allocations are rounded and packed", TestAllocationsAreRoundedAndPacked);
+	LB::Test::Run("free merges neighbours", TestFreeMergesNeighbours);
+	LB::Test::Run("size classes only return blocks that fit", TestSizeClassesFit);
+	LB::Test::Run("defragment slides allocations down", TestDefragmentSlidesAllocationsDown);
+	LB::Test::Run("pages and statistics", TestPagesAndStatistics);
+	LB::Test::Run("renderer defragments mesh buffers", TestRendererDefragmentsMeshBuffers);
+
+	return LB::Test::Finish();
+}
@@ -0,0 +1,148 @@
+#include "TestHarness.h"
+
+#include "LBDescriptorAllocator.h"
+
+namespace
+{
+	void TestFreeListMergesNeighbours()
+	{
+		LB::DescriptorFreeList list(16, 64);
+
+		const uint32_t a = list.Allocate(8);
+		const uint32_t b = list.Allocate(8);
+		const uint32_t c = list.Allocate(8);
+
+		LB_CHECK(a == 16);
+		LB_CHECK(b == 24);
+		LB_CHECK(c == 32);
+		LB_CHECK(list.GetFreeCount() == 40);
+
+		// Neither neighbour is free, a new range.
+		list.Free(b, 8);
+		LB_CHECK(list.GetFreeRangeCount() == 2);
+
+		// Merges with both sides.
+		list.Free(c, 8);
+		LB_CHECK(list.GetFreeRangeCount() == 1);
+		LB_CHECK(list.GetLargestFreeRange() == 56);
+
+		// Merges with the range behind it.
+		list.Free(a, 8);
+		LB_CHECK(list.GetFreeRangeCount() == 1);
+		LB_CHECK(list.GetFreeCount() == 64);
+		LB_CHECK(list.Allocate(64) == 16);
+	}
+
+	void TestFreeListFirstFit()
+	{
+		LB::DescriptorFreeList list(0, 32);
+
+		const uint32_t a = list.Allocate(4);
+		list.Allocate(4);
+		const uint32_t c = list.Allocate(8);
+		list.Allocate(4);
+
+		list.Free(a, 4);
+		list.Free(c, 8);
+
+		// The first hole is too small for 6.
+		LB_CHECK(list.Allocate(6) == c);
+		LB_CHECK(list.Allocate(4) == a);
+		LB_CHECK(list.Allocate(0) == LB::DescriptorFreeList::InvalidIndex);
+		LB_CHECK(list.Allocate(64) == LB::DescriptorFreeList::InvalidIndex);
+	}
+
+	void TestPersistentFreesWaitForTheFence()
+	{
+		LB::DescriptorAllocator allocator(4, 16);
+
+		uint32_t indices[4];
+		for(uint32_t &index : indices)
+			index = allocator.AllocatePersistent();
+
+		LB_CHECK(indices[0] == 0 && indices[3] == 3);
+		LB_CHECK(allocator.AllocatePersistent() == LB::DescriptorAllocator::InvalidIndex);
+
+		allocator.FreePersistent(indices[1], 1, 5);
+		allocator.FreePersistent(indices[2], 1, 6);
+		LB_CHECK(allocator.GetOldestPendingFence() == 5);
+
+		// Still referenced by frames in flight.
+		allocator.Reclaim(4);
+		LB_CHECK(allocator.AllocatePersistent() == LB::DescriptorAllocator::InvalidIndex);
+
+		allocator.Reclaim(5);
+		LB_CHECK(allocator.AllocatePersistent() == indices[1]);
+		LB_CHECK(allocator.GetOldestPendingFence() == 6);
+
+		allocator.Reclaim(6);
+		LB_CHECK(allocator.AllocatePersistent() == indices[2]);
+		LB_CHECK(allocator.GetOldestPendingFence() == 0);
+	}
+
+	void TestTransientRingWraps()
+	{
+		LB::DescriptorAllocator allocator(8, 16);
+
+		// Ring indices come after the persistent region.
+		LB_CHECK(allocator.AllocateTransient(6) == 8);
+		allocator.FinishFrame(1);
+		LB_CHECK(allocator.AllocateTransient(6) == 14);
+		allocator.FinishFrame(2);
+
+		// Only 4 left at the end, a table never straddles it and the start is
+		// still in use.
+		LB_CHECK(allocator.AllocateTransient(6) == LB::DescriptorAllocator::InvalidIndex);
+		LB_CHECK(allocator.GetOldestPendingFence() == 1);
+
+		allocator.Reclaim(1);
+		LB_CHECK(allocator.AllocateTransient(6) == 8);
+		allocator.FinishFrame(3);
+
+		// Empty again, the whole ring is available.
+		allocator.Reclaim(3);
+		LB_CHECK(allocator.GetOldestPendingFence() == 0);
+		LB_CHECK(allocator.AllocateTransient(16) == 8);
+	}
+
+	void TestStatistics()
+	{
+		LB::DescriptorAllocator allocator(4, 8);
+
+		const uint32_t index = allocator.AllocatePersistent(2);
+		allocator.AllocateTransient(3);
+		allocator.AllocateTransient(8);
+		allocator.FreePersistent(index, 2, 1);
+		allocator.FinishFrame(1);
+
+		LB::DescriptorStatistics statistics = allocator.GetStatistics();
+		LB_CHECK(statistics.persistentAllocations == 2);
+		LB_CHECK(statistics.persistentFrees == 2);
+		LB_CHECK(statistics.transientDescriptors == 3);
+		LB_CHECK(statistics.failedAllocations == 1);
+
+		// Pending frees are in use until the fence passes.
+		LB_CHECK(statistics.persistentInUse == 2);
+		LB_CHECK(statistics.transientInUse == 3);
+
+		allocator.Reclaim(1);
+		allocator.ResetStatistics();
+
+		statistics = allocator.GetStatistics();
+		LB_CHECK(statistics.persistentAllocations == 0);
+		LB_CHECK(statistics.failedAllocations == 0);
+		LB_CHECK(statistics.persistentInUse == 0);
+		LB_CHECK(statistics.transientInUse == 0);
+	}
+}
+
+int main()
+{
+	LB::Test::Run("free list merges neighbours", TestFreeListMergesNeighbours);
+	LB::Test::Run("free list is first fit", TestFreeListFirstFit);
+	LB::Test::Run("persistent frees wait for the fence", TestPersistentFreesWaitForTheFence);
+	LB::Test::Run("transient ring wraps", TestTransientRingWraps);
+	LB::Test::Run("statistics", TestStatistics);
+
+	return LB::Test::Finish();
+}
@@ -0,0 +1,184 @@
+#include "TestHarness.h"
+
+#include "LBFramePacer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace
+{
+	// A GPU working through frames one after another, each taking frameTime
+	// seconds once it was submitted and the previous one is done.
+	struct SimulatedGpu
+	{
+		explicit SimulatedGpu(double frameTime) : frameTime(frameTime) {}
+
+		void Submit(uint64_t value, double time)
+		{
+			const double start = finishTimes.empty() ? time : std::max(time, finishTimes.back());
+			finishTimes.resize(value, start);
+			finishTimes[value - 1] = start + frameTime;
+		}
+
+		uint64_t GetCompletedValue(double time) const
+		{
+			uint64_t value = 0;
+			while(value < finishTimes.size() && finishTimes[value] <= time)
+				value++;
+
+			return value;
+		}
+
+		double GetFinishTime(uint64_t value) const
+		{
+			return finishTimes[value - 1];
+		}
+
+		double frameTime;
+		std::vector<double> finishTimes;
+	};
+
+	struct SimulationResult
+	{
+		uint32_t maxFramesInFlight;
+		double lastWaitMilliseconds;
+		double lastLatencyMilliseconds;
+	};
+
+	// Runs frames the way the renderer does: wait for the pacer's fence value,
+	// record for cpuTime seconds, submit.
+	SimulationResult Simulate(LB::FramePacer &pacer, double cpuTime, double gpuTime, uint32_t frames)
+	{
+		SimulatedGpu gpu(gpuTime);
+		SimulationResult result = {};
+		double time = 0.0;
+
+		for(uint32_t frame = 0; frame < frames; frame++)
+		{
+			const uint32_t frameIndex = frame % pacer.GetFrameCount();
+			const uint64_t waitValue = pacer.GetWaitValue(frameIndex);
+			const double waitStart = time;
+
+			if(gpu.GetCompletedValue(time) < waitValue)
+				time = gpu.GetFinishTime(waitValue);
+
+			pacer.Complete(gpu.GetCompletedValue(time), time);
+			pacer.BeginFrame(frameIndex, time, (time - waitStart) * 1000.0);
+
+			result.maxFramesInFlight = std::max(result.maxFramesInFlight, pacer.GetStatistics().framesInFlight);
+
+			time += cpuTime;
+			gpu.Submit(pacer.EndFrame(time), time);
+		}
+
+		result.lastWaitMilliseconds = pacer.GetStatistics().waitMilliseconds;
+		result.lastLatencyMilliseconds = pacer.GetStatistics().latencyMilliseconds;
+		return result;
+	}
+
+	bool IsClose(double a, double b)
+	{
+		return std::fabs(a - b) < 1e-6;
+	}
+
+	void TestSettingsAreClamped()
+	{
+		LB::FramePacer small(1, 0);
+		LB_CHECK(small.GetFrameCount() == LB::FramePacer::MinFrameCount);
+		LB_CHECK(small.GetMaxFrameLatency() == 1);
+
+		LB::FramePacer large(8, 8);
+		LB_CHECK(large.GetFrameCount() == LB::FramePacer::MaxFrameCount);
+		LB_CHECK(large.GetMaxFrameLatency() == LB::FramePacer::MaxFrameCount);
+
+		LB::FramePacer limited(3, 5);
+		LB_CHECK(limited.GetMaxFrameLatency() == 3);
+	}
+
+	// GPU bound, the CPU gets exactly maxFrameLatency frames ahead and the
+	// latency grows with it, one GPU frame per frame in flight.
+	void TestGpuBoundLatency()
+	{
+		const double cpuTime = 0.004;
+		const double gpuTime = 0.010;
+
+		for(uint32_t frameCount = LB::FramePacer::MinFrameCount; frameCount <= LB::FramePacer::MaxFrameCount; frameCount++)
+		{
+			for(uint32_t latency = 1; latency <= frameCount; latency++)
+			{
+				LB::FramePacer pacer(frameCount, latency);
+				const SimulationResult result = Simulate(pacer, cpuTime, gpuTime, 2000);
+
+				LB_CHECK(result.maxFramesInFlight == latency - 1);
+				LB_CHECK(result.lastWaitMilliseconds > 0.0);
+
+				// With a single frame the GPU idles while the CPU records.
+				const double expected = std::max(latency * gpuTime, cpuTime + gpuTime) * 1000.0;
+				LB_CHECK(IsClose(result.lastLatencyMilliseconds, expected));
+				LB_CHECK(IsClose(pacer.GetStatistics().averageLatencyMilliseconds, expected));
+				LB_CHECK(IsClose(pacer.GetStatistics().cpuMilliseconds, cpuTime * 1000.0));
+			}
+		}
+	}
+
+	// CPU bound, more frames in flight don't add latency and only a latency of
+	// one makes the CPU wait. Without the wait, completion is only noticed when
+	// the frame after next starts, which is what gets reported.
+	void TestCpuBoundLatency()
+	{
+		const double cpuTime = 0.010;
+		const double gpuTime = 0.004;
+
+		for(uint32_t frameCount = LB::FramePacer::MinFrameCount; frameCount <= LB::FramePacer::MaxFrameCount; frameCount++)
+		{
+			for(uint32_t latency = 1; latency <= frameCount; latency++)
+			{
+				LB::FramePacer pacer(frameCount, latency);
+				const SimulationResult result = Simulate(pacer, cpuTime, gpuTime, 200);
+
+				LB_CHECK(result.maxFramesInFlight == std::min(latency - 1, 1u));
+				LB_CHECK(IsClose(result.lastWaitMilliseconds, (latency == 1) ? gpuTime * 1000.0 : 0.0));
+				LB_CHECK(IsClose(result.lastLatencyMilliseconds, ((latency == 1) ? cpuTime + gpuTime : 2.0 * cpuTime) * 1000.0));
+			}
+		}
+	}
+
+	// Flushes take fence values without being frames, they don't show up in the
+	// frame statistics.
+	void TestFlushBetweenFrames()
+	{
+		LB::FramePacer pacer(2, 2);
+
+		pacer.BeginFrame(0, 0.0, 0.0);
+		LB_CHECK(pacer.EndFrame(0.001) == 1);
+		pacer.BeginFrame(1, 0.001, 0.0);
+		LB_CHECK(pacer.EndFrame(0.002) == 2);
+
+		LB_CHECK(pacer.Flush() == 3);
+		LB_CHECK(pacer.GetSubmittedValue() == 3);
+
+		// The flush counts towards the latency limit, which wants 2, the back
+		// buffer only 1.
+		LB_CHECK(pacer.GetWaitValue(0) == 2);
+
+		pacer.Complete(3, 0.010);
+		LB_CHECK(pacer.GetCompletedValue() == 3);
+		LB_CHECK(pacer.GetStatistics().framesCompleted == 2);
+		LB_CHECK(IsClose(pacer.GetStatistics().latencyMilliseconds, 9.0));
+
+		pacer.BeginFrame(0, 0.010, 0.0);
+		LB_CHECK(pacer.GetStatistics().framesInFlight == 0);
+		LB_CHECK(pacer.EndFrame(0.011) == 4);
+	}
+}
+
+int main()
+{
+	LB::Test::Run("settings are clamped", TestSettingsAreClamped);
+	LB::Test::Run("gpu bound latency follows the limit", TestGpuBoundLatency);
+	LB::Test::Run("cpu bound latency doesn't grow with the limit", TestCpuBoundLatency);
+	LB::Test::Run("flushes between frames", TestFlushBetweenFrames);
+
+	return LB::Test::Finish();
+}
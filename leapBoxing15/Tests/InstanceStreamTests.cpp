@@ -0,0 +1,250 @@
+#include "TestHarness.h"
+
+#include "LBInstanceStream.h"
+
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+namespace
+{
+	const LB::InstanceFormat Formats[] = { LB::InstanceFormat::Matrix, LB::InstanceFormat::Affine, LB::InstanceFormat::AffineHalf };
+
+	// Rotation and scale in the upper 3x3 part, a translation in the last row
+	// and the last column as an affine matrix has it.
+	void MakeTransform(uint32_t index, float *matrix)
+	{
+		const float angle = 0.1f * static_cast<float>(index);
+		const float scale = 0.5f + 0.01f * static_cast<float>(index % 100);
+
+		const float values[16] = {
+			std::cos(angle) * scale, std::sin(angle) * scale, 0.0f, 0.0f,
+			-std::sin(angle) * scale, std::cos(angle) * scale, 0.0f, 0.0f,
+			0.0f, 0.0f, scale, 0.0f,
+			static_cast<float>(index) * 3.0f - 1000.0f, 0.25f * static_cast<float>(index), -12345.678f, 1.0f
+		};
+
+		memcpy(matrix, values, sizeof(values));
+	}
+
+	std::vector<LB::RenderItem> MakeItems(uint32_t count)
+	{
+		std::vector<LB::RenderItem> items(count);
+		for(uint32_t i = 0; i < count; i++)
+		{
+			memset(&items[i], 0, sizeof(items[i]));
+			MakeTransform(i, items[i].worldMatrix);
+		}
+
+		return items;
+	}
+
+	// Backwards two items at a time, so the order is followed and not the items.
+	std::vector<uint32_t> MakeOrder(uint32_t itemCount, uint32_t count)
+	{
+		std::vector<uint32_t> order(count);
+		for(uint32_t i = 0; i < count; i++)
+			order[i] = (itemCount - 1 - i * 2) % itemCount;
+
+		return order;
+	}
+
+	// What WriteRange has to produce, encoded one instance at a time.
+	std::vector<uint8_t> EncodeReference(LB::InstanceFormat format, const std::vector<LB::RenderItem> &items, const std::vector<uint32_t> &order)
+	{
+		const uint32_t instanceSize = LB::InstanceStream::GetInstanceSize(format);
+		std::vector<uint8_t> data(order.size() * instanceSize);
+
+		for(size_t i = 0; i < order.size(); i++)
+			LB::InstanceStream::EncodeInstance(format, items[order[i]].worldMatrix, data.data() + i * instanceSize);
+
+		return data;
+	}
+
+	// Value of a matrix element after going through the half format.
+	float RoundTripHalf(float value)
+	{
+		float matrix[16] = {};
+		matrix[0] = value;
+		matrix[15] = 1.0f;
+
+		uint8_t instance[64];
+		LB::InstanceStream::EncodeInstance(LB::InstanceFormat::AffineHalf, matrix, instance);
+
+		float decoded[16];
+		LB::InstanceStream::DecodeInstance(LB::InstanceFormat::AffineHalf, instance, decoded);
+		return decoded[0];
+	}
+
+	void TestInstanceSizes()
+	{
+		LB_CHECK(LB::InstanceStream::GetInstanceSize(LB::InstanceFormat::Matrix) == 64);
+		LB_CHECK(LB::InstanceStream::GetInstanceSize(LB::InstanceFormat::Affine) == 48);
+		LB_CHECK(LB::InstanceStream::GetInstanceSize(LB::InstanceFormat::AffineHalf) == 36);
+	}
+
+	// The float formats are exact for affine matrices, the half format keeps the
+	// translation exact and the rest to 11 significant bits.
+	void TestDecodeGivesTheMatrixBack()
+	{
+		for(uint32_t i = 0; i < 50; i++)
+		{
+			float matrix[16];
+			MakeTransform(i * 7, matrix);
+
+			for(LB::InstanceFormat format : Formats)
+			{
+				uint8_t instance[64];
+				LB::InstanceStream::EncodeInstance(format, matrix, instance);
+
+				float decoded[16];
+				LB::InstanceStream::DecodeInstance(format, instance, decoded);
+
+				if(format != LB::InstanceFormat::AffineHalf)
+				{
+					LB_CHECK(memcmp(decoded, matrix, sizeof(matrix)) == 0);
+					continue;
+				}
+
+				for(uint32_t element = 0; element < 16; element++)
+				{
+					if(element >= 12 || element % 4 == 3)
+						LB_CHECK(decoded[element] == matrix[element]);
+					else
+						LB_CHECK(std::fabs(decoded[element] - matrix[element]) <= std::fabs(matrix[element]) / 2048.0f);
+				}
+			}
+		}
+
+		// The last column is implied, whatever was in it.
+		float matrix[16];
+		MakeTransform(3, matrix);
+		matrix[3] = 5.0f;
+		matrix[15] = 2.0f;
+
+		uint8_t instance[64];
+		LB::InstanceStream::EncodeInstance(LB::InstanceFormat::Affine, matrix, instance);
+		float decoded[16];
+		LB::InstanceStream::DecodeInstance(LB::InstanceFormat::Affine, instance, decoded);
+		LB_CHECK(decoded[3] == 0.0f && decoded[15] == 1.0f);
+	}
+
+	// Halfway cases go to the even neighbor, out of range becomes infinity and
+	// subnormals are kept.
+	void TestHalfRounding()
+	{
+		LB_CHECK(RoundTripHalf(1.0f) == 1.0f);
+		LB_CHECK(RoundTripHalf(-2.5f) == -2.5f);
+
+		const float ulp = 1.0f / 1024.0f;
+		LB_CHECK(RoundTripHalf(1.0f + ulp * 0.5f) == 1.0f);
+		LB_CHECK(RoundTripHalf(1.0f + ulp * 1.5f) == 1.0f + ulp * 2.0f);
+		LB_CHECK(RoundTripHalf(1.0f + ulp * 0.75f) == 1.0f + ulp);
+		LB_CHECK(RoundTripHalf(2.0f - ulp * 0.25f) == 2.0f);
+
+		LB_CHECK(RoundTripHalf(65504.0f) == 65504.0f);
+		LB_CHECK(RoundTripHalf(65519.0f) == 65504.0f);
+		LB_CHECK(std::isinf(RoundTripHalf(65520.0f)));
+		LB_CHECK(std::isinf(RoundTripHalf(-1.0e10f)) && RoundTripHalf(-1.0e10f) < 0.0f);
+		LB_CHECK(std::isinf(RoundTripHalf(std::numeric_limits<float>::infinity())));
+		LB_CHECK(std::isnan(RoundTripHalf(std::numeric_limits<float>::quiet_NaN())));
+
+		const float smallest = 1.0f / 16777216.0f;
+		LB_CHECK(RoundTripHalf(smallest) == smallest);
+		LB_CHECK(RoundTripHalf(smallest * 0.5f) == 0.0f);
+		LB_CHECK(RoundTripHalf(smallest * 1.5f) == smallest * 2.0f);
+		LB_CHECK(RoundTripHalf(1.0f / 16384.0f) == 1.0f / 16384.0f);
+		LB_CHECK(std::signbit(RoundTripHalf(-0.0f)));
+	}
+
+	// Any count, including ones that don't fill the last cache line, and any
+	// destination alignment produce the bytes the scalar encoding does, without
+	// writing past the last instance.
+	void TestWriteRangeMatchesTheReference()
+	{
+		const uint32_t itemCount = 101;
+		const std::vector<LB::RenderItem> items = MakeItems(itemCount);
+		const uint32_t counts[] = { 0, 1, 2, 3, 5, 17, 64, 99 };
+		const uint32_t offsets[] = { 0, 4, 8, 12 };
+		const uint8_t guard = 0xcd;
+
+		for(LB::InstanceFormat format : Formats)
+		{
+			const uint32_t instanceSize = LB::InstanceStream::GetInstanceSize(format);
+
+			for(uint32_t count : counts)
+			{
+				const std::vector<uint32_t> order = MakeOrder(itemCount, count);
+				const std::vector<uint8_t> reference = EncodeReference(format, items, order);
+
+				for(uint32_t offset : offsets)
+				{
+					// 16 byte aligned storage, the offset moves the destination off it.
+					std::vector<uint64_t> storage((offset + count * instanceSize + 64) / 8 + 2);
+					uint8_t *buffer = reinterpret_cast<uint8_t *>(storage.data());
+					while(reinterpret_cast<uintptr_t>(buffer) % 16 != 0)
+						buffer += 8;
+
+					memset(buffer, guard, offset + count * instanceSize + 32);
+
+					LB::InstanceStream::WriteRange(format, buffer + offset, items.data(), order.data(), count);
+
+					LB_CHECK(memcmp(buffer + offset, reference.data(), reference.size()) == 0);
+
+					bool untouched = true;
+					for(uint32_t i = 0; i < offset; i++)
+						untouched = untouched && buffer[i] == guard;
+					for(uint32_t i = 0; i < 32; i++)
+						untouched = untouched && buffer[offset + count * instanceSize + i] == guard;
+					LB_CHECK(untouched);
+				}
+			}
+		}
+	}
+
+	// Enough instances for several jobs, the ranges meet without gaps.
+	void TestWriteSplitsIntoJobs()
+	{
+		LB::WorkerPool workerPool(3);
+		LB::InstanceStream stream;
+
+		const uint32_t itemCount = 10001;
+		const std::vector<LB::RenderItem> items = MakeItems(itemCount);
+		const std::vector<uint32_t> order = MakeOrder(itemCount, itemCount);
+
+		for(LB::InstanceFormat format : Formats)
+		{
+			const std::vector<uint8_t> reference = EncodeReference(format, items, order);
+			std::vector<uint8_t> data(reference.size() + 16);
+			uint8_t *aligned = data.data();
+			while(reinterpret_cast<uintptr_t>(aligned) % 16 != 0)
+				aligned++;
+
+			stream.Write(&workerPool, format, aligned, items.data(), order.data(), itemCount);
+
+			LB_CHECK(memcmp(aligned, reference.data(), reference.size()) == 0);
+
+			const LB::InstanceStreamStatistics &statistics = stream.GetStatistics();
+			LB_CHECK(statistics.instances == itemCount);
+			LB_CHECK(statistics.jobs == 4);
+			LB_CHECK(statistics.bytesWritten == reference.size());
+		}
+
+		// Too few to be worth a second job.
+		std::vector<uint8_t> data(64 * 100);
+		stream.Write(&workerPool, LB::InstanceFormat::Matrix, data.data(), items.data(), order.data(), 100);
+		LB_CHECK(stream.GetStatistics().jobs == 1);
+	}
+}
+
+int main()
+{
+	LB::Test::Run("instance sizes", TestInstanceSizes);
+	LB::Test::Run("decode gives the matrix back", TestDecodeGivesTheMatrixBack);
+	LB::Test::Run("half rounding", TestHalfRounding);
+	LB::Test::Run("write range matches the reference", TestWriteRangeMatchesTheReference);
+	LB::Test::Run("write splits into jobs", TestWriteSplitsIntoJobs);
+
+	return LB::Test::Finish();
+}
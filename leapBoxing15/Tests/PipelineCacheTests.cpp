@@ -0,0 +1,225 @@
+#include "TestHarness.h"
+
+#include "LBPipelineCache.h"
+
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace
+{
+	// Reference values of 64 bit FNV-1a, keys persisted in the pipeline library
+	// depend on them staying the same.
+	void TestHashIsStable()
+	{
+		LB::PipelineKey key;
+		LB_CHECK(key.GetHash() == 14695981039346656037ull);
+		LB_CHECK(key.GetName() == L"cbf29ce484222325");
+
+		key.AddBytes("a", 1);
+		LB_CHECK(key.GetHash() == 0xaf63dc4c8601ec8cull);
+		LB_CHECK(key.GetName() == L"af63dc4c8601ec8c");
+
+		key.Clear();
+		LB_CHECK(key.GetData().empty());
+		LB_CHECK(key.GetHash() == 14695981039346656037ull);
+
+		key.AddBytes("foobar", 6);
+		LB_CHECK(key.GetHash() == 0x85944171f73967e8ull);
+	}
+
+	void TestValuesAreLittleEndian()
+	{
+		LB::PipelineKey key;
+		key.AddUInt32(0x04030201);
+
+		const std::vector<uint8_t> expected = { 1, 2, 3, 4 };
+		LB_CHECK(key.GetData() == expected);
+
+		LB::PipelineKey wide;
+		wide.AddUInt64(0x0807060504030201ull);
+
+		LB::PipelineKey halves;
+		halves.AddUInt32(0x04030201);
+		halves.AddUInt32(0x08070605);
+		LB_CHECK(wide == halves);
+
+		LB::PipelineKey number;
+		number.AddFloat(1.0f);
+		LB::PipelineKey bits;
+		bits.AddUInt32(0x3f800000);
+		LB_CHECK(number == bits);
+	}
+
+	void TestStringsDontRunIntoEachOther()
+	{
+		LB::PipelineKey a;
+		a.AddString("ab");
+		a.AddString("c");
+
+		LB::PipelineKey b;
+		b.AddString("a");
+		b.AddString("bc");
+
+		LB_CHECK(!(a == b));
+		LB_CHECK(a.GetHash() != b.GetHash());
+
+		LB::PipelineKey null;
+		null.AddString(nullptr);
+		LB::PipelineKey empty;
+		empty.AddString("");
+
+		LB_CHECK(!(null == empty));
+		LB_CHECK(null.GetData().size() == 4);
+		LB_CHECK(empty.GetData().size() == 4);
+	}
+
+	LB::PipelineKey MakeKey(uint32_t value)
+	{
+		LB::PipelineKey key;
+		key.AddString("shaders.hlsl");
+		key.AddUInt32(value);
+		return key;
+	}
+
+	void TestEqualKeysShareThePipeline()
+	{
+		LB::PipelineCache<int> cache;
+		int creates = 0;
+
+		uint32_t first = ~0u;
+		uint32_t second = ~0u;
+		uint32_t again = ~0u;
+
+		LB_CHECK(cache.GetOrCreate(MakeKey(1), [&]() { creates++; return 10; }, &first) == 10);
+		LB_CHECK(cache.GetOrCreate(MakeKey(2), [&]() { creates++; return 20; }, &second) == 20);
+		LB_CHECK(cache.GetOrCreate(MakeKey(1), [&]() { creates++; return 30; }, &again) == 10);
+
+		LB_CHECK(creates == 2);
+		LB_CHECK(first == 0);
+		LB_CHECK(second == 1);
+		LB_CHECK(again == first);
+		LB_CHECK(cache.GetCount() == 2);
+
+		const LB::PipelineCacheStatistics statistics = cache.GetStatistics();
+		LB_CHECK(statistics.hits == 1);
+		LB_CHECK(statistics.misses == 2);
+		LB_CHECK(statistics.waits == 0);
+		LB_CHECK(statistics.collisions == 0);
+	}
+
+	// All threads ask for the same key while the first one is still creating it.
+	void TestConcurrentLookupsCreateOnce()
+	{
+		LB::PipelineCache<int> cache;
+		const LB::PipelineKey key = MakeKey(7);
+
+		const int threadCount = 8;
+		std::atomic<int> creates(0);
+		std::atomic<int> started(0);
+		std::vector<int> results(threadCount, 0);
+		std::vector<uint32_t> ids(threadCount, ~0u);
+
+		std::vector<std::thread> threads;
+		for(int i = 0; i < threadCount; i++)
+		{
+			threads.emplace_back([&, i]() {
+				started++;
+				while(started < threadCount)
+					std::this_thread::yield();
+
+				results[i] = cache.GetOrCreate(key, [&]() {
+					creates++;
+					std::this_thread::sleep_for(std::chrono::milliseconds(50));
+					return 42;
+				}, &ids[i]);
+			});
+		}
+
+		for(std::thread &thread : threads)
+			thread.join();
+
+		LB_CHECK(creates == 1);
+		for(int i = 0; i < threadCount; i++)
+		{
+			LB_CHECK(results[i] == 42);
+			LB_CHECK(ids[i] == 0);
+		}
+
+		// Whoever came late enough to find it ready counts as a hit.
+		const LB::PipelineCacheStatistics statistics = cache.GetStatistics();
+		LB_CHECK(statistics.misses == 1);
+		LB_CHECK(statistics.waits + statistics.hits == threadCount - 1);
+		LB_CHECK(statistics.waits > 0);
+		LB_CHECK(cache.GetCount() == 1);
+	}
+
+	void TestFailedCreateIsRetried()
+	{
+		LB::PipelineCache<int> cache;
+		const LB::PipelineKey key = MakeKey(3);
+
+		LB_CHECK_THROWS(cache.GetOrCreate(key, []() -> int { throw std::runtime_error("compile failed"); }), std::runtime_error);
+		LB_CHECK(cache.GetCount() == 0);
+
+		LB_CHECK(cache.GetOrCreate(key, []() { return 5; }) == 5);
+		LB_CHECK(cache.GetCount() == 1);
+		LB_CHECK(cache.GetStatistics().misses == 2);
+	}
+
+	// Threads waiting for a creation that fails get its exception.
+	void TestWaitersGetTheException()
+	{
+		LB::PipelineCache<int> cache;
+		const LB::PipelineKey key = MakeKey(4);
+
+		std::atomic<bool> creating(false);
+		bool waiterThrew = false;
+
+		std::thread creator([&]() {
+			try
+			{
+				cache.GetOrCreate(key, [&]() -> int {
+					creating = true;
+					std::this_thread::sleep_for(std::chrono::milliseconds(50));
+					throw std::runtime_error("compile failed");
+				});
+			}
+			catch(std::runtime_error &)
+			{}
+		});
+
+		while(!creating)
+			std::this_thread::yield();
+
+		try
+		{
+			cache.GetOrCreate(key, []() { return 1; });
+		}
+		catch(std::runtime_error &)
+		{
+			waiterThrew = true;
+		}
+
+		creator.join();
+
+		LB_CHECK(waiterThrew);
+		LB_CHECK(cache.GetStatistics().waits == 1);
+		LB_CHECK(cache.GetCount() == 0);
+	}
+}
+
+int main()
+{
+	LB::Test::Run("hash is stable", TestHashIsStable);
+	LB::Test::Run("values are stored little endian at fixed width", TestValuesAreLittleEndian);
+	LB::Test::Run("strings don't run into each other", TestStringsDontRunIntoEachOther);
+	LB::Test::Run("equal keys share the pipeline", TestEqualKeysShareThePipeline);
+	LB::Test::Run("concurrent lookups create once", TestConcurrentLookupsCreateOnce);
+	LB::Test::Run("failed creation is retried", TestFailedCreateIsRetried);
+	LB::Test::Run("waiters get the exception", TestWaitersGetTheException);
+
+	return LB::Test::Finish();
+}
@@ -0,0 +1,109 @@
+#include "TestHarness.h"
+
+#include "LBReleaseQueue.h"
+
+#include <stdexcept>
+#include <vector>
+
+namespace
+{
+	void TestItemsAreReleasedInOrder()
+	{
+		LB::ReleaseQueue<int> queue;
+		std::vector<int> released;
+		const auto release = [&](int item) { released.push_back(item); };
+
+		queue.Push(1, 1);
+		queue.Push(2, 2);
+		queue.Push(3, 2);
+		queue.Push(4, 3);
+
+		LB_CHECK(queue.GetCount() == 4);
+		LB_CHECK(queue.GetOldestPendingFence() == 1);
+
+		LB_CHECK(queue.Reclaim(0, release) == 0);
+		LB_CHECK(released.empty());
+
+		LB_CHECK(queue.Reclaim(2, release) == 3);
+		const std::vector<int> expected = { 1, 2, 3 };
+		LB_CHECK(released == expected);
+		LB_CHECK(queue.GetOldestPendingFence() == 3);
+
+		LB_CHECK(queue.Reclaim(3, release) == 1);
+		LB_CHECK(released.back() == 4);
+		LB_CHECK(queue.GetCount() == 0);
+		LB_CHECK(queue.GetOldestPendingFence() == 0);
+	}
+
+	// A lower value than an earlier one is raised, so nothing is released ahead
+	// of what was queued before it.
+	void TestValuesAreRaised()
+	{
+		LB::ReleaseQueue<int> queue;
+		std::vector<int> released;
+		const auto release = [&](int item) { released.push_back(item); };
+
+		queue.Push(1, 5);
+		queue.Push(2, 3);
+		queue.Push(3, 0);
+
+		LB_CHECK(queue.Reclaim(4, release) == 0);
+		LB_CHECK(queue.GetOldestPendingFence() == 5);
+
+		LB_CHECK(queue.Reclaim(5, release) == 3);
+		const std::vector<int> expected = { 1, 2, 3 };
+		LB_CHECK(released == expected);
+
+		// Stays raised after the queue ran empty.
+		queue.Push(4, 1);
+		LB_CHECK(queue.GetOldestPendingFence() == 5);
+	}
+
+	void TestReleaseAllIgnoresTheFence()
+	{
+		LB::ReleaseQueue<int> queue;
+		std::vector<int> released;
+
+		queue.Push(1, 10);
+		queue.Push(2, 20);
+
+		LB_CHECK(queue.ReleaseAll([&](int item) { released.push_back(item); }) == 2);
+		LB_CHECK(released.size() == 2);
+		LB_CHECK(queue.GetCount() == 0);
+
+		const LB::ReleaseQueueStatistics &statistics = queue.GetStatistics();
+		LB_CHECK(statistics.queued == 2);
+		LB_CHECK(statistics.released == 2);
+	}
+
+	// The item is popped before its release runs, so one that throws is gone
+	// and the ones after it are still there.
+	void TestThrowingReleaseIsNotRepeated()
+	{
+		LB::ReleaseQueue<int> queue;
+		std::vector<int> released;
+
+		queue.Push(1, 1);
+		queue.Push(2, 1);
+
+		LB_CHECK_THROWS(queue.Reclaim(1, [&](int item) {
+			if(item == 1)
+				throw std::runtime_error("release failed");
+			released.push_back(item);
+		}), std::runtime_error);
+
+		LB_CHECK(queue.GetCount() == 1);
+		LB_CHECK(queue.Reclaim(1, [&](int item) { released.push_back(item); }) == 1);
+		LB_CHECK(released.size() == 1 && released[0] == 2);
+	}
+}
+
+int main()
+{
+	LB::Test::Run("items are released in order", TestItemsAreReleasedInOrder);
+	LB::Test::Run("lower fence values are raised", TestValuesAreRaised);
+	LB::Test::Run("release all ignores the fence", TestReleaseAllIgnoresTheFence);
+	LB::Test::Run("a throwing release is not repeated", TestThrowingReleaseIsNotRepeated);
+
+	return LB::Test::Finish();
+}
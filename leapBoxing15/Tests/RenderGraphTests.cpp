@@ -0,0 +1,266 @@
+#include "TestHarness.h"
+
+#include "LBRenderGraph.h"
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+namespace
+{
+	void TestUnusedPassesAreCulled()
+	{
+		LB::RenderGraph graph;
+		const LB::RenderGraphResource backBuffer = graph.ImportResource("Back buffer", LB::ResourceState::Present, LB::ResourceState::Present);
+		const LB::RenderGraphResource unused = graph.CreateTransient("Unused", 1024, 256);
+		const LB::RenderGraphResource color = graph.CreateTransient("Color", 1024, 256);
+
+		const LB::RenderGraphPass unusedPass = graph.AddPass("Unused", nullptr);
+		graph.Write(unusedPass, unused, LB::ResourceState::RenderTarget);
+
+		const LB::RenderGraphPass producer = graph.AddPass("Producer", nullptr);
+		graph.Write(producer, color, LB::ResourceState::RenderTarget);
+
+		// Only writes, but may blend over what the producer left.
+		const LB::RenderGraphPass decals = graph.AddPass("Decals", nullptr);
+		graph.Write(decals, color, LB::ResourceState::RenderTarget);
+
+		const LB::RenderGraphPass consumer = graph.AddPass("Consumer", nullptr);
+		graph.Read(consumer, color, LB::ResourceState::PixelShaderResource);
+		graph.Write(consumer, backBuffer, LB::ResourceState::RenderTarget);
+
+		// Reads after the last pass anyone needs.
+		const LB::RenderGraphPass debug = graph.AddPass("Debug", nullptr);
+		graph.Read(debug, color, LB::ResourceState::PixelShaderResource);
+
+		const LB::RenderGraphPass query = graph.AddPass("Query", nullptr);
+		graph.SetSideEffect(query);
+
+		graph.Compile();
+
+		const std::vector<LB::RenderGraphPass> expected = { producer, decals, consumer, query };
+		LB_CHECK(graph.GetExecutionOrder() == expected);
+		LB_CHECK(graph.GetStatistics().passes == 6);
+		LB_CHECK(graph.GetStatistics().culledPasses == 2);
+
+		// Only used by culled passes, doesn't take up any memory.
+		LB_CHECK(graph.GetStatistics().transientBytes == 1024);
+		LB_CHECK(graph.GetHeapSize() == 1024);
+	}
+
+	void TestBarriersAreBatchedPerPass()
+	{
+		LB::RenderGraph graph;
+		const LB::RenderGraphResource backBuffer = graph.ImportResource("Back buffer", LB::ResourceState::Present, LB::ResourceState::Present);
+		const LB::RenderGraphResource shadowMap = graph.ImportResource("Shadow map", LB::ResourceState::DepthWrite, LB::ResourceState::DepthWrite);
+
+		const LB::RenderGraphPass shadows = graph.AddPass("Shadows", nullptr);
+		graph.Write(shadows, shadowMap, LB::ResourceState::DepthWrite);
+
+		// Two read states become one transition into both.
+		const LB::RenderGraphPass lighting = graph.AddPass("Lighting", nullptr);
+		graph.Read(lighting, shadowMap, LB::ResourceState::PixelShaderResource);
+		graph.Read(lighting, shadowMap, LB::ResourceState::NonPixelShaderResource);
+		graph.Write(lighting, backBuffer, LB::ResourceState::RenderTarget);
+
+		// Already readable, nothing to do.
+		const LB::RenderGraphPass post = graph.AddPass("Post", nullptr);
+		graph.Read(post, shadowMap, LB::ResourceState::PixelShaderResource);
+		graph.Write(post, backBuffer, LB::ResourceState::RenderTarget);
+
+		graph.Compile();
+
+		LB_CHECK(graph.GetBarriers(0).empty());
+		LB_CHECK(graph.GetBarriers(2).empty());
+
+		const std::vector<LB::RenderBarrier> &batch = graph.GetBarriers(1);
+		LB_CHECK(batch.size() == 2);
+		LB_CHECK(batch[0].type == LB::RenderBarrierType::Transition && batch[0].resource == shadowMap);
+		LB_CHECK(batch[0].stateBefore == LB::ResourceState::DepthWrite);
+		LB_CHECK(batch[0].stateAfter == (LB::ResourceState::PixelShaderResource | LB::ResourceState::NonPixelShaderResource));
+		LB_CHECK(batch[1].resource == backBuffer && batch[1].stateAfter == LB::ResourceState::RenderTarget);
+
+		// Imported resources are returned in their final state.
+		const std::vector<LB::RenderBarrier> &finalBarriers = graph.GetFinalBarriers();
+		LB_CHECK(finalBarriers.size() == 2);
+		LB_CHECK(finalBarriers[0].resource == backBuffer && finalBarriers[0].stateAfter == LB::ResourceState::Present);
+		LB_CHECK(finalBarriers[1].resource == shadowMap && finalBarriers[1].stateAfter == LB::ResourceState::DepthWrite);
+
+		const LB::RenderGraphStatistics &statistics = graph.GetStatistics();
+		LB_CHECK(statistics.barriers == 4);
+		LB_CHECK(statistics.barrierBatches == 2);
+		LB_CHECK(statistics.barriersMerged == 1);
+	}
+
+	void TestUnorderedAccessWritesAreSeparated()
+	{
+		LB::RenderGraph graph;
+		const LB::RenderGraphResource particles = graph.ImportResource("Particles", LB::ResourceState::UnorderedAccess, LB::ResourceState::UnorderedAccess);
+
+		const LB::RenderGraphPass emit = graph.AddPass("Emit", nullptr);
+		graph.Write(emit, particles, LB::ResourceState::UnorderedAccess);
+
+		const LB::RenderGraphPass simulate = graph.AddPass("Simulate", nullptr);
+		graph.Write(simulate, particles, LB::ResourceState::UnorderedAccess);
+
+		graph.Compile();
+
+		LB_CHECK(graph.GetBarriers(0).empty());
+		LB_CHECK(graph.GetBarriers(1).size() == 1);
+		LB_CHECK(graph.GetBarriers(1)[0].type == LB::RenderBarrierType::UnorderedAccess);
+		LB_CHECK(graph.GetFinalBarriers().empty());
+	}
+
+	// A, B and C are each used by two neighbouring passes, A and C never live at
+	// the same time and share memory, B overlaps both.
+	void TestTransientsAlias()
+	{
+		LB::RenderGraph graph;
+		const LB::RenderGraphResource a = graph.CreateTransient("A", 1000, 256);
+		const LB::RenderGraphResource b = graph.CreateTransient("B", 500, 256);
+		const LB::RenderGraphResource c = graph.CreateTransient("C", 1000, 256);
+
+		LB::RenderGraphPass passes[4];
+		for(LB::RenderGraphPass &pass : passes)
+		{
+			pass = graph.AddPass("Pass", nullptr);
+			graph.SetSideEffect(pass);
+		}
+
+		graph.Write(passes[0], a, LB::ResourceState::RenderTarget);
+		graph.Read(passes[1], a, LB::ResourceState::PixelShaderResource);
+		graph.Write(passes[1], b, LB::ResourceState::RenderTarget);
+		graph.Read(passes[2], b, LB::ResourceState::PixelShaderResource);
+		graph.Write(passes[2], c, LB::ResourceState::RenderTarget);
+		graph.Read(passes[3], c, LB::ResourceState::PixelShaderResource);
+
+		graph.Compile();
+
+		LB_CHECK(graph.GetHeapOffset(a) == 0);
+		LB_CHECK(graph.GetHeapOffset(c) == 0);
+		LB_CHECK(graph.GetHeapOffset(b) == 1024);
+		LB_CHECK(graph.GetStatistics().transientBytes == 2500);
+		LB_CHECK(graph.GetHeapSize() == 1524);
+
+		// Transients start out in the state of their first use.
+		LB_CHECK(graph.GetInitialState(a) == LB::ResourceState::RenderTarget);
+
+		// A goes back to its initial state before C takes over its memory.
+		const std::vector<LB::RenderBarrier> &batch = graph.GetBarriers(2);
+		LB_CHECK(batch.size() == 3);
+		LB_CHECK(batch[0].type == LB::RenderBarrierType::Transition && batch[0].resource == a);
+		LB_CHECK(batch[0].stateAfter == LB::ResourceState::RenderTarget);
+		LB_CHECK(batch[1].type == LB::RenderBarrierType::Aliasing && batch[1].resource == c && batch[1].aliasBefore == a);
+		LB_CHECK(batch[2].resource == b && batch[2].stateAfter == LB::ResourceState::PixelShaderResource);
+
+		for(size_t i = 0; i < graph.GetExecutionOrder().size(); i++)
+		{
+			for(const LB::RenderBarrier &barrier : graph.GetBarriers(i))
+				LB_CHECK(barrier.type != LB::RenderBarrierType::Aliasing || barrier.resource == c);
+		}
+
+		LB_CHECK(graph.GetFinalBarriers().size() == 1);
+		LB_CHECK(graph.GetFinalBarriers()[0].resource == c);
+	}
+
+	// Many transients with staggered lifetimes, the ones alive at the same time
+	// never share memory and alignments are kept.
+	void TestTransientsAliveTogetherDontOverlap()
+	{
+		LB::RenderGraph graph;
+
+		const uint32_t passCount = 24;
+		LB::RenderGraphPass passes[passCount];
+		for(LB::RenderGraphPass &pass : passes)
+		{
+			pass = graph.AddPass("Pass", nullptr);
+			graph.SetSideEffect(pass);
+		}
+
+		struct Lifetime
+		{
+			LB::RenderGraphResource resource;
+			uint32_t first;
+			uint32_t last;
+			uint64_t size;
+			uint64_t alignment;
+		};
+
+		std::vector<Lifetime> lifetimes;
+		for(uint32_t i = 0; i < 32; i++)
+		{
+			Lifetime lifetime;
+			lifetime.first = (i * 7) % passCount;
+			lifetime.last = std::min(lifetime.first + 1 + (i * 5) % 6, passCount - 1);
+			lifetime.size = 100 + (i * 379) % 4000;
+			lifetime.alignment = 64ull << (i % 4);
+			lifetime.resource = graph.CreateTransient("Transient", lifetime.size, lifetime.alignment);
+
+			graph.Write(passes[lifetime.first], lifetime.resource, LB::ResourceState::UnorderedAccess);
+			graph.Read(passes[lifetime.last], lifetime.resource, LB::ResourceState::NonPixelShaderResource);
+			lifetimes.push_back(lifetime);
+		}
+
+		graph.Compile();
+
+		uint64_t heapEnd = 0;
+		for(const Lifetime &x : lifetimes)
+		{
+			const uint64_t offset = graph.GetHeapOffset(x.resource);
+			LB_CHECK(offset % x.alignment == 0);
+			heapEnd = std::max(heapEnd, offset + x.size);
+
+			for(const Lifetime &y : lifetimes)
+			{
+				if(x.resource == y.resource || x.last < y.first || y.last < x.first)
+					continue;
+
+				const uint64_t otherOffset = graph.GetHeapOffset(y.resource);
+				LB_CHECK(offset + x.size <= otherOffset || otherOffset + y.size <= offset);
+			}
+		}
+
+		LB_CHECK(graph.GetHeapSize() == heapEnd);
+		LB_CHECK(graph.GetHeapSize() < graph.GetStatistics().transientBytes);
+	}
+
+	void TestExecuteInterleavesBarriersAndPasses()
+	{
+		LB::RenderGraph graph;
+		std::vector<std::string> calls;
+
+		const LB::RenderGraphResource backBuffer = graph.ImportResource("Back buffer", LB::ResourceState::Present, LB::ResourceState::Present);
+
+		const LB::RenderGraphPass opaque = graph.AddPass("Opaque", [&]() { calls.push_back("Opaque"); });
+		graph.Write(opaque, backBuffer, LB::ResourceState::RenderTarget);
+
+		const LB::RenderGraphPass overlay = graph.AddPass("Overlay", [&]() { calls.push_back("Overlay"); });
+		graph.Write(overlay, backBuffer, LB::ResourceState::RenderTarget);
+
+		graph.Compile();
+		graph.Execute([&](const LB::RenderBarrier *, size_t count) {
+			calls.push_back("Barriers " + std::to_string(count));
+		});
+
+		const std::vector<std::string> expected = { "Barriers 1", "Opaque", "Overlay", "Barriers 1" };
+		LB_CHECK(calls == expected);
+
+		// Reset starts a new frame from scratch.
+		graph.Reset();
+		graph.Compile();
+		LB_CHECK(graph.GetExecutionOrder().empty());
+		LB_CHECK(graph.GetStatistics().barriers == 0);
+	}
+}
+
+int main()
+{
+	LB::Test::Run("unused passes are culled", TestUnusedPassesAreCulled);
+	LB::Test::Run("barriers are batched per pass", TestBarriersAreBatchedPerPass);
+	LB::Test::Run("unordered access writes are separated", TestUnorderedAccessWritesAreSeparated);
+	LB::Test::Run("transients alias", TestTransientsAlias);
+	LB::Test::Run("transients alive together don't overlap", TestTransientsAliveTogetherDontOverlap);
+	LB::Test::Run("execute interleaves barriers and passes", TestExecuteInterleavesBarriersAndPasses);
+
+	return LB::Test::Finish();
+}
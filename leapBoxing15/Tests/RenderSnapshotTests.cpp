@@ -0,0 +1,136 @@
+#include "TestHarness.h"
+
+#include "LBRenderSnapshot.h"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+namespace
+{
+	void Write(LB::RenderSnapshotBuffer &buffer, float value)
+	{
+		LB::RenderSnapshot &snapshot = buffer.BeginWrite();
+		snapshot.cameraPosition[0] = value;
+		snapshot.items.resize(static_cast<size_t>(value) + 1);
+		buffer.Publish();
+	}
+
+	// The simulation writes frame N+1 into the other slot while the renderer
+	// holds N. Publishing it swaps the slots, so that waits until N is released.
+	void TestSimulationWritesTheNextFrame()
+	{
+		LB::RenderSnapshotBuffer buffer;
+		Write(buffer, 0.0f);
+
+		const LB::RenderSnapshot *rendered = buffer.Acquire(100);
+		LB_CHECK(rendered && rendered->frame == 0);
+
+		LB::RenderSnapshot &next = buffer.BeginWrite();
+		LB_CHECK(&next != rendered);
+		LB_CHECK(next.frame == 1);
+		LB_CHECK(next.items.empty());
+
+		next.cameraPosition[0] = 1.0f;
+		next.items.resize(2);
+
+		LB_CHECK(rendered->frame == 0);
+		LB_CHECK(rendered->cameraPosition[0] == 0.0f);
+		LB_CHECK(rendered->items.size() == 1);
+
+		std::atomic<bool> published(false);
+		std::thread simulation([&]() {
+			buffer.Publish();
+			published = true;
+		});
+
+		std::this_thread::sleep_for(std::chrono::milliseconds(20));
+		LB_CHECK(!published);
+		LB_CHECK(buffer.TryAcquire() == nullptr);
+
+		buffer.Release();
+		simulation.join();
+		LB_CHECK(published);
+		LB_CHECK(buffer.GetPublishWaits() == 1);
+
+		rendered = buffer.Acquire(100);
+		LB_CHECK(rendered && rendered->frame == 1);
+		LB_CHECK(rendered->cameraPosition[0] == 1.0f);
+		LB_CHECK(rendered->items.size() == 2);
+
+		// And the one after goes into the slot frame 0 was in.
+		LB::RenderSnapshot &after = buffer.BeginWrite();
+		LB_CHECK(&after != rendered);
+		LB_CHECK(after.frame == 2);
+		buffer.Release();
+	}
+
+	// Without a new snapshot Acquire waits the whole timeout and returns nullptr,
+	// a snapshot that was rendered isn't handed out again.
+	void TestAcquireTimesOut()
+	{
+		LB::RenderSnapshotBuffer buffer;
+		LB_CHECK(buffer.TryAcquire() == nullptr);
+
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		LB_CHECK(buffer.Acquire(30) == nullptr);
+		LB_CHECK(std::chrono::steady_clock::now() - start >= std::chrono::milliseconds(25));
+
+		Write(buffer, 0.0f);
+		LB_CHECK(buffer.Acquire(30) != nullptr);
+		buffer.Release();
+
+		LB_CHECK(buffer.Acquire(30) == nullptr);
+		LB_CHECK(buffer.TryAcquire() == nullptr);
+
+		// A snapshot published while waiting ends the wait.
+		std::thread simulation([&]() {
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+			Write(buffer, 1.0f);
+		});
+
+		const LB::RenderSnapshot *rendered = buffer.Acquire(5000);
+		LB_CHECK(rendered && rendered->frame == 1);
+		buffer.Release();
+		simulation.join();
+	}
+
+	// Shutdown wakes both sides, the renderer gets nullptr and the simulation
+	// returns from Publish.
+	void TestShutdownWakesBothSides()
+	{
+		LB::RenderSnapshotBuffer buffer;
+
+		LB::RenderSnapshot unset;
+		const LB::RenderSnapshot *acquired = &unset;
+		std::thread renderer([&]() {
+			acquired = buffer.Acquire(5000);
+		});
+
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		buffer.Shutdown();
+		renderer.join();
+		LB_CHECK(acquired == nullptr);
+
+		LB::RenderSnapshotBuffer blocked;
+		Write(blocked, 0.0f);
+
+		std::thread simulation([&]() {
+			Write(blocked, 1.0f);
+		});
+
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		blocked.Shutdown();
+		simulation.join();
+		LB_CHECK(blocked.GetPublishWaits() == 1);
+	}
+}
+
+int main()
+{
+	LB::Test::Run("simulation writes the next frame", TestSimulationWritesTheNextFrame);
+	LB::Test::Run("acquire times out", TestAcquireTimesOut);
+	LB::Test::Run("shutdown wakes both sides", TestShutdownWakesBothSides);
+
+	return LB::Test::Finish();
+}
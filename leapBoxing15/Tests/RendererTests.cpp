@@ -0,0 +1,431 @@
+#include "TestHarness.h"
+
+#include "LBHeadlessBackend.h"
+#include "LBMesh.h"
+#include "LBRenderer.h"
+#include "LBRenderSnapshot.h"
+#include "LBScene.h"
+#include "LBSceneFile.h"
+#include "LBSoftwareBackend.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace
+{
+	const char *ScenePath = "RendererTests.scene";
+
+	// Rows of entities in front of the camera, every third one static. Meshes
+	// and materials alternate, with two materials there are four combinations of
+	// them.
+	uint32_t WriteSyntheticScene(uint32_t count, uint32_t *staticCount, uint32_t materialCount = 2)
+	{
+		LB::SceneFileWriter writer;
+		const uint32_t meshes[] = { writer.AddMesh("cube"), writer.AddMesh("quad") };
+
+		std::vector<uint32_t> materials = { writer.AddMaterial("shaders.hlsl"), writer.AddMaterial("other.hlsl") };
+		for(uint32_t i = 2; i < materialCount; i++)
+			materials.push_back(writer.AddMaterial(("material" + std::to_string(i) + ".hlsl").c_str()));
+
+		*staticCount = 0;
+		for(uint32_t i = 0; i < count; i++)
+		{
+			LB::SceneFileEntity entity = {};
+			entity.position[0] = static_cast<float>(i % 50) * 3.0f - 75.0f;
+			entity.position[1] = static_cast<float>((i / 50) % 20) * 3.0f - 30.0f;
+			entity.position[2] = -10.0f - static_cast<float>(i / 1000) * 3.0f;
+			entity.scale[0] = entity.scale[1] = entity.scale[2] = 1.0f;
+			entity.rotation[3] = 1.0f;
+			entity.parent = LB::SceneFileNoParent;
+			entity.mesh = meshes[(i / 2) % 2];
+			entity.material = materials[i % materialCount];
+			entity.flags = (i % 3 == 0) ? static_cast<uint32_t>(LB::SceneFileEntityFlagStatic) : 0u;
+
+			for(int n = 0; n < 3; n++)
+			{
+				entity.boundsMin[n] = entity.position[n] - 1.0f;
+				entity.boundsMax[n] = entity.position[n] + 1.0f;
+			}
+
+			if(entity.flags & LB::SceneFileEntityFlagStatic)
+				(*staticCount)++;
+
+			writer.AddEntity(entity);
+		}
+
+		writer.Write(ScenePath);
+		return count - *staticCount;
+	}
+
+	uint32_t CountInstances(const std::vector<LB::EncodedCommand> &commands)
+	{
+		uint32_t instances = 0;
+		for(const LB::EncodedCommand &command : commands)
+		{
+			if(command.type == LB::EncodedCommandType::DrawInstanced || command.type == LB::EncodedCommandType::DrawIndexedInstanced)
+				instances += command.arguments[1];
+		}
+
+		return instances;
+	}
+
+	void TestRenderSyntheticScene()
+	{
+		uint32_t staticCount = 0;
+		const uint32_t dynamicCount = WriteSyntheticScene(6000, &staticCount);
+
+		LB::HeadlessBackend backend(640, 360);
+		LB::Renderer renderer(&backend);
+
+		{
+			LB::Scene scene(&renderer, ScenePath);
+			LB::RenderSnapshot snapshot;
+
+			for(uint32_t frame = 0; frame < 4; frame++)
+			{
+				scene.Update(1.0f / 60.0f);
+				scene.Extract(snapshot);
+				renderer.Render(snapshot);
+			}
+
+			const LB::RendererStatistics &statistics = renderer.GetStatistics();
+			const LB::HeadlessBackendStatistics &backendStatistics = backend.GetStatistics();
+
+			LB::Test::Run("every dynamic entity is drawn once", [&]() {
+				LB_CHECK(snapshot.items.size() == dynamicCount);
+				LB_CHECK(statistics.instances == dynamicCount);
+				LB_CHECK(CountInstances(backend.GetFrameCommands()) == dynamicCount);
+			});
+
+			LB::Test::Run("static entities are replayed from bundles", [&]() {
+				LB_CHECK(snapshot.staticItems && !snapshot.staticItems->empty());
+				LB_CHECK(scene.GetStaticBatchStatistics().entities == staticCount);
+				LB_CHECK(statistics.staticDraws > 0);
+				LB_CHECK(backendStatistics.bundles > 0);
+			});
+
+			LB::Test::Run("instances are batched by mesh and material", [&]() {
+				// Two meshes and two materials.
+				LB_CHECK(statistics.drawCalls == 4);
+				LB_CHECK(statistics.drawsSaved == dynamicCount - 4);
+			});
+
+			// Batches are sorted by pipeline first, so each pipeline's draws are
+			// contiguous across all command lists of the pass.
+			LB::Test::Run("draws are sorted by pipeline", [&]() {
+				std::set<const void *> finished;
+				const void *pipelineState = nullptr;
+				const void *drawnPipelineState = nullptr;
+
+				for(const LB::EncodedCommand &command : backend.GetFrameCommands())
+				{
+					if(command.type == LB::EncodedCommandType::SetPipelineState)
+						pipelineState = command.pipelineState;
+
+					if(command.type != LB::EncodedCommandType::DrawInstanced && command.type != LB::EncodedCommandType::DrawIndexedInstanced)
+						continue;
+
+					if(pipelineState != drawnPipelineState)
+					{
+						LB_CHECK(finished.count(pipelineState) == 0);
+						finished.insert(drawnPipelineState);
+						drawnPipelineState = pipelineState;
+					}
+				}
+
+				LB_CHECK(drawnPipelineState != nullptr);
+			});
+
+			// Every dynamic draw uses the same identity transform.
+			LB::Test::Run("draw constants are allocated once per frame", [&]() {
+				std::set<uint64_t> locations;
+				for(const LB::EncodedCommand &command : backend.GetFrameCommands())
+				{
+					if(command.type == LB::EncodedCommandType::SetConstantBuffer && command.arguments[0] == LB::ConstantSlotDraw)
+						locations.insert(command.location);
+				}
+
+				LB_CHECK(locations.size() == 1);
+			});
+
+			// One view in the descriptor ring per list binding the frame constants,
+			// handed back once the frames using them completed.
+			LB::Test::Run("frame constant views come from the descriptor ring", [&]() {
+				uint32_t frameBindings = 0;
+				for(const LB::EncodedCommand &command : backend.GetFrameCommands())
+				{
+					if(command.type == LB::EncodedCommandType::SetConstantBuffer && command.arguments[0] == LB::ConstantSlotFrame)
+						frameBindings++;
+				}
+
+				LB_CHECK(frameBindings > 0);
+				LB_CHECK(statistics.frameDescriptors == frameBindings);
+				LB_CHECK(statistics.descriptorsInUse <= statistics.frameDescriptors * backend.GetFrameCount());
+			});
+
+			LB::Test::Run("mesh uploads go through the copy queue", [&]() {
+				LB_CHECK(backendStatistics.copies > 0);
+				LB_CHECK(backendStatistics.bytesCopied > 0);
+				LB_CHECK(renderer.GetBufferStatistics().allocations > 0);
+			});
+
+			LB::Test::Run("every frame is presented", [&]() {
+				LB_CHECK(backendStatistics.frames == 4);
+				LB_CHECK(statistics.framesInFlight <= 2);
+			});
+		}
+
+		remove(ScenePath);
+	}
+
+	void TestDepthPrePassDrawsTwice()
+	{
+		uint32_t staticCount = 0;
+		const uint32_t dynamicCount = WriteSyntheticScene(900, &staticCount);
+
+		LB::RendererSettings settings;
+		settings.depthPrePass = true;
+
+		LB::HeadlessBackend backend(320, 180);
+		LB::Renderer renderer(&backend, settings);
+
+		{
+			LB::Scene scene(&renderer, ScenePath);
+			LB::RenderSnapshot snapshot;
+
+			scene.Extract(snapshot);
+			renderer.Render(snapshot);
+
+			LB::Test::Run("depth pre-pass draws the dynamic entities twice", [&]() {
+				LB_CHECK(CountInstances(backend.GetFrameCommands()) == dynamicCount * 2);
+			});
+		}
+
+		remove(ScenePath);
+	}
+
+	// A draw with the state it uses, pipeline states by what they were created
+	// from as every backend has its own.
+	struct RecordedDraw
+	{
+		bool operator==(const RecordedDraw &other) const
+		{
+			return shaderFile == other.shaderFile && depthMode == other.depthMode && topology == other.topology && vertexBuffer == other.vertexBuffer && indexBuffer == other.indexBuffer && constantBuffer == other.constantBuffer && memcmp(arguments, other.arguments, sizeof(arguments)) == 0;
+		}
+
+		std::wstring shaderFile;
+		LB::DepthMode depthMode;
+		uint32_t topology;
+		uint64_t vertexBuffer;
+		uint64_t indexBuffer;
+		uint64_t constantBuffer;
+		uint32_t arguments[5];
+	};
+
+	std::vector<RecordedDraw> GetDraws(const LB::HeadlessBackend &backend)
+	{
+		std::vector<RecordedDraw> draws;
+		RecordedDraw state = {};
+
+		for(const LB::EncodedCommand &command : backend.GetFrameCommands())
+		{
+			switch(command.type)
+			{
+				case LB::EncodedCommandType::SetPipelineState:
+					state.shaderFile = backend.GetPipelineDescription(command.pipelineState).shaderFile;
+					state.depthMode = backend.GetPipelineDescription(command.pipelineState).depthMode;
+					break;
+				case LB::EncodedCommandType::SetPrimitiveTopology:
+					state.topology = command.arguments[0];
+					break;
+				case LB::EncodedCommandType::SetVertexBuffer:
+					if(command.arguments[0] == 0)
+						state.vertexBuffer = command.vertexBuffer.location;
+					break;
+				case LB::EncodedCommandType::SetIndexBuffer:
+					state.indexBuffer = command.indexBuffer.location;
+					break;
+				case LB::EncodedCommandType::SetConstantBuffer:
+					if(command.arguments[0] == LB::ConstantSlotDraw)
+						state.constantBuffer = command.location;
+					break;
+				case LB::EncodedCommandType::DrawInstanced:
+				case LB::EncodedCommandType::DrawIndexedInstanced:
+					memcpy(state.arguments, command.arguments, sizeof(state.arguments));
+					draws.push_back(state);
+					break;
+				default:
+					break;
+			}
+		}
+
+		return draws;
+	}
+
+	// Draws of the second frame, after the uploads of the first one.
+	std::vector<RecordedDraw> RenderDraws(uint32_t workerThreads, uint32_t *recordingThreads)
+	{
+		LB::RendererSettings settings;
+		settings.workerThreads = workerThreads;
+
+		LB::HeadlessBackend backend(320, 180);
+		LB::Renderer renderer(&backend, settings);
+
+		LB::Scene scene(&renderer, ScenePath);
+		LB::RenderSnapshot snapshot;
+
+		for(int i = 0; i < 2; i++)
+		{
+			scene.Extract(snapshot);
+			renderer.Render(snapshot);
+		}
+
+		*recordingThreads = renderer.GetStatistics().recordingThreads;
+		return GetDraws(backend);
+	}
+
+	// Enough mesh and material combinations for the draws to be split across
+	// every recording thread. Submitted by chunk, the draws end up in the same
+	// order as recorded on one thread, each with the same state.
+	void TestRecordingThreadsKeepTheOrder()
+	{
+		uint32_t staticCount = 0;
+		WriteSyntheticScene(12000, &staticCount, 3000);
+
+		uint32_t singleThreads = 0;
+		uint32_t parallelThreads = 0;
+		const std::vector<RecordedDraw> single = RenderDraws(1, &singleThreads);
+		const std::vector<RecordedDraw> parallel = RenderDraws(8, &parallelThreads);
+
+		LB::Test::Run("recording threads keep the draw order", [&]() {
+			LB_CHECK(singleThreads == 1);
+			LB_CHECK(parallelThreads == 8);
+			LB_CHECK(single.size() > 1000);
+			LB_CHECK(parallel == single);
+		});
+
+		remove(ScenePath);
+	}
+
+	double RenderOverdraw(bool depthPrePass)
+	{
+		LB::RendererSettings settings;
+		settings.depthPrePass = depthPrePass;
+
+		LB::SoftwareBackend backend(160, 90);
+		LB::Renderer renderer(&backend, settings);
+
+		LB::Scene scene(&renderer, ScenePath);
+		LB::RenderSnapshot snapshot;
+
+		scene.Extract(snapshot);
+		renderer.Render(snapshot);
+
+		return backend.GetOverdraw();
+	}
+
+	// Three layers of entities behind each other. The pre-pass only binds the
+	// depth buffer, so the software backend would throw on a color write, and
+	// the opaque pass then shades each pixel about once.
+	void TestDepthPrePassLowersOverdraw()
+	{
+		uint32_t staticCount = 0;
+		WriteSyntheticScene(3000, &staticCount);
+
+		const double overdraw = RenderOverdraw(false);
+		const double prePassOverdraw = RenderOverdraw(true);
+
+		LB::Test::Run("depth pre-pass lowers the overdraw", [&]() {
+			LB_CHECK(prePassOverdraw > 0.0);
+			LB_CHECK(prePassOverdraw <= 1.0);
+			LB_CHECK(prePassOverdraw < overdraw);
+		});
+
+		remove(ScenePath);
+	}
+
+	// Completes signaled values only once the CPU waits for them or the test
+	// says so, like a GPU that is still busy with the frames.
+	class BusyBackend : public LB::HeadlessBackend
+	{
+	public:
+		BusyBackend() : LB::HeadlessBackend(64, 64), _signaledValues() {}
+
+		void Signal(LB::BackendQueue queue, uint64_t value) override
+		{
+			uint64_t &signaled = _signaledValues[static_cast<uint32_t>(queue)];
+			signaled = std::max(signaled, value);
+		}
+
+		void WaitForValue(LB::BackendQueue queue, uint64_t value) override
+		{
+			if(value <= _signaledValues[static_cast<uint32_t>(queue)])
+				LB::HeadlessBackend::Signal(queue, value);
+
+			LB::HeadlessBackend::WaitForValue(queue, value);
+		}
+
+		void Complete(LB::BackendQueue queue)
+		{
+			LB::HeadlessBackend::Signal(queue, _signaledValues[static_cast<uint32_t>(queue)]);
+		}
+
+	private:
+		uint64_t _signaledValues[2];
+	};
+
+	// A mesh deleted right after it was created hands its ranges back only once
+	// the frame it was deleted in completed and the copy of its upload, which
+	// went out with the next frame, did as well.
+	void TestFreedBuffersWaitForTheGpu()
+	{
+		BusyBackend backend;
+		LB::Renderer renderer(&backend);
+
+		LB::RenderSnapshot snapshot;
+		snapshot.frame = 0;
+		memset(snapshot.viewMatrix, 0, sizeof(snapshot.viewMatrix));
+		snapshot.viewMatrix[0] = snapshot.viewMatrix[5] = snapshot.viewMatrix[10] = snapshot.viewMatrix[15] = 1.0f;
+		memset(snapshot.cameraPosition, 0, sizeof(snapshot.cameraPosition));
+		snapshot.extractMilliseconds = 0.0;
+
+		renderer.Render(snapshot);
+		const uint32_t allocations = renderer.GetBufferStatistics().allocations;
+
+		delete LB::Mesh::WithCube(&renderer);
+		LB_CHECK(renderer.GetBufferStatistics().allocations == allocations + 2);
+
+		renderer.Render(snapshot);
+		LB_CHECK(renderer.GetStatistics().pendingReleases == 2);
+		LB_CHECK(renderer.GetBufferStatistics().allocations == allocations + 2);
+
+		// The frame is done, the copy isn't.
+		backend.Complete(LB::BackendQueue::Graphics);
+		renderer.Render(snapshot);
+		LB_CHECK(renderer.GetStatistics().releases == 0);
+		LB_CHECK(renderer.GetStatistics().pendingReleases == 2);
+		LB_CHECK(renderer.GetBufferStatistics().allocations == allocations + 2);
+
+		backend.Complete(LB::BackendQueue::Copy);
+		renderer.Render(snapshot);
+		LB_CHECK(renderer.GetStatistics().releases == 2);
+		LB_CHECK(renderer.GetStatistics().pendingReleases == 0);
+		LB_CHECK(renderer.GetBufferStatistics().allocations == allocations);
+	}
+}
+
+int main()
+{
+	TestRenderSyntheticScene();
+	TestDepthPrePassDrawsTwice();
+	TestDepthPrePassLowersOverdraw();
+	TestRecordingThreadsKeepTheOrder();
+
+	LB::Test::Run("freed buffers wait for the GPU", TestFreedBuffersWaitForTheGpu);
+
+	return LB::Test::Finish();
+}
@@ -0,0 +1,210 @@
+#include "TestHarness.h"
+
+#include "LBResolutionScaler.h"
+
+#include <stdexcept>
+#include <vector>
+
+namespace
+{
+	// Frame times as they'd be measured, the GPU time follows the pixel count
+	// so it scales with the square of the resolution scale picked before.
+	struct TraceFrame
+	{
+		double cpuMilliseconds;
+		double gpuMillisecondsAtFullScale;
+	};
+
+	std::vector<TraceFrame> MakeTrace(uint32_t frames, double cpuMilliseconds, double gpuMilliseconds)
+	{
+		return std::vector<TraceFrame>(frames, { cpuMilliseconds, gpuMilliseconds });
+	}
+
+	// A few percent of deterministic noise on every frame.
+	std::vector<TraceFrame> MakeNoisyTrace(uint32_t frames, double cpuMilliseconds, double gpuMilliseconds)
+	{
+		static const double noise[] = { 0.0, 0.02, -0.015, 0.01, -0.03, 0.025, -0.01, 0.005 };
+
+		std::vector<TraceFrame> trace;
+		for(uint32_t i = 0; i < frames; i++)
+			trace.push_back({ cpuMilliseconds, gpuMilliseconds * (1.0 + noise[i % 8]) });
+
+		return trace;
+	}
+
+	// Returns the scale picked after each frame.
+	std::vector<float> Replay(LB::ResolutionScaler &scaler, const std::vector<TraceFrame> &trace)
+	{
+		std::vector<float> scales;
+		for(const TraceFrame &frame : trace)
+		{
+			const double scale = scaler.GetScale();
+			scales.push_back(scaler.Update(frame.cpuMilliseconds, frame.gpuMillisecondsAtFullScale * scale * scale));
+		}
+
+		return scales;
+	}
+
+	double GetGpuMilliseconds(const TraceFrame &frame, float scale)
+	{
+		return frame.gpuMillisecondsAtFullScale * scale * scale;
+	}
+
+	void TestSettingsAreValidated()
+	{
+		LB::ResolutionScalerSettings settings;
+		settings.minScale = 0.0f;
+		LB_CHECK_THROWS(LB::ResolutionScaler scaler(settings), std::invalid_argument);
+
+		settings.minScale = 0.8f;
+		settings.maxScale = 0.7f;
+		LB_CHECK_THROWS(LB::ResolutionScaler scaler(settings), std::invalid_argument);
+
+		settings.maxScale = 1.5f;
+		LB_CHECK_THROWS(LB::ResolutionScaler scaler(settings), std::invalid_argument);
+
+		settings = LB::ResolutionScalerSettings();
+		settings.targetMilliseconds = 0.0;
+		LB_CHECK_THROWS(LB::ResolutionScaler scaler(settings), std::invalid_argument);
+	}
+
+	// 25 ms at full resolution against a 16.7 ms target, the scale drops until
+	// the frames fit and stays there.
+	void TestStepsDownUnderLoad()
+	{
+		LB::ResolutionScaler scaler;
+		const std::vector<TraceFrame> trace = MakeTrace(120, 5.0, 25.0);
+		const std::vector<float> scales = Replay(scaler, trace);
+
+		// Never goes up on the way down.
+		for(size_t i = 1; i < scales.size(); i++)
+			LB_CHECK(scales[i] <= scales[i - 1]);
+
+		const double target = scaler.GetSettings().targetMilliseconds;
+		LB_CHECK(GetGpuMilliseconds(trace.back(), scales[30]) <= target);
+		LB_CHECK(GetGpuMilliseconds(trace.back(), scales.back()) <= target);
+
+		// Without giving away more than needed, somewhere in the deadband.
+		LB_CHECK(GetGpuMilliseconds(trace.back(), scales.back()) >= target * (1.0 - 2.0 * scaler.GetSettings().deadband));
+		LB_CHECK(scales.back() > scaler.GetSettings().minScale);
+	}
+
+	// Once settled, a few percent of noise doesn't move the scale.
+	void TestNoiseIsIgnored()
+	{
+		LB::ResolutionScaler scaler;
+		Replay(scaler, MakeTrace(120, 5.0, 25.0));
+
+		const uint64_t changes = scaler.GetStatistics().scaleChanges;
+		const float settled = scaler.GetScale();
+
+		const std::vector<float> scales = Replay(scaler, MakeNoisyTrace(240, 5.0, 25.0));
+		LB_CHECK(scaler.GetStatistics().scaleChanges == changes);
+		for(float scale : scales)
+			LB_CHECK(scale == settled);
+	}
+
+	// When the load goes away the scale waits raiseDelay frames of headroom
+	// before it goes up, then climbs back to the maximum.
+	void TestRaiseIsDelayed()
+	{
+		LB::ResolutionScaler scaler;
+		Replay(scaler, MakeTrace(120, 5.0, 25.0));
+
+		const float lowered = scaler.GetScale();
+		LB_CHECK(lowered < 1.0f);
+
+		const std::vector<float> scales = Replay(scaler, MakeTrace(120, 5.0, 8.0));
+		const uint32_t raiseDelay = scaler.GetSettings().raiseDelay;
+
+		for(uint32_t i = 0; i + 1 < raiseDelay; i++)
+			LB_CHECK(scales[i] == lowered);
+
+		LB_CHECK(scales[raiseDelay - 1] > lowered);
+		LB_CHECK(scales.back() == scaler.GetSettings().maxScale);
+	}
+
+	// Headroom for a few frames, then back to the old load. The streak is
+	// broken before it is long enough to raise.
+	void TestShortHeadroomDoesntRaise()
+	{
+		LB::ResolutionScaler scaler;
+		Replay(scaler, MakeTrace(120, 5.0, 25.0));
+		const float settled = scaler.GetScale();
+
+		std::vector<TraceFrame> trace = MakeTrace(scaler.GetSettings().raiseDelay / 2, 5.0, 8.0);
+		const std::vector<TraceFrame> load = MakeTrace(60, 5.0, 25.0);
+		trace.insert(trace.end(), load.begin(), load.end());
+
+		for(float scale : Replay(scaler, trace))
+			LB_CHECK(scale <= settled);
+	}
+
+	// CPU bound frames over the target don't lower the scale, fewer pixels
+	// wouldn't help. Once the GPU is the bottleneck again, they do.
+	void TestCpuBoundFramesHold()
+	{
+		LB::ResolutionScaler scaler;
+
+		const std::vector<float> scales = Replay(scaler, MakeTrace(60, 30.0, 20.0));
+		for(float scale : scales)
+			LB_CHECK(scale == scaler.GetSettings().maxScale);
+
+		LB_CHECK(scaler.GetStatistics().cpuBoundFrames == 60);
+		LB_CHECK(scaler.GetStatistics().framesOverTarget == 60);
+		LB_CHECK(scaler.GetStatistics().scaleChanges == 0);
+
+		Replay(scaler, MakeTrace(60, 5.0, 20.0));
+		LB_CHECK(scaler.GetScale() < scaler.GetSettings().maxScale);
+	}
+
+	// Without a GPU time the CPU time is controlled instead.
+	void TestCpuTimeWithoutGpuTime()
+	{
+		LB::ResolutionScaler scaler;
+
+		for(int i = 0; i < 30; i++)
+			scaler.Update(25.0, 0.0);
+
+		LB_CHECK(scaler.GetScale() < scaler.GetSettings().maxScale);
+		LB_CHECK(scaler.GetStatistics().cpuBoundFrames == 0);
+	}
+
+	// However heavy or light the frame, the scale ends exactly on the bounds.
+	void TestScaleStaysInBounds()
+	{
+		LB::ResolutionScalerSettings settings;
+		settings.minScale = 0.6f;
+		settings.maxScale = 0.9f;
+
+		LB::ResolutionScaler scaler(settings);
+		LB_CHECK(scaler.GetScale() == 0.9f);
+
+		for(float scale : Replay(scaler, MakeTrace(200, 5.0, 200.0)))
+			LB_CHECK(scale >= 0.6f && scale <= 0.9f);
+		LB_CHECK(scaler.GetScale() == 0.6f);
+
+		for(float scale : Replay(scaler, MakeTrace(200, 5.0, 1.0)))
+			LB_CHECK(scale >= 0.6f && scale <= 0.9f);
+		LB_CHECK(scaler.GetScale() == 0.9f);
+
+		// Reset goes back to the top.
+		Replay(scaler, MakeTrace(200, 5.0, 200.0));
+		scaler.Reset();
+		LB_CHECK(scaler.GetScale() == 0.9f);
+	}
+}
+
+int main()
+{
+	LB::Test::Run("settings are validated", TestSettingsAreValidated);
+	LB::Test::Run("steps down under load", TestStepsDownUnderLoad);
+	LB::Test::Run("noise is ignored", TestNoiseIsIgnored);
+	LB::Test::Run("raise is delayed", TestRaiseIsDelayed);
+	LB::Test::Run("short headroom doesn't raise", TestShortHeadroomDoesntRaise);
+	LB::Test::Run("cpu bound frames hold the scale", TestCpuBoundFramesHold);
+	LB::Test::Run("cpu time is controlled without gpu time", TestCpuTimeWithoutGpuTime);
+	LB::Test::Run("scale stays in bounds", TestScaleStaysInBounds);
+
+	return LB::Test::Finish();
+}
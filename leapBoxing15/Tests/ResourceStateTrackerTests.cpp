@@ -0,0 +1,196 @@
+#include "TestHarness.h"
+
+#include "LBResourceStateTracker.h"
+
+#include <functional>
+#include <vector>
+
+namespace
+{
+	// Collects what every Flush submits, one entry per call.
+	struct SubmittedBatches
+	{
+		void operator()(const LB::ResourceStateBarrier *barriers, size_t count)
+		{
+			batches.push_back(std::vector<LB::ResourceStateBarrier>(barriers, barriers + count));
+		}
+
+		std::vector<std::vector<LB::ResourceStateBarrier>> batches;
+	};
+
+	void TestTransitionBackCancels()
+	{
+		LB::ResourceStateTracker tracker;
+		int texture = 0;
+		tracker.Track(&texture, LB::ResourceState::RenderTarget);
+
+		tracker.Transition(&texture, LB::ResourceState::PixelShaderResource);
+		LB_CHECK(tracker.HasPendingBarriers());
+		LB_CHECK(tracker.GetState(&texture) == LB::ResourceState::PixelShaderResource);
+
+		tracker.Transition(&texture, LB::ResourceState::RenderTarget);
+		LB_CHECK(!tracker.HasPendingBarriers());
+		LB_CHECK(tracker.GetState(&texture) == LB::ResourceState::RenderTarget);
+
+		// Nothing left to submit, so the backend isn't called.
+		SubmittedBatches submitted;
+		tracker.Flush(std::ref(submitted));
+		LB_CHECK(submitted.batches.empty());
+
+		const LB::ResourceStateStatistics &statistics = tracker.GetStatistics();
+		LB_CHECK(statistics.transitionsRequested == 2);
+		LB_CHECK(statistics.transitionsCancelled == 1);
+		LB_CHECK(statistics.transitionsEmitted == 0);
+		LB_CHECK(statistics.flushes == 0);
+	}
+
+	void TestChainedTransitionsMerge()
+	{
+		LB::ResourceStateTracker tracker;
+		int buffer = 0;
+		tracker.Track(&buffer, LB::ResourceState::CopyDest);
+
+		tracker.Transition(&buffer, LB::ResourceState::UnorderedAccess);
+		tracker.Transition(&buffer, LB::ResourceState::RenderTarget);
+
+		SubmittedBatches submitted;
+		tracker.Flush(std::ref(submitted));
+
+		LB_CHECK(submitted.batches.size() == 1);
+		LB_CHECK(submitted.batches[0].size() == 1);
+
+		const LB::ResourceStateBarrier &barrier = submitted.batches[0][0];
+		LB_CHECK(barrier.type == LB::RenderBarrierType::Transition);
+		LB_CHECK(barrier.resource == &buffer);
+		LB_CHECK(barrier.stateBefore == LB::ResourceState::CopyDest);
+		LB_CHECK(barrier.stateAfter == LB::ResourceState::RenderTarget);
+		LB_CHECK(tracker.GetState(&buffer) == LB::ResourceState::RenderTarget);
+
+		LB_CHECK(tracker.GetStatistics().transitionsMerged == 1);
+	}
+
+	// Transitions of several resources requested between two flushes go to the
+	// backend in one call, and the next batch starts where they ended.
+	void TestOneCallPerFlush()
+	{
+		LB::ResourceStateTracker tracker;
+		int resources[4];
+		for(int &resource : resources)
+			tracker.Track(&resource, LB::ResourceState::Common);
+
+		for(int &resource : resources)
+			tracker.Transition(&resource, LB::ResourceState::CopyDest);
+		tracker.UnorderedAccess(&resources[0]);
+		tracker.UnorderedAccess(&resources[0]);
+
+		SubmittedBatches submitted;
+		tracker.Flush(std::ref(submitted));
+		LB_CHECK(submitted.batches.size() == 1);
+		LB_CHECK(submitted.batches[0].size() == 5);
+
+		for(int &resource : resources)
+			tracker.Transition(&resource, LB::ResourceState::VertexAndConstantBuffer);
+
+		tracker.Flush(std::ref(submitted));
+		LB_CHECK(submitted.batches.size() == 2);
+		LB_CHECK(submitted.batches[1].size() == 4);
+		for(const LB::ResourceStateBarrier &barrier : submitted.batches[1])
+			LB_CHECK(barrier.stateBefore == LB::ResourceState::CopyDest);
+
+		LB_CHECK(tracker.GetStatistics().flushes == 2);
+		LB_CHECK(tracker.GetStatistics().barriersEmitted == 9);
+	}
+
+	// Reads the current state covers are skipped, other reads widen it.
+	void TestReadStatesCombine()
+	{
+		LB::ResourceStateTracker tracker;
+		int texture = 0;
+		tracker.Track(&texture, LB::ResourceState::PixelShaderResource | LB::ResourceState::NonPixelShaderResource);
+
+		tracker.Transition(&texture, LB::ResourceState::PixelShaderResource);
+		LB_CHECK(!tracker.HasPendingBarriers());
+
+		tracker.Transition(&texture, LB::ResourceState::CopySource);
+
+		SubmittedBatches submitted;
+		tracker.Flush(std::ref(submitted));
+		LB_CHECK(submitted.batches.size() == 1);
+		LB_CHECK(submitted.batches[0][0].stateAfter == (LB::ResourceState::PixelShaderResource | LB::ResourceState::NonPixelShaderResource | LB::ResourceState::CopySource));
+
+		LB_CHECK(tracker.GetStatistics().transitionsSkipped == 1);
+	}
+
+	// Every request is counted as requested and ends up emitted, skipped, merged
+	// or cancelled, where a cancelled transition took two requests.
+	void TestRequestedAndEmittedCounts()
+	{
+		LB::ResourceStateTracker tracker;
+		int resources[3];
+		tracker.Track(&resources[0], LB::ResourceState::RenderTarget);
+		tracker.Track(&resources[1], LB::ResourceState::DepthWrite);
+		tracker.Track(&resources[2], LB::ResourceState::Present);
+
+		tracker.Transition(&resources[0], LB::ResourceState::PixelShaderResource);
+		tracker.Transition(&resources[0], LB::ResourceState::RenderTarget);
+		tracker.Transition(&resources[1], LB::ResourceState::DepthWrite);
+		tracker.Transition(&resources[1], LB::ResourceState::DepthRead);
+		tracker.Transition(&resources[2], LB::ResourceState::RenderTarget);
+		tracker.Transition(&resources[2], LB::ResourceState::CopySource);
+
+		SubmittedBatches submitted;
+		tracker.Flush(std::ref(submitted));
+
+		const LB::ResourceStateStatistics &statistics = tracker.GetStatistics();
+		LB_CHECK(statistics.transitionsRequested == 6);
+		LB_CHECK(statistics.transitionsCancelled == 1);
+		LB_CHECK(statistics.transitionsSkipped == 1);
+		LB_CHECK(statistics.transitionsMerged == 1);
+		LB_CHECK(statistics.transitionsEmitted == 2);
+		LB_CHECK(statistics.transitionsRequested == statistics.transitionsEmitted + statistics.transitionsSkipped + statistics.transitionsMerged + statistics.transitionsCancelled * 2);
+		LB_CHECK(submitted.batches[0].size() == 2);
+
+		tracker.ResetStatistics();
+		LB_CHECK(tracker.GetStatistics().transitionsRequested == 0);
+	}
+
+	// Tracking anew or untracking drops what was pending for the resource only.
+	void TestUntrackDropsPendingBarriers()
+	{
+		LB::ResourceStateTracker tracker;
+		int resources[3];
+		for(int &resource : resources)
+			tracker.Track(&resource, LB::ResourceState::Common);
+
+		tracker.Transition(&resources[0], LB::ResourceState::CopyDest);
+		tracker.Transition(&resources[1], LB::ResourceState::CopyDest);
+		tracker.Transition(&resources[2], LB::ResourceState::CopyDest);
+
+		tracker.Untrack(&resources[0]);
+		tracker.Track(&resources[1], LB::ResourceState::RenderTarget);
+		LB_CHECK(!tracker.IsTracked(&resources[0]));
+		LB_CHECK(tracker.GetState(&resources[1]) == LB::ResourceState::RenderTarget);
+
+		// Still pending after the indices moved.
+		tracker.Transition(&resources[2], LB::ResourceState::CopySource);
+
+		SubmittedBatches submitted;
+		tracker.Flush(std::ref(submitted));
+		LB_CHECK(submitted.batches.size() == 1);
+		LB_CHECK(submitted.batches[0].size() == 1);
+		LB_CHECK(submitted.batches[0][0].resource == &resources[2]);
+		LB_CHECK(submitted.batches[0][0].stateAfter == LB::ResourceState::CopySource);
+	}
+}
+
+int main()
+{
+	LB::Test::Run("transition back cancels", TestTransitionBackCancels);
+	LB::Test::Run("chained transitions merge", TestChainedTransitionsMerge);
+	LB::Test::Run("one call per flush", TestOneCallPerFlush);
+	LB::Test::Run("read states combine", TestReadStatesCombine);
+	LB::Test::Run("requested and emitted counts", TestRequestedAndEmittedCounts);
+	LB::Test::Run("untrack drops pending barriers", TestUntrackDropsPendingBarriers);
+
+	return LB::Test::Finish();
+}
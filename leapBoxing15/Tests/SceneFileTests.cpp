@@ -0,0 +1,162 @@
+#include "TestHarness.h"
+
+#include "LBSceneFile.h"
+
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace
+{
+	const char *ScenePath = "SceneFileTests.scene";
+
+	LB::SceneFileEntity MakeEntity(int32_t parent, uint32_t mesh, uint32_t material)
+	{
+		LB::SceneFileEntity entity = {};
+		entity.scale[0] = entity.scale[1] = entity.scale[2] = 1.0f;
+		entity.rotation[3] = 1.0f;
+		entity.parent = parent;
+		entity.mesh = mesh;
+		entity.material = material;
+
+		for(int n = 0; n < 3; n++)
+		{
+			entity.boundsMin[n] = -1.0f;
+			entity.boundsMax[n] = 1.0f;
+		}
+
+		return entity;
+	}
+
+	std::vector<uint8_t> SerializeScene()
+	{
+		LB::SceneFileWriter writer;
+		const uint32_t mesh = writer.AddMesh("cube");
+		const uint32_t material = writer.AddMaterial("shaders.hlsl");
+
+		const uint32_t root = writer.AddEntity(MakeEntity(LB::SceneFileNoParent, mesh, material));
+		writer.AddEntity(MakeEntity(static_cast<int32_t>(root), mesh, material));
+		writer.AddEntity(MakeEntity(static_cast<int32_t>(root), mesh, material));
+
+		return writer.Serialize();
+	}
+
+	LB::SceneFileEntity *GetEntities(std::vector<uint8_t> &data)
+	{
+		const LB::SceneFileHeader *header = reinterpret_cast<const LB::SceneFileHeader *>(data.data());
+		return reinterpret_cast<LB::SceneFileEntity *>(data.data() + header->entityOffset);
+	}
+
+	void WriteData(const std::vector<uint8_t> &data)
+	{
+		FILE *file = fopen(ScenePath, "wb");
+		fwrite(data.data(), 1, data.size(), file);
+		fclose(file);
+	}
+
+	// Release builds have to reject these on open just like Validate does, the
+	// scene indexes its tables with them unchecked.
+	void CheckRejected(const std::vector<uint8_t> &data)
+	{
+		LB_CHECK(!LB::SceneFile::Validate(data.data(), data.size(), nullptr));
+
+		WriteData(data);
+
+		LB::SceneFile file;
+		LB_CHECK_THROWS(file.Open(ScenePath), std::runtime_error);
+		LB_CHECK(file.GetEntityCount() == 0);
+	}
+
+	void TestRoundTrip()
+	{
+		WriteData(SerializeScene());
+
+		LB::SceneFile file;
+		file.Open(ScenePath);
+
+		LB_CHECK(file.GetEntityCount() == 3);
+		LB_CHECK(file.GetMeshCount() == 1);
+		LB_CHECK(file.GetMaterialCount() == 1);
+		LB_CHECK(std::string(file.GetMeshName(0)) == "cube");
+		LB_CHECK(std::string(file.GetMaterialName(0)) == "shaders.hlsl");
+		LB_CHECK(file.GetEntity(0).parent == LB::SceneFileNoParent);
+		LB_CHECK(file.GetEntity(2).parent == 0);
+		LB_CHECK(file.GetEntity(1).rotation[3] == 1.0f);
+	}
+
+	void TestWriterRejectsForwardParents()
+	{
+		LB::SceneFileWriter writer;
+		LB_CHECK_THROWS(writer.AddEntity(MakeEntity(0, 0, 0)), std::invalid_argument);
+	}
+
+	void TestUnknownMeshIsRejected()
+	{
+		std::vector<uint8_t> data = SerializeScene();
+		GetEntities(data)[1].mesh = 7;
+		CheckRejected(data);
+	}
+
+	void TestUnknownMaterialIsRejected()
+	{
+		std::vector<uint8_t> data = SerializeScene();
+		GetEntities(data)[2].material = 1;
+		CheckRejected(data);
+	}
+
+	void TestParentOrderIsChecked()
+	{
+		std::vector<uint8_t> data = SerializeScene();
+		GetEntities(data)[1].parent = 2;
+		CheckRejected(data);
+
+		data = SerializeScene();
+		GetEntities(data)[1].parent = 1;
+		CheckRejected(data);
+
+		data = SerializeScene();
+		GetEntities(data)[1].parent = -5;
+		CheckRejected(data);
+	}
+
+	void TestBrokenHeaderIsRejected()
+	{
+		std::vector<uint8_t> data = SerializeScene();
+		reinterpret_cast<LB::SceneFileHeader *>(data.data())->entityCount = 1000;
+		CheckRejected(data);
+
+		data = SerializeScene();
+		reinterpret_cast<LB::SceneFileHeader *>(data.data())->version = LB::SceneFileVersion + 1;
+		CheckRejected(data);
+
+		data = SerializeScene();
+		data.resize(data.size() - 16);
+		CheckRejected(data);
+	}
+
+	void TestInvertedBoundsAreRejected()
+	{
+		std::vector<uint8_t> data = SerializeScene();
+		GetEntities(data)[0].boundsMin[1] = 2.0f;
+
+		std::string error;
+		LB_CHECK(!LB::SceneFile::Validate(data.data(), data.size(), &error));
+		LB_CHECK(error == "Entity 0 has inverted bounds");
+		CheckRejected(data);
+	}
+}
+
+int main()
+{
+	LB::Test::Run("written scenes open with their names and hierarchy", TestRoundTrip);
+	LB::Test::Run("writer rejects parents after their children", TestWriterRejectsForwardParents);
+	LB::Test::Run("unknown meshes are rejected on open", TestUnknownMeshIsRejected);
+	LB::Test::Run("unknown materials are rejected on open", TestUnknownMaterialIsRejected);
+	LB::Test::Run("parent order is checked on open", TestParentOrderIsChecked);
+	LB::Test::Run("broken headers are rejected on open", TestBrokenHeaderIsRejected);
+	LB::Test::Run("inverted bounds are rejected on open", TestInvertedBoundsAreRejected);
+
+	remove(ScenePath);
+	return LB::Test::Finish();
+}
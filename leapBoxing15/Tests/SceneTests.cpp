@@ -0,0 +1,265 @@
+#include "TestHarness.h"
+
+#include "LBHeadlessBackend.h"
+#include "LBRenderer.h"
+#include "LBRenderSnapshot.h"
+#include "LBScene.h"
+#include "LBSceneFile.h"
+#include "LBSceneStreamer.h"
+
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <thread>
+#include <vector>
+
+namespace
+{
+	const char *ChunkPath = "SceneTests.scene";
+
+	// A few entities around the origin, all of them static.
+	uint32_t WriteStaticChunk()
+	{
+		LB::SceneFileWriter writer;
+		const uint32_t mesh = writer.AddMesh("cube");
+		const uint32_t material = writer.AddMaterial("shaders.hlsl");
+
+		const uint32_t count = 12;
+		for(uint32_t i = 0; i < count; i++)
+		{
+			LB::SceneFileEntity entity = {};
+			entity.position[0] = static_cast<float>(i) * 3.0f;
+			entity.scale[0] = entity.scale[1] = entity.scale[2] = 1.0f;
+			entity.rotation[3] = 1.0f;
+			entity.parent = LB::SceneFileNoParent;
+			entity.mesh = mesh;
+			entity.material = material;
+			entity.flags = LB::SceneFileEntityFlagStatic;
+
+			for(int n = 0; n < 3; n++)
+			{
+				entity.boundsMin[n] = entity.position[n] - 1.0f;
+				entity.boundsMax[n] = entity.position[n] + 1.0f;
+			}
+
+			writer.AddEntity(entity);
+		}
+
+		writer.Write(ChunkPath);
+		return count;
+	}
+
+	// The loader threads need a moment, gives up after a few seconds.
+	bool UpdateUntil(LB::Scene &scene, std::function<bool ()> condition)
+	{
+		for(int i = 0; i < 500; i++)
+		{
+			scene.Update(1.0f / 60.0f);
+			if(condition())
+				return true;
+
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		}
+
+		return false;
+	}
+
+	void TestStreamedStaticEntitiesStayWithTheirChunk()
+	{
+		const uint32_t chunkCount = WriteStaticChunk();
+
+		LB::HeadlessBackend backend(320, 180);
+		LB::Renderer renderer(&backend);
+
+		{
+			// Starts out with one dynamic cube.
+			LB::Scene scene(&renderer);
+			LB::RenderSnapshot snapshot;
+
+			const uint32_t chunk = scene.AddStreamingChunk(ChunkPath, RN::Vector3(0.0f, 0.0f, 0.0f), 40.0f);
+			LB_CHECK(UpdateUntil(scene, [&]() { return scene.GetStreamer()->IsChunkResident(chunk); }));
+
+			// The chunk owns its entities, baking them would delete them twice and
+			// keep drawing them once the chunk is gone.
+			scene.BuildStaticBatches();
+			LB_CHECK(scene.GetStaticBatchStatistics().entities == 0);
+
+			scene.Extract(snapshot);
+			LB_CHECK(snapshot.items.size() == chunkCount + 1);
+
+			scene.GetCamera().SetPosition(RN::Vector3(0.0f, 0.0f, 1000.0f));
+			LB_CHECK(UpdateUntil(scene, [&]() { return !scene.GetStreamer()->IsChunkResident(chunk); }));
+
+			scene.Extract(snapshot);
+			LB_CHECK(snapshot.items.size() == 1);
+		}
+
+		remove(ChunkPath);
+	}
+
+	const char *StreamingPaths[] = { "SceneTestsFar.scene", "SceneTestsNear.scene", "SceneTestsMiddle.scene" };
+	const uint32_t StreamingEntities = 256;
+
+	// Returns the file size.
+	uint64_t WriteStreamingChunk(const char *path)
+	{
+		LB::SceneFileWriter writer;
+		const uint32_t mesh = writer.AddMesh("cube");
+		const uint32_t material = writer.AddMaterial("shaders.hlsl");
+
+		for(uint32_t i = 0; i < StreamingEntities; i++)
+		{
+			LB::SceneFileEntity entity = {};
+			entity.scale[0] = entity.scale[1] = entity.scale[2] = 1.0f;
+			entity.rotation[3] = 1.0f;
+			entity.parent = LB::SceneFileNoParent;
+			entity.mesh = mesh;
+			entity.material = material;
+			writer.AddEntity(entity);
+		}
+
+		writer.Write(path);
+		return writer.Serialize().size();
+	}
+
+	struct IntegratedSlice
+	{
+		uint32_t chunk;
+		uint32_t first;
+		uint32_t count;
+	};
+
+	bool WaitUntil(std::function<bool ()> condition)
+	{
+		for(int i = 0; i < 500; i++)
+		{
+			if(condition())
+				return true;
+
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		}
+
+		return false;
+	}
+
+	// With a byte budget below one slice every frame integrates exactly one,
+	// nearest chunk first no matter the order they were added or loaded in.
+	void TestIntegrationIsSpreadOverFrames()
+	{
+		uint64_t totalSize = 0;
+		for(const char *path : StreamingPaths)
+			totalSize += WriteStreamingChunk(path);
+
+		{
+			std::vector<IntegratedSlice> slices;
+			std::vector<uint32_t> unloaded;
+
+			LB::SceneStreamer streamer([&](uint32_t chunk, const LB::SceneFile &, uint32_t first, uint32_t count) {
+				slices.push_back({ chunk, first, count });
+			}, [&](uint32_t chunk) {
+				unloaded.push_back(chunk);
+			});
+
+			streamer.SetFrameBudget(1000.0, 1);
+
+			const float distances[] = { 30.0f, 10.0f, 20.0f };
+			for(uint32_t i = 0; i < 3; i++)
+			{
+				const float center[] = { distances[i], 0.0f, 0.0f };
+				streamer.AddChunk(StreamingPaths[i], center, 1.0f);
+			}
+
+			const float viewer[] = { 0.0f, 0.0f, 0.0f };
+			streamer.Update(viewer);
+
+			// Everything is loaded before the first integration.
+			LB_CHECK(WaitUntil([&]() { return streamer.GetStatistics().bytesInFlight == totalSize; }));
+			LB_CHECK(streamer.GetStatistics().queueDepth == 3);
+
+			const uint32_t slicesPerChunk = StreamingEntities / 64;
+			const uint32_t expectedOrder[] = { 1, 2, 0 };
+
+			for(uint32_t frame = 0; frame < slicesPerChunk * 3; frame++)
+			{
+				streamer.Integrate();
+
+				const LB::SceneStreamingStatistics statistics = streamer.GetStatistics();
+				const uint32_t chunk = expectedOrder[frame / slicesPerChunk];
+				const bool chunkDone = (frame % slicesPerChunk) == slicesPerChunk - 1;
+
+				LB_CHECK(slices.size() == frame + 1);
+				LB_CHECK(slices.back().chunk == chunk);
+				LB_CHECK(slices.back().first == (frame % slicesPerChunk) * 64);
+				LB_CHECK(slices.back().count == 64);
+				LB_CHECK(statistics.bytesIntegratedLastFrame == 64 * sizeof(LB::SceneFileEntity));
+				LB_CHECK(streamer.IsChunkResident(chunk) == chunkDone);
+				LB_CHECK(statistics.residentChunks == frame / slicesPerChunk + (chunkDone ? 1 : 0));
+				LB_CHECK(statistics.queueDepth == 3 - statistics.residentChunks);
+			}
+
+			LB::SceneStreamingStatistics statistics = streamer.GetStatistics();
+			LB_CHECK(statistics.bytesInFlight == 0);
+			LB_CHECK(statistics.chunksLoaded == 3);
+			LB_CHECK(statistics.hitches == 0);
+
+			// Nothing left, the next frame doesn't integrate anything.
+			streamer.Integrate();
+			LB_CHECK(slices.size() == slicesPerChunk * 3);
+			LB_CHECK(streamer.GetStatistics().bytesIntegratedLastFrame == 0);
+
+			// Leaving unloads all of them.
+			const float away[] = { 1000.0f, 0.0f, 0.0f };
+			streamer.Update(away);
+			statistics = streamer.GetStatistics();
+			LB_CHECK(unloaded.size() == 3);
+			LB_CHECK(statistics.residentChunks == 0);
+			LB_CHECK(statistics.chunksUnloaded == 3);
+		}
+
+		for(const char *path : StreamingPaths)
+			remove(path);
+	}
+
+	// The budget is only checked between slices, a frame whose slice takes well
+	// over the time budget counts as a hitch.
+	void TestSlowIntegrationIsAHitch()
+	{
+		const uint64_t size = WriteStreamingChunk(StreamingPaths[0]);
+
+		{
+			uint32_t slices = 0;
+			LB::SceneStreamer streamer([&](uint32_t, const LB::SceneFile &, uint32_t, uint32_t) {
+				slices++;
+				std::this_thread::sleep_for(std::chrono::milliseconds(5));
+			}, [](uint32_t) {}, 1);
+
+			streamer.SetFrameBudget(1.0, 1024 * 1024);
+
+			const float center[] = { 0.0f, 0.0f, 0.0f };
+			streamer.AddChunk(StreamingPaths[0], center, 1.0f);
+			streamer.Update(center);
+
+			LB_CHECK(WaitUntil([&]() { return streamer.GetStatistics().bytesInFlight == size; }));
+
+			streamer.Integrate();
+
+			const LB::SceneStreamingStatistics statistics = streamer.GetStatistics();
+			LB_CHECK(slices == 1);
+			LB_CHECK(statistics.hitches == 1);
+			LB_CHECK(statistics.integrationMillisecondsLastFrame >= 5.0);
+			LB_CHECK(statistics.integrationMillisecondsMax >= statistics.integrationMillisecondsLastFrame);
+			LB_CHECK(statistics.queueDepth == 1);
+		}
+
+		remove(StreamingPaths[0]);
+	}
+}
+
+int main()
+{
+	LB::Test::Run("streamed static entities stay with their chunk", TestStreamedStaticEntitiesStayWithTheirChunk);
+	LB::Test::Run("integration is spread over frames", TestIntegrationIsSpreadOverFrames);
+	LB::Test::Run("slow integration is a hitch", TestSlowIntegrationIsAHitch);
+
+	return LB::Test::Finish();
+}
@@ -0,0 +1,261 @@
+#include "TestHarness.h"
+
+#include "LBShaderCacheFile.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+	const char *Source = "float4 PSMain() : SV_TARGET { return 1; }";
+
+	struct KeyInputs
+	{
+		std::string source;
+		const char *entryPoint;
+		const char *target;
+		std::vector<LB::ShaderDefine> defines;
+		uint32_t flags;
+		uint32_t compilerVersion;
+	};
+
+	uint64_t GetHash(const KeyInputs &inputs)
+	{
+		LB::PipelineKey key;
+		LB::BuildShaderKey(inputs.source.data(), inputs.source.size(), inputs.entryPoint, inputs.target, inputs.defines.data(), inputs.defines.size(), inputs.flags, inputs.compilerVersion, key);
+		return key.GetHash();
+	}
+
+	LB::PipelineKey MakeKey(uint32_t index)
+	{
+		const std::string source = std::string(Source) + "// " + std::to_string(index);
+
+		LB::PipelineKey key;
+		LB::BuildShaderKey(source.data(), source.size(), "PSMain", "ps_5_0", nullptr, 0, 0, 47, key);
+		return key;
+	}
+
+	bool FileExists(const std::string &path)
+	{
+		FILE *file = fopen(path.c_str(), "rb");
+		if(file)
+			fclose(file);
+
+		return file != nullptr;
+	}
+
+	// Stands in for the compiler, every index gives different bytecode.
+	struct Compiler
+	{
+		LB::ShaderBytecodeCache::Bytecode operator()() const
+		{
+			calls++;
+			if(delay > 0)
+				std::this_thread::sleep_for(std::chrono::milliseconds(delay));
+
+			LB::ShaderBytecodeCache::Bytecode bytecode(100 + index);
+			for(size_t i = 0; i < bytecode.size(); i++)
+				bytecode[i] = static_cast<uint8_t>(i * 7 + index);
+
+			return bytecode;
+		}
+
+		uint32_t index;
+		uint32_t delay;
+		uint32_t &calls;
+	};
+
+	// Every input that changes the bytecode changes the key, including where one
+	// define ends and the next begins.
+	void TestEveryInputIsInTheKey()
+	{
+		const KeyInputs base = { Source, "PSMain", "ps_5_0", { { "LIGHTS", "4" }, { "SHADOWS", "1" } }, 0, 47 };
+		const uint64_t hash = GetHash(base);
+		LB_CHECK(GetHash(base) == hash);
+
+		std::vector<KeyInputs> changed(9, base);
+		changed[0].source[0] = 'h';
+		changed[1].entryPoint = "VSMain";
+		changed[2].target = "ps_5_1";
+		changed[3].defines[0].value = "5";
+		changed[4].defines[1].name = "SHADOW";
+		changed[5].defines.pop_back();
+		changed[6].defines = { { "LIGHTS", "4S" }, { "HADOWS", "1" } };
+		changed[7].flags = 1;
+		changed[8].compilerVersion = 48;
+
+		for(const KeyInputs &inputs : changed)
+			LB_CHECK(GetHash(inputs) != hash);
+
+		// A source that ends where another one's entry point starts.
+		KeyInputs shifted = base;
+		shifted.source += "PS";
+		shifted.entryPoint = "Main";
+		LB_CHECK(GetHash(shifted) != hash);
+	}
+
+	void TestFileRoundTrip()
+	{
+		const uint8_t bytecode[] = { 0x44, 0x58, 0x42, 0x43, 1, 2, 3, 4, 5 };
+		const std::vector<uint8_t> file = LB::WriteShaderCacheFile(42, bytecode, sizeof(bytecode));
+		LB_CHECK(file.size() == sizeof(LB::ShaderCacheFileHeader) + sizeof(bytecode));
+
+		const uint8_t *read = nullptr;
+		size_t readSize = 0;
+		LB_CHECK(LB::ReadShaderCacheFile(file.data(), file.size(), 42, &read, &readSize));
+		LB_CHECK(readSize == sizeof(bytecode) && memcmp(read, bytecode, sizeof(bytecode)) == 0);
+
+		// Another key, a truncated file and a damaged byte are all rejected.
+		LB_CHECK(!LB::ReadShaderCacheFile(file.data(), file.size(), 43, &read, &readSize));
+		LB_CHECK(!LB::ReadShaderCacheFile(file.data(), file.size() - 1, 42, &read, &readSize));
+		LB_CHECK(!LB::ReadShaderCacheFile(file.data(), sizeof(LB::ShaderCacheFileHeader) - 1, 42, &read, &readSize));
+
+		std::vector<uint8_t> damaged = file;
+		damaged.back() ^= 1;
+		LB_CHECK(!LB::ReadShaderCacheFile(damaged.data(), damaged.size(), 42, &read, &readSize));
+
+		damaged = file;
+		damaged[4] = LB::ShaderCacheFileVersion + 1;
+		LB_CHECK(!LB::ReadShaderCacheFile(damaged.data(), damaged.size(), 42, &read, &readSize));
+
+		const std::vector<uint8_t> empty = LB::WriteShaderCacheFile(42, nullptr, 0);
+		LB_CHECK(LB::ReadShaderCacheFile(empty.data(), empty.size(), 42, &read, &readSize));
+		LB_CHECK(readSize == 0);
+	}
+
+	// Compiled once, then found in memory, then after a restart in the file. A
+	// damaged file is compiled again and replaced.
+	void TestMissesFallBackToCompiling()
+	{
+		const LB::PipelineKey key = MakeKey(0);
+		uint32_t calls = 0;
+		const Compiler compile = { 0, 0, calls };
+
+		uint32_t uncounted = 0;
+		const LB::ShaderBytecodeCache::Bytecode expected = Compiler { 0, 0, uncounted }();
+
+		{
+			LB::ShaderBytecodeCache cache(".");
+			remove(cache.GetPath(key).c_str());
+
+			const std::shared_ptr<const LB::ShaderBytecodeCache::Bytecode> compiled = cache.Get(key, compile);
+			LB_CHECK(calls == 1);
+			LB_CHECK(*compiled == expected);
+			LB_CHECK(FileExists(cache.GetPath(key)));
+
+			LB_CHECK(cache.Get(key, compile) == compiled);
+			LB_CHECK(calls == 1);
+
+			const LB::ShaderCacheStatistics statistics = cache.GetStatistics();
+			LB_CHECK(statistics.misses == 1);
+			LB_CHECK(statistics.memoryHits == 1);
+			LB_CHECK(statistics.diskHits == 0);
+		}
+
+		{
+			LB::ShaderBytecodeCache cache(".");
+			LB_CHECK(*cache.Get(key, compile) == expected);
+			LB_CHECK(calls == 1);
+			LB_CHECK(cache.GetStatistics().diskHits == 1);
+			LB_CHECK(cache.GetStatistics().misses == 0);
+
+			FILE *file = fopen(cache.GetPath(key).c_str(), "r+b");
+			LB_CHECK(file != nullptr);
+			if(file)
+			{
+				fseek(file, -1, SEEK_END);
+				fputc(0xff, file);
+				fclose(file);
+			}
+		}
+
+		{
+			LB::ShaderBytecodeCache cache(".");
+			LB_CHECK(*cache.Get(key, compile) == expected);
+			LB_CHECK(calls == 2);
+			LB_CHECK(cache.GetStatistics().rejected == 1);
+			LB_CHECK(cache.GetStatistics().misses == 1);
+		}
+
+		{
+			LB::ShaderBytecodeCache cache(".");
+			cache.Get(key, compile);
+			LB_CHECK(calls == 2);
+			LB_CHECK(cache.GetStatistics().diskHits == 1);
+			remove(cache.GetPath(key).c_str());
+		}
+	}
+
+	// A failed compile leaves nothing behind, the next lookup tries again.
+	void TestFailedCompileIsNotCached()
+	{
+		const LB::PipelineKey key = MakeKey(1);
+		LB::ShaderBytecodeCache cache(".");
+		remove(cache.GetPath(key).c_str());
+
+		LB_CHECK_THROWS(cache.Get(key, []() -> LB::ShaderBytecodeCache::Bytecode { throw std::runtime_error("compile failed"); }), std::runtime_error);
+		LB_CHECK(!FileExists(cache.GetPath(key)));
+
+		uint32_t calls = 0;
+		cache.Get(key, Compiler { 1, 0, calls });
+		LB_CHECK(calls == 1);
+		LB_CHECK(cache.GetStatistics().misses == 1);
+
+		remove(cache.GetPath(key).c_str());
+	}
+
+	// A cold start compiles every shader, a warm one loads them all and is
+	// faster for it.
+	void TestWarmStartDoesntCompile()
+	{
+		const uint32_t shaderCount = 20;
+		uint32_t calls = 0;
+
+		std::vector<LB::ShaderBytecodeCache::Bytecode> cold;
+		LB::ShaderCacheStatistics coldStatistics;
+		{
+			LB::ShaderBytecodeCache cache(".");
+			for(uint32_t i = 0; i < shaderCount; i++)
+			{
+				remove(cache.GetPath(MakeKey(100 + i)).c_str());
+				cold.push_back(*cache.Get(MakeKey(100 + i), Compiler { i, 2, calls }));
+			}
+
+			coldStatistics = cache.GetStatistics();
+		}
+
+		LB_CHECK(calls == shaderCount);
+		LB_CHECK(coldStatistics.misses == shaderCount);
+		LB_CHECK(coldStatistics.compileMilliseconds >= shaderCount * 2.0);
+
+		LB::ShaderBytecodeCache cache(".");
+		for(uint32_t i = 0; i < shaderCount; i++)
+			LB_CHECK(*cache.Get(MakeKey(100 + i), Compiler { i, 2, calls }) == cold[i]);
+
+		const LB::ShaderCacheStatistics warmStatistics = cache.GetStatistics();
+		LB_CHECK(calls == shaderCount);
+		LB_CHECK(warmStatistics.misses == 0);
+		LB_CHECK(warmStatistics.diskHits == shaderCount);
+		LB_CHECK(warmStatistics.compileMilliseconds == 0.0);
+		LB_CHECK(warmStatistics.loadMilliseconds < coldStatistics.compileMilliseconds);
+
+		for(uint32_t i = 0; i < shaderCount; i++)
+			remove(cache.GetPath(MakeKey(100 + i)).c_str());
+	}
+}
+
+int main()
+{
+	LB::Test::Run("every input is in the key", TestEveryInputIsInTheKey);
+	LB::Test::Run("file round trip", TestFileRoundTrip);
+	LB::Test::Run("misses fall back to compiling", TestMissesFallBackToCompiling);
+	LB::Test::Run("a failed compile is not cached", TestFailedCompileIsNotCached);
+	LB::Test::Run("a warm start doesn't compile", TestWarmStartDoesntCompile);
+
+	return LB::Test::Finish();
+}
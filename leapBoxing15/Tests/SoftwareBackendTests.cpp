@@ -0,0 +1,348 @@
+#include "TestHarness.h"
+
+#include "LBImageFile.h"
+#include "LBRenderer.h"
+#include "LBRenderSnapshot.h"
+#include "LBScene.h"
+#include "LBSceneFile.h"
+#include "LBSoftwareBackend.h"
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace
+{
+	const char *ScenePath = "SoftwareBackendTests.scene";
+	const char *ReferenceName = "SoftwareBackendScene.tga";
+
+	const uint32_t SceneWidth = 160;
+	const uint32_t SceneHeight = 90;
+
+	// Cubes, quads and triangles in three rows going into the distance, turned a
+	// little around two axes so the cube sides show and overlap each other.
+	void WriteFixedScene()
+	{
+		LB::SceneFileWriter writer;
+		const uint32_t meshes[] = { writer.AddMesh("cube"), writer.AddMesh("quad"), writer.AddMesh("triangle") };
+		const uint32_t materials[] = { writer.AddMaterial("shaders.hlsl"), writer.AddMaterial("other.hlsl") };
+
+		for(uint32_t i = 0; i < 18; i++)
+		{
+			LB::SceneFileEntity entity = {};
+			entity.position[0] = static_cast<float>(i % 6) * 1.6f - 4.0f;
+			entity.position[1] = static_cast<float>(i / 6) * 1.4f - 1.4f;
+			entity.position[2] = -6.0f - static_cast<float>(i % 4);
+			entity.scale[0] = entity.scale[1] = entity.scale[2] = 0.8f + 0.1f * static_cast<float>(i % 3);
+			entity.rotation[0] = 0.2f;
+			entity.rotation[1] = 0.3f;
+			entity.rotation[3] = 0.93f;
+			entity.parent = LB::SceneFileNoParent;
+			entity.mesh = meshes[i % 3];
+			entity.material = materials[(i / 3) % 2];
+			entity.flags = (i % 4 == 0) ? static_cast<uint32_t>(LB::SceneFileEntityFlagStatic) : 0u;
+
+			for(int n = 0; n < 3; n++)
+			{
+				entity.boundsMin[n] = entity.position[n] - 1.5f;
+				entity.boundsMax[n] = entity.position[n] + 1.5f;
+			}
+
+			writer.AddEntity(entity);
+		}
+
+		writer.Write(ScenePath);
+	}
+
+	std::vector<uint8_t> RenderFixedScene(int32_t workers)
+	{
+		LB::SoftwareBackend backend(SceneWidth, SceneHeight, 2, workers);
+		LB::Renderer renderer(&backend);
+
+		LB::Scene scene(&renderer, ScenePath);
+		LB::RenderSnapshot snapshot;
+
+		// The second frame replays the static draws from their bundles.
+		for(int i = 0; i < 2; i++)
+		{
+			scene.Extract(snapshot);
+			renderer.Render(snapshot);
+		}
+
+		const uint8_t *image = backend.GetPresentedImage();
+		return std::vector<uint8_t>(image, image + SceneWidth * SceneHeight * 4);
+	}
+
+	bool ReadReference(std::vector<uint8_t> *pixels)
+	{
+		const std::string path = std::string(LB_TEST_DATA_DIRECTORY) + "/" + ReferenceName;
+
+		FILE *file = fopen(path.c_str(), "rb");
+		if(!file)
+			return false;
+
+		std::vector<uint8_t> data;
+		uint8_t buffer[4096];
+		size_t read;
+		while((read = fread(buffer, 1, sizeof(buffer), file)) > 0)
+			data.insert(data.end(), buffer, buffer + read);
+		fclose(file);
+
+		uint32_t width, height;
+		if(!LB::ReadImageFile(data.data(), data.size(), &width, &height, pixels))
+			return false;
+
+		return width == SceneWidth && height == SceneHeight;
+	}
+
+	void WriteImage(const char *path, const std::vector<uint8_t> &pixels)
+	{
+		const std::vector<uint8_t> data = LB::WriteImageFile(SceneWidth, SceneHeight, pixels.data());
+
+		FILE *file = fopen(path, "wb");
+		if(file)
+		{
+			fwrite(data.data(), 1, data.size(), file);
+			fclose(file);
+		}
+	}
+
+	// Compared against the image committed in Tests/Data. Colors may be off by
+	// one where the scalar and SSE paths round differently, coverage may not.
+	// When it doesn't match, the rendered image is written next to the test to
+	// look at, and to replace the reference with if the change was intended.
+	void TestSceneMatchesReference()
+	{
+		WriteFixedScene();
+		const std::vector<uint8_t> image = RenderFixedScene(1);
+
+		std::vector<uint8_t> reference;
+		const bool found = ReadReference(&reference);
+		LB_CHECK(found);
+
+		const bool matches = found && LB::CountDifferentPixels(image.data(), reference.data(), SceneWidth * SceneHeight, 1) == 0;
+		LB_CHECK(matches);
+
+		if(!matches)
+			WriteImage(ReferenceName, image);
+
+		remove(ScenePath);
+	}
+
+	// Tiles are rasterized by whichever thread gets them, the image doesn't
+	// depend on how many there are.
+	void TestImageIsTheSameForAnyThreadCount()
+	{
+		WriteFixedScene();
+
+		const std::vector<uint8_t> single = RenderFixedScene(1);
+		LB_CHECK(RenderFixedScene(2) == single);
+		LB_CHECK(RenderFixedScene(8) == single);
+
+		remove(ScenePath);
+	}
+
+	// Draws straight into the backend with identity matrices, so vertex
+	// positions are in normalized device coordinates.
+	class DrawTarget
+	{
+	public:
+		DrawTarget(uint32_t width, uint32_t height) : _backend(width, height, 2, 4)
+		{
+			_buffer = _backend.CreateBuffer(BufferSize, LB::BufferHeap::Upload, LB::ResourceState::GenericRead);
+			_data = _backend.MapBuffer(_buffer);
+			_address = _backend.GetBufferAddress(_buffer);
+
+			static const float identity[16] = { 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f };
+			memcpy(_data + FrameConstantsOffset, identity, sizeof(identity));
+			memcpy(_data + DrawConstantsOffset, identity, sizeof(identity));
+			memcpy(_data + InstanceOffset, identity, sizeof(identity));
+
+			LB::PipelineDescription description;
+			description.shaderFile = L"shaders.hlsl";
+			_pipelineState = _backend.GetPipelineState(description, nullptr);
+
+			_commandList = _backend.CreateCommandList(LB::BackendQueue::Graphics);
+		}
+
+		~DrawTarget()
+		{
+			_backend.ReleaseResource(_buffer);
+		}
+
+		// Vertices are x, y and z followed by the color, one draw of them with an
+		// optional index buffer on a cleared target.
+		void Draw(uint32_t topology, const std::vector<float> &vertices, const std::vector<uint32_t> &indices)
+		{
+			memcpy(_data + VertexOffset, vertices.data(), vertices.size() * sizeof(float));
+			memcpy(_data + IndexOffset, indices.data(), indices.size() * sizeof(uint32_t));
+
+			const uint32_t vertexSize = sizeof(float) * 7;
+			const uint32_t vertexCount = static_cast<uint32_t>(vertices.size() / 7);
+			const uint32_t indexCount = static_cast<uint32_t>(indices.size());
+
+			const float clearColor[] = { 0.0f, 0.0f, 0.0f, 0.0f };
+
+			_commandList->Begin();
+			_commandList->SetRenderTarget(_backend.GetBackBuffer(_backend.GetBackBufferIndex()), _backend.GetDepthBuffer(), _backend.GetWidth(), _backend.GetHeight());
+			_commandList->ClearRenderTarget(_backend.GetBackBuffer(_backend.GetBackBufferIndex()), clearColor);
+			_commandList->ClearDepthBuffer(_backend.GetDepthBuffer(), 1.0f);
+			_commandList->SetPipelineState(_pipelineState);
+			_commandList->SetPrimitiveTopology(topology);
+			_commandList->SetVertexBuffer(0, { _address + VertexOffset, vertexCount * vertexSize, vertexSize });
+			_commandList->SetVertexBuffer(1, { _address + InstanceOffset, sizeof(float) * 16, sizeof(float) * 16 });
+			_commandList->SetConstantBuffer(LB::ConstantSlotFrame, _address + FrameConstantsOffset);
+			_commandList->SetConstantBuffer(LB::ConstantSlotDraw, _address + DrawConstantsOffset);
+
+			if(indexCount > 0)
+			{
+				_commandList->SetIndexBuffer({ _address + IndexOffset, indexCount * static_cast<uint32_t>(sizeof(uint32_t)), LB::IndexFormat::UInt32 });
+				_commandList->DrawIndexedInstanced(indexCount, 1, 0, 0, 0);
+			}
+			else
+			{
+				_commandList->DrawInstanced(vertexCount, 1, 0, 0);
+			}
+
+			_commandList->Close();
+
+			_backend.ResetRasterizerStatistics();
+			_backend.ExecuteCommandLists(LB::BackendQueue::Graphics, &_commandList, 1);
+			_backend.Present();
+		}
+
+		std::vector<uint8_t> GetImage()
+		{
+			const uint8_t *image = _backend.GetPresentedImage();
+			return std::vector<uint8_t>(image, image + static_cast<size_t>(_backend.GetWidth()) * _backend.GetHeight() * 4);
+		}
+
+		uint32_t GetPixel(uint32_t x, uint32_t y)
+		{
+			uint32_t pixel;
+			memcpy(&pixel, _backend.GetPresentedImage() + (static_cast<size_t>(y) * _backend.GetWidth() + x) * 4, sizeof(pixel));
+			return pixel;
+		}
+
+		const LB::TileRasterizerStatistics &GetStatistics() const { return _backend.GetRasterizerStatistics(); }
+
+	private:
+		static const uint32_t FrameConstantsOffset = 0;
+		static const uint32_t DrawConstantsOffset = 256;
+		static const uint32_t InstanceOffset = 512;
+		static const uint32_t VertexOffset = 1024;
+		static const uint32_t IndexOffset = 4096;
+		static const uint32_t BufferSize = 8192;
+
+		LB::SoftwareBackend _backend;
+		const void *_buffer;
+		uint8_t *_data;
+		uint64_t _address;
+		const void *_pipelineState;
+		LB::RenderCommandList *_commandList;
+	};
+
+	// Pixel edges of the target in normalized device coordinates.
+	float ToDeviceX(uint32_t x, uint32_t width)
+	{
+		return static_cast<float>(x) / width * 2.0f - 1.0f;
+	}
+
+	float ToDeviceY(uint32_t y, uint32_t height)
+	{
+		return 1.0f - static_cast<float>(y) / height * 2.0f;
+	}
+
+	void AddVertex(std::vector<float> &vertices, float x, float y, const float color[4])
+	{
+		const float vertex[] = { x, y, 0.5f, color[0], color[1], color[2], color[3] };
+		vertices.insert(vertices.end(), vertex, vertex + 7);
+	}
+
+	// Corners in strip order: top left, top right, bottom left, bottom right.
+	std::vector<float> MakeQuadStrip(float left, float top, float right, float bottom, const float color[4])
+	{
+		std::vector<float> vertices;
+		AddVertex(vertices, left, top, color);
+		AddVertex(vertices, right, top, color);
+		AddVertex(vertices, left, bottom, color);
+		AddVertex(vertices, right, bottom, color);
+		return vertices;
+	}
+
+	// A strip, the same two triangles as a list and as an indexed list draw the
+	// same pixels.
+	void TestStripAndListMatch()
+	{
+		DrawTarget target(150, 100);
+		const float color[] = { 1.0f, 0.5f, 0.25f, 1.0f };
+		const std::vector<float> strip = MakeQuadStrip(-0.7f, 0.6f, 0.5f, -0.8f, color);
+
+		target.Draw(LB::PrimitiveTopology::TriangleStrip, strip, {});
+		const std::vector<uint8_t> stripImage = target.GetImage();
+		const uint64_t stripPixels = target.GetStatistics().pixelsWritten;
+		LB_CHECK(stripPixels > 0);
+		LB_CHECK(target.GetStatistics().trianglesCulled == 0);
+
+		std::vector<float> list;
+		const uint32_t order[] = { 0, 1, 2, 2, 1, 3 };
+		for(uint32_t vertex : order)
+			list.insert(list.end(), strip.begin() + vertex * 7, strip.begin() + (vertex + 1) * 7);
+
+		target.Draw(LB::PrimitiveTopology::TriangleList, list, {});
+		LB_CHECK(target.GetImage() == stripImage);
+		LB_CHECK(target.GetStatistics().pixelsWritten == stripPixels);
+
+		target.Draw(LB::PrimitiveTopology::TriangleList, strip, { 0, 1, 2, 2, 1, 3 });
+		LB_CHECK(target.GetImage() == stripImage);
+
+		// An indexed strip as well.
+		target.Draw(LB::PrimitiveTopology::TriangleStrip, strip, { 0, 1, 2, 3 });
+		LB_CHECK(target.GetImage() == stripImage);
+	}
+
+	// Shared edges are drawn once, also where they cross tiles, and rectangles
+	// ending on a tile border cover exactly the pixels up to it. The target
+	// isn't a multiple of the tile size, so the last tiles are partial.
+	void TestTileEdges()
+	{
+		const uint32_t width = LB::TileRasterizer::TileSize * 2 + 30;
+		const uint32_t height = LB::TileRasterizer::TileSize + 20;
+		DrawTarget target(width, height);
+		const float color[] = { 0.0f, 1.0f, 0.0f, 1.0f };
+		const uint32_t packed = LB::TileRasterizer::PackColor(color);
+
+		target.Draw(LB::PrimitiveTopology::TriangleStrip, MakeQuadStrip(-1.0f, 1.0f, 1.0f, -1.0f, color), {});
+		LB_CHECK(target.GetStatistics().pixelsWritten == width * height);
+
+		bool covered = true;
+		for(uint32_t y = 0; y < height; y++)
+		{
+			for(uint32_t x = 0; x < width; x++)
+				covered = covered && target.GetPixel(x, y) == packed;
+		}
+		LB_CHECK(covered);
+
+		// The middle tile column, from the top to the border of the first row.
+		const uint32_t tile = LB::TileRasterizer::TileSize;
+		target.Draw(LB::PrimitiveTopology::TriangleStrip, MakeQuadStrip(ToDeviceX(tile, width), ToDeviceY(0, height), ToDeviceX(tile * 2, width), ToDeviceY(tile, height), color), {});
+		LB_CHECK(target.GetStatistics().pixelsWritten == tile * tile);
+
+		LB_CHECK(target.GetPixel(tile - 1, 0) == 0);
+		LB_CHECK(target.GetPixel(tile, 0) == packed);
+		LB_CHECK(target.GetPixel(tile * 2 - 1, tile - 1) == packed);
+		LB_CHECK(target.GetPixel(tile * 2, tile - 1) == 0);
+		LB_CHECK(target.GetPixel(tile, tile) == 0);
+	}
+}
+
+int main()
+{
+	LB::Test::Run("scene matches the reference image", TestSceneMatchesReference);
+	LB::Test::Run("image is the same for any thread count", TestImageIsTheSameForAnyThreadCount);
+	LB::Test::Run("strips and lists draw the same pixels", TestStripAndListMatch);
+	LB::Test::Run("tile edges are drawn once", TestTileEdges);
+
+	return LB::Test::Finish();
+}
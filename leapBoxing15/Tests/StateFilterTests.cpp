@@ -0,0 +1,182 @@
+#include "TestHarness.h"
+
+#include "LBCommandEncoder.h"
+#include "LBRenderBackend.h"
+
+#include <vector>
+
+namespace
+{
+	std::vector<LB::EncodedCommandType> GetTypes(const LB::RecordingCommandEncoder &encoder)
+	{
+		std::vector<LB::EncodedCommandType> types;
+		for(const LB::EncodedCommand &command : encoder.GetCommands())
+			types.push_back(command.type);
+
+		return types;
+	}
+
+	// Two draws with the same state, the second one only issues the draw.
+	void TestRepeatedStateIsSkipped()
+	{
+		LB::RecordingCommandEncoder encoder;
+		LB::StateFilter filter(&encoder);
+
+		int pipeline = 0;
+		const LB::VertexBufferBinding vertices = { 0x1000, 256, 28 };
+		const LB::VertexBufferBinding instances = { 0x2000, 1024, 64 };
+		const LB::IndexBufferBinding indices = { 0x3000, 72, LB::IndexFormat::UInt32 };
+
+		for(int i = 0; i < 2; i++)
+		{
+			filter.SetPipelineState(&pipeline);
+			filter.SetPrimitiveTopology(LB::PrimitiveTopology::TriangleList);
+			filter.SetVertexBuffer(0, vertices);
+			filter.SetVertexBuffer(1, instances);
+			filter.SetIndexBuffer(indices);
+			filter.SetConstantBuffer(LB::ConstantSlotFrame, 0x4000);
+			filter.SetConstantBuffer(LB::ConstantSlotDraw, 0x4100);
+			filter.DrawIndexedInstanced(36, 4, 0, 0, static_cast<uint32_t>(i) * 4);
+		}
+
+		const std::vector<LB::EncodedCommandType> expected = {
+			LB::EncodedCommandType::SetPipelineState,
+			LB::EncodedCommandType::SetPrimitiveTopology,
+			LB::EncodedCommandType::SetVertexBuffer,
+			LB::EncodedCommandType::SetVertexBuffer,
+			LB::EncodedCommandType::SetIndexBuffer,
+			LB::EncodedCommandType::SetConstantBuffer,
+			LB::EncodedCommandType::SetConstantBuffer,
+			LB::EncodedCommandType::DrawIndexedInstanced,
+			LB::EncodedCommandType::DrawIndexedInstanced
+		};
+		LB_CHECK(GetTypes(encoder) == expected);
+
+		// Draws go through with their own arguments.
+		LB_CHECK(encoder.GetCommands().back().arguments[4] == 4);
+
+		const LB::CommandEncoderStatistics &statistics = filter.GetStatistics();
+		LB_CHECK(statistics.stateChangesIssued == 7);
+		LB_CHECK(statistics.stateChangesSkipped == 7);
+		LB_CHECK(statistics.draws == 2);
+	}
+
+	// A changed value is issued, and so is going back to the one before.
+	void TestChangesAreIssued()
+	{
+		LB::RecordingCommandEncoder encoder;
+		LB::StateFilter filter(&encoder);
+
+		int pipelines[2];
+		filter.SetPipelineState(&pipelines[0]);
+		filter.SetPipelineState(&pipelines[1]);
+		filter.SetPipelineState(&pipelines[0]);
+		filter.SetPipelineState(&pipelines[0]);
+
+		filter.SetPrimitiveTopology(LB::PrimitiveTopology::TriangleList);
+		filter.SetPrimitiveTopology(LB::PrimitiveTopology::TriangleStrip);
+
+		filter.SetConstantBuffer(LB::ConstantSlotDraw, 0x100);
+		filter.SetConstantBuffer(LB::ConstantSlotDraw, 0x200);
+		filter.SetConstantBuffer(LB::ConstantSlotDraw, 0x100);
+
+		const std::vector<LB::EncodedCommand> &commands = encoder.GetCommands();
+		LB_CHECK(commands.size() == 8);
+		LB_CHECK(commands[0].pipelineState == &pipelines[0]);
+		LB_CHECK(commands[1].pipelineState == &pipelines[1]);
+		LB_CHECK(commands[2].pipelineState == &pipelines[0]);
+		LB_CHECK(commands[4].arguments[0] == LB::PrimitiveTopology::TriangleStrip);
+		LB_CHECK(commands[7].location == 0x100);
+
+		LB_CHECK(filter.GetStatistics().stateChangesIssued == 8);
+		LB_CHECK(filter.GetStatistics().stateChangesSkipped == 1);
+	}
+
+	// Any field of a binding differing makes it a different one, slots and root
+	// parameters are tracked separately.
+	void TestBindingsCompareEveryField()
+	{
+		LB::RecordingCommandEncoder encoder;
+		LB::StateFilter filter(&encoder);
+
+		const LB::VertexBufferBinding vertices = { 0x1000, 256, 28 };
+		filter.SetVertexBuffer(0, vertices);
+		filter.SetVertexBuffer(1, vertices);
+		filter.SetVertexBuffer(0, { 0x1000, 512, 28 });
+		filter.SetVertexBuffer(0, { 0x1000, 512, 32 });
+		filter.SetVertexBuffer(0, { 0x1000, 512, 32 });
+
+		const LB::IndexBufferBinding indices = { 0x3000, 72, LB::IndexFormat::UInt32 };
+		filter.SetIndexBuffer(indices);
+		filter.SetIndexBuffer({ 0x3000, 72, LB::IndexFormat::UInt16 });
+		filter.SetIndexBuffer({ 0x3000, 72, LB::IndexFormat::UInt16 });
+
+		filter.SetConstantBuffer(LB::ConstantSlotFrame, 0x100);
+		filter.SetConstantBuffer(LB::ConstantSlotDraw, 0x100);
+
+		LB_CHECK(encoder.GetCommands().size() == 8);
+		LB_CHECK(encoder.GetCommands()[1].arguments[0] == 1);
+		LB_CHECK(filter.GetStatistics().stateChangesSkipped == 2);
+	}
+
+	// Unset state is issued even when it matches the zeroed value remembered,
+	// and after Reset or Invalidate everything is issued again.
+	void TestResetForgetsTheState()
+	{
+		LB::RecordingCommandEncoder encoder;
+		LB::StateFilter filter(&encoder);
+
+		filter.SetPipelineState(nullptr);
+		filter.SetPrimitiveTopology(0);
+		filter.SetConstantBuffer(LB::ConstantSlotFrame, 0);
+		LB_CHECK(encoder.GetCommands().size() == 3);
+
+		filter.Invalidate();
+		filter.SetPipelineState(nullptr);
+		LB_CHECK(encoder.GetCommands().size() == 4);
+		LB_CHECK(filter.GetStatistics().stateChangesIssued == 4);
+
+		filter.Reset();
+		LB_CHECK(filter.GetStatistics().stateChangesIssued == 0);
+
+		filter.SetPrimitiveTopology(0);
+		filter.SetPrimitiveTopology(0);
+		LB_CHECK(encoder.GetCommands().size() == 5);
+		LB_CHECK(filter.GetStatistics().stateChangesIssued == 1);
+		LB_CHECK(filter.GetStatistics().stateChangesSkipped == 1);
+	}
+
+	// Moving the filter to another command list on Reset, as the recording
+	// threads do, issues the state into the new one.
+	void TestNewTargetGetsTheState()
+	{
+		LB::RecordingCommandEncoder first;
+		LB::RecordingCommandEncoder second;
+		LB::StateFilter filter(&first);
+
+		int pipeline = 0;
+		filter.SetPipelineState(&pipeline);
+		filter.DrawInstanced(3, 1, 0, 0);
+
+		filter.SetTarget(&second);
+		filter.Reset();
+		filter.SetPipelineState(&pipeline);
+		filter.DrawInstanced(3, 1, 0, 0);
+
+		LB_CHECK(first.GetCommands().size() == 2);
+		LB_CHECK(second.GetCommands().size() == 2);
+		LB_CHECK(second.GetCommands()[0].pipelineState == &pipeline);
+		LB_CHECK(filter.GetStatistics().draws == 1);
+	}
+}
+
+int main()
+{
+	LB::Test::Run("repeated state is skipped", TestRepeatedStateIsSkipped);
+	LB::Test::Run("changes are issued", TestChangesAreIssued);
+	LB::Test::Run("bindings compare every field", TestBindingsCompareEveryField);
+	LB::Test::Run("reset forgets the state", TestResetForgetsTheState);
+	LB::Test::Run("a new target gets the state", TestNewTargetGetsTheState);
+
+	return LB::Test::Finish();
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstdio>
+#include <exception>
+
+// Tests of the portable parts of the engine, built by CMakeLists.txt next to
+// the solution. Every file is one executable running its tests in order. A
+// failed check is printed and counted, the test goes on, and main returns
+// non-zero if anything failed.
+namespace LB
+{
+	namespace Test
+	{
+		inline int &GetFailureCount()
+		{
+			static int failures = 0;
+			return failures;
+		}
+
+		inline void Fail(const char *file, int line, const char *expression)
+		{
+			printf("%s:%d: check failed: %s\n", file, line, expression);
+			GetFailureCount()++;
+		}
+
+		// An exception escaping the test counts as a failure.
+		template<typename Function>
+		void Run(const char *name, Function test)
+		{
+			const int failures = GetFailureCount();
+
+			try
+			{
+				test();
+			}
+			catch(std::exception &e)
+			{
+				printf("%s: unexpected exception: %s\n", name, e.what());
+				GetFailureCount()++;
+			}
+
+			printf("%s %s\n", (GetFailureCount() == failures) ? "PASS" : "FAIL", name);
+		}
+
+		inline int Finish()
+		{
+			printf("%d failed checks\n", GetFailureCount());
+			return (GetFailureCount() > 0) ? 1 : 0;
+		}
+	}
+}
+
+#define LB_CHECK(expression) \
+	do { if(!(expression)) LB::Test::Fail(__FILE__, __LINE__, #expression); } while(0)
+
+#define LB_CHECK_THROWS(expression, exception) \
+	do { bool thrown = false; try { expression; } catch(const exception &) { thrown = true; } if(!thrown) LB::Test::Fail(__FILE__, __LINE__, #expression " throws " #exception); } while(0)
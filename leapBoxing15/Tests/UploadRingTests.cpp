@@ -0,0 +1,144 @@
+#include "TestHarness.h"
+
+#include "LBUploadRing.h"
+
+namespace
+{
+	// Stands in for a GPU fence, the test decides when work completes.
+	struct FakeFence
+	{
+		uint64_t signaled = 0;
+		uint64_t completed = 0;
+
+		uint64_t Signal() { return ++signaled; }
+		void Complete(uint64_t value) { completed = value; }
+	};
+
+	void TestAlignment()
+	{
+		LB::UploadRing ring(1024);
+
+		LB_CHECK(ring.Allocate(10, 1) == 0);
+		LB_CHECK(ring.Allocate(16, 16) == 16);
+		LB_CHECK(ring.Allocate(1, 256) == 256);
+
+		// Padding counts as used.
+		LB_CHECK(ring.GetUsedSize() == 257);
+		LB_CHECK(ring.GetStatistics().bytesAllocated == 27);
+	}
+
+	void TestReclaimOnFence()
+	{
+		LB::UploadRing ring(256);
+		FakeFence fence;
+
+		ring.Allocate(100, 4);
+		const uint64_t first = fence.Signal();
+		ring.FinishBatch(first);
+
+		ring.Allocate(100, 4);
+		const uint64_t second = fence.Signal();
+		ring.FinishBatch(second);
+
+		LB_CHECK(ring.HasPendingBatches());
+		LB_CHECK(ring.GetOldestPendingFence() == first);
+
+		// Nothing completed yet.
+		ring.Reclaim(fence.completed);
+		LB_CHECK(ring.GetUsedSize() == 200);
+
+		fence.Complete(first);
+		ring.Reclaim(fence.completed);
+		LB_CHECK(ring.GetUsedSize() == 100);
+		LB_CHECK(ring.GetOldestPendingFence() == second);
+
+		fence.Complete(second);
+		ring.Reclaim(fence.completed);
+		LB_CHECK(ring.GetUsedSize() == 0);
+		LB_CHECK(!ring.HasPendingBatches());
+		LB_CHECK(ring.GetOldestPendingFence() == 0);
+	}
+
+	void TestEmptyBatchesAreNotRecorded()
+	{
+		LB::UploadRing ring(256);
+
+		ring.FinishBatch(1);
+		LB_CHECK(!ring.HasPendingBatches());
+
+		ring.Allocate(8, 1);
+		ring.FinishBatch(2);
+		ring.FinishBatch(3);
+		LB_CHECK(ring.GetOldestPendingFence() == 2);
+
+		ring.Reclaim(2);
+		LB_CHECK(!ring.HasPendingBatches());
+	}
+
+	void TestWraparound()
+	{
+		LB::UploadRing ring(256);
+		FakeFence fence;
+
+		LB_CHECK(ring.Allocate(96, 16) == 0);
+		ring.FinishBatch(fence.Signal());
+		LB_CHECK(ring.Allocate(96, 16) == 96);
+		ring.FinishBatch(fence.Signal());
+
+		fence.Complete(1);
+		ring.Reclaim(fence.completed);
+
+		// 64 bytes left at the end, the allocation starts over at the front and the
+		// end is skipped instead of splitting it.
+		LB_CHECK(ring.Allocate(80, 16) == 0);
+		LB_CHECK(ring.GetStatistics().wrapPadding == 64);
+		LB_CHECK(ring.GetUsedSize() == 96 + 64 + 80);
+		ring.FinishBatch(fence.Signal());
+
+		// The skipped end belongs to the batch that wrapped and stays in use with it.
+		fence.Complete(2);
+		ring.Reclaim(fence.completed);
+		LB_CHECK(ring.GetUsedSize() == 64 + 80);
+		LB_CHECK(ring.Allocate(112, 16) == 80);
+		LB_CHECK(ring.Allocate(16, 16) == LB::UploadRing::InvalidOffset);
+	}
+
+	void TestFullRing()
+	{
+		LB::UploadRing ring(256);
+		FakeFence fence;
+
+		LB_CHECK(ring.Allocate(200, 16) == 0);
+		ring.FinishBatch(fence.Signal());
+
+		// Neither the rest at the end nor the front are free yet.
+		LB_CHECK(ring.Allocate(64, 16) == LB::UploadRing::InvalidOffset);
+		LB_CHECK(ring.Allocate(0, 16) == LB::UploadRing::InvalidOffset);
+		LB_CHECK(ring.Allocate(257, 1) == LB::UploadRing::InvalidOffset);
+		LB_CHECK(ring.GetStatistics().failedAllocations == 3);
+
+		// What the caller does when the ring is full: wait for the oldest batch.
+		fence.Complete(ring.GetOldestPendingFence());
+		ring.Reclaim(fence.completed);
+		LB_CHECK(ring.Allocate(64, 16) == 0);
+
+		// The whole ring at once works once it is empty, wherever the last
+		// allocation ended.
+		ring.FinishBatch(fence.Signal());
+		fence.Complete(fence.signaled);
+		ring.Reclaim(fence.completed);
+		LB_CHECK(ring.Allocate(256, 1) == 0);
+		LB_CHECK(ring.GetStatistics().highWaterMark == 256);
+	}
+}
+
+int main()
+{
+	LB::Test::Run("allocations are aligned", TestAlignment);
+	LB::Test::Run("batches are reclaimed when their fence completes", TestReclaimOnFence);
+	LB::Test::Run("empty batches are not recorded", TestEmptyBatchesAreNotRecorded);
+	LB::Test::Run("allocations wrap around instead of straddling the end", TestWraparound);
+	LB::Test::Run("full ring fails until the oldest batch completes", TestFullRing);
+
+	return LB::Test::Finish();
+}
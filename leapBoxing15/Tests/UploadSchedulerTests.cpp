@@ -0,0 +1,147 @@
+#include "TestHarness.h"
+
+#include "LBUploadScheduler.h"
+
+#include <deque>
+
+namespace
+{
+	// A copy queue executing its batches in order, the test decides when the
+	// next one finishes. Wait stands in for blocking on the fence.
+	struct SimulatedCopyQueue
+	{
+		std::deque<uint64_t> pending;
+		uint64_t completed = 0;
+
+		void Signal(uint64_t value)
+		{
+			if(value > 0)
+				pending.push_back(value);
+		}
+
+		void CompleteNext()
+		{
+			if(pending.empty())
+				return;
+
+			completed = pending.front();
+			pending.pop_front();
+		}
+
+		void Wait(uint64_t value)
+		{
+			while(completed < value && !pending.empty())
+				CompleteNext();
+		}
+	};
+
+	void TestTicketsFollowTheBatches()
+	{
+		LB::UploadScheduler scheduler;
+		LB_CHECK(!scheduler.HasOpenBatch());
+		LB_CHECK(scheduler.Submit() == 0);
+
+		const LB::UploadTicket a = scheduler.Enqueue();
+		const LB::UploadTicket b = scheduler.Enqueue();
+		LB_CHECK(a == b);
+		LB_CHECK(scheduler.HasOpenBatch());
+		LB_CHECK(!scheduler.IsSubmitted(a));
+
+		LB_CHECK(scheduler.Submit() == a);
+		LB_CHECK(scheduler.IsSubmitted(a));
+		LB_CHECK(!scheduler.HasOpenBatch());
+
+		const LB::UploadTicket c = scheduler.Enqueue();
+		LB_CHECK(c == a + 1);
+		LB_CHECK(scheduler.Submit() == c);
+		LB_CHECK(scheduler.GetSubmittedValue() == c);
+
+		LB_CHECK(scheduler.GetStatistics().tickets == 3);
+		LB_CHECK(scheduler.GetStatistics().batches == 2);
+	}
+
+	void TestPolling()
+	{
+		LB::UploadScheduler scheduler;
+		SimulatedCopyQueue queue;
+
+		const LB::UploadTicket a = scheduler.Enqueue();
+		queue.Signal(scheduler.Submit());
+		const LB::UploadTicket b = scheduler.Enqueue();
+		queue.Signal(scheduler.Submit());
+
+		LB_CHECK(!scheduler.IsComplete(a, queue.completed));
+
+		queue.CompleteNext();
+		LB_CHECK(scheduler.IsComplete(a, queue.completed));
+		LB_CHECK(!scheduler.IsComplete(b, queue.completed));
+
+		queue.CompleteNext();
+		LB_CHECK(scheduler.IsComplete(b, queue.completed));
+
+		// No ticket means no upload.
+		LB_CHECK(scheduler.IsComplete(0, 0));
+	}
+
+	void TestWaiting()
+	{
+		LB::UploadScheduler scheduler;
+		SimulatedCopyQueue queue;
+
+		LB::UploadTicket tickets[3];
+		for(LB::UploadTicket &ticket : tickets)
+		{
+			ticket = scheduler.Enqueue();
+			queue.Signal(scheduler.Submit());
+		}
+
+		// Waiting for the middle one completes everything before it.
+		queue.Wait(tickets[1]);
+		LB_CHECK(scheduler.IsComplete(tickets[0], queue.completed));
+		LB_CHECK(scheduler.IsComplete(tickets[1], queue.completed));
+		LB_CHECK(!scheduler.IsComplete(tickets[2], queue.completed));
+		LB_CHECK(queue.pending.size() == 1);
+	}
+
+	void TestFirstUseWaits()
+	{
+		LB::UploadScheduler scheduler;
+		SimulatedCopyQueue queue;
+
+		const LB::UploadTicket a = scheduler.Enqueue();
+		queue.Signal(scheduler.Submit());
+		const LB::UploadTicket b = scheduler.Enqueue();
+		queue.Signal(scheduler.Submit());
+
+		// The first use of the newest ticket waits, that wait covers the older one.
+		LB_CHECK(scheduler.RequireForGraphics(b, queue.completed) == b);
+		LB_CHECK(scheduler.RequireForGraphics(a, queue.completed) == 0);
+		LB_CHECK(scheduler.RequireForGraphics(b, queue.completed) == 0);
+
+		// Already complete, no wait.
+		const LB::UploadTicket c = scheduler.Enqueue();
+		queue.Signal(scheduler.Submit());
+		queue.Wait(c);
+		LB_CHECK(scheduler.RequireForGraphics(c, queue.completed) == 0);
+
+		// Resources without an upload never wait.
+		LB_CHECK(scheduler.RequireForGraphics(0, queue.completed) == 0);
+
+		const LB::UploadTicket d = scheduler.Enqueue();
+		queue.Signal(scheduler.Submit());
+		LB_CHECK(scheduler.RequireForGraphics(d, queue.completed) == d);
+
+		LB_CHECK(scheduler.GetStatistics().graphicsWaits == 2);
+		LB_CHECK(scheduler.GetStatistics().graphicsWaitsSkipped == 4);
+	}
+}
+
+int main()
+{
+	LB::Test::Run("tickets follow the batches", TestTicketsFollowTheBatches);
+	LB::Test::Run("tickets complete with their batch", TestPolling);
+	LB::Test::Run("waiting for a ticket completes the older ones", TestWaiting);
+	LB::Test::Run("graphics waits once for the newest ticket", TestFirstUseWaits);
+
+	return LB::Test::Finish();
+}
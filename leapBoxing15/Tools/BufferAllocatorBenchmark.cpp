@@ -0,0 +1,99 @@
+//
+//  BufferAllocatorBenchmark.cpp
+//  leapBoxing15
+//
+//  Measures allocation and free throughput of the buffer allocator under mesh
+//  like churn and how fragmented the pages end up, then how many moves it takes
+//  to compact them again. Sizes are spread evenly on a log scale.
+//
+
+#include "LBBufferAllocator.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+namespace
+{
+	const uint64_t PageSize = 32 * 1024 * 1024;
+	const uint64_t Granularity = 16;
+
+	void PrintStatistics(const char *label, const LB::BufferAllocatorStatistics &statistics)
+	{
+		printf("%s: %u pages, %u allocations, %.1f of %.1f MB used, %u free blocks, largest %.1f MB, fragmentation %.3f\n", label,
+			statistics.pages, statistics.allocations,
+			statistics.usedBytes / (1024.0 * 1024.0), statistics.reservedBytes / (1024.0 * 1024.0),
+			statistics.freeBlocks, statistics.largestFreeBlock / (1024.0 * 1024.0), statistics.fragmentation);
+	}
+}
+
+int main(int argc, char **argv)
+{
+	const uint32_t liveCount = (argc > 1) ? static_cast<uint32_t>(strtoul(argv[1], nullptr, 10)) : 20000;
+	const uint32_t operations = (argc > 2) ? static_cast<uint32_t>(strtoul(argv[2], nullptr, 10)) : 1000000;
+
+	if(liveCount == 0)
+	{
+		printf("Usage: bufferallocatorbenchmark [live allocations] [operations]\n");
+		return 1;
+	}
+
+	std::mt19937 random(1234);
+	std::uniform_real_distribution<double> logSize(std::log(256.0), std::log(256.0 * 1024.0));
+	std::uniform_int_distribution<uint32_t> pick(0, liveCount - 1);
+
+	// Pregenerated, so only the allocator is timed.
+	std::vector<uint64_t> sizes(liveCount + operations);
+	for(uint64_t &size : sizes)
+		size = static_cast<uint64_t>(std::exp(logSize(random)));
+
+	std::vector<uint32_t> victims(operations);
+	for(uint32_t &victim : victims)
+		victim = pick(random);
+
+	LB::BufferAllocator allocator(PageSize, Granularity);
+	std::vector<LB::BufferAllocation> allocations(liveCount);
+
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	for(uint32_t i = 0; i < liveCount; i++)
+		allocations[i] = allocator.Allocate(sizes[i], nullptr);
+	const double fillMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+	PrintStatistics("Filled", allocator.GetStatistics());
+
+	// Steady state, every operation frees a random allocation and replaces it.
+	start = std::chrono::high_resolution_clock::now();
+	for(uint32_t i = 0; i < operations; i++)
+	{
+		LB::BufferAllocation &allocation = allocations[victims[i]];
+		allocator.Free(allocation);
+		allocation = allocator.Allocate(sizes[liveCount + i], nullptr);
+	}
+	const double churnMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+	PrintStatistics("After churn", allocator.GetStatistics());
+
+	// Compaction, handles stay valid so the allocations don't have to be updated.
+	std::vector<LB::BufferMove> moves;
+	uint64_t bytesMoved = 0;
+	uint32_t passes = 0;
+
+	start = std::chrono::high_resolution_clock::now();
+	while(allocator.Defragment(1024, moves) > 0)
+		passes++;
+	const double defragmentMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+	for(const LB::BufferMove &move : moves)
+		bytesMoved += move.from.size;
+
+	PrintStatistics("Defragmented", allocator.GetStatistics());
+
+	printf("Fill: %u allocations in %.3f ms, %.1f ns each\n", liveCount, fillMilliseconds, fillMilliseconds * 1e6 / liveCount);
+	printf("Churn: %u free + allocate pairs in %.3f ms, %.1f ns per pair\n", operations, churnMilliseconds, churnMilliseconds * 1e6 / operations);
+	printf("Defragment: %u moves, %.1f MB in %u passes of up to 1024 moves, %.3f ms\n", static_cast<uint32_t>(moves.size()), bytesMoved / (1024.0 * 1024.0), passes, defragmentMilliseconds);
+
+	return 0;
+}
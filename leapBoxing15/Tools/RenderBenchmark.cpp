@@ -0,0 +1,236 @@
+//
+//  RenderBenchmark.cpp
+//  leapBoxing15
+//
+//  Measures the CPU side of a frame with the headless backend, on any platform.
+//  A synthetic scene of the given size is loaded and rendered, the averages of
+//  the renderer's timings over all frames but the first are printed. With the
+//  software backend the frames are also rasterized, and the rasterizer's time
+//  and overdraw are printed as well. A thread sweep renders the scene again
+//  with 1 up to the given number of worker threads, to see how sorting,
+//  instance writes and recording scale. The threaded run extracts on a
+//  simulation thread through the snapshot buffer as the application does, and
+//  is compared to extracting and rendering one after the other.
+//
+
+#include "LBHeadlessBackend.h"
+#include "LBRenderer.h"
+#include "LBRenderSnapshot.h"
+#include "LBScene.h"
+#include "LBSceneFile.h"
+#include "LBSoftwareBackend.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <atomic>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+	const char *ScenePath = "RenderBenchmark.scene";
+
+	// Every material is a pipeline state of its own, with more of them there are
+	// more draws to record.
+	void WriteScene(uint32_t count, uint32_t staticPercent, uint32_t materialCount)
+	{
+		LB::SceneFileWriter writer;
+		const uint32_t meshes[] = { writer.AddMesh("cube"), writer.AddMesh("quad"), writer.AddMesh("triangle") };
+
+		std::vector<uint32_t> materials = { writer.AddMaterial("shaders.hlsl"), writer.AddMaterial("other.hlsl") };
+		for(uint32_t i = 2; i < materialCount; i++)
+			materials.push_back(writer.AddMaterial(("material" + std::to_string(i) + ".hlsl").c_str()));
+
+		for(uint32_t i = 0; i < count; i++)
+		{
+			LB::SceneFileEntity entity = {};
+			entity.position[0] = static_cast<float>(i % 100) * 3.0f - 150.0f;
+			entity.position[1] = static_cast<float>((i / 100) % 100) * 3.0f - 150.0f;
+			entity.position[2] = -10.0f - static_cast<float>(i / 10000) * 3.0f;
+			entity.scale[0] = entity.scale[1] = entity.scale[2] = 1.0f;
+			entity.rotation[3] = 1.0f;
+			entity.parent = LB::SceneFileNoParent;
+			entity.mesh = meshes[i % 3];
+			entity.material = materials[(i / 3) % materialCount];
+			entity.flags = (i % 100 < staticPercent) ? static_cast<uint32_t>(LB::SceneFileEntityFlagStatic) : 0u;
+
+			for(int n = 0; n < 3; n++)
+			{
+				entity.boundsMin[n] = entity.position[n] - 1.0f;
+				entity.boundsMax[n] = entity.position[n] + 1.0f;
+			}
+
+			writer.AddEntity(entity);
+		}
+
+		writer.Write(ScenePath);
+	}
+
+	// Averages over all frames but the first.
+	struct Timings
+	{
+		double extract;
+		double sort;
+		double instances;
+		double record;
+		double frame;
+		double raster;
+		double overdraw;
+	};
+
+	Timings RenderScene(uint32_t frames, uint32_t workerThreads, bool software, LB::RendererStatistics *statistics)
+	{
+		LB::SoftwareBackend *softwareBackend = software ? new LB::SoftwareBackend(1280, 720) : nullptr;
+		std::unique_ptr<LB::HeadlessBackend> backend(software ? softwareBackend : new LB::HeadlessBackend(1280, 720));
+
+		LB::RendererSettings settings;
+		settings.workerThreads = workerThreads;
+
+		LB::Renderer renderer(backend.get(), settings);
+		LB::Scene scene(&renderer, ScenePath);
+		LB::RenderSnapshot snapshot;
+
+		Timings timings = {};
+		for(uint32_t i = 0; i < frames; i++)
+		{
+			std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+
+			scene.Extract(snapshot);
+			renderer.Render(snapshot);
+
+			const double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+			// The first frame uploads the meshes and records the bundles.
+			if(i == 0)
+			{
+				if(softwareBackend)
+					softwareBackend->ResetRasterizerStatistics();
+				continue;
+			}
+
+			if(softwareBackend)
+				timings.overdraw += softwareBackend->GetOverdraw();
+
+			const LB::RendererStatistics &frameStatistics = renderer.GetStatistics();
+			timings.extract += snapshot.extractMilliseconds;
+			timings.sort += frameStatistics.sortMilliseconds;
+			timings.record += frameStatistics.recordMilliseconds;
+			timings.instances += frameStatistics.instanceWriteMilliseconds;
+			timings.frame += milliseconds;
+		}
+
+		if(softwareBackend)
+			timings.raster = softwareBackend->GetRasterizerStatistics().rasterMilliseconds;
+
+		const double measured = frames - 1;
+		timings.extract /= measured;
+		timings.sort /= measured;
+		timings.instances /= measured;
+		timings.record /= measured;
+		timings.frame /= measured;
+		timings.raster /= measured;
+		timings.overdraw /= measured;
+
+		*statistics = renderer.GetStatistics();
+		return timings;
+	}
+
+	// Milliseconds per frame over all frames but the first, with the simulation
+	// extracting frame N+1 while frame N is rendered.
+	double RenderSceneThreaded(uint32_t frames, bool software, uint64_t *publishWaits)
+	{
+		std::unique_ptr<LB::HeadlessBackend> backend(software ? new LB::SoftwareBackend(1280, 720) : new LB::HeadlessBackend(1280, 720));
+		LB::Renderer renderer(backend.get());
+		LB::Scene scene(&renderer, ScenePath);
+
+		LB::RenderSnapshotBuffer snapshots;
+		std::atomic<bool> running(true);
+
+		std::thread simulation([&]() {
+			while(running)
+			{
+				scene.Update(0.0f);
+				scene.Extract(snapshots.BeginWrite());
+				snapshots.Publish();
+			}
+		});
+
+		std::chrono::high_resolution_clock::time_point start;
+		for(uint32_t i = 0; i < frames; i++)
+		{
+			const LB::RenderSnapshot *snapshot = snapshots.Acquire(1000);
+			if(!snapshot)
+				break;
+
+			renderer.Render(*snapshot);
+			snapshots.Release();
+
+			if(i == 0)
+				start = std::chrono::high_resolution_clock::now();
+		}
+
+		const double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+		running = false;
+		snapshots.Shutdown();
+		simulation.join();
+
+		*publishWaits = snapshots.GetPublishWaits();
+		return milliseconds / (frames - 1);
+	}
+}
+
+int main(int argc, char **argv)
+{
+	const uint32_t count = (argc > 1) ? static_cast<uint32_t>(strtoul(argv[1], nullptr, 10)) : 100000;
+	const uint32_t frames = (argc > 2) ? static_cast<uint32_t>(strtoul(argv[2], nullptr, 10)) : 50;
+	const uint32_t staticPercent = (argc > 3) ? static_cast<uint32_t>(strtoul(argv[3], nullptr, 10)) : 0;
+	const bool software = (argc > 4) && strcmp(argv[4], "software") == 0;
+	const uint32_t materials = (argc > 5) ? static_cast<uint32_t>(strtoul(argv[5], nullptr, 10)) : 2;
+	const uint32_t sweepThreads = (argc > 6) ? static_cast<uint32_t>(strtoul(argv[6], nullptr, 10)) : 0;
+
+	if(frames < 2 || materials < 2 || (argc > 4 && !software && strcmp(argv[4], "headless") != 0))
+	{
+		printf("Usage: renderbenchmark [entity count] [frames, at least 2] [percent static] [headless|software] [materials, at least 2] [threads to sweep up to]\n");
+		return 1;
+	}
+
+	try
+	{
+		WriteScene(count, staticPercent, materials);
+
+		LB::RendererStatistics statistics;
+		const Timings timings = RenderScene(frames, 0, software, &statistics);
+
+		printf("%u entities, %u dynamic, %u draws, %u static draws, %u recording threads\n", count, statistics.instances, statistics.drawCalls, statistics.staticDraws, statistics.recordingThreads);
+		printf("Per frame: extract %.3f ms, sort %.3f ms, instances %.3f ms, record %.3f ms, total %.3f ms\n", timings.extract, timings.sort, timings.instances, timings.record, timings.frame);
+
+		if(software)
+			printf("Rasterizer: %.3f ms per frame, overdraw %.2f\n", timings.raster, timings.overdraw);
+
+		uint64_t publishWaits = 0;
+		const double threaded = RenderSceneThreaded(frames, software, &publishWaits);
+		printf("Simulation thread: %.3f ms per frame, inline %.3f ms, simulation waited %llu times\n", threaded, timings.frame, static_cast<unsigned long long>(publishWaits));
+
+		// Recording only uses more threads if there are enough draws for them.
+		for(uint32_t threads = 1; threads <= sweepThreads; threads++)
+		{
+			const Timings sweep = RenderScene(frames, threads, software, &statistics);
+			printf("%u threads, %u recording: sort %.3f ms, instances %.3f ms, record %.3f ms, total %.3f ms\n", threads, statistics.recordingThreads, sweep.sort, sweep.instances, sweep.record, sweep.frame);
+		}
+	}
+	catch(std::exception &e)
+	{
+		printf("%s\n", e.what());
+		remove(ScenePath);
+		return 1;
+	}
+
+	remove(ScenePath);
+	return 0;
+}
@@ -0,0 +1,310 @@
+//
+//  SceneTool.cpp
+//  leapBoxing15
+//
+//  Command line utility for binary scene files, builds standalone on every platform:
+//  g++ -std=c++14 -O2 -I../Sources SceneTool.cpp ../Sources/LBSceneFile.cpp -o scenetool
+//
+
+#include "LBSceneFile.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace
+{
+	int PrintUsage()
+	{
+		printf("Usage:\n");
+		printf("  scenetool validate <file>\n");
+		printf("  scenetool dump <file>\n");
+		printf("  scenetool generate <file> <entity count>\n");
+		printf("  scenetool benchmark <entity count> [runs]\n");
+		return 1;
+	}
+
+	int Validate(const char *path)
+	{
+		FILE *file = fopen(path, "rb");
+		if(!file)
+		{
+			printf("%s: cannot open file\n", path);
+			return 1;
+		}
+
+		std::vector<uint8_t> data;
+		uint8_t buffer[65536];
+		size_t read;
+		while((read = fread(buffer, 1, sizeof(buffer), file)) > 0)
+			data.insert(data.end(), buffer, buffer + read);
+		fclose(file);
+
+		std::string error;
+		if(!LB::SceneFile::Validate(data.data(), data.size(), &error))
+		{
+			printf("%s: %s\n", path, error.c_str());
+			return 1;
+		}
+
+		printf("%s: OK\n", path);
+		return 0;
+	}
+
+	int Dump(const char *path)
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+
+		LB::SceneFile file;
+		file.Open(path);
+
+		// Touch every entity once so the timing includes the page faults.
+		float checksum = 0.0f;
+		for(uint32_t i = 0; i < file.GetEntityCount(); i++)
+			checksum += file.GetEntity(i).position[0];
+
+		auto end = std::chrono::high_resolution_clock::now();
+		const double milliseconds = std::chrono::duration<double, std::milli>(end - start).count();
+
+		printf("%s: %u bytes, %u entities, %u meshes, %u materials (checksum %f)\n", path, static_cast<uint32_t>(file.GetSize()), file.GetEntityCount(), file.GetMeshCount(), file.GetMaterialCount(), checksum);
+		for(uint32_t i = 0; i < file.GetMeshCount(); i++)
+			printf("  mesh %u: %s\n", i, file.GetMeshName(i));
+		for(uint32_t i = 0; i < file.GetMaterialCount(); i++)
+			printf("  material %u: %s\n", i, file.GetMaterialName(i));
+		printf("Mapped and touched in %.3f ms\n", milliseconds);
+
+		return 0;
+	}
+
+	int Generate(const char *path, uint32_t count)
+	{
+		LB::SceneFileWriter writer;
+		const uint32_t mesh = writer.AddMesh("cube");
+		const uint32_t material = writer.AddMaterial("shaders.hlsl");
+
+		// Lay the entities out in a square grid, every eighth one is parented to the
+		// previous root so the hierarchy path is exercised as well.
+		const uint32_t side = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<double>(count))));
+		uint32_t root = 0;
+		float rootPosition[3] = { 0.0f, 0.0f, 0.0f };
+
+		for(uint32_t i = 0; i < count; i++)
+		{
+			LB::SceneFileEntity entity = {};
+			const bool isChild = (i % 8) != 0;
+
+			entity.position[0] = isChild ? 0.0f : static_cast<float>(i % side) * 3.0f;
+			entity.position[1] = isChild ? 2.5f : 0.0f;
+			entity.position[2] = isChild ? 0.0f : static_cast<float>(i / side) * 3.0f;
+			entity.scale[0] = entity.scale[1] = entity.scale[2] = isChild ? 0.5f : 1.0f;
+			entity.rotation[3] = 1.0f;
+			entity.parent = isChild ? static_cast<int32_t>(root) : LB::SceneFileNoParent;
+			entity.mesh = mesh;
+			entity.material = material;
+
+			for(int n = 0; n < 3; n++)
+			{
+				const float center = isChild ? rootPosition[n] + entity.position[n] : entity.position[n];
+				entity.boundsMin[n] = center - entity.scale[n];
+				entity.boundsMax[n] = center + entity.scale[n];
+			}
+
+			const uint32_t index = writer.AddEntity(entity);
+			if(!isChild)
+			{
+				root = index;
+				std::copy(entity.position, entity.position + 3, rootPosition);
+			}
+		}
+
+		writer.Write(path);
+		printf("%s: wrote %u entities\n", path, count);
+		return 0;
+	}
+
+	// Text version of a scene as the baseline to compare loading against, one
+	// line per name and entity, written and parsed with stdio.
+	void WriteText(const LB::SceneFile &scene, const char *path)
+	{
+		FILE *file = fopen(path, "w");
+		if(!file)
+			throw std::runtime_error("Failed to create text scene file");
+
+		fprintf(file, "meshes %u\n", scene.GetMeshCount());
+		for(uint32_t i = 0; i < scene.GetMeshCount(); i++)
+			fprintf(file, "%s\n", scene.GetMeshName(i));
+
+		fprintf(file, "materials %u\n", scene.GetMaterialCount());
+		for(uint32_t i = 0; i < scene.GetMaterialCount(); i++)
+			fprintf(file, "%s\n", scene.GetMaterialName(i));
+
+		fprintf(file, "entities %u\n", scene.GetEntityCount());
+		for(uint32_t i = 0; i < scene.GetEntityCount(); i++)
+		{
+			const LB::SceneFileEntity &entity = scene.GetEntity(i);
+			fprintf(file, "%.9g %.9g %.9g %.9g %.9g %.9g %.9g %.9g %.9g %.9g %d %u %u %u %.9g %.9g %.9g %.9g %.9g %.9g\n",
+				entity.position[0], entity.position[1], entity.position[2],
+				entity.scale[0], entity.scale[1], entity.scale[2],
+				entity.rotation[0], entity.rotation[1], entity.rotation[2], entity.rotation[3],
+				entity.parent, entity.mesh, entity.material, entity.flags,
+				entity.boundsMin[0], entity.boundsMin[1], entity.boundsMin[2],
+				entity.boundsMax[0], entity.boundsMax[1], entity.boundsMax[2]);
+		}
+
+		fclose(file);
+	}
+
+	// Parses the text version with the same checks opening a binary scene does.
+	void LoadText(const char *path, std::vector<std::string> &meshes, std::vector<std::string> &materials, std::vector<LB::SceneFileEntity> &entities)
+	{
+		FILE *file = fopen(path, "r");
+		if(!file)
+			throw std::runtime_error("Failed to open text scene file");
+
+		bool valid = true;
+		char name[256];
+		uint32_t count = 0;
+
+		valid = valid && fscanf(file, " meshes %u", &count) == 1;
+		for(uint32_t i = 0; valid && i < count; i++)
+		{
+			valid = fscanf(file, " %255s", name) == 1;
+			meshes.push_back(name);
+		}
+
+		valid = valid && fscanf(file, " materials %u", &count) == 1;
+		for(uint32_t i = 0; valid && i < count; i++)
+		{
+			valid = fscanf(file, " %255s", name) == 1;
+			materials.push_back(name);
+		}
+
+		valid = valid && fscanf(file, " entities %u", &count) == 1;
+		entities.reserve(count);
+		for(uint32_t i = 0; valid && i < count; i++)
+		{
+			LB::SceneFileEntity entity;
+			valid = fscanf(file, "%f %f %f %f %f %f %f %f %f %f %d %u %u %u %f %f %f %f %f %f",
+				&entity.position[0], &entity.position[1], &entity.position[2],
+				&entity.scale[0], &entity.scale[1], &entity.scale[2],
+				&entity.rotation[0], &entity.rotation[1], &entity.rotation[2], &entity.rotation[3],
+				&entity.parent, &entity.mesh, &entity.material, &entity.flags,
+				&entity.boundsMin[0], &entity.boundsMin[1], &entity.boundsMin[2],
+				&entity.boundsMax[0], &entity.boundsMax[1], &entity.boundsMax[2]) == 20;
+
+			valid = valid && (entity.parent == LB::SceneFileNoParent || (entity.parent >= 0 && static_cast<uint32_t>(entity.parent) < i));
+			valid = valid && entity.mesh < meshes.size() && entity.material < materials.size();
+
+			entities.push_back(entity);
+		}
+
+		fclose(file);
+
+		if(!valid)
+			throw std::runtime_error("Invalid text scene file");
+	}
+
+	// Loads the same generated scene from the binary and the text file a few
+	// times, the files are warm in the page cache after the first run. The best
+	// run is printed, the binary one includes touching every entity.
+	int Benchmark(uint32_t count, uint32_t runs)
+	{
+		const char *binaryPath = "benchmark.scene";
+		const char *textPath = "benchmark.scene.txt";
+
+		if(Generate(binaryPath, count) != 0)
+			return 1;
+
+		{
+			LB::SceneFile file;
+			file.Open(binaryPath);
+			WriteText(file, textPath);
+		}
+
+		double binaryMilliseconds = 0.0;
+		double textMilliseconds = 0.0;
+		float binaryChecksum = 0.0f;
+		float textChecksum = 0.0f;
+
+		for(uint32_t run = 0; run < runs; run++)
+		{
+			auto start = std::chrono::high_resolution_clock::now();
+			{
+				LB::SceneFile file;
+				file.Open(binaryPath);
+
+				binaryChecksum = 0.0f;
+				for(uint32_t i = 0; i < file.GetEntityCount(); i++)
+					binaryChecksum += file.GetEntity(i).position[0];
+			}
+			auto end = std::chrono::high_resolution_clock::now();
+
+			const double binary = std::chrono::duration<double, std::milli>(end - start).count();
+			binaryMilliseconds = (run == 0) ? binary : std::min(binaryMilliseconds, binary);
+
+			start = std::chrono::high_resolution_clock::now();
+			{
+				std::vector<std::string> meshes;
+				std::vector<std::string> materials;
+				std::vector<LB::SceneFileEntity> entities;
+				LoadText(textPath, meshes, materials, entities);
+
+				textChecksum = 0.0f;
+				for(const LB::SceneFileEntity &entity : entities)
+					textChecksum += entity.position[0];
+			}
+			end = std::chrono::high_resolution_clock::now();
+
+			const double text = std::chrono::duration<double, std::milli>(end - start).count();
+			textMilliseconds = (run == 0) ? text : std::min(textMilliseconds, text);
+		}
+
+		FILE *textFile = fopen(textPath, "rb");
+		fseek(textFile, 0, SEEK_END);
+		const long textSize = ftell(textFile);
+		fclose(textFile);
+
+		LB::SceneFile file;
+		file.Open(binaryPath);
+
+		printf("%u entities, binary %u bytes, text %ld bytes, best of %u runs\n", count, static_cast<uint32_t>(file.GetSize()), textSize, runs);
+		printf("Binary: %.3f ms (checksum %f)\n", binaryMilliseconds, binaryChecksum);
+		printf("Text:   %.3f ms (checksum %f)\n", textMilliseconds, textChecksum);
+
+		file.Close();
+		remove(binaryPath);
+		remove(textPath);
+		return 0;
+	}
+}
+
+int main(int argc, char **argv)
+{
+	if(argc < 3)
+		return PrintUsage();
+
+	try
+	{
+		if(strcmp(argv[1], "validate") == 0)
+			return Validate(argv[2]);
+		if(strcmp(argv[1], "dump") == 0)
+			return Dump(argv[2]);
+		if(strcmp(argv[1], "generate") == 0 && argc >= 4)
+			return Generate(argv[2], static_cast<uint32_t>(strtoul(argv[3], nullptr, 10)));
+		if(strcmp(argv[1], "benchmark") == 0)
+			return Benchmark(static_cast<uint32_t>(strtoul(argv[2], nullptr, 10)), (argc >= 4) ? std::max(static_cast<uint32_t>(strtoul(argv[3], nullptr, 10)), 1u) : 5);
+	}
+	catch(std::exception &e)
+	{
+		printf("%s\n", e.what());
+		return 1;
+	}
+
+	return PrintUsage();
+}
@@ -9,18 +9,43 @@
 //
 //*********************************************************
 
+cbuffer FrameConstants : register(b0)
+{
+	row_major float4x4 viewProjection;
+};
+
+cbuffer DrawConstants : register(b1)
+{
+	row_major float4x4 model;
+};
+
 struct PSInput
 {
 	float4 position : SV_POSITION;
 	float4 color : COLOR;
 };
 
-PSInput VSMain(float4 position : POSITION, float4 color : COLOR)
+struct VSInput
+{
+	float4 position : POSITION;
+	float4 color : COLOR;
+
+	// Per instance affine world matrix, the first three columns of its rows.
+	// world3 is the translation.
+	float3 world0 : WORLD0;
+	float3 world1 : WORLD1;
+	float3 world2 : WORLD2;
+	float3 world3 : WORLD3;
+};
+
+PSInput VSMain(VSInput input)
 {
 	PSInput result;
 
-	position.xyz *= 0.2f;
-	position.z += 0.5f;
+	float3 worldPosition = mul(input.position.xyz, float3x3(input.world0, input.world1, input.world2)) + input.world3;
+	float4 position = mul(mul(float4(worldPosition, 1.0f), model), viewProjection);
+	float4 color = input.color;
+
 	result.position = position;
 	result.color = color;
 